@@ -1,4 +1,7 @@
-#include "Common.h"
+#define _CRT_SECURE_NO_WARNINGS   // scanf
+#include "socket_core.h"          // 소켓 (Windows, Linux 공통). 수업 자료의 Common.h 대신
+#include <cstdio>
+#include <cstring>
 #include <vector>
 #include <string>
 
@@ -42,7 +45,7 @@ const char* SearchFriendIP(const char* name)
 }
 
 int main()
-{
+try {
     int retval;
     char inputName[100];
 
@@ -65,21 +68,15 @@ int main()
 
     printf("선택된 친구 [%s] 의 IP: %s\n", inputName, SERVERIP);
 
-    // 윈속 초기화
-    WSADATA wsa;
-    if (WSAStartup(MAKEWORD(2, 2), &wsa) != 0)
-        return 1;
+    // 윈속 초기화 (끝나면 소멸자가 WSACleanup)
+    net::WinsockInit winsock;
 
-    // UDP 소켓 생성
-    SOCKET sock = socket(AF_INET, SOCK_DGRAM, 0);
-    if (sock == INVALID_SOCKET) err_quit("socket()");
+    // UDP 소켓 생성 (실패하면 runtime_error, 소멸자가 closesocket)
+    net::Socket sock = net::Socket::udp();
 
     // 서버 주소 (상대방 IP)
     struct sockaddr_in serveraddr;
-    memset(&serveraddr, 0, sizeof(serveraddr));
-    serveraddr.sin_family = AF_INET;
-    inet_pton(AF_INET, SERVERIP, &serveraddr.sin_addr);
-    serveraddr.sin_port = htons(SERVERPORT);
+    net::parseAddress(SERVERIP, SERVERPORT, serveraddr);
 
     // 버퍼 비우기
     getchar();
@@ -101,18 +98,20 @@ int main()
             break;
 
         // sendto() → 보내기만 하고, 절대 recvfrom() 호출 안함
-        retval = sendto(sock, buf, strlen(buf), 0,
+        retval = sendto(sock.get(), buf, (int)strlen(buf), 0,
             (struct sockaddr*)&serveraddr, sizeof(serveraddr));
 
         if (retval == SOCKET_ERROR) {
-            err_display("sendto()");
+            printf("[sendto()] %s\n", net::lastWinsockError().c_str());
             break;
         }
 
         printf("[UDP 단순 송신] %d바이트 전송됨\n", retval);
     }
 
-    closesocket(sock);
-    WSACleanup();
     return 0;
 }
+catch (const std::exception& e) {
+    printf("[오류] %s\n", e.what());
+    return 1;
+}
@@ -1,21 +1,14 @@
 // 키보드로 부터 문자열로 표현되는 IP 주소(예: "127.0.0.1")를 입력 받아 16진수 값으로 변환하는 함수를 이용하여 변환한 후 화면에 출력하는 프로그램 작성 (cin, cout 사용)
 
-#include <winsock2.h>
-#include <ws2tcpip.h>   // inet_pton, sockaddr_in
+#include "socket_core.h"   // inet_pton, sockaddr_in, Winsock 초기화 (Linux 에서도 빌드된다)
 #include <iostream>
 #include <string>
 
-#pragma comment(lib, "Ws2_32.lib")  // Winsock 라이브러리 연결
-
 using namespace std;
 
-int main() {
-    // 윈속 초기화
-    WSADATA wsa;
-    if (WSAStartup(MAKEWORD(2, 2), &wsa) != 0) {
-        cout << "윈속 초기화 실패" << endl;
-        return 1;
-    }
+int main() try {
+    // 윈속 초기화 (끝나면 소멸자가 WSACleanup)
+    net::WinsockInit winsock;
 
     string ipStr;
     cout << "IP 주소 입력: ";
@@ -32,7 +25,10 @@ int main() {
             << hex << uppercase << ntohl(addr.s_addr) << endl;
     }
 
-    WSACleanup();
     return 0;
 }
+catch (const exception&) {
+    cout << "윈속 초기화 실패" << endl;
+    return 1;
+}
 
@@ -1,272 +1,603 @@
-// TCP서버 코드
+// TCP 파일 서버 / 클라이언트
+//   실행하면 1) 서버 2) 클라이언트 3) 벤치마크 를 고른다. 소켓과 이벤트 루프는 socket_core.h (Windows, Linux 둘 다 빌드된다)
+//   Windows: cl /std:c++17 /EHsc "TCP 서버 - 클라이언트 개발.cpp"
+//   Linux:   g++ -std=c++17 -O2 "TCP 서버 - 클라이언트 개발.cpp" -o fileserver
+//   TLS:     g++ -std=c++17 -O2 -DNET_TLS "TCP 서버 - 클라이언트 개발.cpp" -o fileserver -lssl -lcrypto   (tls_core.h)
+//
+//   명령 (클라이언트 -> 서버, recv 한 번 = 명령 하나): list / get <파일명>
+//   응답 (서버 -> 클라이언트): int status (1 성공, -1 실패) + int size + 데이터 size 바이트
+//   get 은 작은 파일만 메모리로 읽고, 큰 파일은 소켓이 받는 만큼 sendfile 로 보낸다 (Linux. 다른 POSIX 는 pread + send)
+//
+//   옵션: --write-policy latency|throughput  (서버, 기본 latency, socket_core.h 의 WritePolicy)
+//         --flush-window-us N  --flush-bytes N    throughput 에서 작은 응답을 모으는 시간 / 크기
+//         --tls                                  서버 / 클라이언트 모두 TLS. handshake 뒤 키를 커널에 넘겨 (kTLS)
+//                                                sendfile 이 그대로 암호화되어 나간다. 커널이 못 받으면 userspace 암호화
+//         --tls-cert F --tls-key F               서버 인증서 (PEM). 없으면 임시 self-signed
+//         --tls-ca F                             클라이언트가 서버 인증서를 이 CA 로 검증. 없으면 시스템 CA
+//         --tls-insecure                         클라이언트가 서버 인증서를 검증하지 않는다 (self-signed 시험용, 중간자에 무방비)
+//   벤치마크: 루프백에서 같은 파일을 get 해 plain, TLS (kTLS), TLS (userspace) 처리량과 CPU 를 비교한다
 
 #define _WINSOCK_DEPRECATED_NO_WARNINGS
-#include <winsock2.h>      // 소켓 함수 사용
+#include "socket_core.h"   // 소켓, Poller
+#include "tls_core.h"      // -DNET_TLS 일 때만: OpenSSL handshake + kTLS
 #include <iostream>        // 입출력
 #include <fstream>         // 파일 입출력
 #include <vector>          // 동적 배열
 #include <string>          // 문자열
-#include <io.h>            // _findfirst, _findnext
+#include <filesystem>      // 현재 폴더 파일 목록
+#include <unordered_map>   // 소켓 -> 클라이언트
+#include <csignal>
+#include <chrono>
+#include <optional>        // --tls 일 때만 만드는 context
+#include <thread>          // 벤치마크: 서버 스레드
+#include <ctime>           // 벤치마크: CPU 시간
+#ifndef _WIN32
+#include <sys/stat.h>
+#endif
+#ifdef __linux__
+#include <sys/sendfile.h>
+#endif
 
-#pragma comment(lib, "ws2_32.lib")   // Winsock 라이브러리 링크
 using namespace std;
 
-/* ----------------------------------------------------------
-   SendAll()
-   - send()는 한 번에 모든 데이터를 보내지 못할 수 있기 때문에
-     반복적으로 끝까지 보낼 때까지 전송하는 함수
----------------------------------------------------------- */
-bool SendAll(SOCKET s, const char* data, int size) {
-    int sent = 0, ret;
-    while (sent < size) {
-        ret = send(s, data + sent, size - sent, 0);
-        if (ret <= 0) return false;   // 전송 실패
-        sent += ret;
-    }
-    return true;
-}
+#ifndef NET_HAVE_TLS
+namespace net { struct TlsContext {}; }   // NET_TLS 없이 빌드: TLS context 포인터는 늘 nullptr
+#endif
+
+const unsigned short FILE_PORT = 9000;
+const unsigned short BENCH_PORT = FILE_PORT + 1;
+bool LogCommands = true;                 // 명령마다 한 줄. 벤치마크는 끈다
+
+/* ==========================================================
+   TCP서버 코드
+========================================================== */
 
 /* ----------------------------------------------------------
    GetFileList()
    - 현재 폴더의 파일 목록을 문자열로 만들어 반환
-   - _findfirst(), _findnext()를 이용하여 파일 탐색
+   - std::filesystem 으로 탐색 (Windows, Linux 공통)
 ---------------------------------------------------------- */
 string GetFileList() {
     string result = "";
-    struct _finddata_t fd;
-    intptr_t handle = _findfirst("*.*", &fd);   // 모든 파일 검색
-
-    if (handle == -1) return "";                // 파일 없음
-
-    do {
-        if (!(fd.attrib & _A_SUBDIR)) {         // 폴더가 아닌 경우만
-            result += fd.name;
+    error_code ec;
+    for (auto& e : filesystem::directory_iterator(".", ec)) {
+        if (!e.is_directory(ec)) {            // 폴더가 아닌 경우만
+            result += e.path().filename().string();
             result += "\n";
         }
-    } while (_findnext(handle, &fd) == 0);
-
-    _findclose(handle);
+    }
     return result;
 }
 
-int main() {
-
-    /* ------------------------------------------------------
-       WinSock 초기화
-    ------------------------------------------------------ */
-    WSADATA wsa;
-    WSAStartup(MAKEWORD(2, 2), &wsa);
-
-    /* ------------------------------------------------------
-       서버 소켓 생성 (TCP)
-    ------------------------------------------------------ */
-    SOCKET server = socket(AF_INET, SOCK_STREAM, 0);
-
-    /* ------------------------------------------------------
-       서버 주소 설정
-    ------------------------------------------------------ */
-    sockaddr_in addr = {};
-    addr.sin_family = AF_INET;
-    addr.sin_port = htons(9000);     // 포트 9000
-    addr.sin_addr.s_addr = INADDR_ANY; // 모든 IP 허용
+#ifndef _WIN32
+/* ----------------------------------------------------------
+   FileSpan
+   - get 이 보낼 파일 구간. out 을 다 보낸 뒤 소켓이 받는 만큼 나가고, 다 나가면 닫는다
+---------------------------------------------------------- */
+struct FileSpan {
+    int fd = -1;
+    uint64_t off = 0, len = 0;
+    FileSpan() = default;
+    FileSpan(const FileSpan&) = delete;
+    FileSpan& operator=(const FileSpan&) = delete;
+    ~FileSpan() { reset(); }
+    void reset() { if (fd >= 0) close(fd); fd = -1; off = len = 0; }
+};
+
+const uint64_t FILE_SPAN_MIN = 64 << 10;   // 이보다 큰 파일은 out 에 읽지 않고 FileSpan 으로
+#endif
 
-    /* ------------------------------------------------------
-       서버 소켓 바인딩 + 리슨
-    ------------------------------------------------------ */
-    bind(server, (sockaddr*)&addr, sizeof(addr));
-    listen(server, 5);
+/* ----------------------------------------------------------
+   클라이언트 하나의 상태
+   - 응답은 out 에 쌓아 두고 소켓이 쓸 수 있을 때 보낸다
+     (큰 파일을 받는 클라이언트 하나 때문에 다른 클라이언트가 멈추지 않도록)
+   - 큰 파일은 out 뒤에 file 로 이어진다. 그동안은 다음 명령을 읽지 않는다 (응답 순서)
+---------------------------------------------------------- */
+struct FileClient {
+    net::Socket sock;
+    string out;          // 아직 못 보낸 응답
+    size_t sent = 0;     // out 중 보낸 바이트
+    chrono::steady_clock::time_point flushAt{};   // throughput: 모으는 중이면 보낼 시각
+#ifndef _WIN32
+    FileSpan file;
+#endif
+#ifdef NET_HAVE_TLS
+    unique_ptr<net::TlsSession> tls;              // --tls 면 accept 때 만든다
+    net::TlsSession::Step step = net::TlsSession::WantRead;
+#endif
+};
+
+bool Collecting(const FileClient& c) { return c.flushAt != chrono::steady_clock::time_point{}; }
+
+// 보낼 파일이 남았는지 (남았으면 명령을 더 읽지 않는다)
+bool Busy(const FileClient& c) {
+#ifndef _WIN32
+    return c.file.len > 0;
+#else
+    (void)c;
+    return false;
+#endif
+}
 
-    cout << "[서버] 접속 대기중..." << endl;
+bool Handshaking(const FileClient& c) {
+#ifdef NET_HAVE_TLS
+    return c.tls && c.step != net::TlsSession::Done;
+#else
+    (void)c;
+    return false;
+#endif
+}
 
-    while (true) {
+/* ----------------------------------------------------------
+   SendSome() / RecvSome()
+   - send / recv 한 번. TLS 인데 그 방향이 커널 (kTLS) 이 아니면 SSL_write / SSL_read
+   - 바이트 수, 0 = 지금은 못 한다 (Poller 로 기다린다), -1 = 끊김
+---------------------------------------------------------- */
+int SendSome(FileClient& c, const char* data, size_t size) {
+    int n = (int)min<size_t>(size, 1 << 30);
+#ifdef NET_HAVE_TLS
+    if (c.tls && !c.tls->kernelSend()) {
+        int ret = c.tls->write(data, n);
+        return ret == net::TlsSession::AGAIN ? 0 : (ret > 0 ? ret : -1);
+    }
+#endif
+    int ret = send(c.sock.get(), data, n, 0);
+    if (ret == SOCKET_ERROR && WSAGetLastError() == WSAEWOULDBLOCK) return 0;
+    return ret > 0 ? ret : -1;
+}
 
-        /* ----------------------------------------------
-           클라이언트 접속 기다림 (수락)
-        ---------------------------------------------- */
-        SOCKET client = accept(server, NULL, NULL);
-        cout << "[서버] 클라이언트 연결됨" << endl;
+int RecvSome(FileClient& c, char* buf, int size) {
+#ifdef NET_HAVE_TLS
+    if (c.tls) {   // kTLS 수신이어도 OpenSSL 이 control record 를 처리하도록 SSL_read 로
+        int ret = c.tls->read(buf, size);
+        return ret == net::TlsSession::AGAIN ? 0 : (ret > 0 ? ret : -1);
+    }
+#endif
+    int ret = recv(c.sock.get(), buf, size, 0);
+    if (ret == SOCKET_ERROR && WSAGetLastError() == WSAEWOULDBLOCK) return 0;
+    return ret > 0 ? ret : -1;
+}
 
-        while (true) {
+#ifndef _WIN32
+/* ----------------------------------------------------------
+   SendFileSome()
+   - file 을 소켓이 받는 만큼 보낸다. 연결이 끊겼거나 파일이 줄었으면 false
+   - plain 이나 kTLS 송신이면 sendfile: 파일이 userspace 로 올라오지 않고 암호화도 커널이 한다.
+     userspace TLS (와 Linux 가 아닌 POSIX) 는 pread 로 읽어 SendSome
+---------------------------------------------------------- */
+bool SendFileSome(FileClient& c) {
+    FileSpan& f = c.file;
+    while (f.len > 0) {
+        int64_t n;
+#ifdef __linux__
+#ifdef NET_HAVE_TLS
+        bool kernel = !c.tls || c.tls->kernelSend();
+#else
+        bool kernel = true;
+#endif
+        if (kernel) {
+            off_t o = (off_t)f.off;
+            n = sendfile(c.sock.get(), f.fd, &o, (size_t)min<uint64_t>(f.len, 1 << 30));
+            if (n < 0 && errno == EINTR) continue;
+            if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return true;   // 나머지는 다음 WRITE 때
+            if (n <= 0) return false;
+        }
+        else
+#endif
+        {
+            static thread_local char chunk[1 << 16];
+            ssize_t r = pread(f.fd, chunk, (size_t)min<uint64_t>(sizeof(chunk), f.len), (off_t)f.off);
+            if (r <= 0) return false;
+            n = SendSome(c, chunk, (size_t)r);   // 일부만 나가도 다음에 같은 자리부터 다시 읽는다
+            if (n == 0) return true;
+            if (n < 0) return false;
+        }
+        f.off += (uint64_t)n;
+        f.len -= (uint64_t)n;
+    }
+    f.reset();
+    return true;
+}
+#endif
 
-            /* ------------------------------------------
-               클라이언트 명령 수신
-            ------------------------------------------ */
-            char buf[256] = {};
-            int recvLen = recv(client, buf, sizeof(buf) - 1, 0);
+/* ----------------------------------------------------------
+   Reply()
+   - status, size 와 데이터를 out 뒤에 붙인다
+---------------------------------------------------------- */
+void ReplyHeader(FileClient& c, int status, int size) {
+    c.out.append((const char*)&status, sizeof(int));
+    c.out.append((const char*)&size, sizeof(int));
+}
 
-            if (recvLen <= 0) break;    // 클라 종료
+void Reply(FileClient& c, int status, const char* data, int size) {
+    ReplyHeader(c, status, size);
+    if (size > 0) c.out.append(data, size);
+}
 
-            string cmd(buf);            // 문자열로 변환
+/* ----------------------------------------------------------
+   ReplyFile()
+   - get 의 성공 응답. 작은 파일은 out 에 읽어 붙이고, 큰 파일은 FileSpan 으로 열어 둔다
+   - 파일이 없거나 읽을 수 없으면 false (out 은 그대로)
+---------------------------------------------------------- */
+#ifndef _WIN32
+bool ReplyFile(FileClient& c, const string& filename) {
+    int fd = open(filename.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size > INT_MAX) {
+        close(fd);
+        return false;
+    }
+    int size = (int)st.st_size;
+    if ((uint64_t)size >= FILE_SPAN_MIN) {
+        ReplyHeader(c, 1, size);
+        c.file.fd = fd;
+        c.file.len = (uint64_t)size;
+        return true;
+    }
+    size_t at = c.out.size();
+    ReplyHeader(c, 1, size);
+    size_t head = c.out.size();
+    c.out.resize(head + size);
+    for (size_t got = 0; got < (size_t)size;) {
+        ssize_t r = pread(fd, &c.out[head + got], size - got, (off_t)got);
+        if (r <= 0) {
+            c.out.resize(at);
+            close(fd);
+            return false;
+        }
+        got += (size_t)r;
+    }
+    close(fd);
+    return true;
+}
+#else
+bool ReplyFile(FileClient& c, const string& filename) {
+    ifstream file(filename, ios::binary);
+    if (!file.is_open()) return false;
+
+    // 파일 크기 구하기
+    file.seekg(0, ios::end);
+    int size = (int)file.tellg();
+    file.seekg(0, ios::beg);
+    if (size < 0) return false;
+
+    vector<char> buffer(size);
+    file.read(buffer.data(), size);
+
+    // 성공 + 파일 데이터
+    Reply(c, 1, buffer.data(), size);
+    return true;
+}
+#endif
 
-            /* ==========================================
-               LIST 명령 처리
-            ========================================== */
-            if (cmd == "list") {
+/* ----------------------------------------------------------
+   HandleCommand()
+   - 명령 하나를 처리해 응답을 out 에 넣는다
+---------------------------------------------------------- */
+void HandleCommand(FileClient& c, const string& cmd) {
 
-                // 파일 목록 받아오기
-                string files = GetFileList();
+    /* ==========================================
+       LIST 명령 처리
+    ========================================== */
+    if (cmd == "list") {
 
-                // 파일이 하나도 없으면 실패로 전달
-                if (files.empty()) {
-                    int status = -1;
-                    int size = 0;
-                    send(client, (char*)&status, sizeof(int), 0);
-                    send(client, (char*)&size, sizeof(int), 0);
-                    continue;
-                }
+        // 파일 목록 받아오기
+        string files = GetFileList();
 
-                int status = 1;
-                int size = files.size();
+        // 파일이 하나도 없으면 실패로 전달
+        if (files.empty()) {
+            Reply(c, -1, nullptr, 0);
+            return;
+        }
 
-                // 먼저 status, size 전송
-                send(client, (char*)&status, sizeof(int), 0);
-                send(client, (char*)&size, sizeof(int), 0);
+        // status, size, 실제 파일 목록
+        Reply(c, 1, files.data(), (int)files.size());
+        if (LogCommands) cout << "[서버] LIST 전송" << endl;
+    }
 
-                // 실제 파일 목록 전송
-                SendAll(client, files.c_str(), size);
+    /* ==========================================
+       GET 명령 처리 (파일 다운로드)
+    ========================================== */
+    else if (cmd.rfind("get ", 0) == 0) {
 
-                cout << "[서버] LIST 전송 완료" << endl;
-                continue;
-            }
+        string filename = cmd.substr(4);  // 파일명 추출
 
-            /* ==========================================
-               GET 명령 처리 (파일 다운로드)
-            ========================================== */
-            else if (cmd.rfind("get ", 0) == 0) {
+        // 파일 열기 + 성공 응답
+        if (!ReplyFile(c, filename)) {
+            Reply(c, -1, nullptr, 0);      // 실패 전송
+            if (LogCommands) cout << "[서버] 파일 없음: " << filename << endl;
+            return;
+        }
+        if (LogCommands) cout << "[서버] 파일 전송: " << filename << endl;
+    }
 
-                string filename = cmd.substr(4);  // 파일명 추출
+    /* ==========================================
+       알 수 없는 명령 처리
+    ========================================== */
+    else {
+        Reply(c, -1, nullptr, 0);
+        if (LogCommands) cout << "[서버] 잘못된 명령: " << cmd << endl;
+    }
+}
 
-                // 파일 열기
-                ifstream file(filename, ios::binary);
-                if (!file.is_open()) {
-                    // 실패 전송
-                    int status = -1;
-                    int size = 0;
-                    send(client, (char*)&status, sizeof(int), 0);
-                    send(client, (char*)&size, sizeof(int), 0);
+/* ----------------------------------------------------------
+   Flush()
+   - out 과 (있으면) 파일을 보낼 수 있는 만큼 보낸다. 연결이 끊겼으면 false
+   - throughput 이면 cork 로 감싸 꽉 찬 segment 로 보내고, 다 보냈을 때 풀어서 꼬리를 내보낸다
+     (다 못 보냈으면 다음 WRITE 까지 cork 를 유지한다)
+---------------------------------------------------------- */
+bool Flush(FileClient& c, const net::WritePolicy& wp) {
+    bool corked = wp.mode == net::WriteMode::Throughput;
+    c.flushAt = {};
+    if (corked && (c.sent < c.out.size() || Busy(c))) net::cork(c.sock.get(), true);
+    while (c.sent < c.out.size()) {
+        int ret = SendSome(c, c.out.data() + c.sent, c.out.size() - c.sent);
+        if (ret == 0) return true;    // 나머지는 다음 WRITE 때
+        if (ret < 0) return false;    // 전송 실패
+        c.sent += ret;
+    }
+    c.out.clear();
+    c.sent = 0;
+#ifndef _WIN32
+    if (Busy(c)) {
+        if (!SendFileSome(c)) return false;
+        if (Busy(c)) return true;     // 나머지는 다음 WRITE 때
+    }
+#endif
+    if (corked) net::cork(c.sock.get(), false);
+    return true;
+}
 
-                    cout << "[서버] 파일 없음: " << filename << endl;
-                    continue;
-                }
+/* ----------------------------------------------------------
+   Ready()
+   - 지금 보낼지. latency 는 항상, throughput 은 작은 응답이면 window 동안 모았다가
+---------------------------------------------------------- */
+bool Ready(FileClient& c, const net::WritePolicy& wp, chrono::steady_clock::time_point now) {
+    if (wp.mode == net::WriteMode::Latency || Busy(c) || c.out.size() - c.sent >= wp.bytes) return true;
+    if (c.sent > 0) return true;                      // 이미 보내는 중 (WRITE 대기)
+    if (!Collecting(c)) c.flushAt = now + wp.window;
+    return now >= c.flushAt;
+}
 
-                // 파일 크기 구하기
-                file.seekg(0, ios::end);
-                int size = (int)file.tellg();
-                file.seekg(0, ios::beg);
+/* ----------------------------------------------------------
+   서버 설정
+---------------------------------------------------------- */
+struct ServerConfig {
+    unsigned short port = FILE_PORT;
+    net::WritePolicy write;
+    const net::TlsContext* tls = nullptr;   // --tls
+    net::Waker* stop = nullptr;             // 벤치마크: wake() 하면 RunServer 가 돌아온다
+};
 
-                vector<char> buffer(size);
-                file.read(buffer.data(), size);
+int RunServer(const ServerConfig& cfg) {
+    const net::WritePolicy& wp = cfg.write;
 
-                int status = 1;
+    /* ------------------------------------------------------
+       서버 소켓 생성 + 바인딩 + 리슨 (TCP, 모든 IP, 포트 9000)
+    ------------------------------------------------------ */
+    net::Socket server = net::tcpListen(cfg.port, 5);
+    net::setNonBlocking(server.get());
 
-                // 성공 전송
-                send(client, (char*)&status, sizeof(int), 0);
-                send(client, (char*)&size, sizeof(int), 0);
+    /* ------------------------------------------------------
+       이벤트 루프
+       - 서버 소켓과 모든 클라이언트 소켓을 Poller 하나로 기다린다
+         (host 에서 쓸 수 있는 가장 빠른 backend: epoll, io_uring, poll, select)
+    ------------------------------------------------------ */
+    net::Poller poller;
+    poller.add(server.get(), net::Poller::READ);
+    if (cfg.stop) poller.add(cfg.stop->fd(), net::Poller::READ);
+    unordered_map<SOCKET, FileClient> clients;
+    vector<net::Poller::Event> events;
+
+    cout << "[서버] 접속 대기중... (포트 " << cfg.port << ", " << net::backendName(poller.backend())
+         << ", " << net::writeModeName(wp.mode) << (cfg.tls ? ", TLS" : "") << ")" << endl;
+
+    // 연결이 끊겼으면 닫고 지운다. 아니면 지금 기다릴 것: handshake 가 원하는 것, 파일을 보내는 중이면 WRITE 만,
+    // 보낼 응답이 남았으면 (모으는 중이 아니면) WRITE 도
+    auto settle = [&](unordered_map<SOCKET, FileClient>::iterator it, bool alive) {
+        SOCKET fd = it->first;
+        FileClient& c = it->second;
+        if (alive) {
+            int want = net::Poller::READ;
+#ifdef NET_HAVE_TLS
+            if (Handshaking(c) && c.step == net::TlsSession::WantWrite) want |= net::Poller::WRITE;
+#endif
+            if (!Handshaking(c) && Busy(c)) want = net::Poller::WRITE;
+            else if (!c.out.empty() && !Collecting(c)) want |= net::Poller::WRITE;
+            poller.modify(fd, want);
+            return;
+        }
+        poller.remove(fd);
+        clients.erase(it);
+        cout << "[서버] 클라이언트 종료" << endl;
+    };
 
-                // 파일 데이터 전송
-                SendAll(client, buffer.data(), size);
+    while (true) {
+        /* --------------------------------------------------
+           throughput 에서 모으는 중인 클라이언트가 있으면 가장 이른 flushAt 까지만 기다린다
+        -------------------------------------------------- */
+        auto now = chrono::steady_clock::now();
+        int64_t timeoutUs = -1;
+        for (auto& [fd, c] : clients) {
+            if (!Collecting(c)) continue;
+            int64_t us = max<int64_t>(0, chrono::ceil<chrono::microseconds>(c.flushAt - now).count());
+            if (timeoutUs < 0 || us < timeoutUs) timeoutUs = us;
+        }
+        poller.waitUs(events, timeoutUs);
+
+        /* --------------------------------------------------
+           window 가 지난 응답 전송
+        -------------------------------------------------- */
+        now = chrono::steady_clock::now();
+        for (auto it = clients.begin(); it != clients.end();) {
+            auto cur = it++;
+            if (Collecting(cur->second) && now >= cur->second.flushAt) settle(cur, Flush(cur->second, wp));
+        }
 
-                cout << "[서버] 파일 전송 완료: " << filename << endl;
+        for (auto& ev : events) {
+            if (cfg.stop && ev.fd == cfg.stop->fd()) return 0;
+
+            /* ----------------------------------------------
+               클라이언트 접속 (수락)
+            ---------------------------------------------- */
+            if (ev.fd == server.get()) {
+                SOCKET s = accept(server.get(), NULL, NULL);
+                if (s == INVALID_SOCKET) continue;
+                net::setNonBlocking(s);
+                net::setNoDelay(s);   // 모으는 것은 Ready/Flush 가 정한다 (Nagle 이 작은 응답을 잡아 두지 않도록)
+                try {
+                    poller.add(s, net::Poller::READ);
+                }
+                catch (const exception& e) {     // select 의 FD_SETSIZE 등
+                    cout << "[서버] 접속 거절: " << e.what() << endl;
+                    closesocket(s);
+                    continue;
+                }
+                FileClient& c = clients[s];
+                c.sock.reset(s);
+#ifdef NET_HAVE_TLS
+                if (cfg.tls) c.tls = make_unique<net::TlsSession>(*cfg.tls, s);
+#endif
+                cout << "[서버] 클라이언트 연결됨" << endl;
                 continue;
             }
 
-            /* ==========================================
-               알 수 없는 명령 처리
-            ========================================== */
-            else {
-                int status = -1;
-                int size = 0;
-                send(client, (char*)&status, sizeof(int), 0);
-                send(client, (char*)&size, sizeof(int), 0);
+            auto it = clients.find(ev.fd);
+            if (it == clients.end()) continue;
+            FileClient& c = it->second;
+            bool alive = true;
+            int what = ev.events;
+
+#ifdef NET_HAVE_TLS
+            /* ----------------------------------------------
+               TLS handshake. 끝나면 OpenSSL 이 세션 키를 커널에 넘긴다 (되면 kTLS)
+            ---------------------------------------------- */
+            if (Handshaking(c)) {
+                c.step = c.tls->handshake();
+                if (c.step == net::TlsSession::Failed) {
+                    cout << "[서버] TLS handshake 실패: " << c.tls->error << endl;
+                    settle(it, false);
+                    continue;
+                }
+                if (c.step != net::TlsSession::Done) {
+                    settle(it, true);
+                    continue;
+                }
+                cout << "[서버] TLS 연결: " << c.tls->describe() << endl;
+                what = net::Poller::READ;   // 같이 온 명령이 있으면 바로 읽는다
+            }
+#endif
 
-                cout << "[서버] 잘못된 명령: " << cmd << endl;
-                continue;
+            /* ----------------------------------------------
+               클라이언트 명령 수신 (파일을 보내는 중이면 다 보낸 뒤에)
+            ---------------------------------------------- */
+            if ((what & net::Poller::READ) && !Busy(c)) {
+                char buf[256] = {};
+                int recvLen = RecvSome(c, buf, sizeof(buf) - 1);
+
+                if (recvLen < 0) alive = false;          // 클라 종료
+                else if (recvLen > 0) HandleCommand(c, string(buf));
             }
-        }
 
-        /* ------------------------------------------
-           클라이언트 소켓 종료
-        ------------------------------------------ */
-        closesocket(client);
-        cout << "[서버] 클라이언트 종료" << endl;
+            /* ----------------------------------------------
+               쌓인 응답 전송 (throughput 이면 window 가 찰 때까지 모은다).
+               다 못 보냈으면 WRITE 도 기다린다. 끊겼으면 소켓 종료
+            ---------------------------------------------- */
+            if (alive && (!c.out.empty() || Busy(c)) && Ready(c, wp, now)) alive = Flush(c, wp);
+            settle(it, alive);
+        }
     }
-
-    closesocket(server);
-    WSACleanup();
     return 0;
 }
 
+/* ==========================================================
+   TCP클라이언트 코드
+========================================================== */
 
+/* ----------------------------------------------------------
+   Link
+   - 클라이언트 쪽 연결 (blocking). TLS 면 SSL_read / SSL_write
+     (kTLS 가 켜진 방향은 OpenSSL 이 그대로 커널에 넘긴다)
+---------------------------------------------------------- */
+struct Link {
+    net::Socket sock;
+#ifdef NET_HAVE_TLS
+    unique_ptr<net::TlsSession> tls;
+#endif
+};
 
+/* ----------------------------------------------------------
+   OpenLink()
+   - 접속 + (tls 면) handshake. 실패하면 예외
+---------------------------------------------------------- */
+Link OpenLink(const string& host, unsigned short port, const net::TlsContext* tls) {
+    sockaddr_in addr;
+    if (!net::parseAddress(host, port, addr)) throw runtime_error("주소를 찾을 수 없음: " + host);
+    Link l;
+    l.sock = net::tcpConnect(addr);
+#ifdef NET_HAVE_TLS
+    if (tls) {
+        l.tls = make_unique<net::TlsSession>(*tls, l.sock.get(), false, host);
+        if (l.tls->handshake() != net::TlsSession::Done) throw runtime_error("TLS handshake 실패: " + l.tls->error);
+    }
+#else
+    (void)tls;
+#endif
+    return l;
+}
 
-
-
-
-__________________________________________________________________________________________________________________________________________________________________________________________________________________________________________________________
-
-
-
-
-
-
-
-
-// TCP클라이언트 코드
-#define _WINSOCK_DEPRECATED_NO_WARNINGS
-#include <winsock2.h>
-#include <iostream>
-#include <fstream>
-#include <vector>
-#include <string>
-
-#pragma comment(lib, "ws2_32.lib")
-using namespace std;
+/* ----------------------------------------------------------
+   LinkSend()
+   - send() 한 번. TLS 면 SSL_write (일부만 보낼 수 있다)
+---------------------------------------------------------- */
+int LinkSend(Link& l, const char* data, int size) {
+#ifdef NET_HAVE_TLS
+    if (l.tls) return l.tls->write(data, size);
+#endif
+    return send(l.sock.get(), data, size, 0);
+}
 
 /* ----------------------------------------------------------
    RecvAll()
    - recv()는 원하는 크기만큼 한 번에 오지 않을 수 있으므로
      반복적으로 끝까지 받아야 한다.
 ---------------------------------------------------------- */
-bool RecvAll(SOCKET s, char* buffer, int size) {
+bool RecvAll(Link& l, char* buffer, int size) {
     int received = 0, ret;
     while (received < size) {
-        ret = recv(s, buffer + received, size - received, 0);
+#ifdef NET_HAVE_TLS
+        if (l.tls) ret = l.tls->read(buffer + received, size - received);
+        else
+#endif
+        ret = recv(l.sock.get(), buffer + received, size - received, 0);
         if (ret <= 0) return false;  // 연결 종료 or 오류
         received += ret;
     }
     return true;
 }
 
-int main() {
+int RunClient(const string& host, const net::TlsContext* tls) {
 
     /* ------------------------------------------------------
-       WinSock 초기화
+       서버 주소 설정 + 접속 (+ TLS handshake)
     ------------------------------------------------------ */
-    WSADATA wsa;
-    WSAStartup(MAKEWORD(2, 2), &wsa);
-
-    /* ------------------------------------------------------
-       클라이언트 소켓 생성
-    ------------------------------------------------------ */
-    SOCKET client = socket(AF_INET, SOCK_STREAM, 0);
-
-    /* ------------------------------------------------------
-       서버 주소 설정
-    ------------------------------------------------------ */
-    sockaddr_in addr = {};
-    addr.sin_family = AF_INET;
-    addr.sin_port = htons(9000);
-    addr.sin_addr.s_addr = inet_addr("127.0.0.1");
-
-    /* ------------------------------------------------------
-       서버 접속
-    ------------------------------------------------------ */
-    if (connect(client, (sockaddr*)&addr, sizeof(addr)) == SOCKET_ERROR) {
-        cout << "[클라이언트] 서버 연결 실패" << endl;
+    Link client;
+    try {
+        client = OpenLink(host, FILE_PORT, tls);
+    }
+    catch (const exception& e) {
+        cout << "[클라이언트] 서버 연결 실패 (" << e.what() << ")" << endl;
         return 0;
     }
 
     cout << "[클라이언트] 서버 연결 성공" << endl;
+#ifdef NET_HAVE_TLS
+    if (client.tls) {
+        cout << "[클라이언트] TLS: " << client.tls->describe() << endl;
+        if (!tls->verifies()) cout << "[클라이언트] 주의: 서버 인증서를 검증하지 않음 (--tls-insecure)" << endl;
+    }
+#endif
 
     while (true) {
 
@@ -275,14 +606,13 @@ int main() {
         ---------------------------------------------- */
         cout << "\n명령 입력 (list / get <파일명> / quit): ";
         string cmd;
-        getline(cin, cmd);
-
-        if (cmd == "quit") break;
+        if (!getline(cin, cmd) || cmd == "quit") break;
+        if (cmd.empty()) continue;
 
         /* ----------------------------------------------
            서버로 명령 전송
         ---------------------------------------------- */
-        send(client, cmd.c_str(), cmd.size(), 0);
+        LinkSend(client, cmd.c_str(), (int)cmd.size());
 
         /* ----------------------------------------------
            모든 명령은 status 와 size 를 먼저 받음
@@ -290,54 +620,41 @@ int main() {
         int status = 0;
         int size = 0;
 
-        if (recv(client, (char*)&status, sizeof(int), 0) <= 0) {
+        if (!RecvAll(client, (char*)&status, sizeof(int))) {
             cout << "[클라이언트] status 수신 실패" << endl;
-            continue;
+            break;
         }
-        if (recv(client, (char*)&size, sizeof(int), 0) <= 0) {
+        if (!RecvAll(client, (char*)&size, sizeof(int))) {
             cout << "[클라이언트] size 수신 실패" << endl;
+            break;
+        }
+
+        if (status == -1) {
+            if (cmd == "list") cout << "[클라이언트] 목록 요청 실패" << endl;
+            else if (cmd.rfind("get ", 0) == 0) cout << "[클라이언트] 파일 없음 → 요청 실패" << endl;
+            else cout << "[클라이언트] 알 수 없는 명령" << endl;
             continue;
         }
 
+        vector<char> data(size);
+        if (!RecvAll(client, data.data(), size)) {
+            cout << "[클라이언트] 데이터 수신 실패" << endl;
+            break;
+        }
+
         /* ==================================================
            LIST 명령 처리
         ================================================== */
         if (cmd == "list") {
-
-            if (status == -1) {
-                cout << "[클라이언트] 목록 요청 실패" << endl;
-                continue;
-            }
-
-            vector<char> buffer(size);
-
-            if (!RecvAll(client, buffer.data(), size)) {
-                cout << "[클라이언트] 목록 수신 실패" << endl;
-                continue;
-            }
-
             cout << "\n[서버 파일 목록 성공]\n";
-            cout.write(buffer.data(), size);
+            cout.write(data.data(), size);
             cout << endl;
         }
 
         /* ==================================================
            GET 명령 처리
         ================================================== */
-        else if (cmd.rfind("get ", 0) == 0) {
-
-            if (status == -1) {
-                cout << "[클라이언트] 파일 없음 → 요청 실패" << endl;
-                continue;
-            }
-
-            vector<char> data(size);
-
-            if (!RecvAll(client, data.data(), size)) {
-                cout << "[클라이언트] 파일 데이터 수신 실패" << endl;
-                continue;
-            }
-
+        else {
             string filename = cmd.substr(4);
             ofstream out(filename, ios::binary);
             out.write(data.data(), size);
@@ -345,16 +662,160 @@ int main() {
 
             cout << "[클라이언트] 파일 저장 성공 → " << filename << endl;
         }
+    }
+    return 0;
+}
 
-        /* ==================================================
-           잘못된 명령 처리
-        ================================================== */
-        else {
-            cout << "[클라이언트] 알 수 없는 명령" << endl;
+/* ==========================================================
+   벤치마크: 루프백 get 처리량, plain vs TLS
+========================================================== */
+
+/* ----------------------------------------------------------
+   BenchGet()
+   - 서버를 스레드로 띄우고 (BENCH_PORT) 같은 파일을 rounds 번 get 한다
+   - MB/s 와 MB 당 CPU 시간 (서버 + 클라이언트, 프로세스 전체) 을 한 줄로
+---------------------------------------------------------- */
+void BenchGet(const char* label, const string& filename, int size, int rounds,
+              const net::TlsContext* serverTls, const net::TlsContext* clientTls) {
+    net::Waker stop;
+    ServerConfig cfg;
+    cfg.port = BENCH_PORT;
+    cfg.tls = serverTls;
+    cfg.stop = &stop;
+    thread server([&] {
+        try { RunServer(cfg); }
+        catch (const exception& e) { cout << "[벤치] 서버 실패: " << e.what() << endl; }
+    });
+
+    string error;
+    {
+        Link l;
+        for (int i = 0; i < 100 && !l.sock; ++i) {   // 서버 스레드가 listen 할 때까지
+            try { l = OpenLink("127.0.0.1", BENCH_PORT, clientTls); error.clear(); }
+            catch (const exception& e) { error = e.what(); this_thread::sleep_for(chrono::milliseconds(10)); }
+        }
+
+        vector<char> data(size);
+        string cmd = "get " + filename;
+        auto get = [&] {
+            int status = 0, got = 0;
+            return LinkSend(l, cmd.c_str(), (int)cmd.size()) == (int)cmd.size() &&
+                   RecvAll(l, (char*)&status, sizeof(int)) && RecvAll(l, (char*)&got, sizeof(int)) &&
+                   status == 1 && got == size && RecvAll(l, data.data(), size);
+        };
+
+        if (error.empty() && get()) {   // 첫 번은 page cache, handshake 를 빼려고 재지 않는다
+            clock_t cpu0 = clock();
+            auto t0 = chrono::steady_clock::now();
+            int done = 0;
+            while (done < rounds && get()) ++done;
+            double sec = chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+            double cpu = (double)(clock() - cpu0) / CLOCKS_PER_SEC;
+            double mb = (double)size * done / (1 << 20);
+            if (done < rounds) error = "get 실패";
+            else printf("  %-16s %8.0f MB/s   CPU %6.3f ms/MB\n", label, mb / sec, cpu * 1000 / mb);
         }
+        else if (error.empty()) error = "get 실패";
     }
 
-    closesocket(client);
-    WSACleanup();
+    stop.wake();
+    server.join();
+    if (!error.empty()) cout << "  " << label << ": " << error << endl;
+}
+
+int RunBenchmark() {
+    const string filename = "bench_get.bin";
+    const int size = 64 << 20, rounds = 16;
+    {
+        ofstream f(filename, ios::binary);
+        vector<char> chunk(1 << 20);
+        for (size_t i = 0; i < chunk.size(); ++i) chunk[i] = (char)(i * 131 + (i >> 8));
+        for (int i = 0; i < size / (int)chunk.size(); ++i) f.write(chunk.data(), chunk.size());
+        if (!f) throw runtime_error("벤치 파일을 쓸 수 없음: " + filename);
+    }
+    LogCommands = false;
+    cout << "[벤치] 루프백 get, " << (size >> 20) << "MB x " << rounds << " (포트 " << BENCH_PORT << ")" << endl;
+
+    BenchGet("plain", filename, size, rounds, nullptr, nullptr);
+#ifdef NET_HAVE_TLS
+    net::TlsContext server = net::TlsContext::server(), client = net::TlsContext::client("", false);   // 루프백, 임시 인증서
+    BenchGet("TLS (kTLS)", filename, size, rounds, &server, &client);   // 커널이 못 받으면 userspace 와 같다 (서버 줄 참고)
+    net::TlsContext userServer = net::TlsContext::server();
+    userServer.userspaceOnly();
+    BenchGet("TLS (userspace)", filename, size, rounds, &userServer, &client);
+#else
+    cout << "  TLS: NET_TLS 없이 빌드됨 (-DNET_TLS ... -lssl -lcrypto)" << endl;
+#endif
+
+    LogCommands = true;
+    remove(filename.c_str());
     return 0;
 }
+
+int main(int argc, char** argv) {
+#ifndef _WIN32
+    signal(SIGPIPE, SIG_IGN);   // 끊긴 클라이언트에 send 해도 서버가 죽지 않도록
+#endif
+    try {
+        /* --------------------------------------------------
+           WinSock 초기화 (POSIX 에서는 아무것도 안 한다)
+        -------------------------------------------------- */
+        net::WinsockInit winsock;
+
+        ServerConfig cfg;
+        bool tls = false, insecure = false;
+        string cert, key, ca;
+        for (int i = 1; i < argc; ++i) {
+            string a = argv[i];
+            bool hasValue = i + 1 < argc;
+            if (a == "--write-policy" && hasValue && net::parseWriteMode(argv[i + 1], cfg.write.mode)) ++i;
+            else if (a == "--flush-window-us" && hasValue) cfg.write.window = chrono::microseconds(stoll(argv[++i]));
+            else if (a == "--flush-bytes" && hasValue) cfg.write.bytes = (size_t)stoull(argv[++i]);
+            else if (a == "--tls") tls = true;
+            else if (a == "--tls-cert" && hasValue) cert = argv[++i];
+            else if (a == "--tls-key" && hasValue) key = argv[++i];
+            else if (a == "--tls-ca" && hasValue) ca = argv[++i];
+            else if (a == "--tls-insecure") insecure = true;
+            else {
+                cout << "사용법: " << argv[0] << " [--write-policy latency|throughput] [--flush-window-us N] [--flush-bytes N]"
+                     << " [--tls [--tls-cert F --tls-key F] [--tls-ca F | --tls-insecure]]" << endl;
+                return 1;
+            }
+        }
+#ifndef NET_HAVE_TLS
+        if (tls) {
+            cout << "[오류] TLS 없이 빌드됨: -DNET_TLS ... -lssl -lcrypto 로 다시 빌드" << endl;
+            return 1;
+        }
+#endif
+
+        cout << "1) 서버  2) 클라이언트  3) 벤치마크 : ";
+        string mode;
+        getline(cin, mode);
+        if (mode == "3") return RunBenchmark();
+#ifdef NET_HAVE_TLS
+        optional<net::TlsContext> ctx;
+        if (tls && mode == "1") {
+            ctx = net::TlsContext::server(cert, key);
+            if (cert.empty()) cout << "[서버] TLS: 임시 self-signed 인증서 (--tls-cert / --tls-key)" << endl;
+        }
+        else if (tls) ctx = net::TlsContext::client(ca, !insecure);
+        const net::TlsContext* tlsCtx = ctx ? &*ctx : nullptr;
+#else
+        const net::TlsContext* tlsCtx = nullptr;
+#endif
+        if (mode == "1") {
+            cfg.tls = tlsCtx;
+            return RunServer(cfg);
+        }
+
+        cout << "서버 주소 (엔터 = 127.0.0.1): ";
+        string host;
+        getline(cin, host);
+        return RunClient(host.empty() ? "127.0.0.1" : host, tlsCtx);
+    }
+    catch (const exception& e) {
+        cout << "[오류] " << e.what() << endl;
+        return 1;
+    }
+}
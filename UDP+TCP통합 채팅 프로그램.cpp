@@ -1,6 +1,8 @@
 // chat_full_tcp_udp.cpp
-// Windows, 멀티스레드 TCP/UDP 채팅 서버 + 클라이언트 통합
-// Build: cl /EHsc chat_full_tcp_udp.cpp ws2_32.lib
+// Windows/Linux, 멀티스레드 TCP/UDP 채팅 서버 + 클라이언트 통합
+// Build (Windows): cl /EHsc /std:c++20 chat_full_tcp_udp.cpp ws2_32.lib
+// Build (Linux):   g++ -std=c++20 -O2 -pthread chat_full_tcp_udp.cpp -o chat
+// Build (TLS):     g++ -std=c++20 -O2 -pthread -DNET_TLS chat_full_tcp_udp.cpp -o chat -lssl -lcrypto   (--tls, tls_core.h)
 
 /*
 [사용법 예시]
@@ -8,7 +10,39 @@
    > chat_full_tcp_udp.cpp
    Select: 1
    Port: 9000
-   - 관리자 명령: /list, /list udp, /quit
+   - 관리자 명령: /list (방 목록 포함), /list udp, /queues (클라이언트별 송신 큐: control / bulk 차선의 깊이와 최대), /quit
+   - 서버 옵션 (명령행):
+     --udp-batch N       recvmmsg/sendmmsg 배치 크기 (1 = recvfrom/sendto)
+     --udp-shards N      SO_REUSEPORT UDP 소켓 N개 + 코어별 수신 스레드 (Linux)
+     --udp-cpu-steer     shard 선택을 커널 해시 대신 수신 CPU 기준 BPF 로 (Linux)
+     --no-udp-offload    UDP GSO/GRO 를 쓰지 않는다 (기본: 커널이 지원하면 사용)
+     --udp-fec K M       FEC 로 등록한 클라이언트에게 data K개마다 parity M개 (기본 8 2)
+     --history N         새로 들어온 TCP 클라이언트에게 최근 메시지 N개를 다시 보낸다 (기본 100, 0 = 끔)
+     --history-seconds T 그중 최근 T초 안의 것만 (기본 0 = 시간 제한 없음)
+     --history-bytes B   기록이 쓰는 메모리 상한 (기본 262144)
+     --log-dir DIR       모든 채팅 메시지를 DIR 의 mmap segment 파일에 영구 기록 (POSIX)
+     --log-segment-mb N  segment 파일 크기 (기본 64)
+     --log-sync-ms N     group commit fsync 간격 (기본 10)
+     --mesh-port P       다른 서버 노드의 링크를 받을 포트 (federation)
+     --mesh-peers H:P,.. 연결할 피어 노드. 링크 하나는 한쪽에만 적는다 (예: 뒤에 띄운 노드가 앞 노드들을)
+     --node-id N         mesh 안에서의 노드 번호 (기본: 임의). /list 가 노드별 멤버를 보여 준다
+     --handshake-timeout-ms N  연결 뒤 닉네임이 N ms 안에 오지 않으면 끊는다 (기본 5000)
+     --tcp-listeners N   SO_REUSEPORT TCP listen 소켓 N개, 각자 reactor 스레드 하나가 accept 와 그 연결들을 맡는다 (Linux, 재접속 폭주 대비)
+     --no-defer-accept   TCP_DEFER_ACCEPT 를 쓰지 않는다 (기본: 닉네임이 도착한 연결만 accept, Linux)
+     --no-tcp-fastopen   listen 소켓에 TCP Fast Open 을 켜지 않는다 (Linux)
+     --session-ttl S     binary v2 클라이언트가 끊긴 뒤 S초 동안 세션을 남겨 재접속 때 놓친 것만 보낸다 (기본 30, 0 = 끔)
+     --heartbeat S       binary v3 클라이언트가 S초 동안 조용하면 PING (기본 15, 0 = 끔)
+     --idle-timeout S    PING 뒤에도 S초 동안 아무것도 안 오면 끊는다 (기본 45). PONG 을 못 하는 클라이언트는 TCP keepalive
+     --udp-idle-timeout S  S초 동안 REGISTER 를 다시 보내지 않은 UDP 등록을 지운다 (기본 90, 0 = 끔. 클라이언트는 30초마다 보낸다)
+     --poller NAME       이벤트 대기 backend: select, poll, epoll, io_uring (socket_core.h, 기본 epoll / Windows 는 poll)
+     --write-policy M    클라이언트 TCP 소켓의 쓰기: latency (기본, TCP_NODELAY + 바로 보냄) 또는 throughput
+                         (방송을 모았다가 cork 로 한 번에. 입장/퇴장, 명령의 답은 모으지 않는다)
+     --flush-window-us N throughput: 첫 메시지부터 N us 동안 모은다 (기본 200)
+     --flush-bytes N     throughput: N 바이트가 모이면 window 전에라도 보낸다 (기본 16384)
+     --tls               TCP 연결을 TLS 로 (-DNET_TLS 빌드). handshake 뒤 키를 커널에 넘긴 (kTLS) 방향은 소켓을 그대로
+                         recv / sendmsg / sendfile 로 쓰고, 넘기지 못한 방향 (tls 모듈이 없는 커널 등) 은 SSL_read / SSL_write.
+                         OpenSSL 3.2 전에는 수신까지 넘기려고 TLS 1.2 까지. UDP 와 mesh 링크는 평문
+     --tls-cert F --tls-key F  서버 인증서 (PEM). 없으면 임시 self-signed (클라이언트는 --tls-insecure 로만 붙는다)
 
 2. 클라이언트 실행:
    > chat_full_tcp_udp.cpp
@@ -20,447 +54,5338 @@
      plain text      -> TCP
      /tcp <msg>      -> TCP
      /udp <msg>      -> UDP
+     /history <from> [to] -> 서버 기록 조회 (--log-dir 서버). 시각 HH:MM[:SS], -10m, now 또는 #seq
+     /join <room>    -> 방에 들어간다 (없으면 만든다). 그 뒤 글은 그 방 멤버에게만 (TCP 는 TCP 멤버, UDP 는 UDP 멤버).
+                        여러 방에 들 수 있고 맨 나중에 /join 한 방이 지금 방
+     /part [room]    -> 방에서 나온다 (기본: 지금 방). 남은 방이 없으면 다시 전체 채팅
+     /msg <nick> <msg> -> 그 닉네임에게만 (귓속말). 상대가 TCP 에 없으면 UDP 로 간다. /udp /msg ... 는 UDP 로 보낸다
      /quit           -> 종료
+   - 클라이언트 옵션 (명령행):
+     --reliable-udp      /udp 를 순서 보장 + 재전송되는 신뢰 채널로 (서버가 지원할 때만)
+     --fec-udp           서버의 UDP 방송을 FEC 블록으로 받아 손실을 복구한다 (fec.h)
+     --tcp-fastopen      닉네임을 TCP SYN 에 실어 보낸다 (Linux TCP Fast Open, 서버 쿠키를 받은 두 번째 연결부터)
+     --binary            binary wire protocol (chat_wire.h). 서버는 첫 바이트로 알아보고 텍스트 클라이언트와 섞어 받는다.
+                         TCP 가 끊기면 스스로 다시 붙어 세션을 이어 간다 (놓친 메시지만 받는다, 입장/퇴장 없음)
+     --tls               TCP 를 TLS 로 (--tls 서버). 재접속도 다시 handshake 한다
+     --tls-ca F          서버 인증서를 이 CA 로 검증. 없으면 시스템 CA 로 검증한다 (이름은 접속한 서버 주소와 맞춘다)
+     --tls-insecure      서버 인증서를 검증하지 않는다 (임시 self-signed 서버 시험용. 중간자를 막지 못한다)
+     --poller NAME       이벤트 대기 backend (서버와 같다)
+
+3. 벤치마크:
+   > chat_full_tcp_udp.cpp
+   Select: 3
+   - UDP 송수신 경로(plain vs batched) packets/s 측정
+   - SO_REUSEPORT shard 수별 수신 packets/s 측정
+   - UDP GSO/GRO on/off 의 백만 packet 당 CPU 시간 측정
+   - 신뢰 UDP 채널의 손실률(0~10%)별 goodput / 지연
+   - FEC 부호화/복호 MB/s (scalar vs SIMD), 손실률별 FEC 후 남는 손실
+   - 메시지 로그 append 처리량 / 지연 (group commit)
+   - Poller backend (select/poll/epoll/io_uring) 별 대기 비용: 소켓 16/256/1000 개 중 4개만 준비될 때
+   - 연결 수립 속도 (connect -> WELCOME), 닉네임을 보내지 않는 연결 0/10/50% 섞어서
+   - 재접속 폭주 connections/s: SO_REUSEPORT listen 소켓 수별, TCP_DEFER_ACCEPT + Fast Open on/off
+   - 쓰기 정책 (--write-policy) 별 한가할 때의 방송 지연과 폭주 때의 전달 msgs/s: latency vs throughput window 50/200/1000us
+   - 실행 중인 서버에 수천 클라이언트를 붙인 방송 지연 / 처리량은 "채팅 부하 생성기.cpp" (chat-load)
+   - 메시지당 hot path 마이크로벤치 (Google Benchmark, JSON) 는 "채팅 마이크로벤치.cpp" (chat-microbench)
 */
 
 #define NOMINMAX
 #define _CRT_SECURE_NO_WARNINGS
 #define _WINSOCK_DEPRECATED_NO_WARNINGS
 
+#ifdef _WIN32
 #include <winsock2.h>
 #include <ws2tcpip.h>
 #include <windows.h>
+#else
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <fcntl.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/uio.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <csignal>
+#include <cerrno>
+#include <cstring>
+#endif
+#ifdef __linux__
+#include <sys/resource.h>
+#include <sys/sendfile.h>
+#include <netinet/udp.h>
+#include <linux/filter.h>
+#include <pthread.h>
+#include <sched.h>
+#endif
 #include <iostream>
 #include <sstream>
 #include <string>
 #include <vector>
 #include <thread>
 #include <mutex>
+#include <shared_mutex>
 #include <atomic>
 #include <memory>
 #include <chrono>
 #include <iomanip>
 #include <algorithm>
 #include <limits>
+#include <deque>
+#include <map>
+#include <unordered_map>
+#include <set>
+#include <functional>
+#include <condition_variable>
+#include <random>
+#include <coroutine>
+#include <utility>
 
+#include "socket_core.h"
+#include "fec.h"
+#include "chat_wire.h"
+#include "tls_core.h"   // -DNET_TLS 일 때만: --tls
+
+#ifdef _WIN32
 #pragma comment(lib, "ws2_32.lib")
+#endif
 
 using namespace std;
 using namespace std::chrono;
+using namespace net;
 
 constexpr int BUF_SIZE = 4096;
+constexpr int UDP_BATCH = 64;   // recvmmsg/sendmmsg 한 번에 처리할 최대 datagram 수
+constexpr int UDP_GRO_SLOTS = 8;                // GRO 수신 시 recvmmsg 슬롯 수 (슬롯 하나가 최대 64KB)
+constexpr size_t UDP_GRO_BUF = 65536;
+constexpr size_t UDP_GSO_MAX_SEGS = 64;         // 커널 UDP_MAX_SEGMENTS (오래된 커널 기준)
+constexpr size_t UDP_GSO_MAX_SEG = 1472;        // 이더넷 MTU 에서 segment 하나의 최대 payload
+constexpr size_t UDP_GSO_MAX_BYTES = 65000;     // GSO 한 번의 총 payload
+
+// ---------------- Platform ----------------
+// 소켓 shim (SOCKET, closesocket, WSAGetLastError ...) 은 socket_core.h
+#ifndef _WIN32
+inline void localtime_s(tm* out, const time_t* t) { localtime_r(t, out); }
+#endif
 
 // ---------------- Logger ----------------
 class Logger {
 public:
     enum Level { INFO, WARN, ERR };
-    static void log(Level lvl, const string& msg) {
+    // prefix + [p, p+n) 를 한 줄로. 메시지 경로는 문자열을 이어 붙이지 않고 이것을 쓴다 (할당 없음)
+    static void log(Level lvl, const char* prefix, const char* p, size_t n) {
         lock_guard<mutex> lg(io_mtx);
-        cout << "[" << timestamp() << "] ";
+        char ts[TIMESTAMP_LEN];
+        timestamp(ts);
+        cout << "[";
+        cout.write(ts, TIMESTAMP_LEN) << "] ";
         switch (lvl) {
         case INFO: cout << "[INFO] "; break;
         case WARN: cout << "[WARN] "; break;
         default:   cout << "[ERROR] "; break;
         }
-        cout << msg << "\n";
+        cout << prefix;
+        cout.write(p, (streamsize)n) << "\n";
     }
+    static void log(Level lvl, const string& msg) { log(lvl, "", msg.data(), msg.size()); }
     static void info(const string& s) { log(INFO, s); }
+    static void info(const char* prefix, const char* p, size_t n) { log(INFO, prefix, p, n); }
+    static void info(const char* prefix, const string& s) { log(INFO, prefix, s.data(), s.size()); }
     static void warn(const string& s) { log(WARN, s); }
     static void error(const string& s) { log(ERR, s); }
 private:
+    friend struct ChatBench;   // 채팅 마이크로벤치.cpp
+    static constexpr size_t TIMESTAMP_LEN = 23;   // "YYYY-MM-DD HH:MM:SS.mmm"
     static mutex io_mtx;
-    static string timestamp() {
+    static time_t stampSec;                        // io_mtx: 초 단위 부분은 바뀔 때만 다시 만든다
+    static char stampText[20];
+    static void timestamp(char* out) {
         auto now = system_clock::now();
-        auto t = system_clock::to_time_t(now);
-        auto ms = duration_cast<milliseconds>(now.time_since_epoch()) % 1000;
-        ostringstream oss;
-        tm tmv;
-        localtime_s(&tmv, &t);
-        oss << put_time(&tmv, "%Y-%m-%d %H:%M:%S") << "." << setw(3) << setfill('0') << ms.count();
-        return oss.str();
+        time_t t = system_clock::to_time_t(now);
+        int ms = (int)(duration_cast<milliseconds>(now.time_since_epoch()).count() % 1000);
+        if (t != stampSec) { tm tmv; localtime_s(&tmv, &t); strftime(stampText, sizeof(stampText), "%Y-%m-%d %H:%M:%S", &tmv); stampSec = t; }
+        memcpy(out, stampText, 19);
+        out[19] = '.'; out[20] = (char)('0' + ms / 100); out[21] = (char)('0' + ms / 10 % 10); out[22] = (char)('0' + ms % 10);
     }
 };
 mutex Logger::io_mtx;
+time_t Logger::stampSec = -1;
+char Logger::stampText[20];
 
-string lastWinsockError() {
-    int code = WSAGetLastError();
-    char* buf = nullptr;
-    FormatMessageA(FORMAT_MESSAGE_ALLOCATE_BUFFER | FORMAT_MESSAGE_FROM_SYSTEM | FORMAT_MESSAGE_IGNORE_INSERTS,
-        nullptr, code, MAKELANGID(LANG_NEUTRAL, SUBLANG_DEFAULT), (LPSTR)&buf, 0, nullptr);
-    string s = buf ? buf : "<unknown>";
-    if (buf) LocalFree(buf);
-    return s;
-}
+// ---------------- Buffer pools ----------------
+// 메시지마다 malloc 하지 않도록 스레드마다 버퍼를 돌려 쓴다. 데운 뒤 (풀이 찬 뒤) 의 전달 경로는 할당이 없다.
+constexpr size_t MESSAGE_POOL_SLOTS = 512;   // 스레드당 돌려 쓰는 방송 버퍼 수 (기록 링 + 전송 중인 것보다 커야 한다)
+constexpr size_t LINE_POOL_MAX = 256;        // 스레드당 보관하는 빈 줄 문자열 수
+constexpr size_t POOL_KEEP_BYTES = 64 << 10; // 이보다 커진 버퍼는 돌려받지 않는다
 
-// ---------------- Winsock RAII ----------------
-class WinsockInit {
+// 방송 버퍼 (shared_ptr<string>) 의 링. 방송 버퍼는 소켓 송신과 기록 (HistoryRing) 이 공유하다가
+// 기록에서 밀려나는 순서 (= 만든 순서) 로 풀려나므로, 가장 오래전에 내준 것이 풀려 있으면 그것을 다시 쓴다.
+// 아직 누가 쥐고 있으면 링을 늘리고, 링이 다 찼으면 풀 밖의 버퍼를 새로 만든다.
+class MessagePool {
 public:
-    WinsockInit() {
-        WSADATA w;
-        if (WSAStartup(MAKEWORD(2, 2), &w) != 0) throw runtime_error("WSAStartup failed");
+    MessagePool() : ring(MESSAGE_POOL_SLOTS) {}
+
+    shared_ptr<string> take() {
+        if (count > 0) {
+            shared_ptr<string>& oldest = ring[head];
+            if (oldest.use_count() == 1 && oldest->capacity() <= POOL_KEEP_BYTES) {
+                atomic_thread_fence(memory_order_acquire);   // 마지막으로 놓은 스레드의 읽기가 끝난 뒤에 쓴다
+                shared_ptr<string> m = oldest;
+                ring[(head + count) % ring.size()].swap(oldest);   // 링 맨 뒤로 (count 는 그대로)
+                head = (head + 1) % ring.size();
+                m->clear();
+                return m;
+            }
+        }
+        auto m = make_shared<string>();
+        if (count < ring.size()) { ring[(head + count) % ring.size()] = m; ++count; }
+        return m;
     }
-    ~WinsockInit() { WSACleanup(); }
-};
 
-// ---------------- Utilities ----------------
-string sockaddrToString(const sockaddr_in& a) {
-    char buf[INET_ADDRSTRLEN] = { 0 };
-    inet_ntop(AF_INET, &a.sin_addr, buf, sizeof(buf));
-    ostringstream oss;
-    oss << buf << ":" << ntohs(a.sin_port);
-    return oss.str();
-}
+    // 이 스레드가 쓰는 풀
+    static MessagePool& local() { thread_local MessagePool pool; return pool; }
 
-// ---------------- Data ----------------
-struct TCPClient {
-    SOCKET sock = INVALID_SOCKET;
-    string name;
-    sockaddr_in addr{};
-    atomic<bool> alive{ true };
+private:
+    vector<shared_ptr<string>> ring;
+    size_t head = 0, count = 0;
 };
 
-struct UDPClient {
-    sockaddr_in addr{};
-    string name;
+// 한 번의 수신에서 만든 방송 줄 (vector<string> outs) 의 문자열 재사용. take() 는 capacity 가 남은 빈 문자열을 주고,
+// recycle() 이 outs 의 문자열을 돌려받은 뒤 outs 를 비운다 (vector 의 capacity 도 남는다).
+class LinePool {
+public:
+    string take() {
+        if (spare.empty()) return string();
+        string s = move(spare.back());
+        spare.pop_back();
+        s.clear();
+        return s;
+    }
+    void recycle(vector<string>& outs) {
+        for (auto& s : outs) if (spare.size() < LINE_POOL_MAX && s.capacity() <= POOL_KEEP_BYTES) spare.push_back(move(s));
+        outs.clear();
+    }
+
+    static LinePool& local() { thread_local LinePool pool; return pool; }
+
+private:
+    vector<string> spare;
 };
 
-// ---------------- ChatServer ----------------
-class ChatServer {
+// 현재 스레드를 cpu 번 코어에 고정한다 (Linux 전용, 실패해도 동작에는 지장 없음)
+void pinCurrentThread(int cpu) {
+#ifdef __linux__
+    unsigned ncpu = max(1u, thread::hardware_concurrency());
+    cpu_set_t set; CPU_ZERO(&set); CPU_SET(cpu % (int)ncpu, &set);
+    pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+#else
+    (void)cpu;
+#endif
+}
+
+// ---------------- Event wait ----------------
+// 모든 루프는 잠깐씩 자며 확인하지 않고 실제 readiness 를 기다린다. 종료와 스레드 간 신호는 Waker 로 깨운다.
+// Poller / Waker 는 socket_core.h. Poller 의 backend (select/poll/epoll/io_uring) 는 --poller 로 고른다.
+
+// w 가 깨워지거나 timeoutMs 가 지날 때까지 기다린다 (< 0 이면 무한정). 깨워졌으면 true.
+bool waitWake(const Waker& w, int timeoutMs) {
+    pollfd p{}; p.fd = w.fd(); p.events = POLLIN;
+    return poll(&p, 1, timeoutMs) > 0;
+}
+
+// stdin 에 읽을 것이 생기거나 w 가 깨워질 때까지 기다린다. 깨워졌으면 false.
+// Windows 콘솔 핸들은 WSAPoll 에 넣을 수 없으므로 바로 true 를 돌려주고 getline 이 기다린다
+// (끝낼 때는 CancelSynchronousIo 로 푼다).
+bool waitStdin(const Waker& w) {
+#ifdef _WIN32
+    (void)w;
+    return true;
+#else
+    if (cin.rdbuf()->in_avail() > 0) return true;   // istream 버퍼에 이미 읽어 둔 줄
+    pollfd fds[2] = { { 0, POLLIN, 0 }, { w.fd(), POLLIN, 0 } };
+    while (poll(fds, 2, -1) < 0 && errno == EINTR) {}
+    return fds[1].revents == 0;
+#endif
+}
+
+// ---------------- Timer wheel ----------------
+// 계층 timing wheel. 연결마다 걸어 두는 timer (handshake, PING, idle, UDP 등록 만료, Reactor 의 대기 deadline) 용.
+// tick 은 만들 때 정한다. 기본 1ms: level 0 은 256칸 (256ms 앞까지), 그 위 네 level 은 64칸씩 (16초, 17분, 18시간, 49일).
+// Reactor 는 쓰기 window (us) 때문에 50us: 12.8ms, 0.8초, 52초, 56분, 2.5일.
+// 칸마다 intrusive 이중 연결 리스트라 arm/cancel 은 O(1) 이고 할당이 없다: 연결 10만 개가 recv 마다 timer 를
+// 다시 걸어도 비용은 포인터 몇 개. 시간이 흐르면 level 0 의 칸을 차례로 만료 목록으로 옮기고, level 0 이 한 바퀴
+// 돌 때마다 위 level 의 칸 하나를 아래로 내려 다시 꽂는다 (cascade). 한 스레드에서만 (또는 락 안에서) 쓴다.
+class TimerWheel {
+    struct Link { Link* prev = nullptr; Link* next = nullptr; };
+
 public:
-    ChatServer(const string& port) : portStr(port), listenSock(INVALID_SOCKET), udpSock(INVALID_SOCKET), running(false) {}
-    ~ChatServer() { stop(); }
+    // 걸 수 있는 timer. 보통 이것을 상속한 객체 (Reactor::Wait, UDPClient) 를 걸고 pop() 이 돌려준 것을 되돌려 쓴다.
+    // 복사본은 걸려 있지 않다. 걸린 채 사라지면 스스로 빠진다.
+    class Timer : private Link {
+    public:
+        Timer() = default;
+        Timer(const Timer&) : Link() {}
+        Timer& operator=(const Timer&) { return *this; }
+        ~Timer() { if (wheel) wheel->cancel(*this); }
+        bool armed() const { return wheel != nullptr; }
 
-    void start() {
-        if (running.load()) return;
-        running.store(true);
-        serverThread = thread(&ChatServer::run, this);
+    private:
+        friend class TimerWheel;
+        TimerWheel* wheel = nullptr;
+        uint64_t tick = 0;
+        int level = 0;   // LEVELS 면 만료 목록
+    };
+
+    explicit TimerWheel(steady_clock::duration tick = milliseconds(1)) : origin(steady_clock::now()), tick(tick) {
+        for (auto& h : level0) h.prev = h.next = &h;
+        for (auto& lv : upper) for (auto& h : lv) h.prev = h.next = &h;
+        due.prev = due.next = &due;
     }
+    ~TimerWheel() {
+        auto release = [](Link& h) { for (Link* l = h.next; l != &h; l = l->next) static_cast<Timer*>(l)->wheel = nullptr; };
+        for (auto& h : level0) release(h);
+        for (auto& lv : upper) for (auto& h : lv) release(h);
+        release(due);
+    }
+    TimerWheel(const TimerWheel&) = delete;
+    TimerWheel& operator=(const TimerWheel&) = delete;
 
-    void stop() {
-        if (!running.load()) return;
-        running.store(false);
-        {
-            lock_guard<mutex> lg(controlMtx);
-            if (listenSock != INVALID_SOCKET) { closesocket(listenSock); listenSock = INVALID_SOCKET; }
-            if (udpSock != INVALID_SOCKET) { closesocket(udpSock);   udpSock = INVALID_SOCKET; }
+    size_t size() const { return count; }
+
+    // at 에 만료되도록 건다 (이미 걸려 있으면 옮긴다). 이미 지난 시각이면 바로 만료 목록으로
+    void arm(Timer& t, steady_clock::time_point at) {
+        if (t.wheel) cancel(t);
+        t.wheel = this;
+        ++count;
+        uint64_t tk = tickAt(at);
+        if (tk < cur) toDue(t);
+        else place(t, tk);
+    }
+
+    void cancel(Timer& t) {
+        if (t.wheel != this) return;
+        unlink(t);
+        t.wheel = nullptr;
+        --count;
+        if (t.level == LEVELS) --dueCount;
+        else --perLevel[t.level];
+    }
+
+    // now 까지 만료된 timer 를 만료 목록으로 옮긴다. 꺼내는 것은 pop()
+    void advance(steady_clock::time_point now) {
+        uint64_t target = tickFloor(now);
+        while (cur <= target) {
+            if (count == dueCount) { cur = target + 1; break; }   // 칸에 걸린 것이 없다
+            if ((cur & L0_MASK) == 0) cascade(1);
+            Link& h = level0[cur & L0_MASK];
+            while (h.next != &h) { Timer& t = *static_cast<Timer*>(h.next); unlink(t); --perLevel[0]; toDue(t); }
+            ++cur;
+            if (perLevel[0] == 0) cur = min(target + 1, roundUp(cur, L0_SIZE));   // 다음 cascade 까지 빈 칸은 건너뛴다
         }
+    }
+
+    // 만료 목록의 맨 앞을 빼서 돌려준다. 없으면 nullptr. 꺼낸 timer 를 다루다 다른 timer 를 걸거나 빼도 된다
+    Timer* pop() {
+        if (due.next == &due) return nullptr;
+        Timer* t = static_cast<Timer*>(due.next);
+        cancel(*t);
+        return t;
+    }
 
-        if (acceptThread.joinable()) acceptThread.join();
-        if (udpThread.joinable()) udpThread.join();
+    // 걸린 모든 timer 를 지금 만료시킨다 (멈출 때)
+    void expireAll() {
+        auto drain = [&](Link& h, size_t& n) { while (h.next != &h) { Timer& t = *static_cast<Timer*>(h.next); unlink(t); --n; toDue(t); } };
+        for (auto& h : level0) drain(h, perLevel[0]);
+        for (int l = 1; l < LEVELS; ++l) for (auto& h : upper[l - 1]) drain(h, perLevel[l]);
+    }
 
-        {
-            lock_guard<mutex> lg(clientsMtx);
-            for (auto& cptr : clients) {
-                cptr->alive.store(false);
-                if (cptr->sock != INVALID_SOCKET) {
-                    shutdown(cptr->sock, SD_BOTH);
-                    closesocket(cptr->sock);
-                    cptr->sock = INVALID_SOCKET;
-                }
+    // 다음에 advance() 할 시각: 만료 목록이 차 있으면 min, 걸린 것이 없으면 max.
+    // 위 level 에 걸린 것은 정확한 만료 시각 대신 그 칸이 내려오는 (cascade) 시각. 그때 다시 계산한다
+    steady_clock::time_point nextDeadline() const {
+        if (dueCount) return steady_clock::time_point::min();
+        if (count == 0) return steady_clock::time_point::max();
+        uint64_t best = numeric_limits<uint64_t>::max();
+        if (perLevel[0]) {
+            for (uint64_t t = cur; ; ++t) if (level0[t & L0_MASK].next != &level0[t & L0_MASK]) { best = t; break; }   // level 0 은 [cur, cur + 256) 만 가진다
+        }
+        for (int l = 1; l < LEVELS; ++l) {
+            if (!perLevel[l]) continue;
+            int sh = shiftOf(l);
+            uint64_t first = roundUp(cur, 1ull << sh) >> sh;   // 아직 내려오지 않은 첫 칸
+            for (uint64_t b = first; b < first + LN_SIZE; ++b) {
+                const Link& h = upper[l - 1][b & LN_MASK];
+                if (h.next != &h) { best = min(best, b << sh); break; }
             }
         }
+        return best == numeric_limits<uint64_t>::max() ? steady_clock::time_point::max() : timeOf(best);
+    }
+
+private:
+    static constexpr int LEVELS = 5;
+    static constexpr uint64_t L0_SIZE = 256, L0_MASK = L0_SIZE - 1;
+    static constexpr int LN_BITS = 6;
+    static constexpr uint64_t LN_SIZE = 1 << LN_BITS, LN_MASK = LN_SIZE - 1;
+    static constexpr uint64_t MAX_DELTA = 1ull << 32;   // 이보다 먼 timer 는 여기에 건다 (49일)
+
+    steady_clock::time_point origin;   // tick 0
+    steady_clock::duration tick;
+    uint64_t cur = 0;                  // 아직 만료시키지 않은 첫 tick
+    Link level0[L0_SIZE];
+    Link upper[LEVELS - 1][LN_SIZE];
+    Link due;                          // 만료됐지만 아직 pop() 하지 않은 것
+    size_t perLevel[LEVELS] = {};
+    size_t dueCount = 0, count = 0;
 
-        if (serverThread.joinable()) serverThread.join();
-        Logger::info("Server fully stopped");
+    static int shiftOf(int level) { return 8 + LN_BITS * (level - 1); }
+    static uint64_t roundUp(uint64_t t, uint64_t unit) { return (t + unit - 1) & ~(unit - 1); }
+
+    uint64_t tickFloor(steady_clock::time_point t) const { return t <= origin ? 0 : (uint64_t)((t - origin) / tick); }
+    uint64_t tickAt(steady_clock::time_point t) const {   // 올림: 일찍 만료되지 않도록
+        if (t <= origin) return 0;
+        if (t == steady_clock::time_point::max()) return cur + MAX_DELTA;
+        return (uint64_t)((t - origin + tick - steady_clock::duration(1)) / tick);
     }
+    steady_clock::time_point timeOf(uint64_t tk) const { return origin + tick * (int64_t)tk; }
 
-    void listAll() {
-        Logger::info("=== TCP Clients ===");
-        lock_guard<mutex> lg(clientsMtx);
-        for (auto& cptr : clients) cout << "  " << cptr->name << " @ " << sockaddrToString(cptr->addr) << "\n";
-        Logger::info("=== UDP Clients ===");
-        lock_guard<mutex> lg2(udpMtx);
-        for (auto& u : udpClients) cout << "  " << u.name << " @ " << sockaddrToString(u.addr) << "\n";
+    static void unlink(Link& l) { l.prev->next = l.next; l.next->prev = l.prev; l.prev = l.next = nullptr; }
+    static void pushBack(Link& h, Link& l) { l.prev = h.prev; l.next = &h; h.prev->next = &l; h.prev = &l; }
+
+    void toDue(Timer& t) { t.level = LEVELS; ++dueCount; pushBack(due, t); }
+
+    // cur 기준으로 tk 가 들어갈 level 과 칸. level l (>= 1) 은 cur 에서 2^(shiftOf(l) + 6) 앞까지
+    void place(Timer& t, uint64_t tk) {
+        uint64_t delta = min(tk - cur, MAX_DELTA - 1);
+        t.tick = tk = cur + delta;
+        if (delta < L0_SIZE) { t.level = 0; pushBack(level0[tk & L0_MASK], t); }
+        else {
+            int l = 1;
+            while (l < LEVELS - 1 && delta >= (1ull << (shiftOf(l) + LN_BITS))) ++l;
+            t.level = l;
+            pushBack(upper[l - 1][(tk >> shiftOf(l)) & LN_MASK], t);
+        }
+        ++perLevel[t.level];
     }
 
-    void listUdp() {
-        Logger::info("=== UDP Clients ===");
-        lock_guard<mutex> lg(udpMtx);
-        for (auto& u : udpClients) cout << "  " << u.name << " @ " << sockaddrToString(u.addr) << "\n";
+    // cur 가 level l 의 칸 경계다: 그 칸 (cur 부터 2^shiftOf(l) tick 안에 만료될 것들) 을 아래 level 로 내린다.
+    // 칸 번호가 0 으로 돌았으면 위 level 도 (Linux 의 옛 timer wheel 과 같은 순서)
+    void cascade(int l) {
+        uint64_t idx = (cur >> shiftOf(l)) & LN_MASK;
+        Link& h = upper[l - 1][idx];
+        Link list; list.prev = list.next = &list;
+        if (h.next != &h) { list.next = h.next; list.prev = h.prev; list.next->prev = &list; list.prev->next = &list; h.prev = h.next = &h; }
+        while (list.next != &list) { Timer& t = *static_cast<Timer*>(list.next); unlink(t); --perLevel[l]; place(t, t.tick); }
+        if (idx == 0 && l + 1 < LEVELS) cascade(l + 1);
+    }
+};
+
+// ---------------- Coroutines ----------------
+// 연결마다 스레드 대신 coroutine frame 하나. Reactor 는 스레드 하나에서 Poller 를 돌리며 소켓이 준비되거나
+// 시각이 되면 그것을 기다리던 coroutine 을 이어서 돌린다. 코드는 예전 blocking 루프처럼 위에서 아래로 읽힌다:
+//   int ev = co_await reactor.wait(s, Poller::READ, deadline);   // 준비된 이벤트, timeout 이면 0
+// 모든 대기는 notify() 나 stop() 으로 일찍 (0 으로) 깰 수 있다. 깨어난 쪽이 자기 종료 조건을 본다 (예전 stopWaker 와 같다).
+
+// co_await 으로만 부르는 coroutine. 기다리는 쪽이 co_await 할 때 시작하고, 끝나면 그쪽으로 바로 돌아간다.
+template <typename T> struct TaskResult {
+    T value{};
+    void return_value(T v) { value = move(v); }
+    T take() { return move(value); }
+};
+template <> struct TaskResult<void> {
+    void return_void() {}
+    void take() {}
+};
+
+template <typename T = void>
+class Task {
+public:
+    struct promise_type : TaskResult<T> {
+        coroutine_handle<> next;
+        exception_ptr error;
+        Task get_return_object() { return Task(coroutine_handle<promise_type>::from_promise(*this)); }
+        suspend_always initial_suspend() noexcept { return {}; }
+        struct Final {
+            bool await_ready() noexcept { return false; }
+            coroutine_handle<> await_suspend(coroutine_handle<promise_type> h) noexcept { return h.promise().next ? h.promise().next : noop_coroutine(); }
+            void await_resume() noexcept {}
+        };
+        Final final_suspend() noexcept { return {}; }
+        void unhandled_exception() { error = current_exception(); }
+    };
+
+    Task(Task&& o) noexcept : h(std::exchange(o.h, nullptr)) {}
+    Task(const Task&) = delete;
+    Task& operator=(const Task&) = delete;
+    ~Task() { if (h) h.destroy(); }
+
+    bool await_ready() const noexcept { return false; }
+    coroutine_handle<> await_suspend(coroutine_handle<> caller) noexcept { h.promise().next = caller; return h; }
+    T await_resume() {
+        if (h.promise().error) rethrow_exception(h.promise().error);
+        return h.promise().take();
     }
 
 private:
-    string portStr;
-    SOCKET listenSock;
-    SOCKET udpSock;
+    explicit Task(coroutine_handle<promise_type> h) : h(h) {}
+    coroutine_handle<promise_type> h;
+};
 
-    atomic<bool> running;
-    thread serverThread;
-    thread acceptThread;
-    thread udpThread;
+// 한 스레드의 이벤트 루프. wait/spawn/run 은 그 스레드에서만, notify/stop 은 아무 스레드에서나 부른다.
+// 소켓 하나에는 coroutine 하나만 기다린다 (읽기와 쓰기를 한 번의 wait 에 함께 건다).
+class Reactor {
+public:
+    // deadline 이 있으면 그동안 timers (TimerWheel) 에 걸린다
+    struct Wait : TimerWheel::Timer {
+        Wait(Reactor& r, SOCKET fd, int events, steady_clock::time_point deadline) : r(r), fd(fd), events(events), deadline(deadline) {}
 
-    vector<shared_ptr<TCPClient>> clients;
-    mutex clientsMtx;
+        Reactor& r;
+        SOCKET fd;
+        int events;
+        steady_clock::time_point deadline;
+        coroutine_handle<> h{};
+        int result = 0;
 
-    vector<UDPClient> udpClients;
-    mutex udpMtx;
+        bool await_ready() const noexcept { return false; }
+        void await_suspend(coroutine_handle<> c) { h = c; r.park(*this); }
+        int await_resume() const noexcept { return result; }
+    };
 
-    mutex controlMtx;
+    Reactor() { poller.add(waker.fd(), Poller::READ); }
+    Reactor(const Reactor&) = delete;
+    Reactor& operator=(const Reactor&) = delete;
 
-    void run() {
-        try {
-            WinsockInit w;
-            setupListen();
-            setupUDP();
+    // s 가 events (Poller::READ/WRITE) 중 하나로 준비되면 그 이벤트, deadline 이 지나거나 일찍 깨웠으면 0
+    Wait wait(SOCKET s, int events, steady_clock::time_point deadline = steady_clock::time_point::max()) { return Wait(*this, s, events, deadline); }
+    // until 이 이미 지났으면 한 바퀴 양보 (다른 소켓들을 한 번 본 뒤 돌아온다)
+    Wait sleep(steady_clock::time_point until) { return wait(INVALID_SOCKET, 0, until); }
 
-            acceptThread = thread(&ChatServer::acceptLoop, this);
-            udpThread = thread(&ChatServer::udpLoop, this);
+    // t 를 바로 돌리기 시작한다 (첫 대기까지). 끝나면 스스로 사라진다. run() 은 이렇게 띄운 것이 다 끝나야 돌아간다.
+    void spawn(Task<> t) { detach(*this, move(t)); }
 
-            Logger::info("Server started on port " + portStr + " (TCP + UDP)");
-            while (running.load()) this_thread::sleep_for(milliseconds(200));
-        }
-        catch (const exception& ex) {
-            Logger::error(string("Server fatal: ") + ex.what());
-            running.store(false);
-        }
+    // 소켓을 닫기 전에. 그 소켓을 기다리는 coroutine 이 없어야 한다 (닫는 쪽이 그 coroutine 이다)
+    void forget(SOCKET s) {
+        auto it = slots.find(s);
+        if (it == slots.end()) return;
+        if (it->second.interest) poller.remove(s);
+        slots.erase(it);
     }
 
-    void setupListen() {
-        addrinfo hints{}; addrinfo* res = nullptr;
-        hints.ai_family = AF_INET; hints.ai_socktype = SOCK_STREAM; hints.ai_flags = AI_PASSIVE;
-        if (getaddrinfo(nullptr, portStr.c_str(), &hints, &res) != 0) throw runtime_error("getaddrinfo failed");
+    // s 를 기다리는 coroutine 을 깨운다 (0 으로). 다른 스레드가 그 연결에 할 일을 남겼을 때
+    void notify(SOCKET s) {
+        { lock_guard<mutex> lg(kickMtx); kicked.push_back(s); }
+        waker.wake();
+    }
 
-        listenSock = socket(res->ai_family, res->ai_socktype, res->ai_protocol);
-        if (listenSock == INVALID_SOCKET) { freeaddrinfo(res); throw runtime_error("socket() failed: " + lastWinsockError()); }
-        BOOL opt = TRUE; setsockopt(listenSock, SOL_SOCKET, SO_REUSEADDR, (const char*)&opt, sizeof(opt));
-        if (bind(listenSock, res->ai_addr, (int)res->ai_addrlen) == SOCKET_ERROR) { freeaddrinfo(res); closesocket(listenSock); throw runtime_error("bind() failed: " + lastWinsockError()); }
-        freeaddrinfo(res);
-        if (listen(listenSock, SOMAXCONN) == SOCKET_ERROR) { closesocket(listenSock); throw runtime_error("listen() failed: " + lastWinsockError()); }
+    // 기다리는 모두를 깨우고, 띄운 coroutine 이 다 끝나면 run() 이 돌아간다
+    void stop() {
+        stopping.store(true);
+        waker.wake();
     }
+    bool stopped() const { return stopping.load(); }
 
-    void setupUDP() {
-        udpSock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
-        if (udpSock == INVALID_SOCKET) throw runtime_error("UDP socket() failed: " + lastWinsockError());
-        sockaddr_in u{}; u.sin_family = AF_INET; u.sin_addr.s_addr = INADDR_ANY; u.sin_port = htons((unsigned short)stoi(portStr));
-        if (bind(udpSock, (sockaddr*)&u, sizeof(u)) == SOCKET_ERROR) { closesocket(udpSock); throw runtime_error("UDP bind failed: " + lastWinsockError()); }
+    void run() {
+        vector<Poller::Event> evs;
+        vector<SOCKET> kicks;
+        vector<Wait*> yields;
+        bool swept = false;
+        while (!(stopping.load() && live == 0)) {
+            if (stopping.load() && !swept) { dueAll(); swept = true; }
+            int64_t timeoutUs = -1;
+            auto next = timers.nextDeadline();
+            if (!yielded.empty()) timeoutUs = 0;
+            else if (next != steady_clock::time_point::max()) {
+                auto now = steady_clock::now();
+                timeoutUs = next <= now ? 0 : (int64_t)ceil<microseconds>(next - now).count();
+            }
+            poller.waitUs(evs, timeoutUs);
+            for (auto& ev : evs) {
+                if (ev.fd == waker.fd()) { waker.drain(); continue; }
+                auto it = slots.find(ev.fd);
+                if (it == slots.end()) continue;
+                if (!it->second.waiter) { poller.remove(ev.fd); slots.erase(it); continue; }   // level-triggered: 아무도 기다리지 않으면 뺀다
+                resume(*it->second.waiter, ev.events);
+            }
+            { lock_guard<mutex> lg(kickMtx); kicks.swap(kicked); }
+            for (SOCKET s : kicks) {
+                auto it = slots.find(s);
+                if (it != slots.end() && it->second.waiter) resume(*it->second.waiter, 0);
+            }
+            kicks.clear();
+            yields.swap(yielded);   // 이번 바퀴에 양보한 것만. 다시 양보하면 다음 바퀴
+            for (Wait* w : yields) resume(*w, 0);
+            yields.clear();
+            timers.advance(steady_clock::now());
+            while (TimerWheel::Timer* t = timers.pop()) resume(static_cast<Wait&>(*t), 0);
+        }
     }
 
-    void acceptLoop() {
-        while (running.load()) {
-            sockaddr_in clientAddr{}; int addrlen = sizeof(clientAddr);
-            SOCKET cs = accept(listenSock, (sockaddr*)&clientAddr, &addrlen);
-            if (cs == INVALID_SOCKET) { if (!running.load()) break; Logger::warn("accept() failed: " + lastWinsockError()); this_thread::sleep_for(milliseconds(100)); continue; }
+private:
+    struct Slot {
+        Wait* waiter = nullptr;
+        int interest = 0;   // poller 에 걸린 이벤트. 같은 것을 다시 기다리면 epoll_ctl 을 하지 않는다
+    };
+    struct Detached {
+        struct promise_type {
+            Detached get_return_object() { return {}; }
+            suspend_never initial_suspend() noexcept { return {}; }
+            suspend_never final_suspend() noexcept { return {}; }
+            void return_void() {}
+            void unhandled_exception() { terminate(); }
+        };
+    };
 
-            char buf[BUF_SIZE]; int r = recv(cs, buf, BUF_SIZE - 1, 0);
-            if (r <= 0) { closesocket(cs); Logger::warn("Client connected but didn't send name"); continue; }
-            buf[r] = '\0'; string name = buf;
+    Poller poller;
+    Waker waker;
+    atomic<bool> stopping{ false };
+    int live = 0;   // 띄워서 아직 끝나지 않은 coroutine 수
+    unordered_map<SOCKET, Slot> slots;
+    TimerWheel timers{ microseconds(50) };   // deadline 이 있는 대기 (쓰기 window 가 us 단위)
+    vector<Wait*> yielded;   // 소켓 없이 이미 지난 시각까지 자는 대기: 다음 바퀴에 깨운다
+    mutex kickMtx;
+    vector<SOCKET> kicked;   // notify() 된 소켓 (kickMtx)
 
-            auto client = make_shared<TCPClient>();
-            client->sock = cs; client->name = name; client->addr = clientAddr; client->alive.store(true);
-            {
-                lock_guard<mutex> lg(clientsMtx); clients.push_back(client);
+    static Detached detach(Reactor& r, Task<> t) {
+        ++r.live;
+        try { co_await t; }
+        catch (const exception& ex) { Logger::error(string("Coroutine failed: ") + ex.what()); }
+        --r.live;
+    }
+
+    void park(Wait& w) {
+        if (w.fd != INVALID_SOCKET) {
+            Slot& s = slots[w.fd];
+            if (s.interest != w.events) {
+                try { if (s.interest) poller.modify(w.fd, w.events); else poller.add(w.fd, w.events); }
+                catch (...) { slots.erase(w.fd); throw; }
+                s.interest = w.events;
             }
+            s.waiter = &w;
+        }
+        if (stopping.load()) w.deadline = steady_clock::time_point::min();   // 멈추는 중: 바로 깨운다
+        if (w.deadline == steady_clock::time_point::max()) return;
+        if (w.fd == INVALID_SOCKET && w.deadline <= steady_clock::now()) yielded.push_back(&w);
+        else timers.arm(w, w.deadline);
+    }
 
-            Logger::info(string("[서버] ") + name + " 입장 (" + sockaddrToString(clientAddr) + ")");
-            thread([this, client]() { this->clientHandler(client); }).detach();
+    void resume(Wait& w, int events) {
+        timers.cancel(w);
+        if (w.fd != INVALID_SOCKET) {
+            auto it = slots.find(w.fd);
+            if (it != slots.end() && it->second.waiter == &w) it->second.waiter = nullptr;
         }
+        w.result = events;
+        w.h.resume();   // 여기서 돌아오면 w 는 이미 없을 수 있다
     }
 
-    void clientHandler(shared_ptr<TCPClient> client) {
-        SOCKET s = client->sock;
-        string name = client->name;
-        char buf[BUF_SIZE];
-        while (running.load() && client->alive.load()) {
-            int r = recv(s, buf, BUF_SIZE - 1, 0);
-            if (r > 0) {
-                buf[r] = '\0'; string out = "[" + name + "] " + buf;
-                Logger::info("TCP msg: " + out);
-                broadcastTcp(out + "\n", s); // TCP만
-            }
-            else if (r == 0) { Logger::info("Client disconnected: " + name); break; }
-            else { int e = WSAGetLastError(); if (e == WSAEWOULDBLOCK || e == WSAEINTR) { this_thread::sleep_for(milliseconds(50)); continue; } Logger::warn("recv error: " + lastWinsockError()); break; }
+    // stop(): 기다리는 모두를 지금 만료되는 timer 로 옮긴다. 깨우는 것은 run() 의 timer 처리가 하나씩 (다시 찾아서) 한다
+    void dueAll() {
+        timers.expireAll();
+        for (auto& s : slots) if (s.second.waiter && !s.second.waiter->armed()) timers.arm(*s.second.waiter, steady_clock::time_point::min());
+    }
+};
+
+// ---------------- UDP fan-out ----------------
+// 등록된 UDP 목적지 스냅샷. 등록이 바뀔 때만 새로 만들고, 송신 측은 udpMtx 밖에서 읽는다.
+typedef vector<sockaddr_in> UdpTargets;
+
+// 기존 경로: 목적지마다 sendto 1회. 실패한 목적지 수를 돌려준다.
+int udpFanoutPlain(SOCKET s, const UdpTargets& targets, const char* data, size_t len) {
+    int fails = 0;
+    for (auto& a : targets) if (sendto(s, data, (int)len, 0, (const sockaddr*)&a, sizeof(a)) == SOCKET_ERROR) ++fails;
+    return fails;
+}
+
+#ifdef __linux__
+// 커널이 UDP_SEGMENT(GSO, 4.18+) 를 아는지 소켓에서 직접 확인한다.
+bool udpGsoSupported(SOCKET s) { int v = 0; socklen_t l = sizeof(v); return getsockopt(s, SOL_UDP, UDP_SEGMENT, &v, &l) == 0; }
+// UDP_GRO(5.0+) 를 켠다. 실패하면 평범한 수신 경로를 그대로 쓴다.
+bool enableUdpGro(SOCKET s) { int one = 1; return setsockopt(s, SOL_UDP, UDP_GRO, &one, sizeof(one)) == 0; }
+
+// sendmmsg 로 메시지를 모든 목적지에 보낸다.
+// mmsghdr 배열은 목적지 스냅샷이 바뀔 때만 다시 만들고, 메시지마다 iovec 만 바꾼다.
+// gso 가 켜져 있으면 sendBatch 가 같은 크기 메시지 구간을 목적지당 UDP_SEGMENT 한 번으로 묶는다.
+class UdpBatchSender {
+public:
+    bool gso = false;   // 호출 측이 udpGsoSupported() 결과로 켠다
+
+    int send(SOCKET s, const shared_ptr<const UdpTargets>& targets, const char* data, size_t len) {
+        if (targets != built) rebuild(targets);
+        return sendOne(s, data, len, 0);
+    }
+
+    int sendBatch(SOCKET s, const shared_ptr<const UdpTargets>& targets, const vector<string>& outs) {
+        int fails = 0;
+        for (size_t i = 0; i < outs.size();) {
+            size_t n = gso ? gsoRunLength(outs, i) : 1;
+            if (n == 1) fails += send(s, targets, outs[i].data(), outs[i].size());
+            else fails += sendRun(s, targets, &outs[i], n);
+            i += n;
         }
+        return fails;
+    }
 
-        client->alive.store(false);
-        if (s != INVALID_SOCKET) { shutdown(s, SD_BOTH); closesocket(s); client->sock = INVALID_SOCKET; }
+    // outs[i] 부터 GSO 한 번에 묶을 수 있는 메시지 수. 크기가 모두 같고 마지막 하나만 더 작을 수 있다.
+    static size_t gsoRunLength(const vector<string>& outs, size_t i) {
+        size_t seg = outs[i].size(), total = seg, n = 1;
+        if (seg == 0 || seg > UDP_GSO_MAX_SEG) return 1;
+        while (i + n < outs.size() && n < UDP_GSO_MAX_SEGS) {
+            size_t len = outs[i + n].size();
+            if (len == 0 || len > seg || total + len > UDP_GSO_MAX_BYTES) break;
+            total += len; ++n;
+            if (len < seg) break;
+        }
+        return n;
+    }
 
-        {
-            lock_guard<mutex> lg(clientsMtx);
-            clients.erase(remove_if(clients.begin(), clients.end(), [&](auto& p) { return p.get() == client.get(); }), clients.end());
+private:
+    shared_ptr<const UdpTargets> built;
+    vector<mmsghdr> one;   // 목적지별 메시지 1개
+    vector<mmsghdr> run;   // 목적지별 GSO 구간 (iovec 여러 개 + UDP_SEGMENT cmsg)
+    iovec iov{};
+    vector<iovec> runIov;
+    alignas(cmsghdr) char gsoCtl[CMSG_SPACE(sizeof(uint16_t))] = {};
+
+    void rebuild(const shared_ptr<const UdpTargets>& targets) {
+        built = targets;
+        one.assign(targets->size(), mmsghdr{});
+        run.assign(targets->size(), mmsghdr{});
+        for (size_t i = 0; i < one.size(); ++i) {
+            msghdr& h = one[i].msg_hdr;
+            h.msg_name = const_cast<sockaddr_in*>(&(*targets)[i]); h.msg_namelen = sizeof(sockaddr_in);
+            h.msg_iov = &iov; h.msg_iovlen = 1;
+            msghdr& g = run[i].msg_hdr;
+            g.msg_name = h.msg_name; g.msg_namelen = h.msg_namelen;
+            g.msg_control = gsoCtl; g.msg_controllen = sizeof(gsoCtl);
         }
+    }
 
-        string left = string("[서버] ") + name + " 퇴장\n";
-        broadcastTcp(left);
-        Logger::info("Client handler finished: " + name);
+    int sendOne(SOCKET s, const char* data, size_t len, size_t from) {
+        iov.iov_base = const_cast<char*>(data); iov.iov_len = len;
+        int fails = 0;
+        size_t done = from;
+        while (done < one.size()) {
+            unsigned n = (unsigned)min<size_t>(one.size() - done, UIO_MAXIOV);
+            int r = sendmmsg(s, &one[done], n, 0);
+            if (r < 0) { if (errno == EINTR) continue; ++fails; ++done; continue; } // 첫 항목이 실패하면 건너뛴다
+            done += (size_t)r;
+        }
+        return fails;
     }
 
-    void udpLoop() {
-        char buf[BUF_SIZE];
-        while (running.load()) {
-            sockaddr_in from{}; int fromlen = sizeof(from);
-            int r = recvfrom(udpSock, buf, BUF_SIZE - 1, 0, (sockaddr*)&from, &fromlen);
-            if (r == SOCKET_ERROR) { int e = WSAGetLastError(); if (!running.load()) break; if (e == WSAEWOULDBLOCK || e == WSAEINTR) { this_thread::sleep_for(milliseconds(50)); continue; } Logger::warn("UDP recv failed: " + lastWinsockError()); this_thread::sleep_for(milliseconds(100)); continue; }
-            buf[r] = '\0'; string s = buf;
-            const string reg = "REGISTER ";
-            if (s.rfind(reg, 0) == 0) { string name = s.substr(reg.size()); registerUdpClient(name, from); Logger::info("[UDP] REGISTER: " + name + " from " + sockaddrToString(from)); }
-            else { string out = "[UDP][" + sockaddrToString(from) + "] " + s; Logger::info("UDP msg: " + out); broadcastUdp(out); }
+    int sendRun(SOCKET s, const shared_ptr<const UdpTargets>& targets, const string* msgs, size_t n) {
+        if (targets != built) rebuild(targets);
+        runIov.resize(n);
+        for (size_t k = 0; k < n; ++k) { runIov[k].iov_base = const_cast<char*>(msgs[k].data()); runIov[k].iov_len = msgs[k].size(); }
+        cmsghdr* c = reinterpret_cast<cmsghdr*>(gsoCtl);
+        c->cmsg_level = SOL_UDP; c->cmsg_type = UDP_SEGMENT; c->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+        uint16_t seg = (uint16_t)msgs[0].size(); memcpy(CMSG_DATA(c), &seg, sizeof(seg));
+        for (auto& m : run) { m.msg_hdr.msg_iov = runIov.data(); m.msg_hdr.msg_iovlen = n; }
+
+        int fails = 0;
+        size_t done = 0;
+        while (done < run.size()) {
+            unsigned cnt = (unsigned)min<size_t>(run.size() - done, UIO_MAXIOV);
+            int r = sendmmsg(s, &run[done], cnt, 0);
+            if (r >= 0) { done += (size_t)r; continue; }
+            if (errno == EINTR) continue;
+            if (errno == EIO || errno == EINVAL || errno == EOPNOTSUPP) {
+                // 장치가 체크섬 offload 를 못 하는 등 이 경로에서 GSO 를 쓸 수 없다: 이후로는 plain sendmmsg
+                Logger::warn("UDP GSO rejected (" + lastWinsockError() + "), falling back to sendmmsg");
+                gso = false;
+                for (size_t k = 0; k < n; ++k) fails += sendOne(s, msgs[k].data(), msgs[k].size(), done);
+                break;
+            }
+            ++fails; ++done;
         }
+        return fails;
     }
+};
 
-    void registerUdpClient(const string& name, const sockaddr_in& from) {
-        lock_guard<mutex> lg(udpMtx);
-        for (auto& u : udpClients) { if (u.addr.sin_addr.s_addr == from.sin_addr.s_addr && u.addr.sin_port == from.sin_port) { u.name = name; return; } }
-        UDPClient uu; uu.addr = from; uu.name = name; udpClients.push_back(uu);
+// recvmmsg 로 여러 datagram 을 한 번에 받는다.
+// gro 이면 슬롯 하나가 커널이 합친 최대 64KB 를 받고, UDP_GRO cmsg 의 segment 크기로 다시 나눠 돌려준다.
+class UdpBatchReceiver {
+public:
+    UdpBatchReceiver(int slots, bool gro = false)
+        : slotSize(gro ? UDP_GRO_BUF : BUF_SIZE), bufs((size_t)slots * slotSize), addrs(slots), iovs(slots), msgs(slots),
+        ctl(gro ? (size_t)slots * GRO_CTL : 0) {
+        for (int i = 0; i < slots; ++i) {
+            iovs[i].iov_base = &bufs[(size_t)i * slotSize]; iovs[i].iov_len = slotSize;
+            msghdr& h = msgs[i].msg_hdr;
+            h.msg_name = &addrs[i]; h.msg_iov = &iovs[i]; h.msg_iovlen = 1;
+        }
     }
 
-    void broadcastTcp(const string& msg, SOCKET exceptSock = INVALID_SOCKET) {
-        lock_guard<mutex> lg(clientsMtx);
-        for (auto& cptr : clients) { if (cptr->sock == INVALID_SOCKET) continue; if (cptr->sock == exceptSock) continue; int sent = send(cptr->sock, msg.c_str(), (int)msg.size(), 0); if (sent == SOCKET_ERROR) Logger::warn("TCP send failed to " + cptr->name + ": " + lastWinsockError()); }
+    // MSG_WAITFORONE: 첫 datagram 까지만 block 하고, 그 시점에 쌓여 있는 만큼 가져온다.
+    // 돌려주는 값은 segment(응용이 보낸 datagram) 수다.
+    int recv(SOCKET s, int flags = MSG_WAITFORONE) {
+        for (size_t i = 0; i < msgs.size(); ++i) {
+            msghdr& h = msgs[i].msg_hdr;
+            h.msg_namelen = sizeof(sockaddr_in);
+            if (!ctl.empty()) { h.msg_control = &ctl[i * GRO_CTL]; h.msg_controllen = GRO_CTL; }
+        }
+        int n = recvmmsg(s, msgs.data(), (unsigned)msgs.size(), flags, nullptr);
+        segs.clear();
+        for (int i = 0; i < n; ++i) {
+            char* base = &bufs[(size_t)i * slotSize];
+            size_t len = msgs[i].msg_len, seg = groSegment(msgs[i].msg_hdr, len);
+            if (seg == 0 || seg >= len) { segs.push_back({ base, len, i }); continue; }
+            for (size_t off = 0; off < len; off += seg) segs.push_back({ base + off, min(seg, len - off), i });
+        }
+        return n < 0 ? n : (int)segs.size();
     }
+    char* data(int i) { return segs[i].data; }
+    size_t size(int i) const { return segs[i].len; }
+    const sockaddr_in& from(int i) const { return addrs[segs[i].slot]; }
 
-    void broadcastUdp(const string& msg) {
-        lock_guard<mutex> lg(udpMtx);
-        for (auto& u : udpClients) { int sent = sendto(udpSock, msg.c_str(), (int)msg.size(), 0, (sockaddr*)&u.addr, sizeof(u.addr)); if (sent == SOCKET_ERROR) Logger::warn("UDP sendto failed: " + lastWinsockError()); }
+private:
+    static constexpr size_t GRO_CTL = CMSG_SPACE(sizeof(int));
+    struct Segment { char* data; size_t len; int slot; };
+    size_t slotSize;
+    vector<char> bufs;
+    vector<sockaddr_in> addrs;
+    vector<iovec> iovs;
+    vector<mmsghdr> msgs;
+    vector<char> ctl;
+    vector<Segment> segs;
+
+    static size_t groSegment(const msghdr& h, size_t len) {
+        for (cmsghdr* c = CMSG_FIRSTHDR(&h); c; c = CMSG_NXTHDR(const_cast<msghdr*>(&h), c)) {
+            if (c->cmsg_level == SOL_UDP && c->cmsg_type == UDP_GRO) { int v = 0; memcpy(&v, CMSG_DATA(c), sizeof(v)); if (v > 0) return (size_t)v; }
+        }
+        return len;
     }
 };
 
-// ---------------- ChatClient ----------------
-class ChatClient {
+// SO_REUSEPORT 그룹의 소켓 선택을 "패킷을 처리한 CPU % shards" 로 바꾼다.
+// 코어별로 고정된 수신 스레드와 같이 쓰면 NIC RSS 가 나눈 흐름이 그 코어의 소켓으로 그대로 들어간다.
+bool attachReuseportCpuSteering(SOCKET s, int shards) {
+    sock_filter code[] = {
+        { BPF_LD | BPF_W | BPF_ABS, 0, 0, (uint32_t)(SKF_AD_OFF + SKF_AD_CPU) },
+        { BPF_ALU | BPF_MOD | BPF_K, 0, 0, (uint32_t)shards },
+        { BPF_RET | BPF_A, 0, 0, 0 },
+    };
+    sock_fprog prog{};
+    prog.len = (unsigned short)(sizeof(code) / sizeof(code[0])); prog.filter = code;
+    return setsockopt(s, SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF, &prog, sizeof(prog)) == 0;
+}
+#endif
+
+// UDP 소켓을 port 에 bind 한다. reusePort 이면 같은 포트의 SO_REUSEPORT 그룹에 합류한다.
+SOCKET openUdpSocket(unsigned short port, bool reusePort) {
+    SOCKET s = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (s == INVALID_SOCKET) throw runtime_error("UDP socket() failed: " + lastWinsockError());
+#ifdef SO_REUSEPORT
+    int one = 1;
+    if (reusePort && setsockopt(s, SOL_SOCKET, SO_REUSEPORT, (const char*)&one, sizeof(one)) != 0) { closesocket(s); throw runtime_error("SO_REUSEPORT failed: " + lastWinsockError()); }
+#else
+    if (reusePort) { closesocket(s); throw runtime_error("SO_REUSEPORT not supported on this platform"); }
+#endif
+    sockaddr_in u{}; u.sin_family = AF_INET; u.sin_addr.s_addr = INADDR_ANY; u.sin_port = htons(port);
+    if (bind(s, (sockaddr*)&u, sizeof(u)) == SOCKET_ERROR) { closesocket(s); throw runtime_error("UDP bind failed: " + lastWinsockError()); }
+    return s;
+}
+
+// ---------------- Reliable UDP ----------------
+// /udp 메시지용 선택적 신뢰 전송. "REGISTER <name> RELIABLE" 에 서버가 "REGISTERED RELIABLE" 로 답하면 켜진다.
+// 순서 번호 + selective ACK(누적 ACK + 64bit 비트맵) + 타임스탬프 에코로 잰 RTT 기반 RTO(RFC 6298) + AIMD 혼잡 윈도.
+// 손실 판정은 SACK 3개(dupthresh) 또는 RACK 식 시간 기준(나중에 보낸 packet 이 도착했고 srtt + 재정렬 여유가 지남).
+// 타이머 첫 만료는 probe(최신 미확인 packet 재전송으로 SACK 유도), 연속 만료부터 RTO(윈도 1)로 다룬다.
+//   DATA: [0x01][1][0][0][seq:4][tsVal:4][payload]
+//   ACK : [0x01][2][0][0][cumAck:4][tsEcho:4][sack:8]   sack bit i = cumAck+1+i 수신함
+// 소켓 I/O 는 하지 않는다. 보낼 datagram 은 out 으로, 순서대로 모인 payload 는 deliver 로 넘긴다.
+// deliver 는 채널 락 안에서 불리므로 그 안에서 같은 채널을 다시 호출하면 안 된다.
+constexpr uint8_t RUDP_MAGIC = 0x01;
+constexpr size_t RUDP_WINDOW = 256;           // 송신 in-flight / 수신 재정렬 버퍼 최대 packet 수
+constexpr int RUDP_MAX_TIMEOUTS = 12;         // 연속 타이머 만료가 이만큼 나면(약 13초) 상대가 사라진 것으로 본다
+constexpr int RUDP_REGISTER_TRIES = 3;
+const string RUDP_REGISTER_SUFFIX = " RELIABLE";
+const string RUDP_REGISTERED = "REGISTERED RELIABLE";
+
+class ReliableChannel {
 public:
-    ChatClient(const string& serverIp, const string& port, const string& name)
-        : serverIp(serverIp), portStr(port), myName(name), tcpSock(INVALID_SOCKET), udpSock(INVALID_SOCKET),
-        running(false), stopFlag(false) {
+    typedef function<void(const char*, size_t)> Output;
+    typedef function<void(const char*, size_t)> Deliver;
+
+    struct Stats { uint64_t retransmits = 0, timeouts = 0, lossEvents = 0; double srttMs = 0, cwnd = 0; };
+
+    ReliableChannel() : epoch(steady_clock::now()) {}
+
+    static bool isPacket(const char* p, size_t n) {
+        return n >= DATA_HDR && (uint8_t)p[0] == RUDP_MAGIC && (p[1] == DATA || (p[1] == ACK && n >= ACK_HDR));
     }
-    ~ChatClient() { stop(); }
 
-    void start() {
-        if (running.load()) return;
-        running.store(true);
-        clientThread = thread(&ChatClient::run, this);
+    void send(const char* data, size_t len, const Output& out) {
+        lock_guard<mutex> lg(mtx);
+        backlog.emplace_back(data, len);
+        transmit(steady_clock::now(), out);
     }
 
-    void stop() {
-        if (!running.load()) return;
-        stopFlag.store(true);
-        running.store(false);
-        if (tcpSock != INVALID_SOCKET) { shutdown(tcpSock, SD_BOTH); closesocket(tcpSock); tcpSock = INVALID_SOCKET; }
-        if (udpSock != INVALID_SOCKET) { closesocket(udpSock); udpSock = INVALID_SOCKET; }
-        if (clientThread.joinable()) clientThread.join();
+    void onPacket(const char* p, size_t n, const Output& out, const Deliver& deliver) {
+        lock_guard<mutex> lg(mtx);
+        auto now = steady_clock::now();
+        uint32_t a = rd32(p + 4), ts = rd32(p + 8);
+        if (p[1] == DATA) { onData(a, ts, p + DATA_HDR, n - DATA_HDR, out, deliver); return; }
+        onAck(a, ((uint64_t)rd32(p + 12) << 32) | rd32(p + 16), ts, now);
+        transmit(now, out);
     }
 
-private:
-    string serverIp;
-    string portStr;
-    string myName;
-    SOCKET tcpSock;
-    SOCKET udpSock;
-    thread clientThread;
-    thread tcpRecvThread;
-    thread udpRecvThread;
-    thread inputThread;
-    atomic<bool> running;
-    atomic<bool> stopFlag;
-    sockaddr_in serverUdpAddr{};
+    // 재정렬 타이머 / 재전송 타이머 만료 처리.
+    void tick(const Output& out) {
+        lock_guard<mutex> lg(mtx);
+        auto now = steady_clock::now();
+        if (inflight.empty()) return;
+        if (now >= reoDeadline && now < rtoDeadline) { detectLoss(now); transmit(now, out); return; }
+        if (now < rtoDeadline) return;
+        ++timeouts; ++stats_.timeouts;
+        rto = min(rto * 2, RTO_MAX);
+        rtoDeadline = now + rto;
+        if (timeouts == 1) {
+            // probe: 꼬리 손실이나 ACK 손실이면 이것 하나로 SACK 이 돌아와 RACK 이 나머지를 복구한다. 윈도는 그대로.
+            for (auto it = inflight.rbegin(); it != inflight.rend(); ++it)
+                if (!it->sacked) { it->lost = false; ++stats_.retransmits; emitData(*it, now, out); break; }
+            return;
+        }
+        // 연속 만료: 아직 SACK 되지 않은 in-flight 를 모두 손실로 보고 윈도를 1로 줄인다.
+        for (auto& f : inflight) if (!f.sacked) f.lost = true;
+        enterRecovery();
+        cwnd = 1;
+        transmit(now, out);
+    }
 
-    void run() {
-        try {
-            WinsockInit w;
-            connectTcp();
-            setupUdpAndBindLocal();
-            registerUdp();
-            Logger::info("Connected to server " + serverIp + ":" + portStr + " as " + myName);
+    steady_clock::time_point deadline() {
+        lock_guard<mutex> lg(mtx);
+        return inflight.empty() ? steady_clock::time_point::max() : min(rtoDeadline, reoDeadline);
+    }
+    bool dead() { lock_guard<mutex> lg(mtx); return timeouts >= RUDP_MAX_TIMEOUTS; }
+    Stats stats() {
+        lock_guard<mutex> lg(mtx);
+        Stats st = stats_; st.srttMs = srtt.count() / 1000.0; st.cwnd = cwnd;
+        return st;
+    }
 
-            tcpRecvThread = thread(&ChatClient::tcpReceiver, this);
-            udpRecvThread = thread(&ChatClient::udpReceiver, this);
-            inputThread = thread(&ChatClient::inputLoop, this);
+private:
+    enum : uint8_t { DATA = 1, ACK = 2 };
+    static constexpr size_t DATA_HDR = 12, ACK_HDR = 20;
+    static constexpr microseconds RTO_MIN = milliseconds(10), RTO_MAX = seconds(4), RTO_INIT = milliseconds(300);
+
+    struct Inflight {
+        uint32_t seq;
+        string payload;
+        uint64_t txOrder = 0;   // 마지막 전송 순번 (재전송하면 커진다)
+        steady_clock::time_point sentAt{};
+        bool sacked = false;
+        bool lost = false;
+    };
 
-            while (!stopFlag.load()) this_thread::sleep_for(milliseconds(200));
+    mutex mtx;
+    steady_clock::time_point epoch;
+    // 송신
+    deque<string> backlog;
+    deque<Inflight> inflight;   // seq 오름차순, front 가 가장 오래된 미확인 packet
+    uint32_t sndNxt = 0;
+    uint64_t txCounter = 0;
+    double cwnd = 4, ssthresh = (double)RUDP_WINDOW;
+    bool inRecovery = false;
+    uint32_t recoverSeq = 0;
+    bool haveRtt = false;
+    microseconds srtt{ 0 }, rttvar{ 0 }, rto = RTO_INIT;
+    steady_clock::time_point rtoDeadline;
+    steady_clock::time_point reoDeadline = steady_clock::time_point::max();   // RACK 재정렬 타이머
+    int timeouts = 0;
+    Stats stats_;
+    // 수신
+    uint32_t rcvNxt = 0;
+    map<uint32_t, string> ooo;   // 순서가 어긋나 도착한 packet
+    string pkt;                  // 송신 packet 조립용
 
-            if (inputThread.joinable()) inputThread.join();
-            if (tcpRecvThread.joinable()) tcpRecvThread.join();
-            if (udpRecvThread.joinable()) udpRecvThread.join();
+    static bool seqLess(uint32_t a, uint32_t b) { return (int32_t)(a - b) < 0; }
+    static uint32_t rd32(const char* p) { uint32_t v; memcpy(&v, p, 4); return ntohl(v); }
+    static void wr32(string& s, uint32_t v) { v = htonl(v); s.append((const char*)&v, 4); }
+    uint32_t stamp(steady_clock::time_point t) const { return (uint32_t)duration_cast<microseconds>(t - epoch).count() | 1u; }
 
+    // 손실 표시된 packet 부터 재전송하고, 그다음 새 데이터. 네트워크에 있다고 보는 수(pipe)가 cwnd 미만인 동안만.
+    void transmit(steady_clock::time_point now, const Output& out) {
+        size_t pipe = 0;
+        for (auto& f : inflight) if (!f.sacked && !f.lost) ++pipe;
+        for (auto& f : inflight) {
+            if (pipe >= (size_t)cwnd) return;
+            if (!f.lost) continue;
+            f.lost = false; ++pipe; ++stats_.retransmits;
+            emitData(f, now, out);
         }
-        catch (const exception& ex) {
-            Logger::error(string("Client fatal: ") + ex.what());
+        while (pipe < (size_t)cwnd && !backlog.empty() && inflight.size() < RUDP_WINDOW) {
+            if (inflight.empty()) rtoDeadline = now + rto;
+            inflight.push_back({ sndNxt++, move(backlog.front()), 0, now });
+            backlog.pop_front();
+            ++pipe;
+            emitData(inflight.back(), now, out);
         }
-        running.store(false);
     }
 
-    void connectTcp() {
-        addrinfo hints{}; addrinfo* res = nullptr;
-        hints.ai_family = AF_INET; hints.ai_socktype = SOCK_STREAM;
-        if (getaddrinfo(serverIp.c_str(), portStr.c_str(), &hints, &res) != 0) throw runtime_error("getaddrinfo failed");
-        tcpSock = socket(res->ai_family, res->ai_socktype, res->ai_protocol);
-        if (tcpSock == INVALID_SOCKET) { freeaddrinfo(res); throw runtime_error("socket failed: " + lastWinsockError()); }
-        if (connect(tcpSock, res->ai_addr, (int)res->ai_addrlen) == SOCKET_ERROR) { closesocket(tcpSock); tcpSock = INVALID_SOCKET; freeaddrinfo(res); throw runtime_error("connect failed: " + lastWinsockError()); }
-        freeaddrinfo(res);
-        u_long mode = 1; ioctlsocket(tcpSock, FIONBIO, &mode);
-        send(tcpSock, myName.c_str(), (int)myName.size(), 0);
+    void emitData(Inflight& f, steady_clock::time_point now, const Output& out) {
+        f.txOrder = ++txCounter; f.sentAt = now;
+        pkt.assign({ (char)RUDP_MAGIC, (char)DATA, 0, 0 });
+        wr32(pkt, f.seq); wr32(pkt, stamp(now));
+        pkt += f.payload;
+        out(pkt.data(), pkt.size());
     }
 
-    void setupUdpAndBindLocal() {
-        udpSock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
-        if (udpSock == INVALID_SOCKET) throw runtime_error("udp socket failed");
-        u_long mode = 1; ioctlsocket(udpSock, FIONBIO, &mode);
-        sockaddr_in local{}; local.sin_family = AF_INET; local.sin_addr.s_addr = INADDR_ANY; local.sin_port = htons(0);
-        bind(udpSock, (sockaddr*)&local, sizeof(local));
-        serverUdpAddr.sin_family = AF_INET;
-        inet_pton(AF_INET, serverIp.c_str(), &serverUdpAddr.sin_addr);
-        serverUdpAddr.sin_port = htons((unsigned short)stoi(portStr));
+    void onAck(uint32_t cumAck, uint64_t sack, uint32_t tsEcho, steady_clock::time_point now) {
+        // 에코된 타임스탬프로 재므로 재전송된 packet 의 ACK 도 RTT 가 모호하지 않다 (Karn 문제 없음)
+        if (tsEcho) sampleRtt(microseconds((uint32_t)(stamp(now) - tsEcho)));
+        bool progress = false;
+        while (!inflight.empty() && seqLess(inflight.front().seq, cumAck)) {
+            if (!inflight.front().sacked) growWindow();
+            inflight.pop_front(); progress = true;
+        }
+        for (auto& f : inflight) {
+            uint32_t off = f.seq - cumAck - 1;
+            if (off < 64 && ((sack >> off) & 1) && !f.sacked) { f.sacked = true; f.lost = false; growWindow(); progress = true; }
+        }
+        if (inRecovery && (inflight.empty() || !seqLess(inflight.front().seq, recoverSeq))) inRecovery = false;
+        if (progress) { timeouts = 0; rtoDeadline = now + rto; }
+        detectLoss(now);
     }
 
-    void registerUdp() {
-        string reg = "REGISTER " + myName;
-        sendto(udpSock, reg.c_str(), (int)reg.size(), 0, (sockaddr*)&serverUdpAddr, sizeof(serverUdpAddr));
+    // 자기보다 나중에 보낸 packet 이 3개 이상 SACK 되었거나, 하나라도 SACK 되었고 보낸 지 srtt + 재정렬 여유가 지났으면 손실.
+    // 재전송한 packet 은 txOrder 가 커지므로, 그 뒤에 보낸 packet 이 다시 도착해야 또 손실로 판정된다.
+    // 윈도가 작아 SACK 3개를 모을 수 없을 때도 RTO 까지 기다리지 않게 해 준다.
+    void detectLoss(steady_clock::time_point now) {
+        uint64_t top[3] = { 0, 0, 0 };   // 위쪽에서 SACK 된 packet 의 txOrder 중 큰 3개 (내림차순)
+        microseconds reoWnd = haveRtt ? srtt + max(srtt / 4, microseconds(1000)) : rto;
+        reoDeadline = steady_clock::time_point::max();
+        bool lossEvent = false;
+        for (auto it = inflight.rbegin(); it != inflight.rend(); ++it) {
+            if (it->sacked) {
+                uint64_t t = it->txOrder;
+                if (t > top[0]) { top[2] = top[1]; top[1] = top[0]; top[0] = t; }
+                else if (t > top[1]) { top[2] = top[1]; top[1] = t; }
+                else if (t > top[2]) top[2] = t;
+                continue;
+            }
+            if (it->lost || top[0] < it->txOrder) continue;
+            if (top[2] > it->txOrder || now - it->sentAt >= reoWnd) { it->lost = true; lossEvent = true; }
+            else reoDeadline = min(reoDeadline, it->sentAt + reoWnd);
+        }
+        if (lossEvent) enterRecovery();
     }
 
-    void tcpReceiver() {
-        char buf[BUF_SIZE];
-        while (!stopFlag.load()) {
-            int r = recv(tcpSock, buf, BUF_SIZE - 1, 0);
-            if (r > 0) { buf[r] = '\0'; cout << buf << "\n"; }
-            else if (r == 0) { Logger::info("Server closed TCP"); stopFlag.store(true); break; }
-            else { int e = WSAGetLastError(); if (e == WSAEWOULDBLOCK || e == WSAEINTR) { this_thread::sleep_for(milliseconds(50)); continue; } Logger::warn("TCP recv failed"); stopFlag.store(true); break; }
-        }
+    // 한 윈도 안의 손실에는 한 번만 반응한다.
+    void enterRecovery() {
+        if (inRecovery) return;
+        inRecovery = true; recoverSeq = sndNxt;
+        ssthresh = max(cwnd / 2, 2.0); cwnd = ssthresh;
+        ++stats_.lossEvents;
     }
 
-    void udpReceiver() {
-        char buf[BUF_SIZE];
-        while (!stopFlag.load()) {
-            sockaddr_in from{}; int fromlen = sizeof(from);
-            int r = recvfrom(udpSock, buf, BUF_SIZE - 1, 0, (sockaddr*)&from, &fromlen);
-            if (r > 0) { buf[r] = '\0'; cout << buf << "\n"; }
-            else { int e = WSAGetLastError(); if (e == WSAEWOULDBLOCK || e == WSAEINTR) { this_thread::sleep_for(milliseconds(50)); continue; } if (e != 0) { Logger::warn("UDP recv failed"); stopFlag.store(true); break; } }
-        }
+    void growWindow() {
+        cwnd += cwnd < ssthresh ? 1.0 : 1.0 / cwnd;
+        cwnd = min(cwnd, (double)RUDP_WINDOW);
+    }
+
+    void sampleRtt(microseconds r) {
+        if (!haveRtt) { srtt = r; rttvar = r / 2; haveRtt = true; }
+        else { rttvar = (3 * rttvar + chrono::abs(srtt - r)) / 4; srtt = (7 * srtt + r) / 8; }
+        rto = min(max(srtt + 4 * rttvar, RTO_MIN), RTO_MAX);
     }
 
-    void inputLoop() {
-        string line;
-        while (!stopFlag.load() && getline(cin, line)) {
-            if (line.empty()) continue;
-            if (line == "/quit" || line == "/exit") { stopFlag.store(true); break; }
-            if (line.rfind("/udp ", 0) == 0) { string msg = line.substr(5); sendto(udpSock, msg.c_str(), (int)msg.size(), 0, (sockaddr*)&serverUdpAddr, sizeof(serverUdpAddr)); }
-            else if (line.rfind("/tcp ", 0) == 0) { string msg = line.substr(5); send(tcpSock, msg.c_str(), (int)msg.size(), 0); }
-            else { send(tcpSock, line.c_str(), (int)line.size(), 0); }
+    void onData(uint32_t seq, uint32_t ts, const char* p, size_t n, const Output& out, const Deliver& deliver) {
+        int32_t d = (int32_t)(seq - rcvNxt);
+        if (d == 0) {
+            deliver(p, n); ++rcvNxt;
+            for (auto it = ooo.find(rcvNxt); it != ooo.end(); it = ooo.find(rcvNxt)) { deliver(it->second.data(), it->second.size()); ooo.erase(it); ++rcvNxt; }
         }
+        else if (d > 0 && d < (int32_t)RUDP_WINDOW) ooo.emplace(seq, string(p, n));
+        // 중복이나 창 밖 packet 에도 ACK 는 보낸다 (앞선 ACK 가 손실됐을 수 있다)
+        uint64_t sack = 0;
+        for (auto& kv : ooo) { uint32_t off = kv.first - rcvNxt - 1; if (off < 64) sack |= 1ull << off; }
+        pkt.assign({ (char)RUDP_MAGIC, (char)ACK, 0, 0 });
+        wr32(pkt, rcvNxt); wr32(pkt, ts); wr32(pkt, (uint32_t)(sack >> 32)); wr32(pkt, (uint32_t)sack);
+        out(pkt.data(), pkt.size());
     }
 };
 
-// ---------------- Ctrl+C ----------------
-static atomic<bool> g_terminate(false);
-BOOL WINAPI ConsoleHandler(DWORD signal) { if (signal == CTRL_C_EVENT || signal == CTRL_BREAK_EVENT || signal == CTRL_CLOSE_EVENT) { g_terminate.store(true); return TRUE; } return FALSE; }
+// ---------------- UDP FEC ----------------
+// "REGISTER <name> FEC" 로 등록한 클라이언트에게는 방송을 fec::Encoder 블록으로 보낸다 (fec.h).
+// 모든 FEC 클라이언트가 같은 블록을 받으므로 부호화는 메시지당 한 번이다.
+// 채팅은 메시지가 드문드문 오므로 덜 찬 블록은 UDP_FEC_FLUSH 가 지나면 닫는다.
+const string FEC_REGISTER_SUFFIX = " FEC";
+const string FEC_REGISTERED = "REGISTERED FEC";
+constexpr milliseconds UDP_FEC_FLUSH(20);
+
+bool stripSuffix(string& s, const string& suffix) {
+    if (s.size() <= suffix.size() || s.compare(s.size() - suffix.size(), string::npos, suffix) != 0) return false;
+    s.resize(s.size() - suffix.size());
+    return true;
+}
+
+// ---------------- Data ----------------
+struct Session;
+
+#ifndef _WIN32
+// /history 가 보낼 segment 파일 구간 (MessageLog::spans). 송신 큐에 들어가 소켓이 받는 만큼 sendfile 로 나가고, 다 나가면 닫는다.
+struct FileSpan {
+    int fd = -1;
+    uint64_t off = 0, len = 0;
+    FileSpan() = default;
+    FileSpan(const FileSpan&) = delete;
+    FileSpan& operator=(const FileSpan&) = delete;
+    ~FileSpan() { if (fd >= 0) close(fd); }
+};
+
+// 소켓이 받는 만큼 보낸다 (Linux sendfile, 그 밖에는 pread + send). 보낸 바이트 수, 실패면 -1
+int64_t sendSpan(SOCKET s, FileSpan& f) {
+    int64_t total = 0;
+    while (f.len > 0) {
+#ifdef __linux__
+        off_t o = (off_t)f.off;
+        ssize_t n = sendfile(s, f.fd, &o, (size_t)min<uint64_t>(f.len, 1 << 30));
+#else
+        char buf[1 << 16];
+        ssize_t r = pread(f.fd, buf, (size_t)min<uint64_t>(sizeof(buf), f.len), (off_t)f.off);
+        if (r < 0) return -1;
+        ssize_t n = r == 0 ? 0 : send(s, buf, (size_t)r, 0);
+#endif
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+            return -1;
+        }
+        if (n == 0) { f.len = 0; break; }   // 파일이 생각보다 짧다: 있는 데까지
+        f.off += (uint64_t)n; f.len -= (uint64_t)n; total += n;
+    }
+    return total;
+}
+
+#ifdef NET_HAVE_TLS
+// 송신이 userspace TLS 에 남은 연결의 sendSpan: 읽어서 SSL_write. 막혔으면 다음에 같은 자리, 같은 길이로 다시 부른다 (OpenSSL 의 write retry)
+int64_t sendSpanTls(net::TlsSession& t, FileSpan& f) {
+    char buf[16 << 10];
+    int64_t total = 0;
+    while (f.len > 0) {
+        ssize_t r = pread(f.fd, buf, (size_t)min<uint64_t>(sizeof(buf), f.len), (off_t)f.off);
+        if (r < 0) { if (errno == EINTR) continue; return -1; }
+        if (r == 0) { f.len = 0; break; }
+        int n = t.write(buf, (int)r);
+        if (n == net::TlsSession::AGAIN) break;
+        if (n <= 0) return -1;
+        f.off += (uint64_t)n; f.len -= (uint64_t)n; total += n;
+    }
+    return total;
+}
+#endif
+#endif
+
+// 송신 큐의 한 덩어리: 공유 버퍼 (방송, 기록 등, off 바이트까지는 보냄) 또는 파일 구간
+struct OutChunk {
+    shared_ptr<const string> buf;
+    size_t off = 0;
+    bool more = false;   // 다음 덩어리와 한 frame (헤더 + 파일 구간): 그 사이에 다른 차선이 끼면 안 된다
+#ifndef _WIN32
+    shared_ptr<FileSpan> file;
+#endif
+};
+
+constexpr size_t TCP_CLIENT_OUT_MAX = 4 << 20;   // 한 클라이언트에게 쌓아 둘 송신 바이트 상한 (파일 구간 제외, 두 차선 합). 넘으면 느린 클라이언트로 보고 끊는다
+
+// 송신 큐의 차선. Control (입장/퇴장, 명령의 답, WELCOME, PING) 은 방송 글 (Bulk) 이 밀려 있어도 앞질러 나간다.
+// 둘 다 쌓여 있으면 deficit round robin: 한 차례에 LANE_QUANTUM 바이트씩 (4 : 1), Bulk 도 굶지 않는다.
+// 차선을 바꾸는 것은 덩어리 (= frame / 줄) 경계에서만.
+enum class Lane : uint8_t { Control, Bulk };
+constexpr size_t LANE_COUNT = 2;
+constexpr size_t LANE_QUANTUM[LANE_COUNT] = { 64 << 10, 16 << 10 };
+inline const char* laneName(size_t i) { return i == 0 ? "control" : "bulk"; }
+
+struct OutLane {
+    vector<OutChunk> q;   // head 부터가 남은 것
+    size_t head = 0;
+    size_t bytes = 0;     // 남은 메모리 버퍼 바이트
+    size_t peak = 0;      // 지난 /queues 뒤로 가장 많이 남았던 bytes
+    bool mid = false;     // 맨 앞 덩어리를 보내다 말았거나 앞 덩어리의 more: 이 차선을 먼저 끝낸다
+    bool empty() const { return head == q.size(); }
+    size_t depth() const { return q.size() - head; }
+    void clear() { q.clear(); head = 0; bytes = 0; mid = false; }   // capacity 는 남는다: 다음 송신은 할당 없이
+};
+
+struct TCPClient {
+    SOCKET sock = INVALID_SOCKET;
+    string name;
+    sockaddr_in addr{};
+    uint32_t id = 0;       // binary 프로토콜의 sender ID (텍스트 클라이언트도 받는다: JOIN/LEAVE 에 쓰임)
+    bool binary = false;   // 첫 바이트가 wire::MAGIC 이었으면 (chat_wire.h)
+    string early;          // HELLO 와 같은 recv 에 붙어 온 바이트 (clientHandler 가 먼저 처리)
+    uint8_t version = 0;   // binary 프로토콜 버전 (WELCOME 에서 고른 것)
+    shared_ptr<Session> session;   // v2 재접속 세션 (ChatServer::clientsMtx)
+#ifdef NET_HAVE_TLS
+    unique_ptr<net::TlsSession> tls;   // --tls. 커널로 넘기지 못한 방향은 이것으로 (SSL_read / SSL_write 모두 sendMtx 안에서)
+#endif
+    bool replaced = false;         // RESUME 한 새 연결이 세션을 가져갔다 (clientsMtx)
+    bool bye = false;              // BYE 를 받았다: 세션을 남기지 않는다
+    vector<string> rooms;          // /join 한 방, 맨 뒤가 지금 방 (비어 있으면 전체 채팅). 이 연결의 clientHandler 만 clientsMtx 안에서 바꾼다
+    atomic<bool> alive{ true };
+    Reactor* reactor = nullptr;    // clientHandler coroutine 이 도는 곳. 송신이 밀리면 깨운다
+    mutex sendMtx;                 // 아래 송신 큐. 방송 (아무 스레드), /history, clientHandler 가 함께 쓴다
+    OutLane lanes[LANE_COUNT];     // 소켓이 받지 못한 나머지 (Lane 순). 남아 있으면 clientHandler 가 writable 을 기다려 보낸다
+    size_t turn = 0, credit = 0;   // 지금 차례인 차선과 그 차례에 남은 바이트
+    WritePolicy write;             // 이 소켓의 쓰기 정책 (ServerOptions::write)
+    steady_clock::time_point flushAt = steady_clock::time_point::min();   // Throughput: 모으는 중이면 보낼 시각 (clientHandler 의 timer)
+
+    bool outEmpty() const { for (auto& l : lanes) if (!l.empty()) return false; return true; }
+    size_t outBytes() const { size_t n = 0; for (auto& l : lanes) n += l.bytes; return n; }
+    bool collecting() const { return flushAt != steady_clock::time_point::min(); }
+    void clearOut() { for (auto& l : lanes) l.clear(); credit = 0; flushAt = steady_clock::time_point::min(); }
+};
+
+// sendMtx 안에서. 다음에 보낼 차선: 보내다 만 frame 이 있는 차선, 아니면 차례 (그 차선이 비었거나 credit 을 다 썼으면 다음 차선). 모두 비었으면 nullptr
+OutLane* nextLane(TCPClient& c) {
+    for (auto& l : c.lanes) if (l.mid) return &l;
+    if (c.credit == 0 || c.lanes[c.turn].empty()) {
+        size_t i = 1;
+        while (i <= LANE_COUNT && c.lanes[(c.turn + i) % LANE_COUNT].empty()) ++i;
+        if (i > LANE_COUNT) return nullptr;
+        c.turn = (c.turn + i) % LANE_COUNT;
+        c.credit = LANE_QUANTUM[c.turn];
+    }
+    return &c.lanes[c.turn];
+}
+
+// sendMtx 안에서. 쌓인 것을 소켓이 받는 만큼 보낸다 (차선마다 이어진 버퍼는 writev 식으로 한 번에, 파일 구간은 sendSpan). 소켓 오류면 false
+// 송신이 userspace TLS 면 덩어리마다 SSL_write. 막히면 같은 덩어리를 같은 자리부터 다시 넘겨야 하므로 (OpenSSL 의 write retry)
+// 보낸 것이 없어도 그 차선을 mid 로 둔다.
+bool flushOut(TCPClient& c) {
+    const size_t MAX_IOV = 64;
+#ifdef NET_HAVE_TLS
+    net::TlsSession* tls = c.tls && !c.tls->kernelSend() ? c.tls.get() : nullptr;
+#else
+    const bool tls = false;
+#endif
+    while (OutLane* l = nextLane(c)) {
+        auto& q = l->q;
+#ifndef _WIN32
+        if (auto& file = q[l->head].file) {
+#ifdef NET_HAVE_TLS
+            int64_t sent = tls ? sendSpanTls(*tls, *file) : sendSpan(c.sock, *file);
+#else
+            int64_t sent = sendSpan(c.sock, *file);
+#endif
+            if (sent < 0) return false;
+            c.credit -= min(c.credit, (size_t)sent);
+            if (file->len > 0) { l->mid = l->mid || sent > 0 || tls; return true; }   // 소켓이 가득
+            file.reset();
+            l->mid = q[l->head++].more;
+            if (l->empty()) l->clear();
+            continue;
+        }
+#endif
+#ifdef NET_HAVE_TLS
+        if (tls) {
+            auto& ch = q[l->head];
+            int r = tls->write(ch.buf->data() + ch.off, (int)(ch.buf->size() - ch.off));
+            if (r == net::TlsSession::AGAIN) { l->mid = true; return true; }
+            if (r <= 0) return false;
+            c.credit -= min(c.credit, (size_t)r);
+            ch.off += (size_t)r; l->bytes -= (size_t)r;
+            if (ch.off < ch.buf->size()) { l->mid = true; continue; }   // record 하나만큼 나갔다
+            ch.buf.reset();
+            l->mid = q[l->head++].more;
+            if (l->empty()) l->clear();
+            continue;
+        }
+#endif
+        // credit 만큼 (적어도 한 덩어리) 모아 한 번에
+        size_t end = l->head, n = 0, want = 0;
+#ifdef _WIN32
+        WSABUF iov[MAX_IOV]; DWORD cnt = 0, sent = 0;
+        for (; end < q.size() && cnt < MAX_IOV && (cnt == 0 || want < c.credit); ++end, ++cnt) { auto& ch = q[end]; iov[cnt].buf = (char*)ch.buf->data() + ch.off; iov[cnt].len = (ULONG)(ch.buf->size() - ch.off); want += iov[cnt].len; }
+        if (WSASend(c.sock, iov, cnt, &sent, 0, nullptr, nullptr) != 0) return WSAGetLastError() == WSAEWOULDBLOCK;
+        n = sent;
+#else
+        iovec iov[MAX_IOV]; size_t cnt = 0;
+        for (; end < q.size() && cnt < MAX_IOV && !q[end].file && (cnt == 0 || want < c.credit); ++end, ++cnt) { auto& ch = q[end]; iov[cnt].iov_base = (void*)(ch.buf->data() + ch.off); iov[cnt].iov_len = ch.buf->size() - ch.off; want += iov[cnt].iov_len; }
+        msghdr mh{}; mh.msg_iov = iov; mh.msg_iovlen = cnt;
+        ssize_t r = sendmsg(c.sock, &mh, 0);
+        if (r < 0) { if (errno == EINTR) continue; return errno == EAGAIN || errno == EWOULDBLOCK; }
+        n = (size_t)r;
+#endif
+        c.credit -= min(c.credit, n);
+        for (; l->head < end; ++l->head) {
+            auto& ch = q[l->head];
+            size_t left = ch.buf->size() - ch.off;
+            if (n < left) { ch.off += n; l->bytes -= n; l->mid = l->mid || n > 0; return true; }   // 소켓이 가득
+            n -= left; l->bytes -= left;
+            ch.buf.reset();
+            l->mid = ch.more;
+        }
+        if (l->empty()) l->clear();
+    }
+    return true;
+}
+
+// clientHandler 의 recv. 수신이 userspace TLS 에 남은 연결은 SSL_read (송신과 같은 SSL 이므로 sendMtx 안에서).
+// recv 처럼 돌려준다: 막혔으면 -1 에 WSAEWOULDBLOCK, TLS 오류는 여기서 알리고 0 (끊김)
+int recvClient(TCPClient& c, char* buf, int len) {
+#ifdef NET_HAVE_TLS
+    if (c.tls && !c.tls->kernelRecv()) {
+        lock_guard<mutex> sl(c.sendMtx);
+        int r = c.tls->read(buf, len);
+        if (r == net::TlsSession::AGAIN) {
+#ifdef _WIN32
+            WSASetLastError(WSAEWOULDBLOCK);
+#else
+            errno = EWOULDBLOCK;
+#endif
+            return -1;
+        }
+        if (r < 0) { Logger::warn("TLS recv failed: " + c.name + ": " + c.tls->error); return 0; }
+        return r;
+    }
+#endif
+    return recv(c.sock, buf, len, 0);
+}
+
+// SSL 이 풀어 두고 아직 recvClient 로 돌려주지 않은 평문이 있다 (소켓이 readable 해지기를 기다리면 안 된다)
+bool tlsBuffered(TCPClient& c) {
+#ifdef NET_HAVE_TLS
+    if (c.tls && !c.tls->kernelRecv()) { lock_guard<mutex> sl(c.sendMtx); return c.tls->buffered(); }
+#endif
+    (void)c;
+    return false;
+}
+
+// sendMtx 안에서. 지금 보낸다 (모으던 것이면 그만 모은다). Throughput 소켓은 cork 로 감싸 여러 번의 writev / sendfile 이
+// 꽉 찬 segment 로 나가고 마지막 꼬리는 cork 를 풀 때 나간다
+bool sendOut(TCPClient& c) {
+    c.flushAt = steady_clock::time_point::min();
+    if (c.write.mode == WriteMode::Latency) return flushOut(c);
+    cork(c.sock, true);
+    bool ok = flushOut(c);
+    cork(c.sock, false);
+    return ok;
+}
+
+// sendMtx 안에서, 차선에 더한 뒤. idle (더하기 전 모두 비어 있었음) 이면 바로 보내 보고, 남은 것은 clientHandler 가 보내도록 깨운다.
+// Throughput 소켓의 Bulk 는 모은다: 첫 바이트부터 write.window 뒤 (clientHandler) 또는 write.bytes 가 차거나 Control 이 올 때 한 번에.
+// 오류거나 TCP_CLIENT_OUT_MAX 를 넘으면 큐를 버린다 (넘은 쪽은 끊는다: clientHandler 가 정리한다).
+void startOut(TCPClient& c, bool idle, Lane lane = Lane::Bulk) {
+    bool ready = idle || c.collecting();   // 소켓이 받을 수 있다고 보는 때 (아니면 clientHandler 가 writable 을 기다리는 중)
+    if (ready && c.write.mode == WriteMode::Throughput && lane == Lane::Bulk && c.outBytes() < c.write.bytes) {
+        if (idle) {
+            c.flushAt = steady_clock::now() + c.write.window;
+            if (c.reactor) c.reactor->notify(c.sock);
+        }
+        return;
+    }
+    if (ready && !sendOut(c)) {
+        Logger::warn("TCP send failed to " + c.name + ": " + lastWinsockError());
+        c.clearOut();
+        return;
+    }
+    if (c.outEmpty()) return;
+    for (auto& l : c.lanes) l.peak = max(l.peak, l.bytes);
+    if (c.outBytes() > TCP_CLIENT_OUT_MAX) {
+        Logger::warn("Slow client dropped: " + c.name + " (" + to_string(c.outBytes()) + " bytes queued)");
+        c.clearOut();
+        c.alive.store(false);
+        shutdown(c.sock, SD_BOTH);
+        return;
+    }
+    if (ready && c.reactor) c.reactor->notify(c.sock);
+}
+
+// 아무 스레드에서나. 공유 버퍼들을 그 차선에 순서대로 보낸다 (복사 없음). 앞서 쌓인 것이 없으면 대개 여기서 다 나간다.
+void queueSend(TCPClient& c, const shared_ptr<const string>* bufs, size_t n, Lane lane = Lane::Bulk) {
+    lock_guard<mutex> sl(c.sendMtx);
+    if (c.sock == INVALID_SOCKET || !c.alive.load()) return;   // 이미 끊기로 한 연결
+    bool idle = c.outEmpty();
+    OutLane& l = c.lanes[(size_t)lane];
+    for (size_t i = 0; i < n; ++i) { l.q.emplace_back(); l.q.back().buf = bufs[i]; l.bytes += bufs[i]->size(); }
+    startOut(c, idle, lane);
+}
+
+void queueSend(TCPClient& c, const shared_ptr<const string>& buf, Lane lane = Lane::Bulk) { queueSend(c, &buf, 1, lane); }
+
+// frame 하나를 out 뒤에 붙인다
+void appendFrame(string& out, const wire::Frame& f) {
+    size_t at = out.size();
+    out.resize(at + wire::encodedSize(f));
+    wire::encode(f, &out[at], out.size() - at);
+}
+
+string makeFrame(const wire::Frame& f) {
+    string out;
+    appendFrame(out, f);
+    return out;
+}
+
+string makeFrame(uint8_t type, uint32_t sender, const char* p, size_t n, uint8_t flags = 0) {
+    wire::Frame f;
+    f.type = type; f.sender = sender; f.flags = flags; f.payload = p; f.len = n;
+    return makeFrame(f);
+}
+
+// 완성된 텍스트 줄(들)을 binary 클라이언트용 CHAT (sender 0) 으로
+string frameLine(const string& text, uint8_t flags = 0) { return makeFrame(wire::CHAT, 0, text.data(), text.size(), flags); }
+
+enum class UdpMode { Plain, Reliable, Fec };
+
+const char* udpModeTag(UdpMode m) { return m == UdpMode::Reliable ? " (reliable)" : m == UdpMode::Fec ? " (fec)" : ""; }
+
+// REGISTER 마다 다시 걸리는 만료 timer 를 가진다 (ChatServer::udpIdle)
+struct UDPClient : TimerWheel::Timer {
+    sockaddr_in addr{};
+    string name;
+    UdpMode mode = UdpMode::Plain;   // Reliable 은 rudpPeers, Fec 는 fecTargets 로 보낸다
+    vector<string> rooms;            // /join 한 방, 맨 뒤가 지금 방
+};
+
+uint64_t endpointKey(const sockaddr_in& a) { return ((uint64_t)a.sin_addr.s_addr << 16) | a.sin_port; }
+
+struct ServerOptions {
+    int udpBatch = UDP_BATCH;   // 1 이하이면 recvfrom/sendto 경로 (Linux 외에서는 항상)
+    int udpShards = 1;          // SO_REUSEPORT UDP 소켓 수, 각자 코어에 고정된 수신 스레드를 가진다 (Linux)
+    bool udpCpuSteer = false;   // shard 선택을 커널 4-tuple 해시 대신 수신 CPU 기준 BPF 로
+    bool udpOffload = true;     // 커널이 지원하면 UDP_SEGMENT(GSO) 송신 / UDP_GRO 수신 (batched 경로)
+    int fecData = 8;            // FEC 블록의 data datagram 수 K
+    int fecParity = 2;          // FEC 블록의 parity datagram 수 M (블록당 M개까지 손실 복구)
+    int historyMessages = 100;  // 입장 시 다시 보낼 최근 TCP 메시지 수 (0 = 기록 안 함)
+    int historySeconds = 0;     // 그중 최근 T초 안의 것만 (0 = 제한 없음)
+    size_t historyBytes = 256 * 1024;   // 기록이 붙잡는 메시지 바이트 상한
+    string logDir;              // 비어 있지 않으면 영구 메시지 로그 (POSIX)
+    int logSegmentMb = 64;
+    int logSyncMs = 10;
+    uint32_t meshNodeId = 0;    // 0 이면 임의로 뽑는다
+    string meshPort;            // 서버 간 링크를 받을 포트 (비어 있으면 받지 않는다)
+    vector<string> meshPeers;   // 먼저 연결할 피어 노드 host:port (링크 하나는 한쪽에서만 적을 것)
+    int sessionTtlSec = 30;     // binary v2 클라이언트가 끊긴 뒤 RESUME 을 받아 주는 시간 (0 = 세션 없음)
+    int handshakeTimeoutMs = 5000;   // 연결 뒤 닉네임 (binary 는 HELLO) 이 다 와야 하는 시간. 넘으면 끊는다
+    int tcpListeners = 1;       // SO_REUSEPORT TCP listen 소켓 수, 각자 reactor 스레드가 accept 와 그 연결들을 맡는다 (Linux)
+    bool deferAccept = true;    // TCP_DEFER_ACCEPT: 첫 데이터가 온 연결만 accept (Linux)
+    bool tcpFastOpen = true;    // TCP_FASTOPEN: SYN 에 실린 첫 데이터를 받는다 (Linux, net.ipv4.tcp_fastopen 에 서버 비트가 있어야)
+    int heartbeatSec = 15;      // binary v3 클라이언트가 이만큼 조용하면 PING (0 = 끔)
+    int idleTimeoutSec = 45;    // PING 을 보내고도 이만큼 조용하면 끊는다. PONG 을 못 하는 클라이언트는 TCP keepalive 로 같은 시간
+    int udpIdleTimeoutSec = 90; // 이만큼 REGISTER 를 다시 보내지 않은 UDP 등록은 지운다 (0 = 지우지 않음)
+    WritePolicy write;          // 클라이언트 TCP 소켓의 쓰기 정책 (socket_core.h): latency 는 바로, throughput 은 window / bytes 만큼 모아서
+    bool tls = false;           // TCP 를 TLS 로. kTLS 로 넘어가지 않은 방향은 userspace 에서 (NET_TLS 빌드)
+    string tlsCert, tlsKey;     // 서버 인증서 (PEM). 비어 있으면 임시 self-signed
+};
+
+constexpr int ACCEPT_BATCH = 4;          // listen 소켓이 readable 할 때 한 번에 accept 하는 최대 연결 수. 같은 reactor 가 연결들도 돌리므로 작게 (크면 그동안 퇴장 처리가 밀린다)
+constexpr int TCP_FASTOPEN_QLEN = 1024;  // 쿠키 확인 전 SYN 데이터를 받아 둘 대기 연결 수
+
+#ifdef __linux__
+// net.ipv4.tcp_fastopen (1 = 클라이언트, 2 = 서버). 읽지 못하면 0
+int tcpFastOpenSysctl() {
+    FILE* f = fopen("/proc/sys/net/ipv4/tcp_fastopen", "r");
+    if (!f) return 0;
+    int v = 0;
+    if (fscanf(f, "%d", &v) != 1) v = 0;
+    fclose(f);
+    return v;
+}
+#endif
+
+// PING 에 답하지 못하는 연결 (텍스트, binary v2 이하): 커널 keepalive 로 대략 idleSec 안에 죽은 상대를 알아챈다.
+// 조용한 지 idleSec/3 뒤부터 probe 6번, idleSec/9 간격 (Linux. 다른 OS 는 keepalive 만 켜고 시스템 기본 간격)
+void setTcpKeepAlive(SOCKET s, int idleSec) {
+    int on = 1;
+    setsockopt(s, SOL_SOCKET, SO_KEEPALIVE, (const char*)&on, sizeof(on));
+#ifdef __linux__
+    int idle = max(1, idleSec / 3), intvl = max(1, idleSec / 9), cnt = 6;
+    setsockopt(s, IPPROTO_TCP, TCP_KEEPIDLE, &idle, sizeof(idle));
+    setsockopt(s, IPPROTO_TCP, TCP_KEEPINTVL, &intvl, sizeof(intvl));
+    setsockopt(s, IPPROTO_TCP, TCP_KEEPCNT, &cnt, sizeof(cnt));
+#else
+    (void)idleSec;
+#endif
+}
+
+// 커널 송신 버퍼에 쌓이는 아직 안 나간 바이트를 묶는다 (Linux TCP_NOTSENT_LOWAT). 커널 큐는 FIFO 라 그 안에 몇 MB 가
+// 쌓이면 Control 차선이 앞질러도 그 뒤에 선다: 밀린 것은 송신 큐 (차선) 에 남겨 두어야 우선순위가 듣는다
+constexpr int TCP_CLIENT_NOTSENT_LOWAT = 64 << 10;
+
+void setNotSentLowat(SOCKET s) {
+#ifdef TCP_NOTSENT_LOWAT
+    int v = TCP_CLIENT_NOTSENT_LOWAT;
+    setsockopt(s, IPPROTO_TCP, TCP_NOTSENT_LOWAT, (const char*)&v, sizeof(v));
+#else
+    (void)s;
+#endif
+}
+
+// ---------------- History ----------------
+// 최근 TCP 방송 메시지의 고정 크기 링. 슬롯 수와 총 바이트 둘 다 상한이라 메시지 속도와 상관없이 메모리가 묶인다.
+// 메시지는 방송에 쓴 불변 버퍼를 그대로 공유하므로 기록/재전송에 복사가 없다. 잠금은 호출자 몫 (ChatServer::clientsMtx).
+class HistoryRing {
+public:
+    typedef shared_ptr<const string> Message;
+
+    HistoryRing(size_t capacity, size_t maxBytes) : slots(capacity), maxBytes(maxBytes) {}
+
+    // seq 는 since() 를 쓸 때만 (0 이 아닌 고유한 번호)
+    void append(const Message& m, uint32_t seq = 0) {
+        if (slots.empty() || m->size() > maxBytes) { dropped = true; return; }
+        while (count == slots.size() || bytes + m->size() > maxBytes) popOldest();
+        slots[(head + count) % slots.size()] = { steady_clock::now(), seq, m };
+        ++count; bytes += m->size();
+    }
+
+    // 최근 maxCount 개 중 maxAge 안의 것 (오래된 것부터). maxAge 가 0 이면 시간 제한 없음.
+    vector<Message> recent(size_t maxCount, seconds maxAge) const {
+        vector<Message> out;
+        auto cutoff = steady_clock::now() - maxAge;
+        size_t n = min(count, maxCount);
+        for (size_t i = count - n; i < count; ++i) {
+            const Entry& e = slots[(head + i) % slots.size()];
+            if (maxAge.count() > 0 && e.at < cutoff) continue;
+            out.push_back(e.msg);
+        }
+        return out;
+    }
+
+    // seq 가 after 인 것 뒤에 넣은 것 (넣은 순서대로). seq 는 여러 스레드가 뽑으므로 넣은 순서와 크기 순서가 다를 수 있다:
+    // 크기가 아니라 자리로 자른다. after 가 0 이면 처음부터. after 가 이미 밀려났거나 (0 이면 무엇이든 밀려났으면) false
+    bool since(uint32_t after, vector<Message>& out) const {
+        size_t i = 0;
+        if (after == 0) { if (dropped) return false; }
+        else {
+            while (i < count && slots[(head + i) % slots.size()].seq != after) ++i;
+            if (i == count) return false;
+            ++i;
+        }
+        for (; i < count; ++i) out.push_back(slots[(head + i) % slots.size()].msg);
+        return true;
+    }
+
+private:
+    struct Entry { steady_clock::time_point at; uint32_t seq; Message msg; };
+    vector<Entry> slots;
+    size_t head = 0, count = 0, bytes = 0;
+    size_t maxBytes;
+    bool dropped = false;      // 밀려나거나 (너무 커서) 못 넣은 것이 있다
+
+    void popOldest() {
+        Entry& e = slots[head];
+        dropped = true;
+        bytes -= e.msg->size();
+        e.msg.reset();
+        head = (head + 1) % slots.size();
+        --count;
+    }
+};
+
+// ---------------- Sessions ----------------
+// binary v2 클라이언트의 재접속 세션. 연결이 끊겨도 TTL 동안 남아 그 사이 방송 frame 을 모아 두고,
+// RESUME(토큰, 마지막 seq) 이 오면 놓친 것만 보낸 뒤 같은 ID/이름으로 다시 붙인다 (JOIN/기록 재전송 없음).
+// 붙어 있는 동안에도 보낸 frame 을 남긴다: 끊기기 직전 커널 버퍼에 있던 것도 잃을 수 있으므로.
+// 잠금은 ChatServer::clientsMtx. sent 만 자기 락 (방 fan-out 은 clientsMtx 없이 남긴다).
+constexpr size_t SESSION_BUFFER_MSGS = 256;          // 세션마다 기억하는 최근 frame 수
+constexpr size_t SESSION_BUFFER_BYTES = 256 << 10;   // 그 바이트 상한
+
+struct Session {
+    string token;                    // wire::SESSION_TOKEN_LEN 바이트 난수
+    uint32_t id = 0;
+    string name;
+    shared_ptr<TCPClient> client;    // 붙어 있는 연결. 비어 있으면 expires 까지 RESUME 을 기다린다
+    steady_clock::time_point expires;
+    vector<string> rooms;            // 끊길 때 들어가 있던 방 (RESUME 한 연결이 이어받는다)
+
+    void record(const shared_ptr<const string>& frame, uint32_t seq) { lock_guard<mutex> lg(sentMtx); sent.append(frame, seq); }
+    // 남기고 같은 락 안에서 보낸다 (queue). 전체 방송과 방 fan-out 이 따로 seq 를 뽑아도 한 연결에는 남긴 순서대로 나가므로
+    // 클라이언트가 마지막으로 받은 seq 의 자리에서 since() 가 빠짐없이 이어진다. 락 순서: sentMtx -> TCPClient::sendMtx
+    template <class Queue>
+    void send(const shared_ptr<const string>& frame, uint32_t seq, Queue queue) { lock_guard<mutex> lg(sentMtx); sent.append(frame, seq); queue(); }
+    bool since(uint32_t after, vector<shared_ptr<const string>>& out) { lock_guard<mutex> lg(sentMtx); return sent.since(after, out); }
+
+private:
+    mutex sentMtx;
+    HistoryRing sent{ SESSION_BUFFER_MSGS, SESSION_BUFFER_BYTES };   // 이 세션에 보낸 seq frame
+};
+
+// ---------------- Rooms ----------------
+// /join 으로 들어가는 방. 방마다 자기 구독자 목록을 갖고, 방의 글은 그 목록에만 간다 (방에 없는 글만 전체 방송).
+// 방은 이름 hash 로 shard 에 나뉘고 shard 마다 락이 따로다 (shard 수 = TCP reactor 스레드 수): 다른 방의 fan-out 끼리,
+// 그리고 전체 방송 (clientsMtx) 과도 서로 기다리지 않는다. 기존 방송처럼 TCP 글은 방의 TCP 멤버에게, UDP 글은 UDP 멤버에게.
+// 락 순서: clientsMtx -> shard -> (Session -> TCPClient::sendMtx / udpMtx). 방의 글은 기록/영구 로그/다른 노드로 가지 않는다.
+constexpr size_t ROOM_NAME_MAX = 32;
+
+struct Room {
+    vector<shared_ptr<TCPClient>> tcp;   // 끊겨 세션만 남은 연결도 남는다 (frame 은 세션 버퍼로, RESUME 하면 새 연결로 바뀐다)
+    vector<sockaddr_in> udp;
+};
+
+class RoomTable {
+public:
+    explicit RoomTable(size_t shardCount) : shards(max<size_t>(1, shardCount)) {}
+
+    // 방 하나를 그 shard 의 락 안에서 본다. 방이 없으면 fn 을 부르지 않는다
+    template <class F> void with(const string& name, F&& fn) {
+        Shard& sh = shardOf(name);
+        lock_guard<mutex> lg(sh.mtx);
+        auto it = sh.rooms.find(name);
+        if (it != sh.rooms.end()) fn(it->second);
+    }
+
+    // 들어간 뒤 그 방의 TCP / UDP 멤버 수
+    size_t joinTcp(const string& name, const shared_ptr<TCPClient>& c) {
+        size_t n = 0;
+        edit(name, [&](Room& r) { if (find(r.tcp.begin(), r.tcp.end(), c) == r.tcp.end()) r.tcp.push_back(c); n = r.tcp.size(); });
+        return n;
+    }
+    size_t joinUdp(const string& name, const sockaddr_in& addr) {
+        size_t n = 0;
+        edit(name, [&](Room& r) {
+            if (none_of(r.udp.begin(), r.udp.end(), [&](const sockaddr_in& a) { return endpointKey(a) == endpointKey(addr); })) r.udp.push_back(addr);
+            n = r.udp.size();
+        });
+        return n;
+    }
+    // pred 에 맞는 TCP 멤버를 뺀다 (연결이면 그 포인터, 끊긴 세션이면 그 세션으로)
+    template <class P> void partTcp(const string& name, P&& pred) {
+        edit(name, [&](Room& r) { r.tcp.erase(remove_if(r.tcp.begin(), r.tcp.end(), [&](const shared_ptr<TCPClient>& c) { return pred(*c); }), r.tcp.end()); });
+    }
+    void partUdp(const string& name, const sockaddr_in& addr) {
+        edit(name, [&](Room& r) { r.udp.erase(remove_if(r.udp.begin(), r.udp.end(), [&](const sockaddr_in& a) { return endpointKey(a) == endpointKey(addr); }), r.udp.end()); });
+    }
+    // RESUME: 세션의 옛 연결 자리를 새 연결로
+    void resumeTcp(const string& name, const Session* sess, const shared_ptr<TCPClient>& c) {
+        edit(name, [&](Room& r) {
+            auto it = find_if(r.tcp.begin(), r.tcp.end(), [&](const shared_ptr<TCPClient>& m) { return m->session.get() == sess; });
+            if (it != r.tcp.end()) *it = c;
+            else r.tcp.push_back(c);
+        });
+    }
+
+    struct Summary { string name; size_t tcp, udp; };
+    vector<Summary> list() {
+        vector<Summary> out;
+        for (auto& sh : shards) {
+            lock_guard<mutex> lg(sh.mtx);
+            for (auto& [name, r] : sh.rooms) out.push_back({ name, r.tcp.size(), r.udp.size() });
+        }
+        sort(out.begin(), out.end(), [](const Summary& a, const Summary& b) { return a.name < b.name; });
+        return out;
+    }
+
+private:
+    struct Shard {
+        mutex mtx;
+        unordered_map<string, Room> rooms;
+    };
+    vector<Shard> shards;
+
+    Shard& shardOf(const string& name) { return shards[hash<string>{}(name) % shards.size()]; }
+
+    // 방을 (없으면 만들어) 고치고, 비면 지운다
+    template <class F> void edit(const string& name, F&& fn) {
+        Shard& sh = shardOf(name);
+        lock_guard<mutex> lg(sh.mtx);
+        auto it = sh.rooms.try_emplace(name).first;
+        fn(it->second);
+        if (it->second.tcp.empty() && it->second.udp.empty()) sh.rooms.erase(it);
+    }
+};
+
+// 방 이름: 공백/제어 문자 없이 ROOM_NAME_MAX 바이트까지 (앞의 '#' 은 떼어 낸다)
+bool normalizeRoomName(string& name) {
+    if (!name.empty() && name[0] == '#') name.erase(0, 1);
+    if (name.empty() || name.size() > ROOM_NAME_MAX) return false;
+    return none_of(name.begin(), name.end(), [](char c) { return (unsigned char)c <= ' '; });
+}
+
+// ---------------- Nick index ----------------
+// 닉네임 -> 그 이름의 TCP 연결들과 UDP 주소들. /msg 가 clients 를 훑지 않고 hash 한 번으로 찾는다.
+// shard 마다 shared_mutex: 찾기 (/msg 마다) 끼리는 막지 않고, 고치기는 입장/퇴장/REGISTER 때만.
+// 닉네임은 유일하지 않으므로 항목마다 작은 목록이다. 끊겨 세션만 남은 연결도 남는다 (RoomTable 과 같이, 글은 세션 버퍼로).
+// 락 순서: clientsMtx -> shard -> (Session -> TCPClient::sendMtx / udpMtx).
+constexpr size_t NICK_INDEX_SHARDS = 16;
+
+class NickIndex {
+public:
+    struct Entry {
+        vector<shared_ptr<TCPClient>> tcp;
+        vector<sockaddr_in> udp;
+    };
+
+    NickIndex() : shards(NICK_INDEX_SHARDS) {}
+
+    // 그 이름의 항목을 읽기 락 안에서 fn 에. 없으면 false
+    template <class F> bool find(const string& name, F&& fn) {
+        Shard& sh = shardOf(name);
+        shared_lock<shared_mutex> lk(sh.mtx);
+        auto it = sh.names.find(name);
+        if (it == sh.names.end()) return false;
+        fn(it->second);
+        return true;
+    }
+
+    void addTcp(const string& name, const shared_ptr<TCPClient>& c) { edit(name, [&](Entry& e) { e.tcp.push_back(c); }); }
+    template <class P> void removeTcp(const string& name, P&& pred) {
+        edit(name, [&](Entry& e) { e.tcp.erase(remove_if(e.tcp.begin(), e.tcp.end(), [&](const shared_ptr<TCPClient>& c) { return pred(*c); }), e.tcp.end()); });
+    }
+    // RESUME: 세션의 옛 연결 자리를 새 연결로
+    void resumeTcp(const string& name, const Session* sess, const shared_ptr<TCPClient>& c) {
+        edit(name, [&](Entry& e) {
+            auto it = find_if(e.tcp.begin(), e.tcp.end(), [&](const shared_ptr<TCPClient>& m) { return m->session.get() == sess; });
+            if (it != e.tcp.end()) *it = c;
+            else e.tcp.push_back(c);
+        });
+    }
+    void addUdp(const string& name, const sockaddr_in& addr) {
+        edit(name, [&](Entry& e) {
+            if (none_of(e.udp.begin(), e.udp.end(), [&](const sockaddr_in& a) { return endpointKey(a) == endpointKey(addr); })) e.udp.push_back(addr);
+        });
+    }
+    void removeUdp(const string& name, const sockaddr_in& addr) {
+        edit(name, [&](Entry& e) { e.udp.erase(remove_if(e.udp.begin(), e.udp.end(), [&](const sockaddr_in& a) { return endpointKey(a) == endpointKey(addr); }), e.udp.end()); });
+    }
+
+private:
+    struct Shard {
+        shared_mutex mtx;
+        unordered_map<string, Entry> names;
+    };
+    vector<Shard> shards;
+
+    Shard& shardOf(const string& name) { return shards[hash<string>{}(name) % shards.size()]; }
+
+    template <class F> void edit(const string& name, F&& fn) {
+        Shard& sh = shardOf(name);
+        unique_lock<shared_mutex> lk(sh.mtx);
+        auto it = sh.names.try_emplace(name).first;
+        fn(it->second);
+        if (it->second.tcp.empty() && it->second.udp.empty()) sh.names.erase(it);
+    }
+};
+
+// ---------------- Message log ----------------
+// 채팅 메시지의 영구 기록 (--log-dir, POSIX). 고정 크기 segment 파일에 mmap 으로 이어 쓰고,
+// flusher 스레드가 LOG sync 간격마다 모인 것을 한 번에 msync/fdatasync 한다 (group commit).
+// 방송 경로는 락 안에서 memcpy 만 하고 디스크를 기다리지 않는다. 프로세스가 죽어도 page cache 에 남지만
+// 전원이 나가면 마지막 sync 간격만큼 잃을 수 있다.
+//   segment: <dir>/chat-<번호 8자리>.log, 미리 잡은 크기, 안 쓴 곳은 0
+//   한 줄  : "[YYYY-MM-DD HH:MM:SS.mmm+hhmm] <메시지>\n" (지역 시각과 그때의 UTC 오프셋) -> /history 는 파일 구간을 그대로 sendfile 한다
+//   index  : 같은 이름 .idx, LOG_INDEX_EVERY 바이트마다 {seq, unixMs, offset} (sparse, 데이터 sync 뒤에 쓴다)
+// 시각으로 찾을 때는 index 의 unixMs 와, 줄 머리를 오프셋으로 되돌린 unix ms 를 비교한다 (서머타임, 시간대가 바뀌어도 순서가 맞다).
+// 재시작하면 .idx 의 마지막 항목 (.idx 가 없으면 처음) 부터 첫 0 바이트까지 훑어 끝과 seq 를 되찾고 모자란 index 를 다시 만든 뒤
+// 마지막 segment 에 이어 쓴다.
+#ifndef _WIN32
+constexpr size_t LOG_INDEX_EVERY = 4096;       // sparse index 간격 (바이트)
+constexpr size_t LOG_HISTORY_MAX = 16 << 20;   // /history 한 번에 보내는 최대 바이트
+constexpr size_t LOG_STAMP = 30;               // "[YYYY-MM-DD HH:MM:SS.mmm+hhmm]"
+
+class MessageLog {
+public:
+    struct IndexEntry { uint64_t seq; int64_t unixMs; uint64_t offset; };
+    struct Stats { uint64_t messages = 0, bytes = 0, syncs = 0, segments = 0; };
+
+    MessageLog(const string& dir, size_t segmentBytes, milliseconds syncEvery)
+        : dir(dir), segBytes(max<size_t>(segmentBytes, 1 << 20)), syncEvery(syncEvery) {
+        mkdir(dir.c_str(), 0755);
+        recover();
+        flusher = thread(&MessageLog::flushLoop, this);
+    }
+
+    ~MessageLog() {
+        { lock_guard<mutex> lg(mtx); stopping = true; }
+        cv.notify_one();
+        if (flusher.joinable()) flusher.join();
+        syncDirty();
+    }
+
+    // 한 줄을 붙인다. 끝의 줄바꿈은 떼고, 안의 줄바꿈/NUL 은 공백으로 바꾼다.
+    void append(const char* p, size_t n) {
+        while (n > 0 && p[n - 1] == '\n') --n;
+        n = min(n, segBytes - LOG_STAMP - 2);
+        size_t len = LOG_STAMP + 1 + n + 1;
+        int64_t ms = duration_cast<milliseconds>(system_clock::now().time_since_epoch()).count();
+        lock_guard<mutex> lg(mtx);
+        if (!active || active->end + len > segBytes) {
+            try { roll(); }
+            catch (const exception& ex) { if (!failed) Logger::error(string("Message log: ") + ex.what()); failed = true; return; }
+        }
+        Segment& s = *active;
+        if (s.index.empty() || s.end - s.index.back().offset >= LOG_INDEX_EVERY) s.index.push_back({ nextSeq, ms, s.end });
+        char* d = s.map + s.end;
+        stamp(ms, d);
+        d[LOG_STAMP] = ' ';
+        d += LOG_STAMP + 1;
+        for (size_t i = 0; i < n; ++i) d[i] = (p[i] == '\n' || p[i] == '\0') ? ' ' : p[i];
+        d[n] = '\n';
+        s.end += len;
+        ++nextSeq;
+        ++stats_.messages; stats_.bytes += len;
+        if (!dirty) { dirty = true; cv.notify_one(); }   // 깨끗 -> dirty 로 바뀔 때만 flusher 를 깨운다
+    }
+
+    // [from, to] (bySeq 면 seq, 아니면 unix ms, 양끝 포함) 의 줄들이 있는 파일 구간을 out 에 연다.
+    // 위치는 sparse index 로 한 번 찾아가 그 뒤 LOG_INDEX_EVERY 안쪽만 훑는다. 총 바이트 수, 파일을 열지 못하면 -1.
+    // mtx 안에서는 메모리의 index 만 찾고 segment 경로와 끝을 복사한다. 파일을 열고 훑는 것은 락 밖이라 append (방송) 를 막지 않는다.
+    // 구간은 연결의 송신 큐에 들어가 소켓이 받는 만큼 sendfile 로 나간다 (sendSpan)
+    int64_t spans(int64_t from, int64_t to, bool bySeq, bool& truncated, vector<shared_ptr<FileSpan>>& out) {
+        struct Range { string path; uint64_t off, len; };
+        vector<Range> ranges;
+        vector<SegRef> refs;
+        Probe pa, pb;
+        uint64_t total = 0;
+        truncated = false;
+        {
+            lock_guard<mutex> lg(mtx);
+            if (segs.empty() || from > to) return 0;
+            pa = probe(from, bySeq); pb = probe(to + 1, bySeq);
+            for (size_t si = pa.seg; si < segs.size() && si <= pb.seg + 1; ++si) refs.push_back({ segs[si]->path, segs[si]->end });
+        }
+        Pos a = resolve(pa, from, bySeq, refs, pa.seg), b = resolve(pb, to + 1, bySeq, refs, pa.seg);
+        for (size_t si = a.seg; si <= b.seg && si - pa.seg < refs.size() && !truncated; ++si) {
+            const SegRef& s = refs[si - pa.seg];
+            uint64_t lo = si == a.seg ? a.off : 0, hi = si == b.seg ? b.off : s.end;
+            if (hi <= lo) continue;
+            if (total + (hi - lo) > LOG_HISTORY_MAX) { hi = lo + (LOG_HISTORY_MAX - total); truncated = true; }
+            ranges.push_back({ s.path, lo, hi - lo });
+            total += hi - lo;
+        }
+        for (auto& r : ranges) {
+            auto span = make_shared<FileSpan>();
+            span->fd = open(r.path.c_str(), O_RDONLY | O_CLOEXEC);
+            if (span->fd < 0) { out.clear(); return -1; }
+            span->off = r.off; span->len = r.len;
+            out.push_back(move(span));
+        }
+        return (int64_t)total;
+    }
+
+    Stats stats() { lock_guard<mutex> lg(mtx); return stats_; }
+
+private:
+    struct Segment {
+        string path, idxPath;
+        uint64_t number = 0;
+        size_t size = 0;
+        int fd = -1;
+        char* map = nullptr;      // 쓰는 중이거나 아직 sync 가 덜 된 segment 만 매핑해 둔다
+        size_t end = 0;           // 쓴 바이트
+        size_t synced = 0;        // msync 끝난 바이트 (flusher)
+        size_t idxSynced = 0;     // .idx 에 쓴 항목 수 (flusher)
+        bool sealed = false;
+        vector<IndexEntry> index;
+        void release() { if (map) munmap(map, size); if (fd >= 0) close(fd); map = nullptr; fd = -1; }
+        ~Segment() { release(); }
+    };
+    struct Pos { size_t seg; uint64_t off; };
+    struct Probe { size_t seg; uint64_t off, seq; bool exact; };   // index 로 찾은 곳. exact 가 아니면 off (seq 번째 줄) 부터 훑는다
+    struct SegRef { string path; uint64_t end; };                  // 락 밖에서 훑을 segment (spans 가 복사해 둔다)
+
+    string dir;
+    size_t segBytes;
+    milliseconds syncEvery;
+    mutex mtx;
+    condition_variable cv;
+    thread flusher;
+    bool stopping = false, failed = false;
+    bool dirty = false;                 // 마지막 sync 뒤에 append 가 있었다
+    vector<shared_ptr<Segment>> segs;   // 번호 순
+    shared_ptr<Segment> active, spare;  // spare: flusher 가 미리 만들어 둔 다음 segment
+    uint64_t nextSeq = 0, nextSegNumber = 0;
+    time_t stampSec = -1;
+    char stampBuf[32] = {};
+    Stats stats_;
+
+    string segmentPath(uint64_t number, const char* ext) const {
+        char name[32]; snprintf(name, sizeof(name), "chat-%08llu.%s", (unsigned long long)number, ext);
+        return dir + "/" + name;
+    }
+
+    // mtx 안에서 호출. 밀리초 밖의 부분 (초까지의 지역 시각, UTC 오프셋) 은 캐시한다.
+    void stamp(int64_t ms, char* out) {
+        time_t sec = (time_t)(ms / 1000);
+        if (sec != stampSec) { tm t; localtime_s(&t, &sec); strftime(stampBuf, sizeof(stampBuf), "[%Y-%m-%d %H:%M:%S.000%z]", &t); stampSec = sec; }
+        memcpy(out, stampBuf, LOG_STAMP);
+        int m = (int)(ms % 1000);
+        out[21] = (char)('0' + m / 100); out[22] = (char)('0' + m / 10 % 10); out[23] = (char)('0' + m % 10);
+    }
+
+    // 줄 머리 (n 바이트) 의 시각을 unix ms 로. 적힌 오프셋으로 UTC 로 되돌린다.
+    // 오프셋이 없는 예전 줄 ("[...mmm]") 은 지금 시간대로 푼다. 머리가 아니면 false
+    static bool stampMillis(const char* p, size_t n, int64_t& ms) {
+        auto num = [&](size_t at, int k) {
+            int v = 0;
+            for (int i = 0; i < k; ++i) { char c = p[at + i]; if (c < '0' || c > '9') return -1; v = v * 10 + (c - '0'); }
+            return v;
+        };
+        if (n < 25 || p[0] != '[' || p[20] != '.') return false;
+        int Y = num(1, 4), M = num(6, 2), D = num(9, 2), h = num(12, 2), mi = num(15, 2), sec = num(18, 2), frac = num(21, 3);
+        if (min({ Y, M, D, h, mi, sec, frac }) < 0) return false;
+        tm t{};
+        t.tm_year = Y - 1900; t.tm_mon = M - 1; t.tm_mday = D; t.tm_hour = h; t.tm_min = mi; t.tm_sec = sec;
+        if (n >= LOG_STAMP && (p[24] == '+' || p[24] == '-') && p[29] == ']') {
+            int z = num(25, 4);
+            if (z < 0) return false;
+            int64_t off = (int64_t)(z / 100 * 60 + z % 100) * 60;
+            ms = ((int64_t)timegm(&t) - (p[24] == '-' ? -off : off)) * 1000 + frac;
+            return true;
+        }
+        if (p[24] != ']') return false;
+        t.tm_isdst = -1;
+        ms = (int64_t)mktime(&t) * 1000 + frac;
+        return true;
+    }
+
+    shared_ptr<Segment> createSegment(uint64_t number) {
+        auto s = make_shared<Segment>();
+        s->number = number; s->path = segmentPath(number, "log"); s->idxPath = segmentPath(number, "idx"); s->size = segBytes;
+        s->fd = open(s->path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if (s->fd < 0) throw runtime_error("open " + s->path + ": " + lastWinsockError());
+#ifdef __linux__
+        if (posix_fallocate(s->fd, 0, (off_t)segBytes) != 0 && ftruncate(s->fd, (off_t)segBytes) != 0) throw runtime_error("allocate " + s->path + ": " + lastWinsockError());
+        int flags = MAP_SHARED | MAP_POPULATE;   // 첫 쓰기의 page fault 를 방송 경로에서 치르지 않도록
+#else
+        if (ftruncate(s->fd, (off_t)segBytes) != 0) throw runtime_error("allocate " + s->path + ": " + lastWinsockError());
+        int flags = MAP_SHARED;
+#endif
+        void* m = mmap(nullptr, segBytes, PROT_READ | PROT_WRITE, flags, s->fd, 0);
+        if (m == MAP_FAILED) throw runtime_error("mmap " + s->path + ": " + lastWinsockError());
+        s->map = (char*)m;
+        unlink(s->idxPath.c_str());
+        return s;
+    }
+
+    // mtx 안에서 호출
+    void roll() {
+        if (active) active->sealed = true;
+        shared_ptr<Segment> s;
+        if (spare && spare->number == nextSegNumber) s.swap(spare);
+        else s = createSegment(nextSegNumber);
+        ++nextSegNumber;
+        segs.push_back(s);
+        active = s;
+        ++stats_.segments;
+    }
+
+    // 쓸 것이 없으면 잠들어 있다가, 첫 append 뒤 syncEvery 동안 더 모아서 한 번에 sync 한다 (group commit)
+    void flushLoop() {
+        unique_lock<mutex> lk(mtx);
+        while (!stopping) {
+            cv.wait(lk, [&] { return stopping || dirty; });
+            cv.wait_for(lk, syncEvery, [&] { return stopping; });
+            if (stopping) break;
+            dirty = false;
+            lk.unlock();
+            syncDirty();
+            prepareSpare();
+            lk.lock();
+        }
+    }
+
+    // 지난 sync 뒤에 쓴 구간을 msync 하고, 그 구간을 가리키는 index 항목을 .idx 에 붙인다.
+    void syncDirty() {
+        struct Job { shared_ptr<Segment> s; size_t from, to; vector<IndexEntry> idx; };
+        vector<Job> jobs;
+        {
+            lock_guard<mutex> lg(mtx);
+            for (auto it = segs.rbegin(); it != segs.rend() && (*it)->map; ++it) {
+                Segment& s = **it;
+                if (s.synced == s.end && s.idxSynced == s.index.size() && !s.sealed) continue;
+                jobs.push_back({ *it, s.synced, s.end, vector<IndexEntry>(s.index.begin() + s.idxSynced, s.index.end()) });
+            }
+        }
+        for (auto& j : jobs) {
+            size_t page = (size_t)sysconf(_SC_PAGESIZE), lo = j.from / page * page;
+            if (j.to > j.from && msync(j.s->map + lo, j.to - lo, MS_SYNC) != 0) Logger::warn("Message log msync failed: " + lastWinsockError());
+            if (!j.idx.empty()) {
+                int fd = open(j.s->idxPath.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+                if (fd >= 0) {
+                    if (write(fd, j.idx.data(), j.idx.size() * sizeof(IndexEntry)) < 0) Logger::warn("Message log index write failed: " + lastWinsockError());
+                    fdatasync(fd);
+                    close(fd);
+                }
+            }
+        }
+        lock_guard<mutex> lg(mtx);
+        for (auto& j : jobs) {
+            j.s->synced = j.to;
+            j.s->idxSynced += j.idx.size();
+            if (j.s->sealed && j.s->synced == j.s->end && j.s->idxSynced == j.s->index.size()) j.s->release();
+        }
+        if (!jobs.empty()) ++stats_.syncs;
+    }
+
+    // 다음 segment 를 방송 경로 밖에서 미리 만들고 매핑해 둔다.
+    void prepareSpare() {
+        uint64_t number;
+        {
+            lock_guard<mutex> lg(mtx);
+            if (spare || failed) return;
+            number = nextSegNumber;
+        }
+        shared_ptr<Segment> s;
+        try { s = createSegment(number); }
+        catch (const exception& ex) { Logger::warn(string("Message log: ") + ex.what()); return; }
+        lock_guard<mutex> lg(mtx);
+        if (!spare && nextSegNumber == number) spare = s;
+    }
+
+    // from (줄 머리, seq 번째 줄) 부터 첫 0 바이트(= 쓴 끝)까지 훑으며 줄 수를 센다. 마지막 index 항목 last (없으면 nullptr)
+    // 뒤로 append 와 같은 간격의 index 항목을 more 에 만든다 (.idx 가 없거나 sync 전에 죽어 모자랄 때).
+    static size_t scanEnd(int fd, size_t from, size_t size, uint64_t seq, const IndexEntry* last, vector<IndexEntry>& more, uint64_t& lines) {
+        vector<char> buf(1 << 16);
+        lines = 0;
+        bool indexed = last != nullptr;
+        uint64_t lastOff = indexed ? last->offset : 0;
+        for (size_t pos = from; pos < size;) {
+            ssize_t r = pread(fd, buf.data(), min(buf.size(), size - pos), (off_t)pos);
+            if (r <= 0) return pos;
+            const char* z = (const char*)memchr(buf.data(), '\0', (size_t)r);
+            size_t n = z ? (size_t)(z - buf.data()) : (size_t)r, i = 0;
+            while (const char* nl = (const char*)memchr(buf.data() + i, '\n', n - i)) {
+                if (!indexed || pos + i - lastOff >= LOG_INDEX_EVERY) {
+                    int64_t ms = 0;
+                    stampMillis(buf.data() + i, (size_t)(nl - buf.data()) - i, ms);
+                    more.push_back({ seq + lines, ms, pos + i });
+                    indexed = true;
+                    lastOff = pos + i;
+                }
+                ++lines;
+                i = (size_t)(nl - buf.data()) + 1;
+            }
+            if (z) return pos + n;
+            pos += i ? i : n;   // 다음 pread 는 끝나지 않은 줄의 머리부터 (줄이 버퍼보다 길면 그냥 넘긴다)
+        }
+        return size;
+    }
+
+    void recover() {
+        DIR* d = opendir(dir.c_str());
+        if (!d) throw runtime_error("cannot open log dir " + dir + ": " + lastWinsockError());
+        vector<uint64_t> nums;
+        while (dirent* e = readdir(d)) {
+            unsigned long long n; char ext[8] = {};
+            if (sscanf(e->d_name, "chat-%llu.%7s", &n, ext) == 2 && strcmp(ext, "log") == 0) nums.push_back(n);
+        }
+        closedir(d);
+        sort(nums.begin(), nums.end());
+
+        for (uint64_t n : nums) {
+            auto s = make_shared<Segment>();
+            s->number = n; s->path = segmentPath(n, "log"); s->idxPath = segmentPath(n, "idx");
+            int fd = open(s->path.c_str(), O_RDONLY);
+            if (fd < 0) continue;
+            struct stat st {};
+            fstat(fd, &st);
+            s->size = (size_t)st.st_size;
+            if (FILE* f = fopen(s->idxPath.c_str(), "rb")) {
+                IndexEntry e;
+                while (fread(&e, sizeof(e), 1, f) == 1) s->index.push_back(e);
+                fclose(f);
+            }
+            // index 가 가리키는 곳이 비어 있으면(sync 전에 죽음) 그 항목은 버린다. 그 뒤 (.idx 가 없으면 segment 전체) 는
+            // 훑으면서 index 를 다시 만든다 (시각으로 찾을 segment 를 고르려면 첫 줄의 시각이 있어야 한다)
+            uint64_t lines = 0;
+            vector<IndexEntry> more;
+            for (;;) {
+                while (!s->index.empty() && s->index.back().offset >= s->size) s->index.pop_back();
+                size_t from = s->index.empty() ? 0 : (size_t)s->index.back().offset;
+                more.clear();
+                s->end = scanEnd(fd, from, s->size, s->index.empty() ? nextSeq : s->index.back().seq, s->index.empty() ? nullptr : &s->index.back(), more, lines);
+                if (s->index.empty() || s->end > from) break;
+                s->index.pop_back();
+            }
+            uint64_t firstSeq = s->index.empty() ? nextSeq : s->index.back().seq;
+            s->index.insert(s->index.end(), more.begin(), more.end());
+            nextSeq = firstSeq + lines;
+            close(fd);
+            s->synced = s->end;
+            s->idxSynced = s->index.size();
+            segs.push_back(s);
+        }
+        nextSegNumber = nums.empty() ? 0 : nums.back() + 1;
+
+        // 마지막 segment 가 같은 크기면 이어 쓴다
+        if (!segs.empty() && segs.back()->size == segBytes) {
+            auto& s = segs.back();
+            s->fd = open(s->path.c_str(), O_RDWR);
+            void* m = s->fd >= 0 ? mmap(nullptr, segBytes, PROT_READ | PROT_WRITE, MAP_SHARED, s->fd, 0) : MAP_FAILED;
+            if (m != MAP_FAILED) { s->map = (char*)m; active = s; }
+            else s->release();
+        }
+        if (!segs.empty()) Logger::info("Message log: " + to_string(segs.size()) + " segment(s), next seq " + to_string(nextSeq));
+    }
+
+    uint64_t keyOf(const IndexEntry& e, bool bySeq) const { return bySeq ? e.seq : (uint64_t)e.unixMs; }
+
+    // mtx 안에서 호출. key 이상인 첫 줄이 있을 segment 와 그 앞의 가장 가까운 index 항목 (디스크는 읽지 않는다).
+    Probe probe(int64_t key, bool bySeq) const {
+        size_t si = 0;
+        for (size_t lo = 0, hi = segs.size(); lo < hi;) {
+            size_t mid = (lo + hi) / 2;
+            if (!segs[mid]->index.empty() && (int64_t)keyOf(segs[mid]->index[0], bySeq) <= key) { si = mid; lo = mid + 1; }
+            else hi = mid;
+        }
+        const Segment& s = *segs[si];
+        auto it = upper_bound(s.index.begin(), s.index.end(), key, [&](int64_t k, const IndexEntry& e) { return k < (int64_t)keyOf(e, bySeq); });
+        if (it == s.index.begin()) return { si, 0, 0, true };
+        --it;
+        return { si, it->offset, it->seq, false };
+    }
+
+    // 락 밖에서. probe 가 찾은 곳부터 훑어 key 이상인 첫 줄의 위치. refs[i] 는 segs[base + i] 를 복사한 것이다.
+    static Pos resolve(const Probe& p, int64_t key, bool bySeq, const vector<SegRef>& refs, size_t base) {
+        if (p.exact) return { p.seg, p.off };
+        const SegRef& s = refs[p.seg - base];
+        uint64_t off = scanTo(s, p.off, p.seq, key, bySeq);
+        if (off >= s.end && p.seg + 1 - base < refs.size()) return { p.seg + 1, 0 };
+        return { p.seg, off };
+    }
+
+    // index 항목 하나에서 시작해 key 에 닿는 줄까지 훑는다 (보통 LOG_INDEX_EVERY 바이트 이내).
+    static uint64_t scanTo(const SegRef& s, uint64_t off, uint64_t seq, int64_t key, bool bySeq) {
+        int fd = open(s.path.c_str(), O_RDONLY);
+        if (fd < 0) return s.end;
+        vector<char> buf(1 << 16);
+        while (off < s.end) {
+            ssize_t r = pread(fd, buf.data(), min<uint64_t>(buf.size(), s.end - off), (off_t)off);
+            if (r <= 0) break;
+            size_t i = 0;
+            for (;;) {
+                const char* nl = (const char*)memchr(buf.data() + i, '\n', (size_t)r - i);
+                if (!nl) break;
+                int64_t ms = 0;
+                bool hit = bySeq ? (int64_t)seq >= key : stampMillis(buf.data() + i, (size_t)(nl - buf.data()) - i, ms) && ms >= key;
+                if (hit) { close(fd); return off + i; }
+                ++seq;
+                i = (size_t)(nl - buf.data()) + 1;
+            }
+            if (i == 0) break;   // 줄이 버퍼보다 길다 (있을 수 없음)
+            off += i;
+        }
+        close(fd);
+        return s.end;
+    }
+};
+#endif
+
+// /history 인자 하나. "#N" 은 seq, 그 밖에는 시각: "HH:MM[:SS]"(오늘), "YYYY-MM-DDTHH:MM[:SS]", "-N[s|m|h]"(지금부터 전),
+// "now", 숫자만이면 unix 초. 시각은 unix ms 로 돌려준다.
+bool parseHistoryBound(const string& s, int64_t& value, bool& bySeq) {
+    bySeq = !s.empty() && s[0] == '#';
+    if (bySeq) { try { value = stoll(s.substr(1)); return value >= 0; } catch (...) { return false; } }
+    int64_t nowMs = duration_cast<milliseconds>(system_clock::now().time_since_epoch()).count();
+    if (s == "now") { value = nowMs; return true; }
+    if (s.size() > 1 && s[0] == '-') {
+        char unit = s.back();
+        int64_t mul = unit == 'h' ? 3600000 : unit == 'm' ? 60000 : 1000;
+        try { value = nowMs - stoll(s.substr(1, isdigit((unsigned char)unit) ? string::npos : s.size() - 2)) * mul; return true; } catch (...) { return false; }
+    }
+    if (all_of(s.begin(), s.end(), [](char c) { return isdigit((unsigned char)c); }) && !s.empty()) { value = stoll(s) * 1000; return true; }
+    time_t now = time(nullptr);
+    tm t; localtime_s(&t, &now);
+    int Y, M, D, h, m, sec = 0;
+    if (sscanf(s.c_str(), "%d-%d-%dT%d:%d:%d", &Y, &M, &D, &h, &m, &sec) >= 5) { t.tm_year = Y - 1900; t.tm_mon = M - 1; t.tm_mday = D; }
+    else if (sscanf(s.c_str(), "%d:%d:%d", &h, &m, &sec) < 2) return false;
+    t.tm_hour = h; t.tm_min = m; t.tm_sec = sec; t.tm_isdst = -1;
+    time_t tt = mktime(&t);
+    if (tt == (time_t)-1) return false;
+    value = (int64_t)tt * 1000;
+    return true;
+}
+
+// ---------------- Federation ----------------
+// 여러 ChatServer 노드를 서버 간 전용 TCP 링크로 묶는다. 로컬에서 방송한 메시지를 피어 노드마다 한 번 보내면
+// 그 노드가 자기 클라이언트에게 방송한다.
+// frame: [len:4][type:1][origin node:4][origin epoch:4][seq:8][visited 수:1][visited node:4 ...][payload]  (big endian)
+// 보낼 때 받을 노드들을 visited 에 넣고, 받은 노드는 visited 에 없는 자기 피어에게만 넘긴다: full mesh 면 한 번에 끝나고,
+// 일부만 이어진 mesh 에서도 (origin, epoch, seq) 로 중복을 버리므로 고리를 돌지 않는다.
+// epoch 는 프로세스마다 새로 뽑아서 노드가 재시작해 seq 가 0 부터 다시 시작해도 중복으로 버려지지 않는다.
+// 다른 노드의 멤버 (view) 는 그 소식이 들어온 링크가 끊기면 지우고 RESYNC 로 다른 경로에 다시 묻는다.
+// 모든 노드가 MESH_MEMBERS_REFRESH 마다 MEMBERS 를 다시 보내고, 그 세 배 동안 소식이 없는 노드는 지운다.
+constexpr size_t MESH_FRAME_MAX = 1 << 20;
+constexpr size_t MESH_DEDUP_WINDOW = 4096;   // origin 별로 기억하는 최근 seq 수
+constexpr size_t MESH_RETIRED_EPOCHS = 8;    // origin 별로 기억하는 지난 epoch 수 (재시작 전 frame 이 늦게 와도 버린다)
+constexpr auto MESH_MEMBERS_REFRESH = seconds(30);
+constexpr size_t MESH_LINK_OUT_MAX = 4 << 20;   // 링크마다 못 보내고 쌓아 두는 최대 바이트. 넘으면 그 링크를 끊는다
+
+class Federation {
+public:
+    enum class Kind : uint8_t { Tcp = 0, Udp = 1 };
+    struct Member { Kind kind; string name; };
+    struct Callbacks {
+        function<void(Kind, const string&)> deliver;   // 다른 노드에서 온 메시지를 로컬에 방송
+        function<vector<Member>()> members;            // 이 노드의 현재 멤버 (링크가 새로 열릴 때 보낸다)
+    };
+    struct Stats { uint64_t published = 0, framesSent = 0, received = 0, forwarded = 0, duplicates = 0; };
+
+    Federation(uint32_t nodeId, const string& listenPort, const vector<string>& peers, Callbacks cb, const atomic<bool>& running, const Waker& stop)
+        : self(nodeId), epoch((uint32_t)random_device{}()), port(listenPort), peers(peers), cb(move(cb)), running(running), stopWaker(stop) {}
+    ~Federation() { stop(); }
+
+    uint32_t nodeId() const { return self; }
+
+    void start() {
+        if (!port.empty()) {
+            listenSock = openListen(port);
+            threads.emplace_back(&Federation::acceptLoop, this);
+        }
+        for (auto& p : peers) threads.emplace_back(&Federation::dialLoop, this, p);
+        threads.emplace_back(&Federation::refreshLoop, this);
+    }
+
+    // 서버의 stopWaker 가 이미 깨워진 뒤에 부른다. 링크 소켓을 shutdown 하고 스레드를 모두 join 한다.
+    void stop() {
+        {
+            lock_guard<mutex> lg(linksMtx);
+            for (auto& l : links) shutdown(l->sock, SD_BOTH);
+        }
+        for (;;) {
+            vector<thread> ts;
+            { lock_guard<mutex> lg(threadsMtx); ts.swap(threads); }
+            if (ts.empty()) break;
+            for (auto& t : ts) if (t.joinable()) t.join();
+        }
+        if (listenSock != INVALID_SOCKET) { closesocket(listenSock); listenSock = INVALID_SOCKET; }
+    }
+
+    // 로컬 클라이언트가 보낸 (로컬에 이미 방송한) 메시지를 모든 피어 노드로
+    void publish(Kind kind, const string& text) {
+        string payload(1, (char)kind);
+        payload += text;
+        originate(MSG_CHAT, payload);
+        lock_guard<mutex> lg(statsMtx);
+        ++stats_.published;
+    }
+
+    void memberJoined(Kind kind, const string& name) { originate(MSG_JOIN, string(1, (char)kind) + name); }
+    void memberLeft(Kind kind, const string& name) { originate(MSG_LEAVE, string(1, (char)kind) + name); }
+
+    // /list: 다른 노드의 멤버
+    void describe(ostream& os) {
+        lock_guard<mutex> lg(viewMtx);
+        for (auto& kv : view) {
+            os << "=== Node " << kv.first << (linkedNodes().count(kv.first) ? "" : " (via relay)") << " ===\n";
+            for (auto& m : kv.second.members) os << "  " << m.second << (m.first == Kind::Udp ? " (UDP)" : "") << "\n";
+        }
+    }
+
+    Stats stats() { lock_guard<mutex> lg(statsMtx); return stats_; }
+
+private:
+    enum : uint8_t { MSG_HELLO = 1, MSG_CHAT = 2, MSG_MEMBERS = 3, MSG_JOIN = 4, MSG_LEAVE = 5, MSG_RESYNC = 6 };
+    // 보내기는 막히지 않는다: 로컬 클라이언트 경로 (reactor, UDP 스레드) 와 다른 링크의 읽는 스레드는 out 에 넣기만 하고,
+    // 소켓이 받지 못한 나머지는 링크 자기 스레드가 writable 을 기다려 보낸다.
+    struct Link {
+        SOCKET sock = INVALID_SOCKET;
+        uint32_t node = 0;
+        string addr;
+        Waker wake;                              // out 에 새로 쌓였다
+        mutex sendMtx;                           // 아래와 sock 으로의 send
+        deque<shared_ptr<const string>> out;     // 보낼 frame. 링크 여럿이 같은 바이트를 나눠 쓴다
+        size_t outOff = 0, outBytes = 0;         // out.front() 에서 이미 보낸 바이트, out 전체 바이트
+        bool closed = false;                     // 끊기로 했다 (더 넣지 않는다)
+    };
+    struct Frame {
+        uint8_t type = 0;
+        uint32_t origin = 0, epoch = 0;
+        uint64_t seq = 0;
+        vector<uint32_t> visited;
+        string payload;
+    };
+    struct Seen { uint64_t floor = 0; set<uint64_t> recent; };   // floor 이하는 모두 본 것으로 친다
+    struct Origin { uint32_t epoch = 0; Seen seen; deque<uint32_t> retired; };   // 지금 epoch 만 seq 를 기억한다
+    struct Remote {
+        multiset<pair<Kind, string>> members;
+        uint32_t via = 0;                        // 마지막 소식이 들어온 링크의 노드
+        steady_clock::time_point heard;
+    };
+
+    uint32_t self, epoch;
+    string port;
+    vector<string> peers;
+    Callbacks cb;
+    const atomic<bool>& running;
+    const Waker& stopWaker;
+    SOCKET listenSock = INVALID_SOCKET;
+
+    mutex threadsMtx;
+    vector<thread> threads;
+
+    mutex linksMtx;
+    vector<shared_ptr<Link>> links;
+
+    mutex seqMtx;                      // seq 배정과 첫 전송 순서를 묶는다 (링크마다 seq 순서대로 나가도록)
+    uint64_t nextSeq = 1;
+
+    mutex seenMtx;
+    map<uint32_t, Origin> seen;
+
+    mutex viewMtx;
+    map<uint32_t, Remote> view;   // 다른 노드 -> 멤버
+
+    mutex statsMtx;
+    Stats stats_;
+
+    static void putU32(string& s, uint32_t v) { for (int i = 3; i >= 0; --i) s.push_back((char)(v >> (i * 8))); }
+    static void putU64(string& s, uint64_t v) { for (int i = 7; i >= 0; --i) s.push_back((char)(v >> (i * 8))); }
+    static uint32_t getU32(const char* p) { uint32_t v = 0; for (int i = 0; i < 4; ++i) v = (v << 8) | (uint8_t)p[i]; return v; }
+    static uint64_t getU64(const char* p) { uint64_t v = 0; for (int i = 0; i < 8; ++i) v = (v << 8) | (uint8_t)p[i]; return v; }
+
+    static string encode(const Frame& f) {
+        string body;
+        body.push_back((char)f.type);
+        putU32(body, f.origin); putU32(body, f.epoch); putU64(body, f.seq);
+        body.push_back((char)f.visited.size());
+        for (uint32_t v : f.visited) putU32(body, v);
+        body += f.payload;
+        string out;
+        putU32(out, (uint32_t)body.size());
+        return out + body;
+    }
+
+    static bool decode(const char* p, size_t n, Frame& f) {
+        if (n < 18) return false;
+        f.type = (uint8_t)p[0]; f.origin = getU32(p + 1); f.epoch = getU32(p + 5); f.seq = getU64(p + 9);
+        size_t nv = (uint8_t)p[17];
+        if (n < 18 + nv * 4) return false;
+        f.visited.clear();
+        for (size_t i = 0; i < nv; ++i) f.visited.push_back(getU32(p + 18 + i * 4));
+        f.payload.assign(p + 18 + nv * 4, n - 18 - nv * 4);
+        return true;
+    }
+
+    static SOCKET openListen(const string& port) {
+        addrinfo hints{}; addrinfo* res = nullptr;
+        hints.ai_family = AF_INET; hints.ai_socktype = SOCK_STREAM; hints.ai_flags = AI_PASSIVE;
+        if (getaddrinfo(nullptr, port.c_str(), &hints, &res) != 0) throw runtime_error("mesh getaddrinfo failed");
+        SOCKET s = socket(res->ai_family, res->ai_socktype, res->ai_protocol);
+        if (s == INVALID_SOCKET) { freeaddrinfo(res); throw runtime_error("mesh socket() failed: " + lastWinsockError()); }
+        int opt = 1; setsockopt(s, SOL_SOCKET, SO_REUSEADDR, (const char*)&opt, sizeof(opt));
+        if (bind(s, res->ai_addr, (int)res->ai_addrlen) == SOCKET_ERROR) { freeaddrinfo(res); closesocket(s); throw runtime_error("mesh bind() failed: " + lastWinsockError()); }
+        freeaddrinfo(res);
+        if (listen(s, SOMAXCONN) == SOCKET_ERROR) { closesocket(s); throw runtime_error("mesh listen() failed: " + lastWinsockError()); }
+        setNonBlocking(s);
+        return s;
+    }
+
+    set<uint32_t> linkedNodes() {
+        lock_guard<mutex> lg(linksMtx);
+        set<uint32_t> out;
+        for (auto& l : links) out.insert(l->node);
+        return out;
+    }
+
+    vector<shared_ptr<Link>> snapshotLinks() {
+        lock_guard<mutex> lg(linksMtx);
+        return links;
+    }
+
+    // sendMtx 안에서. out 을 소켓이 지금 받는 만큼 보낸다. 오류면 false
+    static bool flushLink(Link& l) {
+        while (!l.out.empty()) {
+            const string& b = *l.out.front();
+            int r = send(l.sock, b.data() + l.outOff, (int)(b.size() - l.outOff), 0);
+            if (r < 0) {
+                int e = WSAGetLastError();
+                if (e == WSAEINTR) continue;
+                return e == WSAEWOULDBLOCK;
+            }
+            l.outOff += (size_t)r;
+            if (l.outOff == b.size()) { l.outBytes -= b.size(); l.out.pop_front(); l.outOff = 0; }
+        }
+        return true;
+    }
+
+    // l 로 보낼 frame 을 넣는다. 큐가 비어 있으면 소켓이 받는 만큼 바로 보내고 나머지는 링크 스레드에게 맡긴다.
+    // 피어가 MESH_LINK_OUT_MAX 만큼 밀려 있으면 기다리지 않고 링크를 끊는다 (다시 붙으면 MEMBERS 부터 다시 맞춘다).
+    bool enqueue(Link& l, const shared_ptr<const string>& bytes) {
+        bool overflow = false;
+        {
+            lock_guard<mutex> lg(l.sendMtx);
+            if (l.closed) return false;
+            if (l.outBytes + bytes->size() > MESH_LINK_OUT_MAX) overflow = true;
+            else {
+                bool idle = l.out.empty();
+                l.out.push_back(bytes);
+                l.outBytes += bytes->size();
+                if (idle && !flushLink(l)) l.closed = true;
+                else if (!l.out.empty()) l.wake.wake();
+            }
+            if (overflow) l.closed = true;
+            if (l.closed) shutdown(l.sock, SD_BOTH);   // 링크 스레드가 깨어나 정리한다
+        }
+        if (overflow) Logger::warn("Mesh link to node " + to_string(l.node) + " (" + l.addr + ") is not draining, closing it");
+        lock_guard<mutex> sl(statsMtx);
+        if (!overflow) ++stats_.framesSent;
+        return !overflow;
+    }
+
+    // targets 에게 f 를 보낸다. 받는 노드들을 모두 visited 에 넣어 그들이 서로에게 다시 넘기지 않게 한다.
+    void sendToAll(Frame& f, const vector<shared_ptr<Link>>& targets) {
+        for (auto& l : targets) f.visited.push_back(l->node);
+        if (f.visited.size() > 255) f.visited.resize(255);
+        auto bytes = make_shared<const string>(encode(f));
+        for (auto& l : targets) enqueue(*l, bytes);
+    }
+
+    void originate(uint8_t type, const string& payload) {
+        auto targets = snapshotLinks();
+        if (targets.empty()) return;
+        Frame f;
+        f.type = type; f.origin = self; f.epoch = epoch; f.visited.push_back(self); f.payload = payload;
+        lock_guard<mutex> lg(seqMtx);
+        f.seq = nextSeq++;
+        sendToAll(f, targets);
+    }
+
+    // 처음 본 (origin, epoch, seq) 면 true. 새 epoch 가 오면 (재시작) 이전 epoch 의 seq 는 버리고 epoch 만 retired 에 남긴다
+    bool firstSeen(const Frame& f) {
+        lock_guard<mutex> lg(seenMtx);
+        auto [it, fresh] = seen.try_emplace(f.origin);
+        Origin& o = it->second;
+        if (fresh) o.epoch = f.epoch;
+        else if (f.epoch != o.epoch) {
+            if (find(o.retired.begin(), o.retired.end(), f.epoch) != o.retired.end()) return false;
+            o.retired.push_back(o.epoch);
+            if (o.retired.size() > MESH_RETIRED_EPOCHS) o.retired.pop_front();
+            o.epoch = f.epoch;
+            o.seen = Seen();
+        }
+        Seen& s = o.seen;
+        if (f.seq <= s.floor || !s.recent.insert(f.seq).second) return false;
+        while (s.recent.size() > MESH_DEDUP_WINDOW) { s.floor = *s.recent.begin(); s.recent.erase(s.recent.begin()); }
+        return true;
+    }
+
+    void onFrame(const Link& from, Frame& f) {
+        if (f.origin == self) return;   // 내 메시지가 돌아왔다
+        if (!firstSeen(f)) { lock_guard<mutex> lg(statsMtx); ++stats_.duplicates; return; }
+        {
+            lock_guard<mutex> lg(statsMtx);
+            ++stats_.received;
+        }
+        vector<shared_ptr<Link>> onward;
+        for (auto& l : snapshotLinks())
+            if (l.get() != &from && find(f.visited.begin(), f.visited.end(), l->node) == f.visited.end()) onward.push_back(l);
+        if (!onward.empty()) {
+            Frame fwd = f;
+            sendToAll(fwd, onward);
+            lock_guard<mutex> lg(statsMtx);
+            stats_.forwarded += onward.size();
+        }
+        if (f.type == MSG_RESYNC) { originate(MSG_MEMBERS, membersPayload()); return; }
+        if (f.payload.empty()) return;
+        Kind kind = (Kind)f.payload[0];
+        string body = f.payload.substr(1);
+        if (f.type == MSG_CHAT) { if (cb.deliver) cb.deliver(kind, body); return; }
+        lock_guard<mutex> lg(viewMtx);
+        Remote& r = view[f.origin];
+        r.via = from.node;
+        r.heard = steady_clock::now();
+        auto& members = r.members;
+        if (f.type == MSG_JOIN) members.insert({ kind, body });
+        else if (f.type == MSG_LEAVE) { auto it = members.find({ kind, body }); if (it != members.end()) members.erase(it); }
+        else if (f.type == MSG_MEMBERS) {
+            // payload 전체가 [kind][name]\n[kind][name]\n... (멤버가 없으면 kind 한 바이트뿐)
+            members.clear();
+            string all = f.payload;
+            for (size_t pos = 0; pos < all.size();) {
+                size_t nl = all.find('\n', pos);
+                if (nl == string::npos) nl = all.size();
+                if (nl > pos + 1) members.insert({ (Kind)all[pos], all.substr(pos + 1, nl - pos - 1) });
+                pos = nl + 1;
+            }
+        }
+    }
+
+    string membersPayload() {
+        string payload;
+        if (cb.members) for (auto& m : cb.members()) { payload.push_back((char)m.kind); payload += m.name; payload.push_back('\n'); }
+        if (payload.empty()) payload.push_back((char)Kind::Tcp);   // 빈 목록도 교체로 보낸다
+        return payload;
+    }
+
+    // 새 링크에게 이 노드의 멤버 전체를 보낸다 (그 뒤로는 JOIN/LEAVE)
+    void sendMembers(const shared_ptr<Link>& l) {
+        Frame f;
+        f.type = MSG_MEMBERS; f.origin = self; f.epoch = epoch; f.visited.push_back(self); f.payload = membersPayload();
+        lock_guard<mutex> lg(seqMtx);
+        f.seq = nextSeq++;
+        sendToAll(f, { l });
+    }
+
+    // 멤버를 주기적으로 다시 알리고, 소식이 끊긴 노드 (중계 너머에서 죽었거나 경로가 사라진) 를 view 에서 지운다
+    void refreshLoop() {
+        while (running.load() && !waitWake(stopWaker, (int)duration_cast<milliseconds>(MESH_MEMBERS_REFRESH).count())) {
+            originate(MSG_MEMBERS, membersPayload());
+            auto cutoff = steady_clock::now() - MESH_MEMBERS_REFRESH * 3;
+            lock_guard<mutex> lg(viewMtx);
+            for (auto it = view.begin(); it != view.end();) it = it->second.heard < cutoff ? view.erase(it) : next(it);
+        }
+    }
+
+    void acceptLoop() {
+        Poller poller;
+        poller.add(listenSock, Poller::READ);
+        poller.add(stopWaker.fd(), Poller::READ);
+        vector<Poller::Event> evs;
+        while (running.load()) {
+            poller.wait(evs, -1);
+            if (!running.load()) break;
+            sockaddr_in addr{}; socklen_t len = sizeof(addr);
+            SOCKET s = accept(listenSock, (sockaddr*)&addr, &len);
+            if (s == INVALID_SOCKET) continue;
+            setNonBlocking(s);
+            lock_guard<mutex> lg(threadsMtx);
+            threads.emplace_back(&Federation::serveLink, this, s, sockaddrToString(addr));
+        }
+    }
+
+    // host:port 로 연결을 유지한다. 끊기면 200ms 부터 5초까지 늘려 가며 다시 건다.
+    void dialLoop(string peer) {
+        int backoffMs = 200;
+        while (running.load()) {
+            SOCKET s = dial(peer);
+            if (s != INVALID_SOCKET) { serveLink(s, peer); backoffMs = 200; }
+            if (!running.load() || waitWake(stopWaker, backoffMs)) break;
+            backoffMs = min(backoffMs * 2, 5000);
+        }
+    }
+
+    // stop 이 오면 바로 포기하도록 non-blocking connect 를 stopWaker 와 함께 기다린다
+    SOCKET dial(const string& peer) {
+        size_t colon = peer.rfind(':');
+        if (colon == string::npos) { Logger::warn("Mesh peer needs host:port: " + peer); return INVALID_SOCKET; }
+        addrinfo hints{}; addrinfo* res = nullptr;
+        hints.ai_family = AF_INET; hints.ai_socktype = SOCK_STREAM;
+        if (getaddrinfo(peer.substr(0, colon).c_str(), peer.substr(colon + 1).c_str(), &hints, &res) != 0) return INVALID_SOCKET;
+        SOCKET s = socket(res->ai_family, res->ai_socktype, res->ai_protocol);
+        if (s == INVALID_SOCKET) { freeaddrinfo(res); return INVALID_SOCKET; }
+        setNonBlocking(s);
+        int r = connect(s, res->ai_addr, (int)res->ai_addrlen);
+        freeaddrinfo(res);
+        if (r != 0) {
+            int e = WSAGetLastError();
+#ifdef _WIN32
+            bool pending = e == WSAEWOULDBLOCK;
+#else
+            bool pending = e == EINPROGRESS;
+#endif
+            if (!pending) { closesocket(s); return INVALID_SOCKET; }
+            Poller poller;
+            poller.add(s, Poller::WRITE);
+            poller.add(stopWaker.fd(), Poller::READ);
+            vector<Poller::Event> evs;
+            poller.wait(evs, 3000);
+            int err = 0; socklen_t len = sizeof(err);
+            bool ready = any_of(evs.begin(), evs.end(), [&](const Poller::Event& ev) { return ev.fd == s; });
+            if (!running.load() || !ready || getsockopt(s, SOL_SOCKET, SO_ERROR, (char*)&err, &len) != 0 || err != 0) { closesocket(s); return INVALID_SOCKET; }
+        }
+        return s;
+    }
+
+    // 링크 하나의 수명: HELLO 교환, 멤버 교환, frame 읽기, 밀린 out 보내기. 같은 노드와 이미 링크가 있으면 새 것을 닫는다.
+    // 소켓은 non-blocking: 읽다가 막히지 않고, out 이 남아 있을 때만 WRITE 를 기다린다.
+    void serveLink(SOCKET s, string addr) {
+        int one = 1; setsockopt(s, IPPROTO_TCP, TCP_NODELAY, (const char*)&one, sizeof(one));
+        auto link = make_shared<Link>();
+        link->sock = s; link->addr = addr;
+        Frame hello;
+        hello.type = MSG_HELLO; hello.origin = self; hello.epoch = epoch;
+        bool registered = false;
+        if (enqueue(*link, make_shared<const string>(encode(hello)))) {
+            Poller poller;
+            poller.add(s, Poller::READ);
+            poller.add(link->wake.fd(), Poller::READ);
+            poller.add(stopWaker.fd(), Poller::READ);
+            vector<Poller::Event> evs;
+            string in;
+            size_t off = 0;
+            char buf[BUF_SIZE * 4];
+            bool ok = true, writing = false;
+            while (ok && running.load()) {
+                poller.wait(evs, -1);
+                if (!running.load()) break;
+                bool readable = false;
+                for (auto& ev : evs) {
+                    if (ev.fd == link->wake.fd()) link->wake.drain();
+                    else if (ev.fd == s && (ev.events & Poller::READ)) readable = true;
+                }
+                bool wantWrite;
+                {
+                    lock_guard<mutex> lg(link->sendMtx);
+                    if (link->closed || !flushLink(*link)) break;
+                    wantWrite = !link->out.empty();
+                }
+                if (wantWrite != writing) { poller.modify(s, Poller::READ | (wantWrite ? Poller::WRITE : 0)); writing = wantWrite; }
+                if (!readable) continue;
+                int r = recv(s, buf, sizeof(buf), 0);
+                if (r <= 0) {
+                    if (r < 0 && (WSAGetLastError() == WSAEINTR || WSAGetLastError() == WSAEWOULDBLOCK)) continue;
+                    break;
+                }
+                in.append(buf, (size_t)r);
+                while (ok && in.size() - off >= 4) {
+                    size_t len = getU32(in.data() + off);
+                    if (len > MESH_FRAME_MAX) { Logger::warn("Mesh frame too large from " + addr); ok = false; break; }
+                    if (in.size() - off - 4 < len) break;
+                    Frame f;
+                    if (!decode(in.data() + off + 4, len, f)) { ok = false; break; }
+                    off += 4 + len;
+                    if (!registered) {
+                        if (f.type != MSG_HELLO || f.origin == self) { ok = false; break; }
+                        link->node = f.origin;
+                        {
+                            lock_guard<mutex> lg(linksMtx);
+                            if (any_of(links.begin(), links.end(), [&](const shared_ptr<Link>& l) { return l->node == f.origin; })) { ok = false; break; }
+                            links.push_back(link);
+                        }
+                        registered = true;
+                        Logger::info("Mesh link up: node " + to_string(f.origin) + " (" + addr + ")");
+                        sendMembers(link);
+                        continue;
+                    }
+                    onFrame(*link, f);
+                }
+                if (off > (1 << 16) || off == in.size()) { in.erase(0, off); off = 0; }
+            }
+        }
+        if (registered) {
+            {
+                lock_guard<mutex> lg(linksMtx);
+                links.erase(remove(links.begin(), links.end(), link), links.end());
+            }
+            {
+                lock_guard<mutex> lg(viewMtx);
+                for (auto it = view.begin(); it != view.end();)
+                    it = it->first == link->node || it->second.via == link->node ? view.erase(it) : next(it);
+            }
+            Logger::info("Mesh link down: node " + to_string(link->node) + " (" + addr + ")");
+            if (running.load()) originate(MSG_RESYNC, "");   // 다른 경로로 아직 닿는 노드는 MEMBERS 를 다시 보낸다
+        }
+        lock_guard<mutex> lg(link->sendMtx);   // 다른 스레드가 이 링크에 넣는 중이면 끝난 뒤에 닫는다
+        link->closed = true;
+        link->out.clear();
+        link->outBytes = link->outOff = 0;
+        closesocket(s);
+        link->sock = INVALID_SOCKET;
+    }
+};
+
+// ---------------- ChatServer ----------------
+class ChatServer {
+public:
+    ChatServer(const string& port, const ServerOptions& o = ServerOptions())
+        : portStr(port), opts(o), running(false), history((size_t)max(0, o.historyMessages), o.historyBytes), rooms((size_t)max(1, o.tcpListeners)),
+        udpTargets(make_shared<UdpTargets>()), fecTargets(make_shared<UdpTargets>()), fecTx(o.fecData, o.fecParity) {}
+    ~ChatServer() { stop(); }
+
+    void start() {
+        if (running.load()) return;
+        running.store(true);
+        serverThread = thread(&ChatServer::run, this);
+    }
+
+    void stop() {
+        bool wasRunning = running.exchange(false);
+        if (wasRunning) {
+            // 모든 루프가 stopWaker (TCP 쪽은 reactor 의 stop) 로 깨어나 스스로 빠져나온다. 소켓은 아무도 기다리지 않을 때 닫는다.
+            stopWaker.wake();
+            kickUdpTimer();
+            if (mesh) mesh->stop();   // 피어로 막힌 send 를 풀어야 reactor 가 끝난다
+            for (auto& l : listeners) l->reactor.stop();
+            for (auto& l : listeners) if (l->worker.joinable()) l->worker.join();   // 연결 coroutine 은 모두 자기 소켓을 닫고 끝났다
+            for (auto& t : udpThreads) if (t.joinable()) t.join();
+            if (udpTimerThread.joinable()) udpTimerThread.join();
+            lock_guard<mutex> lg(controlMtx);
+            for (auto& l : listeners) if (l->sock != INVALID_SOCKET) { closesocket(l->sock); l->sock = INVALID_SOCKET; }
+            for (auto& s : udpSocks) if (s != INVALID_SOCKET) { closesocket(s); s = INVALID_SOCKET; }
+        }
+        if (serverThread.joinable()) serverThread.join();   // run() 이 fatal 로 끝났어도 join 한다
+        if (wasRunning) Logger::info("Server fully stopped");
+    }
+
+    void listAll() {
+        Logger::info("=== TCP Clients ===");
+        lock_guard<mutex> lg(clientsMtx);
+        for (auto& cptr : clients) cout << "  " << cptr->name << " @ " << sockaddrToString(cptr->addr) << "\n";
+        for (auto& sess : detached) cout << "  " << sess->name << " (disconnected, resumable " << duration_cast<seconds>(sess->expires - steady_clock::now()).count() << "s)\n";
+        Logger::info("=== UDP Clients ===");
+        {
+            lock_guard<mutex> lg2(udpMtx);
+            for (auto& [key, u] : udpClients) cout << "  " << u.name << " @ " << sockaddrToString(u.addr) << udpModeTag(u.mode) << "\n";
+        }
+        auto roomList = rooms.list();   // udpMtx 를 놓은 뒤 (락 순서: shard -> udpMtx)
+        if (!roomList.empty()) {
+            Logger::info("=== Rooms ===");
+            for (auto& r : roomList) cout << "  #" << r.name << " (TCP " << r.tcp << ", UDP " << r.udp << ")\n";
+        }
+        if (mesh) {
+            auto st = mesh->stats();
+            Logger::info("=== Mesh (this node " + to_string(mesh->nodeId()) + ", relayed " + to_string(st.published) + ", received " + to_string(st.received) + ", duplicates " + to_string(st.duplicates) + ") ===");
+            mesh->describe(cout);
+        }
+    }
+
+    // 차선별 송신 큐: 지금 남은 덩어리 / 바이트와 지난 /queues 뒤의 최대 바이트 (보고하면 최대를 지금 값으로 되돌린다)
+    void listQueues() {
+        Logger::info("=== TCP send queues ===");
+        size_t depth[LANE_COUNT] = {}, bytes[LANE_COUNT] = {}, peak[LANE_COUNT] = {};
+        lock_guard<mutex> lg(clientsMtx);
+        for (auto& cptr : clients) {
+            lock_guard<mutex> sl(cptr->sendMtx);
+            cout << "  " << cptr->name;
+            for (size_t i = 0; i < LANE_COUNT; ++i) {
+                auto& l = cptr->lanes[i];
+                cout << "  " << laneName(i) << " " << l.depth() << " (" << l.bytes << " B, peak " << l.peak << " B)";
+                depth[i] += l.depth(); bytes[i] += l.bytes; peak[i] = max(peak[i], l.peak);
+                l.peak = l.bytes;
+            }
+            cout << "\n";
+        }
+        cout << "  total";
+        for (size_t i = 0; i < LANE_COUNT; ++i) cout << "  " << laneName(i) << " " << depth[i] << " (" << bytes[i] << " B, peak " << peak[i] << " B)";
+        cout << "\n";
+    }
+
+    void listUdp() {
+        Logger::info("=== UDP Clients ===");
+        lock_guard<mutex> lg(udpMtx);
+        for (auto& [key, u] : udpClients) cout << "  " << u.name << " @ " << sockaddrToString(u.addr) << udpModeTag(u.mode) << "\n";
+    }
+
+private:
+    friend struct ChatBench;   // 채팅 마이크로벤치.cpp
+    string portStr;
+    ServerOptions opts;
+    vector<SOCKET> udpSocks;   // shard 별 소켓, 모두 같은 포트
+
+    atomic<bool> running;
+    Waker stopWaker;   // stop() 이 깨운다. 모든 대기 루프가 함께 기다린다
+    thread serverThread;
+    vector<thread> udpThreads;
+    thread udpTimerThread;
+
+    vector<shared_ptr<TCPClient>> clients;
+    uint32_t nextClientId = 1;   // clientsMtx
+    atomic<uint32_t> tcpSeq{ 0 };   // v2 방송 frame 의 seq (전체 방송과 방 fan-out 이 함께 늘린다)
+    unordered_map<string, shared_ptr<Session>> sessions;   // 토큰 -> 세션 (clientsMtx)
+    vector<shared_ptr<Session>> detached;                  // 끊겨서 RESUME 이나 만료를 기다리는 세션 (clientsMtx)
+    Waker sessionWaker;          // 세션이 끊기면 listeners[0] 의 sessionTimers 가 만료 시각을 다시 잡도록
+    HistoryRing history;   // clientsMtx 로 보호: 기록 순서 = 방송 순서, 스냅샷 + 입장이 방송과 섞이지 않는다
+    mutex clientsMtx;
+    RoomTable rooms;
+    NickIndex nicks;   // /msg. TCP 는 clientsMtx 안에서, UDP 는 udpMtx 밖에서 고친다
+
+    unordered_map<uint64_t, UDPClient> udpClients;   // endpointKey -> 등록 (udpMtx)
+    TimerWheel udpIdle;                              // 등록 만료 (udpMtx). udpTimerLoop 가 돌린다
+    atomic<int> udpRoomed{ 0 };                      // 방에 들어간 UDP 등록 수. 0 이면 datagram 마다 방을 찾지 않는다
+    shared_ptr<const UdpTargets> udpTargets;   // plain udpClients 주소의 불변 스냅샷 (udpMtx 로 교체)
+    shared_ptr<const UdpTargets> fecTargets;   // FEC udpClients 주소의 불변 스냅샷 (udpMtx 로 교체)
+    map<uint64_t, pair<sockaddr_in, shared_ptr<ReliableChannel>>> rudpPeers;   // 신뢰 채널 클라이언트 (udpMtx)
+    mutex udpMtx;
+
+    fec::Encoder fecTx;   // 모든 shard 가 같은 블록 순서를 쓴다 (fecMtx)
+    mutex fecMtx;
+
+    mutex udpTimerMtx;
+    condition_variable udpTimerCv;
+    bool udpTimerKick = false;
+
+    mutex controlMtx;
+#ifdef NET_HAVE_TLS
+    unique_ptr<net::TlsContext> tlsCtx;   // --tls (setupTls)
+#endif
+
+    struct Handshake {
+        SOCKET sock;
+        sockaddr_in addr;
+        string buf;                             // 지금까지 받은 첫 메시지
+        steady_clock::time_point deadline;
+        bool ready = false;                     // accept 직후 이미 다 왔다 (TCP_DEFER_ACCEPT)
+#ifdef NET_HAVE_TLS
+        unique_ptr<net::TlsSession> tls = nullptr;   // --tls. admit 이 TCPClient 로 넘긴다
+#endif
+    };
+    enum class HandshakeStep { Wait, Ready, Drop };
+
+    // listen 소켓 하나와 그것의 reactor 스레드 (--tcp-listeners 개, 같은 포트의 SO_REUSEPORT 그룹).
+    // accept, handshake, 이 소켓으로 들어온 모든 연결이 그 스레드의 coroutine 이다.
+    struct Listener {
+        SOCKET sock = INVALID_SOCKET;
+        thread worker;
+        Reactor reactor;
+    };
+    vector<unique_ptr<Listener>> listeners;
+
+#ifndef _WIN32
+    unique_ptr<MessageLog> messageLog;   // run() 에서 만들고 소멸자까지 둔다
+#endif
+    unique_ptr<Federation> mesh;         // --mesh-port / --mesh-peers 일 때만
+
+    void run() {
+        try {
+            WinsockInit w;
+            setupLog();
+            setupTls();
+            setupListen();
+            setupUDP();
+            setupMesh();
+
+            for (size_t i = 0; i < listeners.size(); ++i) listeners[i]->worker = thread(&ChatServer::reactorLoop, this, ref(*listeners[i]), i == 0);
+            for (size_t i = 0; i < udpSocks.size(); ++i) udpThreads.emplace_back(&ChatServer::udpLoop, this, udpSocks[i], (int)i);
+            udpTimerThread = thread(&ChatServer::udpTimerLoop, this, udpSocks[0]);
+
+            Logger::info("Server started on port " + portStr + " (TCP x" + to_string(listeners.size()) + " + UDP x" + to_string(udpSocks.size()) + ", " + backendName(defaultBackend()) + ")");
+            while (running.load()) waitWake(stopWaker, -1);
+        }
+        catch (const exception& ex) {
+            Logger::error(string("Server fatal: ") + ex.what());
+            running.store(false);
+        }
+    }
+
+    void setupMesh() {
+        if (opts.meshPort.empty() && opts.meshPeers.empty()) return;
+        uint32_t id = opts.meshNodeId;
+        while (id == 0) id = (uint32_t)random_device{}();
+        Federation::Callbacks cb;
+        cb.deliver = [this](Federation::Kind kind, const string& text) { deliverRelayed(kind, text); };
+        cb.members = [this]() { return meshMembers(); };
+        mesh.reset(new Federation(id, opts.meshPort, opts.meshPeers, cb, running, stopWaker));
+        mesh->start();
+        Logger::info("Mesh node " + to_string(id) + (opts.meshPort.empty() ? "" : " listening on " + opts.meshPort) + ", " + to_string(opts.meshPeers.size()) + " peer(s) to dial");
+    }
+
+    // 로컬에서 방송한 메시지를 다른 노드로
+    void relay(Federation::Kind kind, const string& text) {
+        if (mesh) mesh->publish(kind, text);
+    }
+
+    // 다른 노드에서 온 메시지를 로컬 클라이언트에게. 다시 relay 하지 않는다 (Federation 이 넘긴다).
+    void deliverRelayed(Federation::Kind kind, const string& text) {
+        if (kind == Federation::Kind::Tcp) {
+            Logger::info("Mesh msg: " + text.substr(0, text.find_last_not_of('\n') + 1));
+            broadcastTcp(make_shared<const string>(text));
+            return;
+        }
+        Logger::info("Mesh UDP msg: " + text);
+        logMessage(text);
+        SOCKET sock = udpSocks[0];
+        broadcastUdp(text, sock);
+        vector<string> outs{ text };
+        broadcastFec(encodeFec(outs), sock);
+        broadcastReliable(outs, sock);
+    }
+
+    vector<Federation::Member> meshMembers() {
+        vector<Federation::Member> out;
+        {
+            lock_guard<mutex> lg(clientsMtx);
+            for (auto& c : clients) out.push_back({ Federation::Kind::Tcp, c->name });
+        }
+        lock_guard<mutex> lg(udpMtx);
+        for (auto& [key, u] : udpClients) out.push_back({ Federation::Kind::Udp, u.name });
+        return out;
+    }
+
+    void setupLog() {
+        if (opts.logDir.empty()) return;
+#ifndef _WIN32
+        messageLog.reset(new MessageLog(opts.logDir, (size_t)max(1, opts.logSegmentMb) << 20, milliseconds(max(1, opts.logSyncMs))));
+        Logger::info("Message log: " + opts.logDir);
+#else
+        Logger::warn("--log-dir needs POSIX mmap; message log disabled");
+#endif
+    }
+
+    void logMessage(const string& msg) {
+#ifndef _WIN32
+        if (messageLog) messageLog->append(msg.data(), msg.size());
+#else
+        (void)msg;
+#endif
+    }
+
+    // "/history <from> [to]" 를 그 클라이언트에게만 답한다. 방송이 중간에 끼지 않도록 sendMtx 를 쥔다.
+    void serveHistory(const shared_ptr<TCPClient>& client, const string& args) {
+        istringstream iss(args);
+        string a, b;
+        iss >> a >> b;
+        if (b.empty()) b = a.empty() || a[0] != '#' ? "now" : "#" + to_string(numeric_limits<int64_t>::max() - 1);
+        int64_t from = 0, to = 0; bool seqA = false, seqB = false;
+        auto reply = [&](const string& text) { queueSend(*client, make_shared<const string>(client->binary ? frameLine(text, wire::FLAG_HISTORY) : text), Lane::Control); };
+        if (!parseHistoryBound(a, from, seqA) || !parseHistoryBound(b, to, seqB) || seqA != seqB) { reply("[서버] 사용법: /history <from> [to]  (HH:MM[:SS], YYYY-MM-DDTHH:MM, -10m, now, 또는 #seq)\n"); return; }
+#ifndef _WIN32
+        if (!messageLog) { reply("[서버] 메시지 로그가 꺼져 있습니다 (--log-dir)\n"); return; }
+        bool busy;
+        {
+            // 구간 파일은 fd 를 쥔 채 송신 큐에서 나간다. 앞의 /history 가 다 나가기 전에는 새로 열지 않는다
+            lock_guard<mutex> sl(client->sendMtx);
+            auto& q = client->lanes[(size_t)Lane::Bulk].q;
+            busy = any_of(q.begin() + (ptrdiff_t)client->lanes[(size_t)Lane::Bulk].head, q.end(), [](const OutChunk& ch) { return ch.file != nullptr; });
+        }
+        if (busy) { reply("[서버] 앞의 /history 를 아직 보내는 중입니다\n"); return; }
+        bool truncated = false;
+        vector<shared_ptr<FileSpan>> spans;
+        int64_t total = messageLog->spans(from, to, seqA, truncated, spans);
+        if (total < 0) { Logger::warn("History read failed for " + client->name + ": " + lastWinsockError()); return; }
+        if (total == 0) { reply("[서버] 해당 구간의 기록이 없습니다\n"); return; }
+        {
+            lock_guard<mutex> sl(client->sendMtx);
+            if (client->sock == INVALID_SOCKET) return;
+            bool idle = client->outEmpty();
+            OutLane& l = client->lanes[(size_t)Lane::Bulk];
+            if (client->binary) {
+                // binary 클라이언트에는 구간 전체를 CHAT frame 하나로: 헤더만 버퍼로, 본문은 파일 그대로 (끝까지 차선을 바꾸지 않는다)
+                wire::Frame f; f.type = wire::CHAT; f.flags = wire::FLAG_HISTORY;
+                string h(wire::HEADER_MAX, '\0');
+                h.resize(wire::encodeHeader(f, (size_t)total, &h[0], h.size()));
+                l.bytes += h.size();
+                l.q.emplace_back();
+                l.q.back().buf = make_shared<const string>(move(h));
+                l.q.back().more = true;
+            }
+            for (auto& sp : spans) { l.q.emplace_back(); l.q.back().file = move(sp); l.q.back().more = client->binary; }
+            l.q.back().more = false;
+            startOut(*client, idle);
+        }
+        if (truncated) reply("\n[서버] /history 는 한 번에 " + to_string(LOG_HISTORY_MAX >> 20) + "MB 까지만 보냅니다\n");
+#else
+        reply("[서버] 메시지 로그가 꺼져 있습니다 (--log-dir)\n");
+#endif
+    }
+
+    void setupTls() {
+        if (!opts.tls) return;
+#ifdef NET_HAVE_TLS
+        tlsCtx = make_unique<net::TlsContext>(net::TlsContext::server(opts.tlsCert, opts.tlsKey));
+        tlsCtx->kernelBothWays();
+        Logger::info(string("TLS on") + (opts.tlsCert.empty() ? " (temporary self-signed certificate; --tls-cert / --tls-key)" : ""));
+#endif
+    }
+
+    void setupListen() {
+        int n = max(1, opts.tcpListeners);
+#ifndef __linux__
+        if (n > 1) { Logger::warn("Multiple TCP listeners need Linux SO_REUSEPORT; using 1"); n = 1; }
+#endif
+        for (int i = 0; i < n; ++i) {
+            listeners.emplace_back(new Listener());
+            listeners.back()->sock = openTcpListener(n > 1);
+        }
+#ifdef __linux__
+        if (opts.tcpFastOpen && !(tcpFastOpenSysctl() & 2))
+            Logger::warn("TCP Fast Open: server side is off in net.ipv4.tcp_fastopen (needs bit 2); SYN data will wait for the handshake");
+#endif
+    }
+
+    // TCP listen 소켓. reusePort 이면 같은 포트의 SO_REUSEPORT 그룹에 합류한다 (커널이 4-tuple 해시로 연결을 나눈다).
+    // Linux: TCP_DEFER_ACCEPT 로 첫 데이터 (닉네임/HELLO) 가 온 연결만 accept 에 올라오고,
+    // TCP_FASTOPEN 이면 쿠키를 가진 클라이언트의 SYN 에 실린 첫 데이터를 3-way handshake 를 기다리지 않고 받는다.
+    SOCKET openTcpListener(bool reusePort) {
+        addrinfo hints{}; addrinfo* res = nullptr;
+        hints.ai_family = AF_INET; hints.ai_socktype = SOCK_STREAM; hints.ai_flags = AI_PASSIVE;
+        if (getaddrinfo(nullptr, portStr.c_str(), &hints, &res) != 0) throw runtime_error("getaddrinfo failed");
+
+        SOCKET s = socket(res->ai_family, res->ai_socktype, res->ai_protocol);
+        if (s == INVALID_SOCKET) { freeaddrinfo(res); throw runtime_error("socket() failed: " + lastWinsockError()); }
+        int opt = 1; setsockopt(s, SOL_SOCKET, SO_REUSEADDR, (const char*)&opt, sizeof(opt));
+#ifdef SO_REUSEPORT
+        if (reusePort && setsockopt(s, SOL_SOCKET, SO_REUSEPORT, (const char*)&opt, sizeof(opt)) != 0) { freeaddrinfo(res); closesocket(s); throw runtime_error("SO_REUSEPORT failed: " + lastWinsockError()); }
+#endif
+        if (bind(s, res->ai_addr, (int)res->ai_addrlen) == SOCKET_ERROR) { freeaddrinfo(res); closesocket(s); throw runtime_error("bind() failed: " + lastWinsockError()); }
+        freeaddrinfo(res);
+#ifdef __linux__
+        if (opts.deferAccept) {
+            int secs = max(1, (opts.handshakeTimeoutMs + 999) / 1000);
+            if (setsockopt(s, IPPROTO_TCP, TCP_DEFER_ACCEPT, &secs, sizeof(secs)) != 0) Logger::warn("TCP_DEFER_ACCEPT failed: " + lastWinsockError());
+        }
+        if (opts.tcpFastOpen) {
+            int qlen = TCP_FASTOPEN_QLEN;
+            if (setsockopt(s, IPPROTO_TCP, TCP_FASTOPEN, &qlen, sizeof(qlen)) != 0) Logger::warn("TCP_FASTOPEN failed: " + lastWinsockError());
+        }
+#endif
+        if (listen(s, SOMAXCONN) == SOCKET_ERROR) { closesocket(s); throw runtime_error("listen() failed: " + lastWinsockError()); }
+        setNonBlocking(s);   // readiness 를 본 뒤 accept 한다. 그 사이 연결이 끊겨도 막히지 않도록
+        return s;
+    }
+
+    void setupUDP() {
+        int shards = max(1, opts.udpShards);
+#ifndef __linux__
+        if (shards > 1) { Logger::warn("UDP sharding needs Linux SO_REUSEPORT; using 1 socket"); shards = 1; }
+#endif
+        unsigned short port = (unsigned short)stoi(portStr);
+        for (int i = 0; i < shards; ++i) udpSocks.push_back(openUdpSocket(port, shards > 1));
+#ifdef __linux__
+        if (shards > 1 && opts.udpCpuSteer && !attachReuseportCpuSteering(udpSocks[0], shards))
+            Logger::warn("SO_ATTACH_REUSEPORT_CBPF failed, using kernel hash: " + lastWinsockError());
+        if (opts.udpBatch > 1 && opts.udpOffload)
+            Logger::info(string("UDP offload: GSO ") + (udpGsoSupported(udpSocks[0]) ? "on" : "off (unsupported)"));
+#endif
+    }
+
+    // listen 소켓 하나의 reactor 스레드. 연결 수만큼 스레드를 띄우지 않고 모두 이 스레드의 coroutine 으로 돈다.
+    void reactorLoop(Listener& l, bool sessionTimers) {
+        l.reactor.spawn(acceptLoop(l));
+        if (sessionTimers) l.reactor.spawn(expireLoop(l.reactor));
+        l.reactor.run();
+    }
+
+    // readable 한 번에 ACCEPT_BATCH 개까지 (Linux 는 accept4 로 바로 non-blocking) 받아 연결마다 coroutine 을 띄운다.
+    // 닉네임을 보내지 않는 연결은 자기 coroutine 안에서 기다리므로 뒤 연결을 막지 않는다.
+    Task<> acceptLoop(Listener& l) {
+        vector<Handshake> batch;
+        while (running.load()) {
+            co_await l.reactor.wait(l.sock, Poller::READ);
+            if (!running.load()) break;
+            bool backoff = acceptBatch(l.sock, batch);
+            for (auto& h : batch) l.reactor.spawn(connection(l.reactor, move(h)));
+            batch.clear();
+            if (backoff) co_await l.reactor.sleep(steady_clock::now() + milliseconds(100));   // EMFILE 등: 바로 다시 readable 이므로 잠깐 물러난다
+        }
+    }
+
+    // 대기 중인 연결을 다 받거나 ACCEPT_BATCH 개까지. 물러나야 하는 오류면 true
+    bool acceptBatch(SOCKET listenSock, vector<Handshake>& out) {
+        auto deadline = steady_clock::now() + milliseconds(opts.handshakeTimeoutMs);
+        for (int i = 0; i < ACCEPT_BATCH; ++i) {
+            sockaddr_in addr{}; socklen_t addrlen = sizeof(addr);
+#ifdef __linux__
+            SOCKET cs = accept4(listenSock, (sockaddr*)&addr, &addrlen, SOCK_NONBLOCK | SOCK_CLOEXEC);
+#else
+            SOCKET cs = accept(listenSock, (sockaddr*)&addr, &addrlen);
+            if (cs != INVALID_SOCKET) setNonBlocking(cs);
+#endif
+            if (cs == INVALID_SOCKET) {
+                int e = WSAGetLastError();
+                if (e == WSAECONNABORTED) continue;
+                if (e == WSAEWOULDBLOCK || e == WSAEINTR) return false;
+                Logger::warn("accept() failed: " + lastWinsockError());
+                return true;
+            }
+            out.push_back({ cs, addr, string(), deadline });
+            if (!opts.deferAccept || opts.tls) continue;   // TLS: 와 있는 것은 ClientHello
+            // TCP_DEFER_ACCEPT: 첫 데이터가 이미 와 있다. 다 왔으면 연결 coroutine 은 기다리지 않고 바로 들인다
+            HandshakeStep step = readHandshake(out.back());
+            if (step == HandshakeStep::Ready) out.back().ready = true;
+            else if (step == HandshakeStep::Drop) { closesocket(cs); out.pop_back(); }
+        }
+        return false;
+    }
+
+    // 연결 하나의 일생: 첫 메시지 (텍스트 닉네임, binary HELLO/RESUME) 를 handshake timeout 안에 받아 들이고,
+    // 그 뒤로는 clientHandler. 소켓은 끝까지 non-blocking 이고 이 coroutine 만 기다린다.
+    Task<> connection(Reactor& r, Handshake h) {
+#ifdef NET_HAVE_TLS
+        if (tlsCtx && !co_await tlsHandshake(r, h)) { r.forget(h.sock); closesocket(h.sock); co_return; }
+#endif
+        while (!h.ready) {
+            int ev = 0;
+            try { ev = co_await r.wait(h.sock, Poller::READ, h.deadline); }
+            catch (const exception& ex) { Logger::warn(sockaddrToString(h.addr) + ": " + ex.what()); break; }
+            if (!running.load()) break;
+            if (ev) {
+                HandshakeStep step = readHandshake(h);
+                if (step == HandshakeStep::Ready) h.ready = true;
+                else if (step == HandshakeStep::Drop) break;
+            }
+            else if (steady_clock::now() >= h.deadline) { Logger::warn("Handshake timed out: " + sockaddrToString(h.addr)); break; }
+        }
+        if (!h.ready) { r.forget(h.sock); closesocket(h.sock); co_return; }
+        auto client = admit(r, h);
+        if (client) co_await clientHandler(r, client);
+    }
+
+#ifdef NET_HAVE_TLS
+    // --tls: handshake timeout 안에 TLS handshake. 키가 커널로 넘어간 방향은 예전처럼 recv / sendmsg / sendfile 로 쓰고
+    // record 는 커널이 암호화 / 복호한다. 넘어가지 못한 방향은 SSL_read / SSL_write (recvClient, flushOut)
+    Task<bool> tlsHandshake(Reactor& r, Handshake& h) {
+        string who = sockaddrToString(h.addr);
+        h.tls = make_unique<net::TlsSession>(*tlsCtx, h.sock);
+        for (;;) {
+            net::TlsSession::Step step = h.tls->handshake();
+            if (step == net::TlsSession::Done) break;
+            if (step == net::TlsSession::Failed) { Logger::warn("TLS handshake failed: " + who + ": " + h.tls->error); co_return false; }
+            int ev = 0;
+            try { ev = co_await r.wait(h.sock, step == net::TlsSession::WantRead ? Poller::READ : Poller::WRITE, h.deadline); }
+            catch (const exception& ex) { Logger::warn(who + ": " + ex.what()); co_return false; }
+            if (!running.load()) co_return false;
+            if (!ev && steady_clock::now() >= h.deadline) { Logger::warn("TLS handshake timed out: " + who); co_return false; }
+        }
+        co_return true;
+    }
+#endif
+
+    // listeners[0] 만: TTL 안에 돌아오지 않은 세션을 퇴장시킨다. 세션이 새로 끊기면 sessionWaker 로 만료 시각을 다시 잡는다
+    Task<> expireLoop(Reactor& r) {
+        while (running.load()) {
+            int ms = sessionTimeoutMs();
+            co_await r.wait(sessionWaker.fd(), Poller::READ, ms < 0 ? steady_clock::time_point::max() : steady_clock::now() + milliseconds(ms));
+            if (!running.load()) break;
+            sessionWaker.drain();
+            expireSessions();
+        }
+        r.forget(sessionWaker.fd());
+    }
+
+    // readable 한 연결에서 받은 만큼 쌓고 첫 메시지가 다 왔는지 본다
+    HandshakeStep readHandshake(Handshake& h) {
+        char buf[BUF_SIZE];
+        int r;
+#ifdef NET_HAVE_TLS
+        if (h.tls && !h.tls->kernelRecv()) {
+            r = h.tls->read(buf, BUF_SIZE);   // 다 못 돌려준 평문은 clientHandler 가 이어 읽는다 (tlsBuffered)
+            if (r == net::TlsSession::AGAIN) return HandshakeStep::Wait;
+            if (r < 0) { Logger::warn("TLS recv failed: " + sockaddrToString(h.addr) + ": " + h.tls->error); return HandshakeStep::Drop; }
+        }
+        else
+#endif
+        r = recv(h.sock, buf, BUF_SIZE, 0);
+        if (r == 0) { Logger::warn("Client connected but didn't send name"); return HandshakeStep::Drop; }
+        if (r < 0) {
+            int e = WSAGetLastError();
+            if (e == WSAEWOULDBLOCK || e == WSAEINTR) return HandshakeStep::Wait;
+            Logger::warn("Handshake recv failed: " + lastWinsockError());
+            return HandshakeStep::Drop;
+        }
+        h.buf.append(buf, (size_t)r);
+        if (!wire::isFrame(h.buf.data(), h.buf.size())) return HandshakeStep::Ready;   // 텍스트: 첫 recv 가 닉네임 (예전과 같다)
+        wire::Frame f; size_t used = 0;
+        wire::Status st = wire::decode(h.buf.data(), h.buf.size(), f, used);
+        if (st == wire::Status::Ok) return HandshakeStep::Ready;
+        if (st == wire::Status::NeedMore && h.buf.size() < BUF_SIZE) return HandshakeStep::Wait;   // HELLO 가 나뉘어 왔다
+        Logger::warn("Bad HELLO from " + sockaddrToString(h.addr));
+        return HandshakeStep::Drop;
+    }
+
+    // 첫 메시지가 다 온 연결을 들인다 (새 입장 또는 세션 재접속). 못 들이면 소켓을 닫고 nullptr
+    shared_ptr<TCPClient> admit(Reactor& r, Handshake& h) {
+        SOCKET cs = h.sock;
+        auto client = make_shared<TCPClient>();
+        client->sock = cs; client->addr = h.addr; client->alive.store(true); client->reactor = &r;
+#ifdef NET_HAVE_TLS
+        client->tls = move(h.tls);
+#endif
+        string token; uint32_t lastSeq = 0;   // RESUME 일 때
+        if (wire::isFrame(h.buf.data(), h.buf.size())) {
+            wire::Frame hello; size_t used = 0;
+            bool resume = false;
+            if (wire::decode(h.buf.data(), h.buf.size(), hello, used) != wire::Status::Ok || hello.len == 0
+                || (hello.type != wire::HELLO && !(resume = hello.type == wire::RESUME && hello.len > wire::SESSION_TOKEN_LEN))) {
+                r.forget(cs); closesocket(cs); Logger::warn("Bad HELLO from " + sockaddrToString(h.addr)); return nullptr;
+            }
+            client->binary = true;
+            client->version = min(hello.version, wire::VERSION);
+            size_t skip = resume ? wire::SESSION_TOKEN_LEN : 0;
+            if (resume) { token.assign(hello.payload, skip); lastSeq = hello.seq; }
+            client->name.assign(hello.payload + skip, hello.len - skip);
+            client->early.assign(h.buf, used, string::npos);
+        }
+        else client->name = h.buf.c_str();
+        if (opts.heartbeatSec > 0 && !(client->binary && client->version >= 3)) setTcpKeepAlive(cs, opts.idleTimeoutSec);
+        setNotSentLowat(cs);
+        setNoDelay(cs);
+        client->write = opts.write;
+        shared_ptr<Session> stale;   // RESUME 이 받아들여지지 않은 옛 세션: 따로 퇴장시킨다
+        size_t missed = 0;
+        bool resumed = false;
+        {
+            // 재전송을 락 안에서 끝내야 그 사이 방송이 기록보다 먼저 도착하거나 빠지지 않는다
+            lock_guard<mutex> lg(clientsMtx);
+            if (!token.empty()) resumed = resumeSession(client, token, lastSeq, stale, missed);
+            if (!resumed) {
+                client->id = nextClientId++;
+                nicks.addTcp(client->name, client);
+                if (client->version >= 2 && opts.sessionTtlSec > 0) openSession(client);
+                if (client->binary) welcomeBinary(client);
+                announceJoin(client);
+                replayHistory(client);
+            }
+            clients.push_back(client);
+        }
+        if (stale) announceLeave(stale->id, stale->name);
+
+        string name = client->name;
+        string proto = client->binary ? " binary v" + to_string(client->version) : "";
+#ifdef NET_HAVE_TLS
+        if (client->tls) proto += ", " + client->tls->describe();
+#endif
+        if (resumed) Logger::info(string("[서버] ") + name + " 재접속 (" + sockaddrToString(h.addr) + ")" + proto + ", 놓친 frame " + to_string(missed) + "개");
+        else {
+            Logger::info(string("[서버] ") + name + " 입장 (" + sockaddrToString(h.addr) + ")" + proto);
+            if (mesh) mesh->memberJoined(Federation::Kind::Tcp, name);
+        }
+        return client;
+    }
+
+    // 완성된 frame 을 모두 처리한다. 깨진 stream 이면 false
+    bool drainFrames(const shared_ptr<TCPClient>& client, wire::StreamReader<BUF_SIZE * 2>& rx) {
+        wire::Frame f;
+        wire::Status st;
+        while ((st = rx.next(f)) == wire::Status::Ok) {
+            if (f.type == wire::CHAT && f.len > 0) onClientText(client, f.payload, f.len);
+            else if (f.type == wire::PONG) {}   // clientHandler 가 recv 에서 이미 살아 있다고 봤다
+            else if (f.type == wire::BYE) { client->bye = true; client->alive.store(false); break; }
+        }
+        return st != wire::Status::Bad;
+    }
+
+    // clientsMtx 안에서. WELCOME (세션이 있으면 토큰) 과 지금 있는 사람들의 JOIN 을 한 번에 보낸다.
+    void welcomeBinary(const shared_ptr<TCPClient>& client) {
+        string out;
+        wire::Frame f;
+        f.type = wire::WELCOME; f.version = client->version; f.sender = client->id;
+        if (client->session) { f.payload = client->session->token.data(); f.len = client->session->token.size(); }
+        appendFrame(out, f);
+        for (auto& c : clients) {
+            wire::Frame j; j.type = wire::JOIN; j.sender = c->id; j.payload = c->name.data(); j.len = c->name.size();
+            appendFrame(out, j);
+        }
+        queueSend(*client, make_shared<const string>(move(out)), Lane::Control);
+    }
+
+    // clientsMtx 안에서. 새로 들어온 사람의 ID 를 binary 클라이언트들에게 (자기 자신 포함, 끊긴 세션에도)
+    void announceJoin(const shared_ptr<TCPClient>& client) {
+        wire::Frame join; join.type = wire::JOIN; join.sender = client->id; join.payload = client->name.data(); join.len = client->name.size();
+        if (client->binary) queueSend(*client, make_shared<const string>(makeFrame(join)), Lane::Control);
+        fanout(nullptr, INVALID_SOCKET, join, Lane::Control);
+    }
+
+    // 퇴장 알림: 텍스트 줄, binary LEAVE, 다른 노드
+    void announceLeave(uint32_t id, const string& name) {
+        auto bye = make_shared<const string>(string("[서버] ") + name + " 퇴장\n");
+        wire::Frame leave; leave.type = wire::LEAVE; leave.sender = id;
+        broadcastTcp(bye, INVALID_SOCKET, &leave, Lane::Control);
+        relay(Federation::Kind::Tcp, *bye);
+        if (mesh) mesh->memberLeft(Federation::Kind::Tcp, name);
+    }
+
+    static string newSessionToken() {
+        random_device rd;
+        string t(wire::SESSION_TOKEN_LEN, '\0');
+        for (size_t i = 0; i < t.size(); i += 4) { uint32_t v = rd(); memcpy(&t[i], &v, min<size_t>(4, t.size() - i)); }
+        return t;
+    }
+
+    // clientsMtx 안에서
+    void openSession(const shared_ptr<TCPClient>& client) {
+        auto sess = make_shared<Session>();
+        do sess->token = newSessionToken(); while (sessions.count(sess->token));
+        sess->id = client->id; sess->name = client->name; sess->client = client;
+        sessions[sess->token] = sess;
+        client->session = sess;
+    }
+
+    // clientsMtx 안에서. 세션 버퍼가 lastSeq 뒤를 다 갖고 있으면 client 를 그 세션에 다시 붙이고
+    // WELCOME(RESUMED) 과 놓친 frame 들을 한 번의 gather send 로 보낸다. 못 붙이면 false, 옛 세션은 stale 로 돌려준다.
+    bool resumeSession(const shared_ptr<TCPClient>& client, const string& token, uint32_t lastSeq, shared_ptr<Session>& stale, size_t& missed) {
+        auto it = sessions.find(token);
+        if (it == sessions.end()) return false;
+        shared_ptr<Session> sess = it->second;
+        shared_ptr<TCPClient> old = sess->client;
+        if (old) {
+            // 옛 연결이 아직 끊긴 줄 모른다. 깨워서 조용히 끝내게 한다 (소켓은 옛 clientHandler 가 닫는다, 다른 reactor 일 수 있다)
+            old->replaced = true;
+            old->alive.store(false);
+            shutdown(old->sock, SD_BOTH);
+            sess->client.reset();
+        }
+        detached.erase(remove(detached.begin(), detached.end(), sess), detached.end());
+        vector<HistoryRing::Message> delta;
+        if (!sess->since(lastSeq, delta)) {
+            sessions.erase(it);
+            stale = sess;
+            for (auto& name : sess->rooms) rooms.partTcp(name, [&](const TCPClient& m) { return m.session == sess; });
+            nicks.removeTcp(sess->name, [&](const TCPClient& m) { return m.session == sess; });
+            return false;
+        }
+
+        client->id = sess->id; client->name = sess->name; client->session = sess;
+        client->rooms = old ? old->rooms : sess->rooms;   // 방은 그대로: 세션 버퍼에 방의 글도 남아 있다
+        for (auto& name : client->rooms) rooms.resumeTcp(name, sess.get(), client);
+        nicks.resumeTcp(client->name, sess.get(), client);
+        sess->rooms.clear();
+        sess->client = client;
+        wire::Frame f;
+        f.type = wire::WELCOME; f.version = client->version; f.flags = wire::FLAG_RESUMED; f.sender = sess->id;
+        f.payload = token.data(); f.len = token.size();
+        missed = delta.size();
+        delta.insert(delta.begin(), make_shared<const string>(makeFrame(f)));
+        queueSend(*client, delta.data(), delta.size());
+        return true;
+    }
+
+    // expireLoop 가 기다릴 시간: 가장 먼저 끝나는 끊긴 세션까지
+    int sessionTimeoutMs() {
+        lock_guard<mutex> lg(clientsMtx);
+        if (detached.empty()) return -1;
+        auto first = detached.front()->expires;
+        for (auto& sess : detached) first = min(first, sess->expires);
+        auto left = duration_cast<milliseconds>(first - steady_clock::now()).count();
+        return (int)max<long long>(0, left + 1);
+    }
+
+    // TTL 안에 돌아오지 않은 세션을 퇴장시킨다
+    void expireSessions() {
+        vector<shared_ptr<Session>> gone;
+        {
+            lock_guard<mutex> lg(clientsMtx);
+            auto now = steady_clock::now();
+            for (auto& sess : detached) {
+                if (sess->expires > now) continue;
+                gone.push_back(sess);
+                sessions.erase(sess->token);
+                for (auto& room : sess->rooms) rooms.partTcp(room, [&](const TCPClient& m) { return m.session == sess; });
+                nicks.removeTcp(sess->name, [&](const TCPClient& m) { return m.session == sess; });
+            }
+            detached.erase(remove_if(detached.begin(), detached.end(), [&](auto& sess) { return sess->expires <= now; }), detached.end());
+        }
+        for (auto& sess : gone) {
+            Logger::info("Session expired: " + sess->name);
+            announceLeave(sess->id, sess->name);
+        }
+    }
+
+    // 받은 글 하나로 방송/기록이 공유할 버퍼 "[name] text\n" 을 만든다 (MessagePool 의 버퍼, 로그 줄은 줄바꿈 앞까지)
+    static HistoryRing::Message buildTcpMessage(const string& name, const char* text, size_t len) {
+        auto m = MessagePool::local().take();
+        m->reserve(name.size() + len + 4);
+        m->append(1, '[').append(name).append("] ", 2).append(text, len).push_back('\n');
+        return m;
+    }
+
+    static HistoryRing::Message pooledFrame(const wire::Frame& f) {
+        auto m = MessagePool::local().take();
+        appendFrame(*m, f);
+        return m;
+    }
+
+    // 받은 글 하나: /history, /join, /part 이거나 방송 (지금 방이 있으면 그 방에만). binary 클라이언트에게는 이름 대신 sender ID 로 보낸다.
+    void onClientText(const shared_ptr<TCPClient>& client, const char* text, size_t len) {
+        if (isCommand(text, len, "/history")) { serveHistory(client, string(text + 8, len - 8)); return; }
+        if (isCommand(text, len, "/join")) { joinRoom(client, string(text + 5, len - 5)); return; }
+        if (isCommand(text, len, "/part")) { partRoom(client, string(text + 5, len - 5)); return; }
+        if (isCommand(text, len, "/msg")) {
+            string nick, body;
+            if (!splitDirect(string(text + 4, len - 4), nick, body)) notice(*client, "[서버] 사용법: /msg <닉네임> <글>\n");
+            else if (!sendDirect(client->name, nick, body)) notice(*client, "[서버] " + nick + " 님이 없습니다\n");
+            return;
+        }
+        if (!client->rooms.empty()) { roomMessage(client, client->rooms.back(), text, len); return; }   // rooms 는 이 스레드만 바꾼다
+        auto msg = buildTcpMessage(client->name, text, len);
+        Logger::info("TCP msg: ", msg->data(), msg->size() - 1);
+        wire::Frame chat; chat.type = wire::CHAT; chat.sender = client->id; chat.payload = text; chat.len = len;
+        broadcastTcp(msg, client->sock, &chat); // TCP만
+        relay(Federation::Kind::Tcp, *msg);
+    }
+
+    // text 가 "cmd" 이거나 "cmd <인자>"
+    static bool isCommand(const char* text, size_t len, const char* cmd) {
+        size_t n = strlen(cmd);
+        return len >= n && memcmp(text, cmd, n) == 0 && (len == n || text[n] == ' ');
+    }
+
+    static string trimmed(const string& s) {
+        size_t b = s.find_first_not_of(" \t\r\n"), e = s.find_last_not_of(" \t\r\n");
+        return b == string::npos ? string() : s.substr(b, e - b + 1);
+    }
+
+    // 그 클라이언트에게만 알림 한 줄
+    static void notice(TCPClient& c, const string& text) {
+        queueSend(c, make_shared<const string>(c.binary ? frameLine(text) : text), Lane::Control);
+    }
+
+    // "/join <방>": 없으면 만들고, 이미 들어가 있으면 지금 방으로 돌린다. 방의 다른 멤버들에게 알린다
+    void joinRoom(const shared_ptr<TCPClient>& client, const string& args) {
+        string room = trimmed(args);
+        if (!normalizeRoomName(room)) { notice(*client, "[서버] 사용법: /join <방> (공백 없이 " + to_string(ROOM_NAME_MAX) + "바이트까지)\n"); return; }
+        bool fresh;
+        size_t members;
+        {
+            lock_guard<mutex> lg(clientsMtx);
+            auto& rs = client->rooms;
+            auto it = find(rs.begin(), rs.end(), room);
+            fresh = it == rs.end();
+            if (!fresh) rs.erase(it);
+            rs.push_back(room);
+            members = rooms.joinTcp(room, client);
+        }
+        if (!fresh) { notice(*client, "[서버] 지금 방: #" + room + "\n"); return; }
+        Logger::info("[방] " + client->name + " -> #" + room + " (TCP " + to_string(members) + "명)");
+        notice(*client, "[서버] #" + room + " 에 들어왔습니다 (" + to_string(members) + "명). 글은 이 방에만 갑니다, /part 로 나갑니다\n");
+        fanoutRoom(room, roomLine(room, "[서버] " + client->name + " 님이 들어왔습니다"), client.get());
+    }
+
+    // "/part [방]": 그 방 (없으면 지금 방) 에서 나온다. 남은 방이 없으면 다시 전체 채팅
+    void partRoom(const shared_ptr<TCPClient>& client, const string& args) {
+        string room = trimmed(args);
+        if (room.empty() && !client->rooms.empty()) room = client->rooms.back();
+        bool member = false;
+        string now;
+        if (normalizeRoomName(room)) {
+            lock_guard<mutex> lg(clientsMtx);
+            auto& rs = client->rooms;
+            auto it = find(rs.begin(), rs.end(), room);
+            member = it != rs.end();
+            if (member) { rs.erase(it); rooms.partTcp(room, [&](const TCPClient& m) { return &m == client.get(); }); }
+            if (!rs.empty()) now = rs.back();
+        }
+        if (!member) { notice(*client, "[서버] 들어가 있지 않은 방입니다\n"); return; }
+        Logger::info("[방] " + client->name + " <- #" + room);
+        notice(*client, "[서버] #" + room + " 에서 나왔습니다. 지금: " + (now.empty() ? string("전체 채팅") : "#" + now) + "\n");
+        fanoutRoom(room, roomLine(room, "[서버] " + client->name + " 님이 나갔습니다"), nullptr);
+    }
+
+    // 방의 글 "[#방] [name] text\n" 을 방의 TCP 멤버에게만 (보낸 사람 빼고)
+    void roomMessage(const shared_ptr<TCPClient>& client, const string& room, const char* text, size_t len) {
+        auto m = MessagePool::local().take();
+        m->reserve(room.size() + client->name.size() + len + 8);
+        m->append("[#", 2).append(room).append("] [", 3).append(client->name).append("] ", 2).append(text, len).push_back('\n');
+        Logger::info("Room msg: ", m->data(), m->size() - 1);
+        fanoutRoom(room, m, client.get());
+    }
+
+    static HistoryRing::Message roomLine(const string& room, const string& text) { return make_shared<const string>("[#" + room + "] " + text + "\n"); }
+
+    // fanout 과 같되 방의 멤버에게만, 그 방 shard 의 락 안에서 (clientsMtx 없음)
+    void fanoutRoom(const string& room, const HistoryRing::Message& line, const TCPClient* except) {
+        uint32_t seq = ++tcpSeq;
+        HistoryRing::Message v1, v2;
+        rooms.with(room, [&](Room& r) { for (auto& c : r.tcp) if (c.get() != except) sendLine(*c, line, seq, v1, v2); });
+    }
+
+    // 완성된 줄 하나를 c 에게 (방, /msg). binary 는 CHAT (sender 0) frame, v2 이상은 seq 를 붙여 세션 버퍼에도 남긴다.
+    // frame 은 처음 필요할 때 v1 / v2 에 만들어 다음 받는 사람과 함께 쓴다. 끊겨 세션만 남은 연결은 세션 버퍼에만 (queueSend 는 닫힌 연결을 건너뛴다)
+    void sendLine(TCPClient& c, const HistoryRing::Message& line, uint32_t seq, HistoryRing::Message& v1, HistoryRing::Message& v2) {
+        if (!c.binary) { queueSend(c, line); return; }
+        wire::Frame f; f.type = wire::CHAT; f.payload = line->data(); f.len = line->size();
+        if (c.version < 2) { if (!v1) v1 = pooledFrame(f); queueSend(c, v1); return; }
+        if (!v2) { f.flags |= wire::FLAG_SEQ; f.seq = seq; v2 = pooledFrame(f); }
+        if (c.session) c.session->send(v2, seq, [&] { queueSend(c, v2); });
+        else queueSend(c, v2);
+    }
+
+    // "/msg" 뒤: "<닉네임> <글>"
+    static bool splitDirect(const string& args, string& nick, string& body) {
+        string t = trimmed(args);
+        size_t e = t.find(' ');
+        if (e == string::npos) return false;
+        nick = t.substr(0, e);
+        body = trimmed(t.substr(e + 1));
+        return !body.empty();
+    }
+
+    // 귓속말: 그 이름의 TCP 연결들에게 (끊긴 세션이면 세션 버퍼로), TCP 가 없으면 UDP 주소들로. 이름이 없으면 false.
+    // 찾기는 NickIndex 한 번 (clients / udpClients 를 훑지 않는다). 기록, 영구 로그, 다른 노드로는 가지 않는다
+    bool sendDirect(const string& from, const string& to, const string& body) {
+        auto line = make_shared<const string>("[DM][" + from + "] " + body + "\n");
+        bool reliable = false;
+        bool found = nicks.find(to, [&](NickIndex::Entry& e) {
+            if (!e.tcp.empty()) {
+                uint32_t seq = ++tcpSeq;
+                HistoryRing::Message v1, v2;
+                for (auto& c : e.tcp) sendLine(*c, line, seq, v1, v2);
+                return;
+            }
+            if (udpSocks.empty()) return;
+            for (auto& a : e.udp) reliable |= sendUdpLine(udpSocks[0], a, line->data(), line->size() - 1);
+        });
+        if (reliable) kickUdpTimer();   // shard 잠금 밖에서 (타이머 스레드의 만료가 그 shard 를 잡는다)
+        if (found) Logger::info("DM: " + from + " -> " + to);
+        return found;
+    }
+
+    // 한 주소에게 datagram 한 줄: 신뢰 채널이면 그 채널로 (true), 아니면 그대로. sendto 실패면 false 가 아니라 fails 를 늘린다.
+    // true 면 호출자가 잠금 (방 / NickIndex shard) 을 놓은 뒤 kickUdpTimer() 한다
+    bool sendUdpLine(SOCKET udpSock, const sockaddr_in& a, const char* p, size_t n, int* fails = nullptr) {
+        if (auto ch = findReliablePeer(a)) { ch->send(p, n, udpOutput(udpSock, a)); return true; }
+        if (sendto(udpSock, p, (int)n, 0, (const sockaddr*)&a, sizeof(a)) == SOCKET_ERROR && fails) ++*fails;
+        return false;
+    }
+
+    // 들인 연결 (coroutine): 받은 글을 처리하고, 방송이 다 못 보낸 것을 writable 때 보내고, 끊기면 정리한다.
+    // 읽기와 쓰기를 한 번의 wait 로 기다린다 (밀린 송신이 있을 때만 WRITE). 다른 스레드의 방송이 밀리면 notify 로 깨운다.
+    // v3 클라이언트는 heartbeat 동안 조용하면 PING, 그 뒤 idle timeout 까지 아무것도 안 오면 끊는다 (wait 의 deadline = reactor 의 timer wheel).
+    Task<> clientHandler(Reactor& r, shared_ptr<TCPClient> client) {
+        SOCKET s = client->sock;
+        string name = client->name;
+        char buf[BUF_SIZE];
+        wire::StreamReader<BUF_SIZE * 2> rx;   // binary 클라이언트만
+        bool heartbeat = client->binary && client->version >= 3 && opts.heartbeatSec > 0;
+        auto lastHeard = steady_clock::now();
+        bool pinged = false;
+        bool bad = false;
+        if (client->binary && !client->early.empty()) {
+            memcpy(rx.space(), client->early.data(), client->early.size());
+            rx.commit(client->early.size());
+            client->early.clear();
+            bad = !drainFrames(client, rx);
+        }
+        while (!bad && running.load() && client->alive.load()) {
+            bool pending;
+            auto flushAt = steady_clock::time_point::min();   // Throughput 으로 모으는 중이면 보낼 시각: 그때까지는 writable 을 기다리지 않는다
+            {
+                lock_guard<mutex> sl(client->sendMtx);
+                pending = !client->outEmpty();
+                if (pending) flushAt = client->flushAt;
+            }
+            bool collecting = flushAt != steady_clock::time_point::min();
+            auto hbDeadline = heartbeat ? lastHeard + seconds(pinged ? opts.idleTimeoutSec : opts.heartbeatSec) : steady_clock::time_point::max();
+            int ev = 0;
+            if (tlsBuffered(*client)) ev = Poller::READ;   // 소켓은 비었어도 SSL 에 남은 평문이 있다
+            else {
+                try { ev = co_await r.wait(s, Poller::READ | (pending && !collecting ? Poller::WRITE : 0), collecting ? min(hbDeadline, flushAt) : hbDeadline); }
+                catch (const exception& ex) { Logger::warn("Cannot wait on " + name + ": " + ex.what()); break; }   // 예: select 의 FD_SETSIZE
+            }
+            if (!running.load()) break;
+            if (collecting && !(ev & Poller::WRITE) && steady_clock::now() >= flushAt) ev |= Poller::WRITE;   // window 가 끝났다
+            if (ev == 0 && heartbeat && steady_clock::now() >= hbDeadline) {
+                if (pinged) { Logger::info("Idle timeout: " + name); break; }
+                pinged = true;
+                static const auto ping = make_shared<const string>(makeFrame(wire::PING, 0, nullptr, 0));
+                queueSend(*client, ping, Lane::Control);
+                continue;
+            }
+            if (ev & Poller::WRITE) {
+                lock_guard<mutex> sl(client->sendMtx);
+                if (!sendOut(*client)) { Logger::warn("TCP send failed to " + name + ": " + lastWinsockError()); break; }
+            }
+            if (!(ev & Poller::READ)) continue;   // 보내기만 했거나 방송이 밀려 깨웠다 (다음 wait 에 WRITE 를 건다)
+            int n = client->binary ? recvClient(*client, rx.space(), (int)rx.room()) : recvClient(*client, buf, BUF_SIZE - 1);
+            if (n > 0) {
+                lastHeard = steady_clock::now(); pinged = false;   // 무엇이든 오면 살아 있다 (PONG 포함)
+                if (!client->binary) { onClientText(client, buf, strnlen(buf, (size_t)n)); continue; }
+                rx.commit((size_t)n);
+                if (!drainFrames(client, rx)) { Logger::warn("Bad frame from " + name); break; }
+            }
+            else if (n == 0) { Logger::info("Client disconnected: " + name); break; }
+            else { int e = WSAGetLastError(); if (e == WSAEWOULDBLOCK || e == WSAEINTR) continue; Logger::warn("recv error: " + lastWinsockError()); break; }
+        }
+
+        client->alive.store(false);
+        bool replaced, detach = false;
+        {
+            // 목록에서 먼저 빼야 방송이 닫힌 소켓에 쓰지 않는다
+            lock_guard<mutex> lg(clientsMtx);
+            clients.erase(remove_if(clients.begin(), clients.end(), [&](auto& p) { return p.get() == client.get(); }), clients.end());
+            replaced = client->replaced;
+            if (client->session && !replaced) {
+                // 스스로 나간 게 아니면 세션을 TTL 동안 남긴다. 퇴장 알림은 만료될 때
+                detach = !client->bye && running.load();
+                if (detach) {
+                    client->session->client.reset();
+                    client->session->expires = steady_clock::now() + seconds(opts.sessionTtlSec);
+                    client->session->rooms = client->rooms;   // 방 자리는 남긴다: 그동안 방의 글은 세션 버퍼로
+                    detached.push_back(client->session);
+                }
+                else sessions.erase(client->session->token);
+            }
+            if (!detach) {
+                for (auto& room : client->rooms) rooms.partTcp(room, [&](const TCPClient& m) { return &m == client.get(); });
+                nicks.removeTcp(name, [&](const TCPClient& m) { return &m == client.get(); });
+            }
+        }
+        {
+            lock_guard<mutex> sl(client->sendMtx);   // 못 보낸 것은 버린다 (재접속하면 세션 버퍼에서 다시 보낸다)
+            client->clearOut();
+            r.forget(s);
+            shutdown(s, SD_BOTH); closesocket(s); client->sock = INVALID_SOCKET;
+        }
+
+        if (replaced) Logger::info("Connection replaced by resumed session: " + name);
+        else if (detach) { Logger::info("Session kept " + to_string(opts.sessionTtlSec) + "s for " + name); sessionWaker.wake(); }
+        else if (running.load()) announceLeave(client->id, name);
+        Logger::info("Client handler finished: " + name);
+    }
+
+    void udpLoop(SOCKET udpSock, int shard) {
+        if (udpSocks.size() > 1) pinCurrentThread(shard);
+#ifdef __linux__
+        if (opts.udpBatch > 1) { udpLoopBatched(udpSock); return; }
+#endif
+        char buf[BUF_SIZE];
+        vector<string> outs;
+        Poller poller;
+        poller.add(udpSock, Poller::READ);
+        poller.add(stopWaker.fd(), Poller::READ);
+        vector<Poller::Event> evs;
+        while (running.load()) {
+            poller.wait(evs, -1);
+            if (!running.load()) break;
+            if (evs.empty()) continue;
+            sockaddr_in from{}; socklen_t fromlen = sizeof(from);
+            int r = recvfrom(udpSock, buf, BUF_SIZE - 1, 0, (sockaddr*)&from, &fromlen);
+            if (r == SOCKET_ERROR) { int e = WSAGetLastError(); if (e != WSAEWOULDBLOCK && e != WSAEINTR && e != WSAECONNRESET) Logger::warn("UDP recv failed: " + lastWinsockError()); continue; }
+            forwardUdp(udpSock, buf, (size_t)r, from, outs);
+        }
+    }
+
+    // datagram 하나를 처리하고 나온 줄을 방송한다 (batch 가 아닌 경로). outs 는 호출자가 돌려 쓰는 버퍼.
+    void forwardUdp(SOCKET udpSock, const char* data, size_t len, const sockaddr_in& from, vector<string>& outs) {
+        LinePool::local().recycle(outs);
+        handleUdpDatagram(udpSock, data, len, from, outs);
+        for (auto& out : outs) { Logger::info("UDP msg: ", out); logMessage(out); broadcastUdp(out, udpSock); relay(Federation::Kind::Udp, out); }
+        broadcastFec(encodeFec(outs), udpSock);
+        broadcastReliable(outs, udpSock);
+    }
+
+    // datagram 하나를 처리한다: REGISTER, 신뢰 채널 packet, 일반 메시지. 방송할 문장은 outs 에 쌓는다.
+    void handleUdpDatagram(SOCKET udpSock, const char* data, size_t len, const sockaddr_in& from, vector<string>& outs) {
+        if (ReliableChannel::isPacket(data, len)) {
+            auto ch = findReliablePeer(from);
+            if (!ch) return;   // 신뢰 채널로 등록하지 않은 주소의 packet 은 버린다
+            // 채널 락 밖에서 처리한다: 방의 글은 다른 멤버의 채널로 보낸다
+            vector<string> lines;
+            ch->onPacket(data, len, udpOutput(udpSock, from), [&](const char* p, size_t n) { lines.emplace_back(p, n); });
+            for (auto& l : lines) addUdpText(udpSock, outs, from, l.data(), l.size());
+            return;
+        }
+        if (wire::isFrame(data, len)) { handleUdpFrame(udpSock, data, len, from, outs); return; }
+        static const char reg[] = "REGISTER ";
+        if (len >= sizeof(reg) - 1 && memcmp(data, reg, sizeof(reg) - 1) == 0) {
+            string name(data + sizeof(reg) - 1, len - (sizeof(reg) - 1));
+            UdpMode mode = stripSuffix(name, RUDP_REGISTER_SUFFIX) ? UdpMode::Reliable : stripSuffix(name, FEC_REGISTER_SUFFIX) ? UdpMode::Fec : UdpMode::Plain;
+            registerUdpClient(name, from, mode);
+            const string* reply = mode == UdpMode::Reliable ? &RUDP_REGISTERED : mode == UdpMode::Fec ? &FEC_REGISTERED : nullptr;
+            if (reply) sendto(udpSock, reply->data(), (int)reply->size(), 0, (const sockaddr*)&from, sizeof(from));
+            Logger::info("[UDP] REGISTER: " + name + " from " + sockaddrToString(from) + udpModeTag(mode));
+        }
+        else addUdpText(udpSock, outs, from, data, len);
+    }
+
+    // 글 하나: 방 명령이거나, 방에 들어간 주소의 글이면 여기서 그 방으로 보낸다. 아니면 전체 방송 줄로 outs 에
+    void addUdpText(SOCKET udpSock, vector<string>& outs, const sockaddr_in& from, const char* p, size_t n) {
+        if (n >= 5 && p[0] == '/') {
+            if (isCommand(p, n, "/join")) { udpRoomCommand(udpSock, from, true, trimmed(string(p + 5, n - 5))); return; }
+            if (isCommand(p, n, "/part")) { udpRoomCommand(udpSock, from, false, trimmed(string(p + 5, n - 5))); return; }
+            if (isCommand(p, n, "/msg")) { udpDirect(udpSock, from, string(p + 4, n - 4)); return; }
+        }
+        if (udpRoomed.load(memory_order_relaxed) > 0) {
+            string room;
+            {
+                lock_guard<mutex> lg(udpMtx);
+                auto it = udpClients.find(endpointKey(from));
+                if (it != udpClients.end() && !it->second.rooms.empty()) room = it->second.rooms.back();
+            }
+            if (!room.empty()) {
+                string line = "[#" + room + "][UDP][" + sockaddrToString(from) + "] " + string(p, n);
+                Logger::info("UDP room msg: ", line);
+                fanoutRoomUdp(udpSock, room, line, &from);
+                return;
+            }
+        }
+        addUdpLine(outs, from, p, n);
+    }
+
+    // UDP 의 /msg. 보낸 이름은 REGISTER 한 닉네임
+    void udpDirect(SOCKET udpSock, const sockaddr_in& from, const string& args) {
+        string name;
+        {
+            lock_guard<mutex> lg(udpMtx);
+            auto it = udpClients.find(endpointKey(from));
+            if (it != udpClients.end()) name = it->second.name;
+        }
+        string nick, body, err;
+        if (name.empty()) err = "[서버] /msg 는 REGISTER 한 뒤에 쓸 수 있습니다";
+        else if (!splitDirect(args, nick, body)) err = "[서버] 사용법: /msg <닉네임> <글>";
+        else if (!sendDirect(name, nick, body)) err = "[서버] " + nick + " 님이 없습니다";
+        if (!err.empty()) sendto(udpSock, err.data(), (int)err.size(), 0, (const sockaddr*)&from, sizeof(from));
+    }
+
+    // UDP 의 /join, /part. 등록한 (REGISTER) 주소만. 답은 그 주소로 한 줄 (입장 알림은 TCP 쪽만 한다: 보통 같은 사람이 둘 다 든다)
+    void udpRoomCommand(SOCKET udpSock, const sockaddr_in& from, bool join, string room) {
+        string name, now;
+        bool changed = false, known = false;
+        {
+            lock_guard<mutex> lg(udpMtx);
+            auto it = udpClients.find(endpointKey(from));
+            if (it != udpClients.end()) {
+                known = true;
+                auto& rs = it->second.rooms;
+                name = it->second.name;
+                if (!join && room.empty() && !rs.empty()) room = rs.back();
+                if (normalizeRoomName(room)) {
+                    bool wasEmpty = rs.empty();
+                    auto at = find(rs.begin(), rs.end(), room);
+                    changed = join == (at == rs.end());
+                    if (at != rs.end()) rs.erase(at);
+                    if (join) rs.push_back(room);
+                    if (wasEmpty != rs.empty()) udpRoomed.fetch_add(rs.empty() ? -1 : 1);
+                    if (!rs.empty()) now = rs.back();
+                }
+            }
+        }
+        auto reply = [&](const string& text) { sendto(udpSock, text.data(), (int)text.size(), 0, (const sockaddr*)&from, sizeof(from)); };
+        if (!known) { reply("[서버] UDP 방은 REGISTER 한 뒤에 들어갈 수 있습니다"); return; }
+        if (!normalizeRoomName(room)) { reply("[서버] 사용법: /join <방>, /part [방]"); return; }
+        if (!changed) { reply(join ? "[서버] UDP 지금 방: #" + room : "[서버] 들어가 있지 않은 방입니다"); return; }
+        size_t members = 0;
+        if (join) members = rooms.joinUdp(room, from);
+        else rooms.partUdp(room, from);
+        Logger::info("[방] " + name + (join ? " (UDP) -> #" : " (UDP) <- #") + room);
+        if (join) reply("[서버] UDP: #" + room + " 에 들어왔습니다 (" + to_string(members) + "명)");
+        else reply("[서버] UDP: #" + room + " 에서 나왔습니다. 지금: " + (now.empty() ? string("전체 채팅") : "#" + now));
+    }
+
+    // 방의 UDP 멤버에게만 (from 빼고). 신뢰 채널 멤버는 자기 채널로, 나머지는 datagram 그대로 (FEC 블록에는 넣지 않는다)
+    void fanoutRoomUdp(SOCKET udpSock, const string& room, const string& line, const sockaddr_in* except) {
+        int fails = 0;
+        bool reliable = false;
+        rooms.with(room, [&](Room& r) {
+            for (auto& a : r.udp) if (!except || endpointKey(a) != endpointKey(*except)) reliable |= sendUdpLine(udpSock, a, line.data(), line.size(), &fails);
+        });
+        if (reliable) kickUdpTimer();
+        if (fails) Logger::warn("UDP room sendto failed for " + to_string(fails) + " client(s): " + lastWinsockError());
+    }
+
+    // UDP 등록이 사라질 때 (만료, 신뢰 채널 끊김): 그 주소를 방들에서 뺀다. udpMtx 밖에서
+    void partUdpRooms(const sockaddr_in& addr, const vector<string>& names) {
+        if (names.empty()) return;
+        udpRoomed.fetch_sub(1);
+        for (auto& room : names) rooms.partUdp(room, addr);
+    }
+
+    // 방송 줄 "[UDP][addr] text" 를 LinePool 의 문자열에 만든다
+    static void addUdpLine(vector<string>& outs, const sockaddr_in& from, const char* p, size_t n) {
+        outs.push_back(LinePool::local().take());
+        string& line = outs.back();
+        line += "[UDP][";
+        appendSockaddr(line, from);
+        line += "] ";
+        line.append(p, n);
+    }
+
+    // binary 클라이언트의 datagram: REGISTER 또는 CHAT. 방송은 텍스트 줄 그대로 간다 (datagram 이 곧 경계).
+    void handleUdpFrame(SOCKET udpSock, const char* data, size_t len, const sockaddr_in& from, vector<string>& outs) {
+        wire::Frame f; size_t used = 0;
+        if (wire::decode(data, len, f, used) != wire::Status::Ok) return;
+        if (f.type == wire::CHAT) { addUdpText(udpSock, outs, from, f.payload, f.len); return; }
+        if (f.type != wire::REGISTER || f.len == 0) return;
+        string name(f.payload, f.len);
+        UdpMode mode = (f.flags & wire::FLAG_RELIABLE) ? UdpMode::Reliable : (f.flags & wire::FLAG_FEC) ? UdpMode::Fec : UdpMode::Plain;
+        registerUdpClient(name, from, mode);
+        uint8_t on = mode == UdpMode::Reliable ? wire::FLAG_RELIABLE : mode == UdpMode::Fec ? wire::FLAG_FEC : 0;
+        char reply[wire::HEADER_MAX];
+        wire::Frame r; r.type = wire::REGISTERED; r.flags = on;
+        size_t n = wire::encode(r, reply, sizeof(reply));
+        sendto(udpSock, reply, (int)n, 0, (const sockaddr*)&from, sizeof(from));
+        Logger::info("[UDP] REGISTER: " + name + " from " + sockaddrToString(from) + udpModeTag(mode) + " binary");
+    }
+
+    static ReliableChannel::Output udpOutput(SOCKET udpSock, sockaddr_in to) {
+        return [udpSock, to](const char* p, size_t n) { sendto(udpSock, p, (int)n, 0, (const sockaddr*)&to, sizeof(to)); };
+    }
+
+    // 신뢰 UDP 재전송, FEC 블록 flush, UDP 등록 만료 타이머. 가장 이른 RTO / flush / 만료 시각까지 기다렸다가 만료된 것을 처리한다.
+    // 기다릴 것이 없으면 kickUdpTimer() 가 깨울 때까지 잠든다. udpTimerMtx 는 기다리는 동안만 잡는다
+    // (처리 중에 잡고 있으면 shard 잠금 안에서 kick 하는 스레드와 서로 기다릴 수 있다)
+    void udpTimerLoop(SOCKET udpSock) {
+        while (running.load()) {
+            auto deadline = steady_clock::time_point::max();
+            for (auto& p : snapshotReliablePeers()) deadline = min(deadline, p.second->deadline());
+            {
+                lock_guard<mutex> lg(udpMtx);
+                deadline = min(deadline, udpIdle.nextDeadline());
+            }
+            {
+                lock_guard<mutex> lg(fecMtx);
+                if (fecTx.pending()) deadline = min(deadline, fecTx.openedAt() + UDP_FEC_FLUSH);
+            }
+            {
+                unique_lock<mutex> lk(udpTimerMtx);   // 위에서 deadline 을 잰 뒤 온 kick 은 udpTimerKick 으로 남아 있다
+                if (deadline == steady_clock::time_point::max()) udpTimerCv.wait(lk, [&] { return udpTimerKick || !running.load(); });
+                else udpTimerCv.wait_until(lk, deadline, [&] { return udpTimerKick || !running.load(); });
+                udpTimerKick = false;
+            }
+            if (!running.load()) break;
+            broadcastFec(flushFec(), udpSock);
+            for (auto& p : snapshotReliablePeers()) {
+                p.second->tick(udpOutput(udpSock, p.first));
+                if (p.second->dead()) dropReliablePeer(p.first);
+            }
+            expireUdpClients();
+        }
+    }
+
+    // REGISTER 를 udpIdleTimeoutSec 동안 다시 보내지 않은 등록을 지운다 (클라이언트는 CLIENT_UDP_REFRESH 마다 보낸다)
+    void expireUdpClients() {
+        vector<UDPClient> gone;
+        {
+            lock_guard<mutex> lg(udpMtx);
+            udpIdle.advance(steady_clock::now());
+            while (TimerWheel::Timer* t = udpIdle.pop()) {
+                auto& u = static_cast<UDPClient&>(*t);
+                uint64_t key = endpointKey(u.addr);
+                gone.push_back(u);
+                rudpPeers.erase(key);
+                udpClients.erase(key);
+            }
+            if (!gone.empty()) rebuildUdpTargets();
+        }
+        for (auto& u : gone) {
+            Logger::info("[UDP] registration expired: " + u.name + " @ " + sockaddrToString(u.addr));
+            partUdpRooms(u.addr, u.rooms);
+            nicks.removeUdp(u.name, u.addr);
+            if (mesh) mesh->memberLeft(Federation::Kind::Udp, u.name);
+        }
+    }
+
+    void kickUdpTimer() {
+        { lock_guard<mutex> lg(udpTimerMtx); udpTimerKick = true; }
+        udpTimerCv.notify_one();
+    }
+
+#ifdef __linux__
+    void udpLoopBatched(SOCKET udpSock) {
+        bool gro = opts.udpOffload && enableUdpGro(udpSock);
+        UdpBatchReceiver rx(gro ? UDP_GRO_SLOTS : opts.udpBatch, gro);
+        UdpBatchSender tx, fecSender;   // 대상 스냅샷마다 mmsghdr 배열을 캐시하므로 따로 둔다
+        tx.gso = fecSender.gso = opts.udpOffload && udpGsoSupported(udpSock);
+        vector<string> outs;
+        Poller poller;
+        poller.add(udpSock, Poller::READ);
+        poller.add(stopWaker.fd(), Poller::READ);
+        vector<Poller::Event> evs;
+        while (running.load()) {
+            // 먼저 비우고, 비었을 때만 기다린다: 부하 중에는 recvmmsg 한 번에 batch 하나
+            int n = rx.recv(udpSock, MSG_WAITFORONE | MSG_DONTWAIT);
+            if (n < 0) {
+                int e = errno;
+                if (e == EAGAIN || e == EWOULDBLOCK) poller.wait(evs, -1);
+                else if (e != EINTR) Logger::warn("UDP recvmmsg failed: " + lastWinsockError());
+                continue;
+            }
+            LinePool::local().recycle(outs);
+            for (int i = 0; i < n; ++i) handleUdpDatagram(udpSock, rx.data(i), rx.size(i), rx.from(i), outs);
+            if (outs.empty()) continue;
+            for (auto& out : outs) { Logger::info("UDP msg: ", out); logMessage(out); relay(Federation::Kind::Udp, out); }
+            int fails = tx.sendBatch(udpSock, snapshotUdpTargets(), outs);
+            auto frames = encodeFec(outs);
+            if (!frames.empty()) fails += fecSender.sendBatch(udpSock, snapshotFecTargets(), frames);
+            if (fails) Logger::warn("UDP sendmmsg failed for " + to_string(fails) + " send(s): " + lastWinsockError());
+            broadcastReliable(outs, udpSock);
+        }
+    }
+#endif
+
+    // 같은 주소의 REGISTER 는 이름/방식을 고치고 만료를 뒤로 미룬다 (hash 한 번, timer 다시 걸기 O(1))
+    void registerUdpClient(const string& name, const sockaddr_in& from, UdpMode mode = UdpMode::Plain) {
+        bool added = false;
+        string renamed;   // 같은 주소가 다른 이름으로 REGISTER 했으면 옛 이름
+        {
+            lock_guard<mutex> lg(udpMtx);
+            uint64_t key = endpointKey(from);
+            // 신뢰 채널 재등록(클라이언트 재시도)은 기존 채널을 그대로 둔다
+            if (mode == UdpMode::Reliable && !rudpPeers.count(key)) rudpPeers[key] = { from, make_shared<ReliableChannel>() };
+            if (mode != UdpMode::Reliable) rudpPeers.erase(key);
+            auto [it, fresh] = udpClients.try_emplace(key);
+            UDPClient& u = it->second;
+            if (opts.udpIdleTimeoutSec > 0) udpIdle.arm(u, steady_clock::now() + seconds(opts.udpIdleTimeoutSec));
+            if (!fresh && u.name != name) renamed = u.name;
+            u.name = name;
+            if (!fresh && u.mode == mode && renamed.empty()) return;
+            u.addr = from; u.mode = mode; added = fresh;
+            rebuildUdpTargets();
+        }
+        if (!renamed.empty()) nicks.removeUdp(renamed, from);
+        if (added || !renamed.empty()) nicks.addUdp(name, from);   // udpMtx 밖에서 (sendDirect 가 NickIndex 안에서 udpMtx 를 잡는다)
+        if (added && opts.udpIdleTimeoutSec > 0) kickUdpTimer();   // 잠든 타이머 스레드가 만료 시각을 잡도록
+        if (added && mesh) mesh->memberJoined(Federation::Kind::Udp, name);   // 피어로 보내는 동안 udpMtx 를 잡지 않는다
+    }
+
+    // udpMtx 안에서 호출
+    void rebuildUdpTargets() {
+        auto plain = make_shared<UdpTargets>(), coded = make_shared<UdpTargets>();
+        for (auto& [key, u] : udpClients) {
+            if (u.mode == UdpMode::Plain) plain->push_back(u.addr);
+            else if (u.mode == UdpMode::Fec) coded->push_back(u.addr);
+        }
+        udpTargets = plain;
+        fecTargets = coded;
+    }
+
+    shared_ptr<const UdpTargets> snapshotUdpTargets() {
+        lock_guard<mutex> lg(udpMtx);
+        return udpTargets;
+    }
+
+    shared_ptr<const UdpTargets> snapshotFecTargets() {
+        lock_guard<mutex> lg(udpMtx);
+        return fecTargets;
+    }
+
+    shared_ptr<ReliableChannel> findReliablePeer(const sockaddr_in& from) {
+        lock_guard<mutex> lg(udpMtx);
+        auto it = rudpPeers.find(endpointKey(from));
+        return it == rudpPeers.end() ? nullptr : it->second.second;
+    }
+
+    vector<pair<sockaddr_in, shared_ptr<ReliableChannel>>> snapshotReliablePeers() {
+        lock_guard<mutex> lg(udpMtx);
+        vector<pair<sockaddr_in, shared_ptr<ReliableChannel>>> v;
+        for (auto& kv : rudpPeers) v.push_back(kv.second);
+        return v;
+    }
+
+    void dropReliablePeer(const sockaddr_in& addr) {
+        vector<string> gone, roomNames;
+        {
+            lock_guard<mutex> lg(udpMtx);
+            rudpPeers.erase(endpointKey(addr));
+            auto it = udpClients.find(endpointKey(addr));
+            if (it != udpClients.end()) { gone.push_back(it->second.name); roomNames = move(it->second.rooms); udpClients.erase(it); }
+        }
+        Logger::warn("[UDP] reliable peer timed out: " + sockaddrToString(addr));
+        partUdpRooms(addr, roomNames);
+        for (auto& n : gone) nicks.removeUdp(n, addr);
+        if (mesh) for (auto& n : gone) mesh->memberLeft(Federation::Kind::Udp, n);
+    }
+
+    // 같은 버퍼를 모든 클라이언트와 기록이 공유한다. binary 클라이언트는 spec 을 frame 으로 받는다:
+    // spec 이 없으면 텍스트 줄을 CHAT (sender 0) 으로 감싼다.
+    void broadcastTcp(const HistoryRing::Message& msg, SOCKET exceptSock = INVALID_SOCKET, const wire::Frame* spec = nullptr, Lane lane = Lane::Bulk) {
+        lock_guard<mutex> lg(clientsMtx);
+        history.append(msg);
+        logMessage(*msg);
+        wire::Frame line;
+        if (!spec) { line.type = wire::CHAT; line.payload = msg->data(); line.len = msg->size(); spec = &line; }
+        fanout(&msg, exceptSock, *spec, lane);
+    }
+
+    // clientsMtx 안에서. 텍스트 클라이언트는 text 를 (nullptr 이면 건너뜀), binary 클라이언트는 spec 을 frame 으로 받는다.
+    // frame 은 버전별로 처음 필요할 때 한 번만 만든다. v2 는 seq 를 붙이고 세션 버퍼에도 남긴다 (끊겨 있는 세션 포함).
+    // 보내기는 non-blocking: 소켓이 받지 못한 나머지는 그 클라이언트의 송신 큐로 가고, 느린 한 명이 방송을 막지 않는다.
+    // Control 은 seq 없는 frame 으로 보낸다 (세션 버퍼에는 seq 를 붙여 남긴다): Bulk 를 앞지른 seq 로 클라이언트의 lastSeq 가
+    // 앞서 가면 재접속 때 아직 못 받은 Bulk 를 건너뛴다. 재접속 때 다시 받는 JOIN/LEAVE 는 두 번 받아도 같다.
+    void fanout(const HistoryRing::Message* text, SOCKET exceptSock, const wire::Frame& spec, Lane lane = Lane::Bulk) {
+        uint32_t seq = ++tcpSeq;
+        HistoryRing::Message v1, v2;
+        auto frameFor = [&](uint8_t version) -> const HistoryRing::Message& {
+            if (version < 2) { if (!v1) v1 = pooledFrame(spec); return v1; }
+            if (!v2) { wire::Frame f = spec; f.flags |= wire::FLAG_SEQ; f.seq = seq; v2 = pooledFrame(f); }
+            return v2;
+        };
+        for (auto& cptr : clients) {
+            if (cptr->sock == INVALID_SOCKET || cptr->replaced) continue;
+            if (cptr->sock == exceptSock) continue;
+            const HistoryRing::Message* out = text;
+            if (cptr->binary) {
+                auto& f = frameFor(cptr->version);
+                out = lane == Lane::Control ? &frameFor(1) : &f;
+                if (cptr->session) { cptr->session->send(f, seq, [&] { queueSend(*cptr, *out, lane); }); continue; }
+            }
+            if (out) queueSend(*cptr, *out, lane);
+        }
+        for (auto& sess : detached) sess->record(frameFor(2), seq);
+    }
+
+    // clientsMtx 안에서 호출. 기록을 한 번의 gather send 로 보낸다 (다 못 나간 것은 송신 큐로).
+    void replayHistory(const shared_ptr<TCPClient>& client) {
+        auto msgs = history.recent((size_t)max(0, opts.historyMessages), seconds(opts.historySeconds));
+        if (msgs.empty()) return;
+        msgs.insert(msgs.begin(), make_shared<const string>("[서버] 최근 메시지 " + to_string(msgs.size()) + "개\n"));
+        if (client->binary) {
+            string framed;
+            for (auto& m : msgs) { wire::Frame f; f.type = wire::CHAT; f.flags = wire::FLAG_HISTORY; f.payload = m->data(); f.len = m->size(); appendFrame(framed, f); }
+            msgs.assign(1, make_shared<const string>(move(framed)));
+        }
+        queueSend(*client, msgs.data(), msgs.size());
+    }
+
+    // 같은 포트의 어느 shard 소켓으로 보내도 클라이언트에는 같은 발신 주소로 보인다.
+    void broadcastUdp(const string& msg, SOCKET udpSock) {
+        auto targets = snapshotUdpTargets();
+        int fails = udpFanoutPlain(udpSock, *targets, msg.c_str(), msg.size());
+        if (fails) Logger::warn("UDP sendto failed for " + to_string(fails) + " client(s): " + lastWinsockError());
+    }
+
+    // 방송 메시지를 FEC 블록에 넣고 내보낼 datagram 을 돌려준다. FEC 클라이언트가 없으면 부호화하지 않는다.
+    vector<string> encodeFec(const vector<string>& outs) {
+        vector<string> frames;
+        if (outs.empty() || snapshotFecTargets()->empty()) return frames;
+        bool opened;
+        {
+            lock_guard<mutex> lg(fecMtx);
+            opened = !fecTx.pending();
+            for (auto& m : outs) fecTx.add(m.data(), m.size(), frames);
+            opened = opened && fecTx.pending();
+        }
+        if (opened) kickUdpTimer();   // 새 블록의 flush 시각을 타이머가 알도록
+        return frames;
+    }
+
+    // flush 시각이 지난 덜 찬 블록을 닫는다.
+    vector<string> flushFec() {
+        vector<string> frames;
+        lock_guard<mutex> lg(fecMtx);
+        if (fecTx.pending() && steady_clock::now() >= fecTx.openedAt() + UDP_FEC_FLUSH) fecTx.flush(frames);
+        return frames;
+    }
+
+    void broadcastFec(const vector<string>& frames, SOCKET udpSock) {
+        if (frames.empty()) return;
+        auto targets = snapshotFecTargets();
+        int fails = 0;
+        for (auto& f : frames) fails += udpFanoutPlain(udpSock, *targets, f.data(), f.size());
+        if (fails) Logger::warn("UDP FEC sendto failed for " + to_string(fails) + " send(s): " + lastWinsockError());
+    }
+
+    // 신뢰 채널 클라이언트에게는 각자의 윈도를 거쳐 보낸다.
+    void broadcastReliable(const vector<string>& outs, SOCKET udpSock) {
+        if (outs.empty()) return;
+        auto peers = snapshotReliablePeers();
+        if (peers.empty()) return;
+        for (auto& p : peers) {
+            auto out = udpOutput(udpSock, p.first);
+            for (auto& m : outs) p.second->send(m.data(), m.size(), out);
+        }
+        kickUdpTimer();
+    }
+};
+
+struct ClientOptions {
+    bool reliableUdp = false;   // /udp 를 신뢰 채널로 (서버가 REGISTERED RELIABLE 로 답해야 켜진다)
+    bool fecUdp = false;        // 서버 방송을 FEC 블록으로 받는다 (reliableUdp 가 우선)
+    bool binary = false;        // chat_wire.h 의 binary 프로토콜로 (이 버전 이후의 서버만)
+    bool readStdin = true;      // false 면 입력은 post() 로만 (한 프로세스에 여러 클라이언트를 띄울 때)
+    bool tcpFastOpen = false;   // 닉네임/HELLO (재접속이면 RESUME) 를 SYN 에 싣는다 (Linux TCP_FASTOPEN_CONNECT, 서버 쿠키를 받은 뒤부터)
+    bool tls = false;           // TCP 를 TLS 로 (SSL_read / SSL_write. kTLS 가 켜진 방향은 OpenSSL 이 커널에 넘긴다)
+    string tlsCa;               // 서버 인증서를 검증할 CA (PEM). 비어 있으면 시스템 CA
+    bool tlsInsecure = false;   // 서버 인증서를 검증하지 않는다 (--tls-insecure)
+};
+
+// TCP_FASTOPEN_CONNECT: connect 는 바로 돌아오고 첫 send 가 SYN 에 데이터를 싣는다 (쿠키가 없으면 보통 handshake)
+void enableFastOpenConnect(SOCKET s) {
+#if defined(__linux__) && defined(TCP_FASTOPEN_CONNECT)
+    int one = 1;
+    if (setsockopt(s, IPPROTO_TCP, TCP_FASTOPEN_CONNECT, &one, sizeof(one)) != 0) Logger::warn("TCP_FASTOPEN_CONNECT failed: " + lastWinsockError());
+#else
+    (void)s;
+#endif
+}
+
+constexpr size_t CLIENT_TCP_OUT_MAX = 4 << 20;   // 서버가 못 받아 쌓인 TCP 송신 상한. 넘으면 끊는다
+constexpr size_t CLIENT_UDP_OUT_MAX = 1024;      // 송신 버퍼가 찬 동안 쌓아 둘 datagram 수. 넘으면 버린다
+constexpr milliseconds CLIENT_RESUME_BACKOFF(50);        // 재접속 두 번째 시도까지. 실패할 때마다 두 배 (첫 시도는 바로)
+constexpr milliseconds CLIENT_RESUME_BACKOFF_MAX(2000);
+constexpr milliseconds CLIENT_CONNECT_TIMEOUT(3000);     // 재접속 connect 한 번을 기다리는 시간
+constexpr seconds CLIENT_RESUME_WINDOW(30);              // 이 안에 다시 붙지 못하면 끝낸다 (서버 세션 TTL 기본값)
+constexpr seconds CLIENT_UDP_REFRESH(30);                // UDP REGISTER 를 다시 보내는 간격 (서버 --udp-idle-timeout 기본값의 1/3)
+
+// ---------------- ChatClient ----------------
+// 스레드 하나의 Reactor 위에서 TCP, UDP, 입력이 각자 coroutine 으로 돈다 (tcpLoop, udpLoop, inboxLoop, stdinLoop).
+// 보낼 것은 바로 보내 보고, 소켓이 받지 못한 나머지는 버퍼에 두었다가 writable 이 되면 보낸다.
+class ChatClient {
+public:
+    using MessageHandler = function<void(const string&)>;
+
+    ChatClient(const string& serverIp, const string& port, const string& name, const ClientOptions& o = ClientOptions())
+        : serverIp(serverIp), portStr(port), myName(name), opts(o), tcpSock(INVALID_SOCKET), udpSock(INVALID_SOCKET),
+        running(false), stopFlag(false) {
+    }
+    ~ChatClient() { stop(); }
+
+    void start() {
+        if (running.load()) return;
+        running.store(true);
+        clientThread = thread(&ChatClient::run, this);
+    }
+
+    // /quit, 서버 종료, 오류로 run() 이 끝나도 join 은 여기서 한다
+    void stop() {
+        requestStop();
+        if (clientThread.joinable()) clientThread.join();
+    }
+
+    // 클라이언트가 스스로 끝내려 할 때 (또는 stop() 이) 깨워지는 핸들. main 이 시그널과 함께 기다린다.
+    SOCKET stopHandle() const { return stopWaker.fd(); }
+
+    // 입력 한 줄을 루프에 넘긴다. 아무 스레드에서나 부를 수 있다.
+    void post(const string& line) {
+        { lock_guard<mutex> lg(inboxMtx); inbox.push_back(line); }
+        inboxWaker.wake();
+    }
+
+    // 받은 메시지를 cout 대신 h 로 넘긴다 (루프 스레드에서 불린다). start() 전에 설정할 것.
+    void onMessage(MessageHandler h) { handler = move(h); }
+
+private:
+    string serverIp;
+    string portStr;
+    string myName;
+    ClientOptions opts;
+    SOCKET tcpSock;
+    SOCKET udpSock;
+    thread clientThread;
+    thread inputThread;                      // Windows 콘솔 입력만 (콘솔 핸들은 poll 할 수 없다)
+    atomic<bool> running;
+    atomic<bool> stopFlag;
+    Waker stopWaker;                         // requestStop() 이 깨운다
+    Waker inboxWaker;                        // post() 가 깨운다
+    mutex inboxMtx;
+    vector<string> inbox;
+    MessageHandler handler;
+    sockaddr_in serverUdpAddr{};
+    bool udpGro = false;
+#ifdef __linux__
+    unique_ptr<UdpBatchReceiver> udpRx;
+#endif
+    ReliableChannel rudp;
+    bool rudpReady = false;
+    bool fecReady = false;
+    fec::Decoder fecRx;
+    int registerTries = 0;                   // 신뢰 채널 등록 재시도
+    steady_clock::time_point lastRegister;
+    steady_clock::time_point lastRefresh;    // 마지막으로 REGISTER 를 보낸 때 (재시도든 주기적 갱신이든)
+
+    // 아래는 모두 루프 스레드만 쓴다
+    Reactor reactor;
+    string tcpOut;                           // 아직 못 보낸 TCP 바이트 (앞의 tcpOutOff 바이트는 보냄)
+    size_t tcpOutOff = 0;
+    deque<string> udpOut;                    // 아직 못 보낸 datagram
+    uint64_t udpOutDropped = 0;
+    bool stdinOpen = false, stdinIsFile = false;
+    string stdinBuf;
+    string tcpIn;                            // binary: 아직 덜 온 frame
+    uint32_t myId = 0;                       // binary: WELCOME 으로 받은 ID
+    unordered_map<uint32_t, string> names;   // binary: sender ID -> 닉네임 (JOIN/LEAVE)
+    sockaddr_in serverTcpAddr{};
+    string sessionToken;                     // binary v2: WELCOME 으로 받은 토큰. 있으면 끊겨도 RESUME 으로 다시 붙는다
+    uint32_t lastSeq = 0;                    // binary v2: 받은 방송 frame 의 마지막 seq
+    bool resuming = false;                   // 끊긴 뒤 WELCOME 을 다시 받기 전까지
+    steady_clock::time_point resumeGiveUp;
+    string tcpLost;                          // 비어 있지 않으면 TCP 가 끊긴 까닭: tcpLoop 가 정리하고 다시 붙는다
+    bool tcpLostWarn = false;
+#ifdef NET_HAVE_TLS
+    unique_ptr<net::TlsContext> tlsCtx;      // --tls
+    unique_ptr<net::TlsSession> tls;         // 지금 tcpSock 의 TLS. 다시 붙으면 새로 handshake
+#endif
+
+    void run() {
+        try {
+            WinsockInit w;
+            connectTcp();
+            setupUdpAndBindLocal();
+            registerUdp();
+            Logger::info("Connected to server " + serverIp + ":" + portStr + " as " + myName);
+            eventLoop();
+        }
+        catch (const exception& ex) {
+            Logger::error(string("Client fatal: ") + ex.what());
+        }
+        requestStop();
+#ifdef _WIN32
+        if (inputThread.joinable()) CancelSynchronousIo(inputThread.native_handle());   // 콘솔 getline 을 푼다
+#endif
+        if (inputThread.joinable()) inputThread.join();
+        if (tcpSock != INVALID_SOCKET) { shutdown(tcpSock, SD_BOTH); closesocket(tcpSock); tcpSock = INVALID_SOCKET; }
+        if (udpSock != INVALID_SOCKET) { closesocket(udpSock); udpSock = INVALID_SOCKET; }
+        if (udpOutDropped) Logger::warn("UDP send buffer full: dropped " + to_string(udpOutDropped) + " datagram(s)");
+        running.store(false);
+    }
+
+    void requestStop() {
+        if (!stopFlag.exchange(true)) { stopWaker.wake(); reactor.stop(); }
+    }
+
+    // coroutine 들이 모두 끝날 때까지 (requestStop 뒤) 돈다
+    void eventLoop() {
+        openStdin();
+        reactor.spawn(tcpLoop());
+        reactor.spawn(udpLoop());
+        reactor.spawn(inboxLoop());
+#ifndef _WIN32
+        if (stdinOpen) reactor.spawn(stdinLoop());
+#endif
+        reactor.run();
+    }
+
+    // TCP: 받은 것을 처리하고 쌓인 것을 보낸다. 끊기면 (tcpLost) 세션이 있는 동안 다시 붙어 이어 간다
+    Task<> tcpLoop() {
+        while (!stopFlag.load()) {
+            if (!tcpLost.empty()) {
+                if (!co_await resumeTcp()) break;
+                continue;
+            }
+            int ev = co_await reactor.wait(tcpSock, Poller::READ | (tcpOutOff < tcpOut.size() ? Poller::WRITE : 0));
+            if (stopFlag.load()) break;
+            if (ev & Poller::WRITE) flushTcp();
+            if ((ev & Poller::READ) && tcpLost.empty()) readTcp();
+        }
+    }
+
+    // UDP: 받은 것을 처리하고, 송신 버퍼가 찼던 동안 쌓인 것을 보내고, 신뢰 채널 타이머를 돌린다
+    Task<> udpLoop() {
+        while (!stopFlag.load()) {
+            int ev = co_await reactor.wait(udpSock, Poller::READ | (udpOut.empty() ? 0 : Poller::WRITE), udpDeadline());
+            if (stopFlag.load()) break;
+            if (ev & Poller::WRITE) flushUdp();
+            if (ev & Poller::READ) readUdp();
+            udpTimers();
+        }
+    }
+
+    // post() 로 넘어온 입력
+    Task<> inboxLoop() {
+        while (!stopFlag.load()) {
+            co_await reactor.wait(inboxWaker.fd(), Poller::READ);
+            inboxWaker.drain();
+            vector<string> lines;
+            { lock_guard<mutex> lg(inboxMtx); lines.swap(inbox); }
+            for (auto& l : lines) if (!stopFlag.load()) handleInput(l);
+        }
+    }
+
+#ifndef _WIN32
+    // 터미널/파이프는 readable 을 기다린다. 일반 파일은 epoll 에 넣을 수 없고 늘 readable 이므로 한 바퀴씩 양보하며 읽는다
+    Task<> stdinLoop() {
+        while (stdinOpen && !stopFlag.load()) {
+            if (stdinIsFile) co_await reactor.sleep(steady_clock::now());
+            else co_await reactor.wait(0, Poller::READ);
+            if (stopFlag.load()) break;
+            readStdin();
+        }
+    }
+#endif
+
+    // stdin 을 루프에 붙인다. main 이 getline 으로 앞줄을 읽으며 istream 버퍼에 남긴 것부터 넘겨받는다.
+    void openStdin() {
+        if (!opts.readStdin) return;
+#ifdef _WIN32
+        inputThread = thread([this]() { string line; while (!stopFlag.load() && getline(cin, line)) post(line); });
+#else
+        streamsize n = cin.rdbuf()->in_avail();
+        if (n > 0) { string pre((size_t)n, '\0'); cin.rdbuf()->sgetn(&pre[0], n); stdinBuf = pre; }
+        struct stat st;
+        stdinIsFile = fstat(0, &st) == 0 && S_ISREG(st.st_mode);   // epoll 은 일반 파일을 받지 않는다: 항상 readable 로 취급
+        stdinOpen = true;
+        takeStdinLines();
+#endif
+    }
+
+#ifndef _WIN32
+    // readable 일 때 한 번만 read 하므로 blocking fd 여도 막히지 않는다 (터미널의 O_NONBLOCK 은 건드리지 않는다)
+    void readStdin() {
+        if (!stdinOpen) return;
+        char buf[BUF_SIZE];
+        ssize_t r = read(0, buf, sizeof(buf));
+        if (r > 0) { stdinBuf.append(buf, (size_t)r); takeStdinLines(); return; }
+        if (r < 0 && (errno == EINTR || errno == EAGAIN)) return;
+        stdinOpen = false;   // EOF: 기존처럼 입력만 끝나고 수신은 계속한다
+        if (!stdinIsFile) reactor.forget(0);
+        if (!stdinBuf.empty()) { string last; last.swap(stdinBuf); handleInput(last); }
+    }
+
+    void takeStdinLines() {
+        size_t start = 0;
+        for (size_t nl; !stopFlag.load() && (nl = stdinBuf.find('\n', start)) != string::npos; start = nl + 1) {
+            size_t end = nl > start && stdinBuf[nl - 1] == '\r' ? nl - 1 : nl;
+            handleInput(stdinBuf.substr(start, end - start));
+        }
+        stdinBuf.erase(0, start);
+    }
+#endif
+
+    void connectTcp() {
+        addrinfo hints{}; addrinfo* res = nullptr;
+        hints.ai_family = AF_INET; hints.ai_socktype = SOCK_STREAM;
+        if (getaddrinfo(serverIp.c_str(), portStr.c_str(), &hints, &res) != 0) throw runtime_error("getaddrinfo failed");
+        tcpSock = socket(res->ai_family, res->ai_socktype, res->ai_protocol);
+        if (tcpSock == INVALID_SOCKET) { freeaddrinfo(res); throw runtime_error("socket failed: " + lastWinsockError()); }
+        if (opts.tcpFastOpen) enableFastOpenConnect(tcpSock);   // 연결 실패는 첫 send 에서 드러난다
+        if (connect(tcpSock, res->ai_addr, (int)res->ai_addrlen) == SOCKET_ERROR) { closesocket(tcpSock); tcpSock = INVALID_SOCKET; freeaddrinfo(res); throw runtime_error("connect failed: " + lastWinsockError()); }
+        memcpy(&serverTcpAddr, res->ai_addr, min(sizeof(serverTcpAddr), (size_t)res->ai_addrlen));   // 재접속용
+        freeaddrinfo(res);
+#ifdef NET_HAVE_TLS
+        if (opts.tls) {   // 아직 blocking 소켓: 한 번에 끝난다
+            tlsCtx = make_unique<net::TlsContext>(net::TlsContext::client(opts.tlsCa, !opts.tlsInsecure));
+            tls = make_unique<net::TlsSession>(*tlsCtx, tcpSock, false, serverIp);
+            if (tls->handshake() != net::TlsSession::Done) throw runtime_error("TLS handshake failed: " + tls->error);
+            Logger::info("TLS: " + tls->describe() + (tlsCtx->verifies() ? "" : " (server certificate not verified; --tls-insecure)"));
+        }
+#endif
+        setNonBlocking(tcpSock);
+        setNoDelay(tcpSock);   // 입력한 줄 하나하나가 바로 나가도록 (앞 줄의 ACK 를 기다리지 않는다)
+        if (opts.binary) queueTcp(makeFrame(wire::HELLO, 0, myName.data(), myName.size()));
+        else queueTcp(myName);
+    }
+
+    void setupUdpAndBindLocal() {
+        udpSock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+        if (udpSock == INVALID_SOCKET) throw runtime_error("udp socket failed");
+        setNonBlocking(udpSock);
+        sockaddr_in local{}; local.sin_family = AF_INET; local.sin_addr.s_addr = INADDR_ANY; local.sin_port = htons(0);
+        bind(udpSock, (sockaddr*)&local, sizeof(local));
+#ifdef __linux__
+        udpGro = enableUdpGro(udpSock);
+        // 서버가 GSO 로 묶어 보낸 메시지는 GRO 로 합쳐진 채 도착할 수 있으므로 segment 단위로 받는다.
+        udpRx.reset(new UdpBatchReceiver(udpGro ? UDP_GRO_SLOTS : UDP_BATCH, udpGro));
+#endif
+        serverUdpAddr.sin_family = AF_INET;
+        inet_pton(AF_INET, serverIp.c_str(), &serverUdpAddr.sin_addr);
+        serverUdpAddr.sin_port = htons((unsigned short)stoi(portStr));
+    }
+
+    void registerUdp() {
+        sendRegister();
+        ++registerTries; lastRegister = lastRefresh;
+    }
+
+    // 서버는 한동안 REGISTER 가 없는 등록을 지운다: 같은 것을 CLIENT_UDP_REFRESH 마다 다시 보낸다
+    void sendRegister() {
+        string reg = opts.binary
+            ? makeFrame(wire::REGISTER, 0, myName.data(), myName.size(), opts.reliableUdp ? wire::FLAG_RELIABLE : opts.fecUdp ? wire::FLAG_FEC : 0)
+            : "REGISTER " + myName + (opts.reliableUdp ? RUDP_REGISTER_SUFFIX : opts.fecUdp ? FEC_REGISTER_SUFFIX : "");
+        sendUdp(reg.data(), reg.size());
+        lastRefresh = steady_clock::now();
+    }
+
+    ReliableChannel::Output udpOutput() {
+        return [this](const char* p, size_t n) { sendUdp(p, n); };
+    }
+
+    void deliver(const string& s) {
+        if (handler) handler(s);
+        else cout << s << "\n";
+    }
+
+    void handleUdp(const char* p, size_t n) {
+        if (ReliableChannel::isPacket(p, n)) { rudp.onPacket(p, n, udpOutput(), [this](const char* d, size_t len) { deliver(string(d, len)); }); return; }
+        if (fec::isPacket(p, n)) { fecRx.onPacket(p, n, [this](const char* d, size_t len, bool recovered) { deliver(string(d, len) + (recovered ? " (FEC)" : "")); }); return; }
+        if (wire::isFrame(p, n)) {
+            wire::Frame f; size_t used = 0;
+            if (wire::decode(p, n, f, used) != wire::Status::Ok || f.type != wire::REGISTERED) return;
+            if (f.flags & wire::FLAG_RELIABLE) { if (!rudpReady) Logger::info("Reliable UDP enabled"); rudpReady = true; }
+            if ((f.flags & wire::FLAG_FEC) && !fecReady) { Logger::info("UDP FEC enabled"); fecReady = true; }
+            return;
+        }
+        string s(p, n);
+        if (s == RUDP_REGISTERED) { if (!rudpReady) Logger::info("Reliable UDP enabled"); rudpReady = true; return; }
+        if (s == FEC_REGISTERED) { if (!fecReady) Logger::info("UDP FEC enabled"); fecReady = true; return; }
+        deliver(s);
+    }
+
+    // 재전송 타이머, 등록 갱신, 신뢰 채널 등록 재시도. 응답이 없으면 /udp 는 기존처럼 fire-and-forget 으로 남는다.
+    void udpTimers() {
+        rudp.tick(udpOutput());
+        if (steady_clock::now() - lastRefresh >= CLIENT_UDP_REFRESH) sendRegister();
+        if (!opts.reliableUdp || rudpReady || registerTries > RUDP_REGISTER_TRIES) return;
+        if (steady_clock::now() - lastRegister < milliseconds(300)) return;
+        if (registerTries < RUDP_REGISTER_TRIES) registerUdp();
+        else { ++registerTries; Logger::warn("Server did not confirm reliable UDP; /udp stays fire-and-forget"); }
+    }
+
+    // 다음 udpTimers() 가 할 일이 생기는 시각. 없으면 max (이벤트가 올 때까지 잔다)
+    steady_clock::time_point udpDeadline() {
+        auto next = min(rudp.deadline(), lastRefresh + CLIENT_UDP_REFRESH);
+        if (opts.reliableUdp && !rudpReady && registerTries <= RUDP_REGISTER_TRIES) next = min(next, lastRegister + milliseconds(300));
+        return next;
+    }
+
+    void handleInput(const string& line) {
+        if (line.empty()) return;
+        if (line == "/quit" || line == "/exit") {
+            if (!sessionToken.empty()) queueTcp(makeFrame(wire::BYE, 0, nullptr, 0));   // 서버가 세션을 남기지 않도록 (나가지 못해도 TTL 뒤 퇴장)
+            requestStop();
+            return;
+        }
+        if (line.rfind("/join ", 0) == 0 || line == "/part" || line.rfind("/part ", 0) == 0) {
+            // 방은 TCP 와 UDP 가 따로 든다: 둘 다 같은 방으로
+            sendChat(line);
+            sendUdpText(line);
+        }
+        else if (line.rfind("/udp ", 0) == 0) sendUdpText(line.substr(5));
+        else if (line.rfind("/tcp ", 0) == 0) sendChat(line.substr(5));
+        else sendChat(line);
+    }
+
+    void sendUdpText(const string& msg) {
+        if (rudpReady) { rudp.send(msg.data(), msg.size(), udpOutput()); reactor.notify(udpSock); }   // udpLoop 가 재전송 timer 를 다시 잡도록
+        else if (opts.binary) { string f = makeFrame(wire::CHAT, 0, msg.data(), msg.size()); sendUdp(f.data(), f.size()); }
+        else sendUdp(msg.data(), msg.size());
+    }
+
+    void sendChat(const string& text) {
+        if (opts.binary) queueTcp(makeFrame(wire::CHAT, 0, text.data(), text.size()));
+        else queueTcp(text);
+    }
+
+    // binary 프로토콜로 받은 frame 들. 이름은 JOIN 으로 받은 표에서 찾는다.
+    void readFrames() {
+        size_t off = 0, used = 0;
+        wire::Frame f;
+        wire::Status st;
+        while ((st = wire::decode(tcpIn.data() + off, tcpIn.size() - off, f, used)) == wire::Status::Ok) {
+            off += used;
+            if (f.flags & wire::FLAG_SEQ) lastSeq = f.seq;   // 크기가 아니라 마지막으로 받은 것 (서버는 그 자리부터 이어 보낸다)
+            string text(f.payload, f.len);
+            switch (f.type) {
+            case wire::WELCOME: onWelcome(f, text); break;
+            case wire::JOIN: names[f.sender] = text; break;
+            case wire::LEAVE: {
+                auto it = names.find(f.sender);
+                if (it != names.end()) { deliver("[서버] " + it->second + " 퇴장"); names.erase(it); }
+                break;
+            }
+            case wire::PING: queueTcp(makeFrame(wire::PONG, 0, nullptr, 0)); break;
+            case wire::CHAT:
+                if (f.sender == 0) { while (!text.empty() && text.back() == '\n') text.pop_back(); deliver(text); }
+                else { auto it = names.find(f.sender); deliver("[" + (it != names.end() ? it->second : "#" + to_string(f.sender)) + "] " + text); }
+                break;
+            default: break;   // 모르는 type 은 건너뛴다 (뒤 버전과의 호환)
+            }
+        }
+        tcpIn.erase(0, off);
+        if (st == wire::Status::Bad) { Logger::warn("Bad frame from server"); requestStop(); }
+    }
+
+    void onWelcome(const wire::Frame& f, const string& token) {
+        myId = f.sender;
+        if (f.flags & wire::FLAG_RESUMED) Logger::info("Session resumed, id " + to_string(myId));
+        else if (resuming) { names.clear(); Logger::warn("Session could not be resumed; joined again as id " + to_string(myId)); }   // 뒤따르는 JOIN 으로 다시 채운다
+        else Logger::info("Binary protocol v" + to_string(f.version) + ", id " + to_string(myId));
+        sessionToken = token;
+        resuming = false;
+    }
+
+    void readTcp() {
+        if (tcpSock == INVALID_SOCKET) return;   // 같은 이벤트의 WRITE 처리에서 끊겼다
+        char buf[BUF_SIZE];
+#ifdef NET_HAVE_TLS
+        if (tls) {
+            // SSL_read 는 record 를 통째로 풀어 두므로 소켓이 readable 이 아니어도 평문이 남아 있을 수 있다: AGAIN 까지 읽는다
+            int r;
+            while ((r = tls->read(buf, BUF_SIZE)) > 0 && tcpLost.empty() && !stopFlag.load()) receivedTcp(buf, (size_t)r);
+            if (r == 0) lostTcp("Server closed TCP", false);
+            else if (r == -1) lostTcp("TLS recv failed: " + tls->error, true);
+            return;
+        }
+#endif
+        int r = recv(tcpSock, buf, BUF_SIZE, 0);
+        if (r > 0) receivedTcp(buf, (size_t)r);
+        else if (r == 0) lostTcp("Server closed TCP", false);
+        else { int e = WSAGetLastError(); if (e == WSAEWOULDBLOCK || e == WSAEINTR) return; lostTcp("TCP recv failed: " + lastWinsockError(), true); }
+    }
+
+    void receivedTcp(const char* p, size_t n) {
+        if (opts.binary) { tcpIn.append(p, n); readFrames(); }
+        else deliver(string(p, n));
+    }
+
+    // TCP 가 끊겼다. 정리와 재접속은 tcpLoop 가 한다 (다른 coroutine 에서 알게 됐으면 깨운다)
+    void lostTcp(const string& why, bool warn) {
+        if (!tcpLost.empty()) return;
+        tcpLost = why; tcpLostWarn = warn;
+        if (tcpSock != INVALID_SOCKET) reactor.notify(tcpSock);
+    }
+
+    // 세션이 있으면 RESUME 으로 다시 붙는다: 첫 시도는 바로, 그 뒤로는 두 배씩 물러나며 CLIENT_RESUME_WINDOW 안에서.
+    // 세션이 없으면 예전처럼 끝낸다 (false).
+    Task<bool> resumeTcp() {
+        string why;
+        why.swap(tcpLost);
+        closeTcp();
+        if (sessionToken.empty() || stopFlag.load()) {
+            if (tcpLostWarn) Logger::warn(why); else Logger::info(why);
+            requestStop();
+            co_return false;
+        }
+        if (!resuming) { resuming = true; resumeGiveUp = steady_clock::now() + CLIENT_RESUME_WINDOW; Logger::warn(why + "; resuming session"); }
+        for (int tries = 0; !stopFlag.load(); ++tries) {
+            if (tries > 0) co_await reactor.sleep(steady_clock::now() + min(CLIENT_RESUME_BACKOFF_MAX, CLIENT_RESUME_BACKOFF * (1 << min(tries - 1, 6))));
+            if (stopFlag.load()) break;
+            if (steady_clock::now() >= resumeGiveUp) { Logger::warn("Could not resume session: " + why); requestStop(); break; }
+            if (co_await reconnectTcp(why)) { sendResume(); co_return true; }
+        }
+        co_return false;
+    }
+
+    // 다시 붙을 때 보낼 것만 남긴다: 다 나간 frame 은 서버가 받았다고 보고, 덜 나간 frame 부터. 옛 RESUME 은 버린다.
+    void closeTcp() {
+        if (tcpSock == INVALID_SOCKET) return;
+        reactor.forget(tcpSock);
+        closesocket(tcpSock);
+        tcpSock = INVALID_SOCKET;
+#ifdef NET_HAVE_TLS
+        tls.reset();
+#endif
+        tcpIn.clear();
+        string keep;
+        size_t off = 0, used = 0;
+        wire::Frame f;
+        while (wire::decode(tcpOut.data() + off, tcpOut.size() - off, f, used) == wire::Status::Ok) {
+            if (off + used > tcpOutOff && f.type != wire::RESUME) keep.append(tcpOut, off, used);
+            off += used;
+        }
+        tcpOut.swap(keep); tcpOutOff = 0;
+    }
+
+    // 재접속 connect 하나 (non-blocking, CLIENT_CONNECT_TIMEOUT 까지). 붙으면 tcpSock, 못 붙으면 why 에 까닭
+    Task<bool> reconnectTcp(string& why) {
+        SOCKET s = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+        if (s == INVALID_SOCKET) { why = "socket failed: " + lastWinsockError(); co_return false; }
+        setNonBlocking(s);
+        if (opts.tcpFastOpen) enableFastOpenConnect(s);
+        if (connect(s, (const sockaddr*)&serverTcpAddr, sizeof(serverTcpAddr)) == SOCKET_ERROR) {   // Fast Open 이면 바로 성공한다
+            int e = WSAGetLastError();
+            if (e != WSAEWOULDBLOCK && e != EINPROGRESS) { why = "reconnect failed: " + lastWinsockError(); closesocket(s); co_return false; }
+            auto deadline = steady_clock::now() + CLIENT_CONNECT_TIMEOUT;
+            int ev = 0;
+            while (!ev && !stopFlag.load() && steady_clock::now() < deadline) ev = co_await reactor.wait(s, Poller::WRITE, deadline);
+            int err = 0; socklen_t len = sizeof(err);
+            if (!ev || getsockopt(s, SOL_SOCKET, SO_ERROR, (char*)&err, &len) != 0 || err != 0) {
+                why = ev ? "reconnect failed (error " + to_string(err) + ")" : "reconnect timed out";
+                reactor.forget(s);
+                closesocket(s);
+                co_return false;
+            }
+        }
+#ifdef NET_HAVE_TLS
+        if (opts.tls && !co_await tlsReconnect(s, why)) { tls.reset(); reactor.forget(s); closesocket(s); co_return false; }
+#endif
+        tcpSock = s;
+        co_return true;
+    }
+
+#ifdef NET_HAVE_TLS
+    // 다시 붙은 소켓 (non-blocking) 의 TLS handshake, CLIENT_CONNECT_TIMEOUT 까지
+    Task<bool> tlsReconnect(SOCKET s, string& why) {
+        tls = make_unique<net::TlsSession>(*tlsCtx, s, false, serverIp);
+        auto deadline = steady_clock::now() + CLIENT_CONNECT_TIMEOUT;
+        for (;;) {
+            net::TlsSession::Step step = tls->handshake();
+            if (step == net::TlsSession::Done) co_return true;
+            if (step == net::TlsSession::Failed) { why = "TLS handshake failed: " + tls->error; co_return false; }
+            if (stopFlag.load() || steady_clock::now() >= deadline) { why = "TLS handshake timed out"; co_return false; }
+            co_await reactor.wait(s, step == net::TlsSession::WantRead ? Poller::READ : Poller::WRITE, deadline);
+        }
+    }
+#endif
+
+    // 쌓인 것보다 RESUME 을 먼저 보낸다
+    void sendResume() {
+        string payload = sessionToken + myName;
+        wire::Frame f;
+        f.type = wire::RESUME; f.flags = wire::FLAG_SEQ; f.seq = lastSeq; f.payload = payload.data(); f.len = payload.size();
+        tcpOut.insert(0, makeFrame(f));
+        flushTcp();
+    }
+
+    void readUdp() {
+#ifdef __linux__
+        int n = udpRx->recv(udpSock, MSG_DONTWAIT);
+        for (int i = 0; i < n; ++i) handleUdp(udpRx->data(i), udpRx->size(i));
+        if (n >= 0) return;
+#else
+        char buf[BUF_SIZE];
+        sockaddr_in from{}; socklen_t fromlen = sizeof(from);
+        int r = recvfrom(udpSock, buf, BUF_SIZE - 1, 0, (sockaddr*)&from, &fromlen);
+        if (r >= 0) { handleUdp(buf, (size_t)r); return; }
+#endif
+        int e = WSAGetLastError();
+        if (e == WSAEWOULDBLOCK || e == WSAEINTR || e == WSAECONNRESET) return;
+        Logger::warn("UDP recv failed: " + lastWinsockError());
+        requestStop();
+    }
+
+    // 앞서 쌓인 것이 없으면 바로 보내 본다. 남은 것은 tcpSock 이 writable 일 때 flushTcp() 가 보낸다.
+    void queueTcp(const string& msg) {
+        if (tcpOut.size() - tcpOutOff + msg.size() > CLIENT_TCP_OUT_MAX) { Logger::warn("Server is not reading; TCP send buffer full"); requestStop(); return; }
+        bool idle = tcpOutOff == tcpOut.size();
+        tcpOut += msg;
+        if (!idle) return;
+        flushTcp();
+        if (tcpOutOff < tcpOut.size() && tcpSock != INVALID_SOCKET) reactor.notify(tcpSock);   // tcpLoop 가 WRITE 도 기다리도록
+    }
+
+    void flushTcp() {
+        if (tcpSock == INVALID_SOCKET || !tcpLost.empty()) return;   // 재접속 중: 붙으면 보낸다
+        while (tcpOutOff < tcpOut.size()) {
+            int len = (int)min<size_t>(tcpOut.size() - tcpOutOff, 1 << 20);
+#ifdef NET_HAVE_TLS
+            if (tls) {   // 다시 부를 때 버퍼가 옮겨지거나 길어져도 된다 (SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER, 뒤에만 붙는다)
+                int r = tls->write(tcpOut.data() + tcpOutOff, len);
+                if (r > 0) { tcpOutOff += (size_t)r; continue; }
+                if (r != net::TlsSession::AGAIN) { lostTcp("TLS send failed: " + tls->error, true); return; }
+                break;
+            }
+#endif
+            int r = send(tcpSock, tcpOut.data() + tcpOutOff, len, 0);
+            if (r > 0) { tcpOutOff += (size_t)r; continue; }
+            int e = WSAGetLastError();
+            if (e == WSAEINTR) continue;
+            if (e != WSAEWOULDBLOCK && e != EINPROGRESS) { lostTcp("TCP send failed: " + lastWinsockError(), true); return; }   // EINPROGRESS: Fast Open 쿠키 없이 SYN 만 나갔다
+            break;
+        }
+        if (tcpOutOff == tcpOut.size()) { tcpOut.clear(); tcpOutOff = 0; }
+        else if (tcpOutOff > (1 << 16) && tcpOutOff * 2 > tcpOut.size()) {
+            // binary 는 frame 경계까지만 지운다: 끊기면 closeTcp() 가 덜 나간 frame 부터 다시 보낸다
+            size_t cut = tcpOutOff;
+            if (opts.binary) {
+                size_t off = 0, used = 0; wire::Frame f;
+                while (wire::decode(tcpOut.data() + off, tcpOut.size() - off, f, used) == wire::Status::Ok && off + used <= tcpOutOff) off += used;
+                cut = off;
+            }
+            tcpOut.erase(0, cut); tcpOutOff -= cut;
+        }
+    }
+
+    // 순서를 지키기 위해 쌓인 것이 있으면 뒤에 붙인다. 송신 버퍼가 찬 동안 CLIENT_UDP_OUT_MAX 를 넘는 것은 버린다 (UDP).
+    void sendUdp(const char* p, size_t n) {
+        if (udpOut.empty()) {
+            if (sendto(udpSock, p, (int)n, 0, (const sockaddr*)&serverUdpAddr, sizeof(serverUdpAddr)) >= 0) return;
+            int e = WSAGetLastError();
+            if (e != WSAEWOULDBLOCK && e != WSAENOBUFS) { Logger::warn("UDP send failed: " + lastWinsockError()); return; }
+            reactor.notify(udpSock);   // udpLoop 가 WRITE 도 기다리도록
+        }
+        if (udpOut.size() >= CLIENT_UDP_OUT_MAX) { ++udpOutDropped; return; }
+        udpOut.emplace_back(p, n);
+    }
+
+    void flushUdp() {
+        while (!udpOut.empty()) {
+            const string& d = udpOut.front();
+            if (sendto(udpSock, d.data(), (int)d.size(), 0, (const sockaddr*)&serverUdpAddr, sizeof(serverUdpAddr)) < 0) {
+                int e = WSAGetLastError();
+                if (e == WSAEWOULDBLOCK || e == WSAENOBUFS) break;
+                Logger::warn("UDP send failed: " + lastWinsockError());
+            }
+            udpOut.pop_front();
+        }
+    }
+};
+
+// ---------------- Benchmark ----------------
+// 루프백에서 UDP 경로의 packets/s 를 측정한다. 절대값은 장비마다 다르므로 같은 장비에서 before/after 를 비교할 것.
+SOCKET benchUdpSocket(sockaddr_in& bound) {
+    SOCKET s = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (s == INVALID_SOCKET) throw runtime_error("bench socket() failed: " + lastWinsockError());
+    int rcv = 4 << 20; setsockopt(s, SOL_SOCKET, SO_RCVBUF, (const char*)&rcv, sizeof(rcv));
+    sockaddr_in a{}; a.sin_family = AF_INET; inet_pton(AF_INET, "127.0.0.1", &a.sin_addr); a.sin_port = 0;
+    if (bind(s, (sockaddr*)&a, sizeof(a)) == SOCKET_ERROR) { closesocket(s); throw runtime_error("bench bind() failed: " + lastWinsockError()); }
+    socklen_t len = sizeof(bound); getsockname(s, (sockaddr*)&bound, &len);
+    return s;
+}
+
+void reportRate(const string& label, uint64_t packets, double secs) {
+    ostringstream oss;
+    oss << "[bench] " << label << ": " << fixed << setprecision(0) << (secs > 0 ? packets / secs : 0.0) << " pkts/s ("
+        << packets << " pkts, " << setprecision(3) << secs << " s)";
+    Logger::info(oss.str());
+}
+
+// 송신: 64B 메시지 하나를 sink 소켓 N개에 fan-out 하는 것을 rounds 번 반복.
+// sink 는 읽지 않으므로 수신 큐가 차면 커널에서 버려지지만, 측정 대상인 송신 syscall 비용은 그대로다.
+void benchUdpFanout(int sinks, int rounds) {
+    sockaddr_in txAddr{};
+    SOCKET tx = benchUdpSocket(txAddr);
+    vector<SOCKET> sinkSocks;
+    auto targets = make_shared<UdpTargets>();
+    for (int i = 0; i < sinks; ++i) { sockaddr_in a{}; sinkSocks.push_back(benchUdpSocket(a)); targets->push_back(a); }
+    string msg(64, 'x');
+    uint64_t pkts = (uint64_t)sinks * rounds;
+
+    auto t0 = steady_clock::now();
+    for (int r = 0; r < rounds; ++r) udpFanoutPlain(tx, *targets, msg.data(), msg.size());
+    reportRate("fan-out x" + to_string(sinks) + " sendto  ", pkts, duration<double>(steady_clock::now() - t0).count());
+#ifdef __linux__
+    UdpBatchSender sender;
+    t0 = steady_clock::now();
+    for (int r = 0; r < rounds; ++r) sender.send(tx, targets, msg.data(), msg.size());
+    reportRate("fan-out x" + to_string(sinks) + " sendmmsg", pkts, duration<double>(steady_clock::now() - t0).count());
+#endif
+    for (SOCKET s : sinkSocks) closesocket(s);
+    closesocket(tx);
+}
+
+// 수신: sink 하나에 burst 개를 쌓아 두고, 비우는 데 걸린 시간만 잰다.
+void benchUdpReceive(int burst, int rounds) {
+    sockaddr_in rxAddr{}, txAddr{};
+    SOCKET rx = benchUdpSocket(rxAddr), tx = benchUdpSocket(txAddr);
+    setNonBlocking(rx);
+    string msg(64, 'x');
+    auto fill = [&]() { for (int i = 0; i < burst; ++i) sendto(tx, msg.data(), (int)msg.size(), 0, (sockaddr*)&rxAddr, sizeof(rxAddr)); };
+
+    uint64_t pkts = 0; double secs = 0;
+    char buf[BUF_SIZE];
+    for (int r = 0; r < rounds; ++r) {
+        fill();
+        auto t0 = steady_clock::now();
+        for (;;) { sockaddr_in from{}; socklen_t fl = sizeof(from); if (recvfrom(rx, buf, BUF_SIZE - 1, 0, (sockaddr*)&from, &fl) < 0) break; ++pkts; }
+        secs += duration<double>(steady_clock::now() - t0).count();
+    }
+    reportRate("receive recvfrom ", pkts, secs);
+#ifdef __linux__
+    UdpBatchReceiver batch(UDP_BATCH);
+    pkts = 0; secs = 0;
+    for (int r = 0; r < rounds; ++r) {
+        fill();
+        auto t0 = steady_clock::now();
+        for (;;) { int n = batch.recv(rx, MSG_DONTWAIT); if (n <= 0) break; pkts += (uint64_t)n; }
+        secs += duration<double>(steady_clock::now() - t0).count();
+    }
+    reportRate("receive recvmmsg ", pkts, secs);
+#endif
+    closesocket(rx); closesocket(tx);
+}
+
+#ifdef __linux__
+// SO_REUSEPORT shard 수별 수신 처리량. shard 수만큼의 송신 스레드가 각자 소스 포트 16개를 돌려 가며
+// 1초간 보내고, 코어에 고정된 shard 수신 스레드들이 받은 datagram 수를 센다.
+void benchUdpShards(int shards) {
+    vector<SOCKET> socks;
+    socks.push_back(openUdpSocket(0, true));
+    sockaddr_in dst{}; socklen_t len = sizeof(dst); getsockname(socks[0], (sockaddr*)&dst, &len);
+    inet_pton(AF_INET, "127.0.0.1", &dst.sin_addr);
+    for (int i = 1; i < shards; ++i) socks.push_back(openUdpSocket(ntohs(dst.sin_port), true));
+    for (SOCKET s : socks) { timeval tv{ 0, 100000 }; setsockopt(s, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv)); }
+
+    atomic<bool> stopFlag(false);
+    atomic<uint64_t> received(0);
+    vector<thread> threads;
+    for (int i = 0; i < shards; ++i) threads.emplace_back([&, i]() {
+        pinCurrentThread(i);
+        UdpBatchReceiver rx(UDP_BATCH);
+        uint64_t n = 0;
+        while (!stopFlag.load()) { int r = rx.recv(socks[i]); if (r > 0) n += (uint64_t)r; }
+        received += n;
+    });
+    for (int i = 0; i < shards; ++i) threads.emplace_back([&]() {
+        vector<SOCKET> srcs;
+        for (int k = 0; k < 16; ++k) { sockaddr_in a{}; srcs.push_back(benchUdpSocket(a)); }
+        string msg(64, 'x');
+        for (size_t k = 0; !stopFlag.load(); ++k) sendto(srcs[k % srcs.size()], msg.data(), (int)msg.size(), 0, (sockaddr*)&dst, sizeof(dst));
+        for (SOCKET s : srcs) closesocket(s);
+    });
+
+    auto t0 = steady_clock::now();
+    this_thread::sleep_for(seconds(1));
+    stopFlag.store(true);
+    for (auto& t : threads) t.join();
+    reportRate("reuseport x" + to_string(shards) + " receive", received.load(), duration<double>(steady_clock::now() - t0).count());
+    for (SOCKET s : socks) closesocket(s);
+}
+
+double processCpuSeconds() {
+    rusage ru{};
+    getrusage(RUSAGE_SELF, &ru);
+    return ru.ru_utime.tv_sec + ru.ru_stime.tv_sec + (ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) / 1e6;
+}
+
+// 루프백 GSO/GRO: 1초 동안 1200B datagram 을 UDP_GSO_MAX_SEGS 개씩 보내고,
+// 프로세스 CPU 시간(user+sys, 송신+수신 합계)을 받은 packet 수로 나눠 백만 packet 당 CPU 초로 보고한다.
+void benchUdpOffload(bool offload) {
+    sockaddr_in rxAddr{}, txAddr{};
+    SOCKET rx = benchUdpSocket(rxAddr), tx = benchUdpSocket(txAddr);
+    timeval tv{ 0, 100000 }; setsockopt(rx, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    bool gro = offload && enableUdpGro(rx);
+    UdpBatchSender sender;
+    sender.gso = offload && udpGsoSupported(tx);
+    auto targets = make_shared<UdpTargets>(1, rxAddr);
+    vector<string> outs(UDP_GSO_MAX_SEGS, string(1200, 'x'));
+
+    atomic<bool> stopFlag(false);
+    uint64_t received = 0;
+    thread receiver([&]() {
+        UdpBatchReceiver r(gro ? UDP_GRO_SLOTS : UDP_BATCH, gro);
+        while (!stopFlag.load()) { int n = r.recv(rx); if (n > 0) received += (uint64_t)n; }
+    });
+    double cpu0 = processCpuSeconds();
+    auto t0 = steady_clock::now();
+    while (steady_clock::now() - t0 < seconds(1)) sender.sendBatch(tx, targets, outs);
+    stopFlag.store(true);
+    receiver.join();
+    double cpu = processCpuSeconds() - cpu0, secs = duration<double>(steady_clock::now() - t0).count();
+
+    string label = offload ? string("offload GSO ") + (sender.gso ? "on" : "off") + "/GRO " + (gro ? "on" : "off") : "offload disabled    ";
+    reportRate(label, received, secs);
+    ostringstream oss;
+    oss << "[bench] " << label << ": " << fixed << setprecision(3) << (received ? cpu / (received / 1e6) : 0.0) << " CPU s per 1M pkts";
+    Logger::info(oss.str());
+    closesocket(rx); closesocket(tx);
+}
+
+#endif
+
+double percentile(vector<double> v, double p) {
+    if (v.empty()) return 0;
+    size_t k = min(v.size() - 1, (size_t)(p / 100.0 * v.size()));
+    nth_element(v.begin(), v.begin() + k, v.end());
+    return v[k];
+}
+
+// 신뢰 UDP 손실 주입 하네스. 루프백 소켓 두 개 사이의 ReliableChannel 한 쌍, 양방향(DATA, ACK) 송신을 loss 확률로 버린다.
+// 메시지 앞 16B 는 순번, send() 시각 (ns)
+struct LossyReliableLink {
+    static constexpr size_t MSG = 200;
+    sockaddr_in aAddr{}, bAddr{};
+    SOCKET a, b;
+    mt19937 rng;
+    uniform_real_distribution<double> coin{0, 1};
+    double loss;
+    uint64_t dropped = 0;
+    ReliableChannel tx, rx;
+    ReliableChannel::Output toB, toA;
+
+    LossyReliableLink(double loss, unsigned seed) : a(benchUdpSocket(aAddr)), b(benchUdpSocket(bAddr)), rng(seed), loss(loss) {
+        setNonBlocking(a); setNonBlocking(b);
+        toB = lossy(a, bAddr); toA = lossy(b, aAddr);
+    }
+    ~LossyReliableLink() { closesocket(a); closesocket(b); }
+
+    ReliableChannel::Output lossy(SOCKET from, sockaddr_in to) {
+        return [this, from, to](const char* p, size_t n) { if (coin(rng) < loss) { ++dropped; return; } sendto(from, p, (int)n, 0, (const sockaddr*)&to, sizeof(to)); };
+    }
+    void send(uint64_t idx) {
+        string m(MSG, 'x');
+        int64_t ns = duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+        memcpy(&m[0], &idx, 8); memcpy(&m[8], &ns, 8);
+        tx.send(m.data(), m.size(), toB);
+    }
+    void pump(int timeoutMs, const ReliableChannel::Deliver& deliver) {
+        pollfd fds[2] = { { a, POLLIN, 0 }, { b, POLLIN, 0 } };
+        poll(fds, 2, timeoutMs);
+        char buf[BUF_SIZE];
+        for (int r; (r = recv(b, buf, BUF_SIZE, 0)) > 0;) rx.onPacket(buf, (size_t)r, toA, deliver);
+        for (int r; (r = recv(a, buf, BUF_SIZE, 0)) > 0;) tx.onPacket(buf, (size_t)r, toB, [](const char*, size_t) {});
+        tx.tick(toB); rx.tick(toA);
+    }
+};
+
+// 손실률 하나에 대해
+//   bulk : 미전송 메시지를 항상 BACKLOG 개 쌓아 두고, 200ms 워밍업 (cwnd, srtt 가 자리잡을 때까지) 뒤 1초 동안 순서대로 도착한 바이트.
+//          링크를 새로 만들어 RUNS 번 (손실 패턴도 매번 다르다) 재고 중앙값을 낸다
+//   paced: 1ms 간격 메시지 1000개의 send() -> deliver 지연 p50/p99
+void benchReliableUdp(double loss) {
+    const int RUNS = 3;
+    const size_t BACKLOG = 1024, PACED = 1000;
+    const milliseconds WARMUP(200), WINDOW(1000);
+
+    vector<double> goodput;
+    uint64_t retx = 0, rto = 0, dropped = 0, outOfOrder = 0;
+    for (int run = 0; run < RUNS; ++run) {
+        LossyReliableLink link(loss, 42 + run);
+        uint64_t sent = 0, delivered = 0, bytes = 0;
+        auto t0 = steady_clock::now(), start = t0 + WARMUP, end = start + WINDOW;
+        auto deliver = [&](const char* p, size_t n) {
+            uint64_t idx; memcpy(&idx, p, 8);
+            if (idx != delivered) ++outOfOrder;
+            ++delivered;
+            if (steady_clock::now() >= start) bytes += n;
+        };
+        while (steady_clock::now() < end) {
+            while (sent - delivered < BACKLOG) link.send(sent++);
+            link.pump(1, deliver);
+        }
+        goodput.push_back(bytes / duration<double>(WINDOW).count() / 1e6);
+        auto st = link.tx.stats();
+        retx += st.retransmits; rto += st.timeouts; dropped += link.dropped;
+    }
+    sort(goodput.begin(), goodput.end());
+
+    LossyReliableLink link(loss, 42);
+    size_t delivered = 0;
+    vector<double> latUs;
+    auto deliver = [&](const char* p, size_t) {
+        uint64_t idx; int64_t sentNs; memcpy(&idx, p, 8); memcpy(&sentNs, p + 8, 8);
+        if (idx != delivered) ++outOfOrder;
+        ++delivered;
+        latUs.push_back((duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count() - sentNs) / 1e3);
+    };
+    auto next = steady_clock::now(), t1 = next;
+    for (size_t sent = 0; (sent < PACED || delivered < PACED) && steady_clock::now() - t1 < seconds(30);) {
+        if (sent < PACED && steady_clock::now() >= next) { link.send(sent++); next += milliseconds(1); }
+        link.pump(1, deliver);
+    }
+
+    ostringstream oss;
+    oss << "[bench] reliable udp loss " << fixed << setprecision(0) << loss * 100 << "%: goodput " << setprecision(1) << goodput[RUNS / 2]
+        << " MB/s (median of " << RUNS << " x 1s, " << goodput.front() << ".." << goodput.back() << ")"
+        << ", latency p50 " << setprecision(0) << percentile(latUs, 50) << " us p99 " << percentile(latUs, 99) << " us"
+        << ", bulk retx " << retx << " rto " << rto << " dropped " << dropped
+        << ", reordered " << outOfOrder << ", paced delivered " << delivered << "/" << PACED;
+    Logger::info(oss.str());
+}
+
+// FEC 부호화/복호 처리량 (data 바이트 기준 MB/s). 복호는 data shard m개를 잃은 최악의 경우.
+void benchFecCodec(int k, int m, size_t shard) {
+    mt19937 rng(7);
+    vector<vector<uint8_t>> data(k, vector<uint8_t>(shard)), parity(m, vector<uint8_t>(shard)), work(k, vector<uint8_t>(shard));
+    for (auto& d : data) for (auto& b : d) b = (uint8_t)rng();
+    vector<const uint8_t*> in(k), par(m);
+    vector<uint8_t*> out(m), rec(k);
+    for (int j = 0; j < k; ++j) { in[j] = data[j].data(); rec[j] = work[j].data(); }
+    for (int r = 0; r < m; ++r) { out[r] = parity[r].data(); par[r] = parity[r].data(); }
+    bool have[fec::MAX_SHARDS], haveParity[fec::MAX_SHARDS];
+    for (int j = 0; j < k; ++j) have[j] = j >= m;
+    for (int r = 0; r < m; ++r) haveParity[r] = true;
+
+    auto rate = [&](const function<void()>& f) {
+        uint64_t blocks = 0;
+        auto t0 = steady_clock::now();
+        while (steady_clock::now() - t0 < milliseconds(300)) { for (int i = 0; i < 16; ++i) f(); blocks += 16; }
+        return blocks * k * shard / duration<double>(steady_clock::now() - t0).count() / 1e6;
+    };
+    fec::Simd best = fec::detectSimd();
+    for (fec::Simd simd : { fec::Simd::Scalar, best }) {
+        fec::activeSimd() = simd;
+        double enc = rate([&] { fec::encode(in.data(), k, out.data(), m, shard); });
+        for (int j = m; j < k; ++j) work[j] = data[j];
+        bool ok = true;
+        double dec = rate([&] { ok &= fec::reconstruct(rec.data(), have, k, par.data(), haveParity, m, shard); });
+        ok = ok && work == data;
+        ostringstream oss;
+        oss << "[bench] fec " << k << "+" << m << " x " << shard << "B " << fec::simdName(simd) << ": encode " << fixed << setprecision(0) << enc
+            << " MB/s, decode (" << m << " lost) " << dec << " MB/s" << (ok ? "" : " MISMATCH");
+        Logger::info(oss.str());
+        if (best == fec::Simd::Scalar) break;
+    }
+    fec::activeSimd() = best;
+}
+
+// 방송 손실률별 FEC 효과. 200B 메시지 20000개를 Encoder -> 무작위 손실 -> Decoder 로 흘려 남는 손실을 센다.
+void benchFecLoss(int k, int m, double loss) {
+    mt19937 rng(42);
+    uniform_real_distribution<double> coin(0, 1);
+    fec::Encoder enc(k, m);
+    fec::Decoder dec;
+    const int N = 20000;
+    string msg(200, 'x');
+    vector<string> frames;
+    uint64_t dataDropped = 0, delivered = 0, recovered = 0;
+    for (int i = 0; i < N; ++i) {
+        frames.clear();
+        enc.add(msg.data(), msg.size(), frames);
+        if (i == N - 1) enc.flush(frames);
+        for (auto& f : frames) {
+            if (coin(rng) < loss) { if ((uint8_t)f[3] < (uint8_t)f[1]) ++dataDropped; continue; }
+            dec.onPacket(f.data(), f.size(), [&](const char*, size_t, bool r) { ++delivered; recovered += r; });
+        }
+    }
+    ostringstream oss;
+    oss << "[bench] fec " << k << "+" << m << " loss " << fixed << setprecision(0) << loss * 100 << "%: lost without fec "
+        << setprecision(2) << dataDropped * 100.0 / N << "%, with fec " << (N - delivered) * 100.0 / N << "% (recovered " << recovered << ")";
+    Logger::info(oss.str());
+}
+
+#ifndef _WIN32
+// 메시지 로그 append 처리량과 호출 지연. 임시 디렉터리에 100B 메시지 count 개를 쓰고 지운다.
+void benchMessageLog(size_t count) {
+    char tmpl[] = "/tmp/chatlog-XXXXXX";
+    if (!mkdtemp(tmpl)) { Logger::warn("mkdtemp failed: " + lastWinsockError()); return; }
+    string dir = tmpl;
+    string msg = "[bench] " + string(92, 'x');
+    vector<double> latNs;
+    latNs.reserve(count / 16 + 1);
+    double secs;
+    MessageLog::Stats st;
+    {
+        MessageLog log(dir, 64 << 20, milliseconds(10));
+        auto t0 = steady_clock::now();
+        for (size_t i = 0; i < count; ++i) {
+            if (i % 16) { log.append(msg.data(), msg.size()); continue; }
+            auto a = steady_clock::now();
+            log.append(msg.data(), msg.size());
+            latNs.push_back((double)duration_cast<nanoseconds>(steady_clock::now() - a).count());
+        }
+        secs = duration<double>(steady_clock::now() - t0).count();
+        st = log.stats();
+    }
+    ostringstream oss;
+    oss << "[bench] message log: " << fixed << setprecision(0) << count / secs << " msg/s (" << setprecision(1) << count / secs * 60 / 1e6
+        << "M/min), append p50 " << setprecision(0) << percentile(latNs, 50) << " ns p99 " << percentile(latNs, 99) << " ns p99.9 " << percentile(latNs, 99.9)
+        << " ns, " << st.syncs << " group commits, " << st.segments << " segments";
+    Logger::info(oss.str());
+    if (DIR* d = opendir(dir.c_str())) {
+        while (dirent* e = readdir(d)) if (e->d_name[0] != '.') unlink((dir + "/" + e->d_name).c_str());
+        closedir(d);
+    }
+    rmdir(dir.c_str());
+}
+#endif
+
+// 벤치마크 동안 cout 을 버린다 (안에서 띄운 서버의 로그, 터미널 출력 비용)
+class NullBuf : public streambuf {
+protected:
+    int overflow(int c) override { return c; }
+    streamsize xsputn(const char*, streamsize n) override { return n; }
+};
+
+// Poller backend 별 대기 비용. 소켓 sockets 개를 READ 로 걸어 두고, round 마다 그중 active 개에만 datagram 을 보낸 뒤
+// 그것을 다 받을 때까지의 wait + recv 시간만 잰다 (대부분의 연결이 조용한 채팅 서버의 모양).
+// select/poll 은 wait 마다 모든 소켓을 훑고 epoll/io_uring 은 준비된 것만 본다.
+void benchPollers(int sockets, int active, int rounds) {
+    sockaddr_in txAddr{};
+    SOCKET tx = benchUdpSocket(txAddr);
+    vector<SOCKET> socks;
+    vector<sockaddr_in> addrs((size_t)sockets);
+    for (int i = 0; i < sockets; ++i) { socks.push_back(benchUdpSocket(addrs[(size_t)i])); setNonBlocking(socks.back()); }
+    mt19937 rng(7);
+    char buf[64];
+    for (Backend b : availableBackends()) {
+        ostringstream label;
+        label << "poller " << left << setw(8) << backendName(b) << " x" << sockets << " sockets, " << active << " active";
+        try {
+            Poller p(b);
+            for (SOCKET s : socks) p.add(s, Poller::READ);
+            vector<Poller::Event> evs;
+            uint64_t events = 0;
+            double secs = 0;
+            for (int r = 0; r < rounds; ++r) {
+                for (int k = 0; k < active; ++k) {
+                    const sockaddr_in& to = addrs[rng() % (uint32_t)sockets];
+                    sendto(tx, "x", 1, 0, (const sockaddr*)&to, sizeof(to));
+                }
+                auto t0 = steady_clock::now();
+                for (int left = active; left > 0;) {
+                    if (p.wait(evs, 1000) == 0) break;   // 루프백 UDP 가 버려졌다
+                    for (auto& ev : evs) { ++events; while (recv(ev.fd, buf, sizeof(buf), 0) > 0) --left; }
+                }
+                secs += duration<double>(steady_clock::now() - t0).count();
+            }
+            ostringstream oss;
+            oss << "[bench] " << label.str() << ": " << fixed << setprecision(2) << secs * 1e6 / rounds << " us/round, "
+                << setprecision(0) << (secs > 0 ? events / secs : 0.0) << " events/s";
+            Logger::info(oss.str());
+        }
+        catch (const exception& ex) { Logger::warn("[bench] " + label.str() + ": " + ex.what()); }
+    }
+    for (SOCKET s : socks) closesocket(s);
+    closesocket(tx);
+}
+
+// 빈 루프백 포트 번호 (서버가 TCP/UDP 로 다시 연다)
+sockaddr_in benchFreePort() {
+    SOCKET probe = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    sockaddr_in a{}; a.sin_family = AF_INET; a.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t len = sizeof(a);
+    if (probe == INVALID_SOCKET || bind(probe, (sockaddr*)&a, sizeof(a)) != 0 || getsockname(probe, (sockaddr*)&a, &len) != 0)
+        throw runtime_error("bench bind() failed: " + lastWinsockError());
+    closesocket(probe);
+    return a;
+}
+
+// 루프백 서버 (o) 에 클라이언트 스레드 threads 개가 각자 perThread 번 connect -> binary HELLO -> WELCOME 을 반복하고
+// 결과를 label 로 보고한다. silentShare 비율의 연결은 connect 만 하고 아무것도 보내지 않는다 (끝날 때까지 열어 둔다).
+// fastOpen 이면 클라이언트가 HELLO 를 SYN 에 싣는다 (같은 서버에서 첫 연결이 쿠키를 받은 뒤부터).
+void benchJoins(const string& label, ServerOptions o, int threads, int perThread, double silentShare, bool fastOpen) {
+    sockaddr_in a = benchFreePort();
+    o.historyMessages = 0;
+    o.sessionTtlSec = 0;
+    vector<double> latUs;
+    mutex latMtx;
+    atomic<uint64_t> failed(0);
+    double secs = 0;
+    NullBuf null;
+    streambuf* old = cout.rdbuf(&null);   // 서버의 입장/퇴장 로그는 버린다
+    {
+        ChatServer server(to_string(ntohs(a.sin_port)), o);
+        server.start();
+        this_thread::sleep_for(milliseconds(200));
+        string hello = makeFrame(wire::HELLO, 0, "bench", 5);
+        auto t0 = steady_clock::now();
+        vector<thread> ts;
+        vector<vector<SOCKET>> silent(threads);
+        for (int t = 0; t < threads; ++t) ts.emplace_back([&, t]() {
+            vector<double> mine;
+            char buf[256];
+            for (int i = 0; i < perThread; ++i) {
+                SOCKET s = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+                auto c0 = steady_clock::now();
+                if (s != INVALID_SOCKET && fastOpen) enableFastOpenConnect(s);
+                if (s == INVALID_SOCKET || connect(s, (sockaddr*)&a, sizeof(a)) != 0) { if (s != INVALID_SOCKET) closesocket(s); ++failed; continue; }
+                if ((int)((i + 1) * silentShare) > (int)(i * silentShare)) { silent[t].push_back(s); continue; }
+                pollfd p{ s, POLLIN, 0 };
+                if (send(s, hello.data(), (int)hello.size(), 0) != (int)hello.size() || poll(&p, 1, 2000) <= 0 || recv(s, buf, sizeof(buf), 0) <= 0) ++failed;
+                else mine.push_back((double)duration_cast<microseconds>(steady_clock::now() - c0).count());
+                closesocket(s);
+            }
+            lock_guard<mutex> lg(latMtx);
+            latUs.insert(latUs.end(), mine.begin(), mine.end());
+        });
+        for (auto& t : ts) t.join();
+        secs = duration<double>(steady_clock::now() - t0).count();
+        for (auto& v : silent) for (SOCKET s : v) closesocket(s);
+        server.stop();
+    }
+    cout.rdbuf(old);
+    ostringstream oss;
+    oss << "[bench] " << label << ": " << fixed << setprecision(0) << (secs > 0 ? latUs.size() / secs : 0.0)
+        << " joins/s (" << latUs.size() << " joins, " << setprecision(3) << secs << " s), connect->WELCOME p50 " << setprecision(0)
+        << percentile(latUs, 50) << " us p99 " << percentile(latUs, 99) << " us, failed " << failed.load();
+    Logger::info(oss.str());
+}
+
+// 연결 수립 속도, 닉네임을 보내지 않는 연결을 섞어서.
+// 닉네임을 accept 스레드에서 blocking recv 하던 때는 조용한 연결 하나가 뒤의 모든 입장을 막았다.
+void benchHandshake(double silentShare) {
+    ostringstream label;
+    label << "handshake, " << fixed << setprecision(0) << silentShare * 100 << "% silent";
+    benchJoins(label.str(), ServerOptions(), 4, 1000, silentShare, false);
+}
+
+// 재접속 폭주: 클라이언트 스레드 64개가 한꺼번에 접속한다. listen 소켓 수 / TCP_DEFER_ACCEPT / Fast Open 별 connections/s
+void benchReconnectStorm(int listeners, bool tuned) {
+    ServerOptions o;
+    o.tcpListeners = listeners;
+    o.deferAccept = o.tcpFastOpen = tuned;
+    string label = "reconnect storm, " + to_string(listeners) + " listener(s), " + (tuned ? "defer-accept + fast open" : "plain accept");
+    benchJoins(label, o, 64, 125, 0.0, tuned);
+}
+
+// 쓰기 정책의 지연 / 처리량: 루프백 서버 (policy) 에 binary 수신자 readers 명과 보내는 사람 하나.
+//   paced  1ms 마다 한 줄 1000번: 한가할 때의 방송 지연 (throughput 은 대략 window 만큼 늘어난다)
+//   flood  count 줄을 쉬지 않고: 모두에게 다 닿을 때까지의 전달 msgs/s 와 그동안의 지연
+// 줄마다 "T<보낸 시각 ns>" 로 시작해서 받는 쪽이 지연을 잰다 (같은 프로세스의 steady_clock)
+void benchWritePolicy(const string& label, WritePolicy policy, int readers, int count) {
+    sockaddr_in a = benchFreePort();
+    ServerOptions o;
+    o.historyMessages = 0;
+    o.sessionTtlSec = 0;
+    o.heartbeatSec = 0;
+    o.write = policy;
+    NullBuf null;
+    streambuf* old = cout.rdbuf(&null);
+    vector<double> pacedUs, floodUs;
+    double floodSecs = 0;
+    uint64_t expected = 0, got = 0;
+    {
+        ChatServer server(to_string(ntohs(a.sin_port)), o);
+        server.start();
+        this_thread::sleep_for(milliseconds(200));
+        auto join = [&](const string& name) {
+            SOCKET s = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+            if (s == INVALID_SOCKET || connect(s, (sockaddr*)&a, sizeof(a)) != 0) throw runtime_error("bench connect() failed: " + lastWinsockError());
+            string hello = makeFrame(wire::HELLO, 0, name.data(), name.size());
+            send(s, hello.data(), (int)hello.size(), 0);
+            return s;
+        };
+        vector<SOCKET> rs;
+        for (int i = 0; i < readers; ++i) { rs.push_back(join("r" + to_string(i))); setNonBlocking(rs.back()); }
+        SOCKET tx = join("sender");
+        setNoDelay(tx);
+        this_thread::sleep_for(milliseconds(200));
+
+        atomic<bool> flood(false), done(false);
+        atomic<uint64_t> delivered(0);
+        thread rx([&]() {
+            vector<unique_ptr<wire::StreamReader<1 << 16>>> in;
+            vector<pollfd> pfds;
+            for (SOCKET s : rs) { in.push_back(make_unique<wire::StreamReader<1 << 16>>()); pfds.push_back({ s, POLLIN, 0 }); }
+            char num[32];
+            while (!done.load()) {
+                if (poll(pfds.data(), pfds.size(), 20) <= 0) continue;
+                for (size_t i = 0; i < pfds.size(); ++i) {
+                    if (!(pfds[i].revents & POLLIN)) continue;
+                    auto& r = *in[i];
+                    int n = recv(pfds[i].fd, r.space(), (int)r.room(), 0);
+                    if (n <= 0) continue;
+                    r.commit((size_t)n);
+                    auto now = (double)duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+                    wire::Frame f;
+                    while (r.next(f) == wire::Status::Ok) {
+                        if (f.type != wire::CHAT || f.len < 2 || f.payload[0] != 'T') continue;
+                        size_t k = min(f.len - 1, sizeof(num) - 1);
+                        memcpy(num, f.payload + 1, k); num[k] = '\0';
+                        double us = (now - strtod(num, nullptr)) / 1000;
+                        (flood.load() ? floodUs : pacedUs).push_back(us);
+                        delivered.fetch_add(1);
+                    }
+                }
+            }
+        });
+        auto line = [](string& out) {
+            char p[64];
+            int n = snprintf(p, sizeof(p), "T%lld ", (long long)duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count());
+            string text(p, (size_t)n);
+            text.resize(64, 'x');
+            out += makeFrame(wire::CHAT, 0, text.data(), text.size());
+        };
+        auto waitFor = [&](uint64_t n) { for (int i = 0; i < 500 && delivered.load() < n; ++i) this_thread::sleep_for(milliseconds(10)); };
+
+        for (int i = 0; i < 1000; ++i) {
+            string f; line(f);
+            send(tx, f.data(), (int)f.size(), 0);
+            this_thread::sleep_for(milliseconds(1));
+        }
+        waitFor((uint64_t)1000 * readers);
+        uint64_t base = delivered.load();
+        flood.store(true);
+        auto t0 = steady_clock::now();
+        for (int i = 0; i < count; i += 16) {
+            string f;
+            for (int k = 0; k < 16; ++k) line(f);
+            send(tx, f.data(), (int)f.size(), 0);
+        }
+        expected = (uint64_t)count * readers;
+        waitFor(base + expected);
+        floodSecs = duration<double>(steady_clock::now() - t0).count();
+        got = delivered.load() - base;
+        done.store(true);
+        rx.join();
+        closesocket(tx);
+        for (SOCKET s : rs) closesocket(s);
+        server.stop();
+    }
+    cout.rdbuf(old);
+    ostringstream oss;
+    oss << "[bench] write policy " << label << ": paced p50 " << fixed << setprecision(0) << percentile(pacedUs, 50) << " us p99 " << percentile(pacedUs, 99)
+        << " us | flood " << (floodSecs > 0 ? got / floodSecs : 0.0) << " msgs/s (" << got << "/" << expected << "), p50 "
+        << percentile(floodUs, 50) << " us p99 " << percentile(floodUs, 99) << " us";
+    Logger::info(oss.str());
+}
+
+void runBenchmarks() {
+    WinsockInit w;
+    Logger::info("UDP benchmark (loopback, 64B datagrams, batch " + to_string(UDP_BATCH) + ")");
+    for (int sinks : { 16, 256, 1024 }) benchUdpFanout(sinks, max(1, 200000 / sinks));
+    benchUdpReceive(256, 400);
+#ifdef __linux__
+    int ncpu = (int)max(1u, thread::hardware_concurrency());
+    for (int shards = 1; shards <= ncpu; shards *= 2) benchUdpShards(shards);
+    benchUdpOffload(false);
+    benchUdpOffload(true);
+#endif
+    for (double loss : { 0.0, 0.01, 0.02, 0.05, 0.10 }) benchReliableUdp(loss);
+    benchFecCodec(8, 2, 1200);
+    benchFecCodec(32, 8, 1200);
+    for (double loss : { 0.01, 0.05, 0.10 }) benchFecLoss(8, 2, loss);
+#ifndef _WIN32
+    benchMessageLog(2000000);
+#endif
+    for (int sockets : { 16, 256, 1000 }) benchPollers(sockets, 4, 20000);
+    for (double silent : { 0.0, 0.1, 0.5 }) benchHandshake(silent);
+#ifdef __linux__
+    for (int listeners = 1; listeners <= max(4, ncpu); listeners *= 2) {
+        benchReconnectStorm(listeners, false);
+        benchReconnectStorm(listeners, true);
+    }
+#else
+    benchReconnectStorm(1, false);
+#endif
+    benchWritePolicy("latency", WritePolicy(), 16, 20000);
+    for (int us : { 50, 200, 1000 }) {
+        WritePolicy p;
+        p.mode = WriteMode::Throughput;
+        p.window = microseconds(us);
+        benchWritePolicy("throughput " + to_string(us) + "us", p, 16, 20000);
+    }
+}
+
+// ---------------- Ctrl+C ----------------
+static atomic<bool> g_terminate(false);
+static const Waker* g_signalWaker = nullptr;   // main 이 기다리는 핸들. 핸들러가 깨운다
+
+void requestTerminate() {
+    g_terminate.store(true);
+    if (g_signalWaker) g_signalWaker->wake();
+}
+#ifdef _WIN32
+BOOL WINAPI ConsoleHandler(DWORD signal) { if (signal == CTRL_C_EVENT || signal == CTRL_BREAK_EVENT || signal == CTRL_CLOSE_EVENT) { requestTerminate(); return TRUE; } return FALSE; }
+#else
+void SignalHandler(int) { requestTerminate(); }
+#endif
+
+// ---------------- Options ----------------
+struct ProgramOptions {
+    ServerOptions server;
+    ClientOptions client;
+};
+
+ProgramOptions parseOptions(int argc, char** argv) {
+    ProgramOptions o;
+    for (int i = 1; i < argc; ++i) {
+        string a = argv[i];
+        auto value = [&]() { if (i + 1 >= argc) throw runtime_error("missing value for " + a); return stoi(argv[++i]); };
+        if (a == "--udp-batch") o.server.udpBatch = value();
+        else if (a == "--udp-shards") o.server.udpShards = value();
+        else if (a == "--udp-cpu-steer") o.server.udpCpuSteer = true;
+        else if (a == "--no-udp-offload") o.server.udpOffload = false;
+        else if (a == "--udp-fec") {
+            o.server.fecData = value(); o.server.fecParity = value();
+            if (o.server.fecData < 1 || o.server.fecParity < 1 || o.server.fecData + o.server.fecParity > fec::MAX_SHARDS) throw runtime_error("--udp-fec needs K >= 1, M >= 1, K + M <= 255");
+        }
+        else if (a == "--history") o.server.historyMessages = value();
+        else if (a == "--history-seconds") o.server.historySeconds = value();
+        else if (a == "--session-ttl") o.server.sessionTtlSec = value();
+        else if (a == "--handshake-timeout-ms") o.server.handshakeTimeoutMs = max(1, value());
+        else if (a == "--heartbeat") o.server.heartbeatSec = max(0, value());
+        else if (a == "--idle-timeout") o.server.idleTimeoutSec = value();
+        else if (a == "--udp-idle-timeout") o.server.udpIdleTimeoutSec = max(0, value());
+        else if (a == "--tcp-listeners") o.server.tcpListeners = value();
+        else if (a == "--write-policy") {
+            if (i + 1 >= argc) throw runtime_error("missing value for " + a);
+            if (!parseWriteMode(argv[++i], o.server.write.mode)) throw runtime_error(string("unknown write policy: ") + argv[i]);
+        }
+        else if (a == "--flush-window-us") o.server.write.window = microseconds(max(1, value()));
+        else if (a == "--flush-bytes") o.server.write.bytes = (size_t)max(1, value());
+        else if (a == "--no-defer-accept") o.server.deferAccept = false;
+        else if (a == "--no-tcp-fastopen") o.server.tcpFastOpen = false;
+        else if (a == "--tcp-fastopen") o.client.tcpFastOpen = true;
+        else if (a == "--history-bytes") o.server.historyBytes = (size_t)max(0, value());
+        else if (a == "--log-dir") { if (i + 1 >= argc) throw runtime_error("missing value for " + a); o.server.logDir = argv[++i]; }
+        else if (a == "--log-segment-mb") o.server.logSegmentMb = value();
+        else if (a == "--log-sync-ms") o.server.logSyncMs = value();
+        else if (a == "--node-id") { if (i + 1 >= argc) throw runtime_error("missing value for " + a); o.server.meshNodeId = (uint32_t)stoul(argv[++i]); }
+        else if (a == "--mesh-port") { if (i + 1 >= argc) throw runtime_error("missing value for " + a); o.server.meshPort = argv[++i]; }
+        else if (a == "--mesh-peers") {
+            if (i + 1 >= argc) throw runtime_error("missing value for " + a);
+            istringstream iss(argv[++i]);
+            for (string p; getline(iss, p, ',');) if (!p.empty()) o.server.meshPeers.push_back(p);
+        }
+        else if (a == "--tls") o.server.tls = o.client.tls = true;
+        else if (a == "--tls-cert") { if (i + 1 >= argc) throw runtime_error("missing value for " + a); o.server.tlsCert = argv[++i]; }
+        else if (a == "--tls-key") { if (i + 1 >= argc) throw runtime_error("missing value for " + a); o.server.tlsKey = argv[++i]; }
+        else if (a == "--tls-ca") { if (i + 1 >= argc) throw runtime_error("missing value for " + a); o.client.tlsCa = argv[++i]; }
+        else if (a == "--tls-insecure") o.client.tlsInsecure = true;
+        else if (a == "--reliable-udp") o.client.reliableUdp = true;
+        else if (a == "--fec-udp") o.client.fecUdp = true;
+        else if (a == "--binary") o.client.binary = true;
+        else if (a == "--poller") {
+            if (i + 1 >= argc) throw runtime_error("missing value for " + a);
+            Backend b;
+            if (!parseBackend(argv[++i], b)) throw runtime_error(string("unknown poller: ") + argv[i]);
+            if (!setDefaultBackend(b)) Logger::warn(string(argv[i]) + " is not available here; using " + backendName(defaultBackend()));
+        }
+        else Logger::warn("Unknown option: " + a);
+    }
+    if (o.server.heartbeatSec > 0 && o.server.idleTimeoutSec <= o.server.heartbeatSec) throw runtime_error("--idle-timeout must be longer than --heartbeat");
+#ifndef NET_HAVE_TLS
+    if (o.server.tls) throw runtime_error("--tls needs a build with -DNET_TLS ... -lssl -lcrypto (tls_core.h)");
+#endif
+    return o;
+}
 
 // ---------------- main ----------------
-int main() {
+#ifndef CHAT_NO_MAIN   // 채팅 마이크로벤치.cpp 가 이 파일을 include 할 때는 뺀다
+int main(int argc, char** argv) {
     ios::sync_with_stdio(false); cin.tie(nullptr);
+    WinsockInit winsock;   // Waker 가 Windows 에서는 소켓이다
+    Waker signals;
+    g_signalWaker = &signals;
+#ifdef _WIN32
     SetConsoleCtrlHandler((PHANDLER_ROUTINE)ConsoleHandler, TRUE);
+#else
+    signal(SIGINT, SignalHandler); signal(SIGTERM, SignalHandler);
+    signal(SIGPIPE, SIG_IGN);   // 끊긴 TCP 소켓에 send 해도 프로세스가 죽지 않도록
+#endif
 
-    cout << "==== Chat Program TCP+UDP v1 ====\n1) Server mode\n2) Client mode\nSelect: ";
+    cout << "==== Chat Program TCP+UDP v1 ====\n1) Server mode\n2) Client mode\n3) Benchmark\nSelect: ";
     int mode = 0; if (!(cin >> mode)) { Logger::error("Invalid input"); return 0; } cin.ignore(numeric_limits<streamsize>::max(), '\n');
 
     try {
+        ProgramOptions opts = parseOptions(argc, argv);
         if (mode == 1) {
             cout << "Port: "; string port; getline(cin, port);
-            ChatServer server(port);
+            ChatServer server(port, opts.server);
             server.start();
-            Logger::info("Server started. Commands: /list /list udp /quit");
+            Logger::info("Server started. Commands: /list /list udp /queues /quit");
             string cmd;
-            while (!g_terminate.load()) {
-                if (!getline(cin, cmd)) { this_thread::sleep_for(milliseconds(100)); continue; }
+            while (!g_terminate.load() && waitStdin(signals)) {
+                if (!getline(cin, cmd)) { while (!g_terminate.load()) waitWake(signals, -1); break; }   // stdin 이 닫혀도 시그널까지는 돈다
                 if (cmd.empty()) continue;
                 if (cmd == "/list") server.listAll();
                 else if (cmd == "/list udp") server.listUdp();
+                else if (cmd == "/queues") server.listQueues();
                 else if (cmd == "/quit" || cmd == "/exit") { Logger::info("Shutdown"); server.stop(); break; }
                 else Logger::info("Unknown command");
             }
@@ -470,12 +5395,17 @@ int main() {
             cout << "Server IP: "; string ip; getline(cin, ip);
             cout << "Port: "; string port; getline(cin, port);
             cout << "Nickname: "; string name; getline(cin, name);
-            ChatClient client(ip, port, name);
+            ChatClient client(ip, port, name, opts.client);
             client.start();
             Logger::info("Type messages. /udp <msg> for UDP, /tcp <msg> or plain for TCP. /quit to exit.");
-            while (!g_terminate.load()) this_thread::sleep_for(milliseconds(200));
+            Poller poller;   // Ctrl+C 또는 클라이언트가 스스로 끝날 때 (/quit, 서버 종료)
+            poller.add(signals.fd(), Poller::READ);
+            poller.add(client.stopHandle(), Poller::READ);
+            vector<Poller::Event> evs;
+            while (!g_terminate.load() && poller.wait(evs, -1) == 0) {}
             client.stop();
         }
+        else if (mode == 3) runBenchmarks();
         else Logger::error("Unknown mode");
     }
     catch (const exception& ex) { Logger::error(string("Fatal: ") + ex.what()); return 1; }
@@ -483,3 +5413,4 @@ int main() {
     Logger::info("Exiting.");
     return 0;
 }
+#endif
@@ -0,0 +1,166 @@
+// chat_wire.h
+// 채팅 binary wire protocol. 텍스트 프로토콜 (닉네임 한 번, 그 뒤로는 글 그대로) 과 같은 포트를 쓰고
+// 서버가 클라이언트의 첫 바이트로 고른다: MAGIC 이면 binary, 아니면 기존 텍스트 클라이언트.
+// MAGIC (0xF8) 은 UTF-8 에 나오지 않는 바이트라 닉네임/글과 헷갈리지 않는다.
+//
+//   frame: [MAGIC][version:1][type:1][flags:1][sender:varint][seq:varint, FLAG_SEQ 일 때만][len:varint][payload:len]
+//   varint 는 LEB128 (7비트씩 낮은 자리부터, uint32 는 최대 5바이트)
+//
+//   HELLO      c->s  TCP 의 첫 frame. version = 클라이언트가 아는 최고 버전, payload = 닉네임
+//   WELCOME    s->c  version = 서버가 고른 버전, sender = 이 클라이언트의 ID
+//                    v2: payload = 세션 토큰 (SESSION_TOKEN_LEN 바이트, 세션이 꺼져 있으면 비어 있음).
+//                    FLAG_RESUMED 면 RESUME 이 받아들여진 것: JOIN 목록 없이 놓친 frame 들이 바로 뒤따른다.
+//   JOIN       s->c  sender = ID, payload = 닉네임 (WELCOME 뒤에 이미 있던 사람들도 하나씩)
+//   LEAVE      s->c  sender = ID
+//   CHAT       c->s  payload = 글
+//              s->c  sender 의 글. sender 0 이면 payload 가 완성된 줄이다 (서버 알림, UDP, 다른 노드, 기록)
+//   REGISTER   c->s  UDP 등록. payload = 닉네임, flags 의 FLAG_RELIABLE / FLAG_FEC 가 받는 방식
+//   REGISTERED s->c  REGISTER 응답. flags = 켜진 방식
+//   RESUME     c->s  v2, HELLO 대신. payload = 토큰 + 닉네임, seq = 마지막으로 받은 seq.
+//                    서버가 세션을 못 찾거나 그 사이 것이 버퍼에서 밀려났으면 HELLO 처럼 새로 들어온다.
+//   BYE        c->s  v2, 스스로 나간다 (세션을 남기지 않는다)
+//   PING       s->c  v3, 한동안 아무것도 안 온 클라이언트에게. 답이 없으면 서버가 끊는다
+//   PONG       c->s  v3, PING 에 바로 답한다
+//
+// v2 서버는 방송 frame 에 FLAG_SEQ 와 seq (서버 전체에서 늘어나는 번호) 를 붙인다.
+// encode/decode 는 호출자가 준 버퍼 위에서만 돈다 (할당 없음). decode 한 Frame 의 payload 는 입력 버퍼를 가리킨다.
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+
+namespace wire {
+
+constexpr uint8_t MAGIC = 0xF8;
+constexpr uint8_t VERSION = 3;
+constexpr size_t HEADER_MAX = 4 + 5 + 5 + 5;  // 고정 4바이트 + varint 세 개
+constexpr size_t SESSION_TOKEN_LEN = 16;
+constexpr uint32_t PAYLOAD_MAX = 1u << 24;    // 이보다 긴 len 은 깨진 stream 으로 본다
+
+enum Type : uint8_t { HELLO = 1, WELCOME = 2, JOIN = 3, LEAVE = 4, CHAT = 5, REGISTER = 6, REGISTERED = 7, RESUME = 8, BYE = 9, PING = 10, PONG = 11 };
+enum Flag : uint8_t { FLAG_UDP = 1, FLAG_HISTORY = 2, FLAG_RELIABLE = 4, FLAG_FEC = 8, FLAG_SEQ = 16, FLAG_RESUMED = 32 };
+
+struct Frame {
+    uint8_t version = VERSION;
+    uint8_t type = 0;
+    uint8_t flags = 0;
+    uint32_t sender = 0;
+    uint32_t seq = 0;                  // FLAG_SEQ 일 때만 실린다
+    const char* payload = nullptr;
+    size_t len = 0;
+};
+
+enum class Status { Ok, NeedMore, Bad };
+
+inline bool isFrame(const char* p, size_t n) { return n > 0 && (uint8_t)p[0] == MAGIC; }
+
+inline size_t varintSize(uint32_t v) {
+    size_t n = 1;
+    while (v >= 0x80) { v >>= 7; ++n; }
+    return n;
+}
+
+inline size_t putVarint(char* p, uint32_t v) {
+    size_t n = 0;
+    while (v >= 0x80) { p[n++] = (char)(uint8_t)(v | 0x80); v >>= 7; }
+    p[n++] = (char)(uint8_t)v;
+    return n;
+}
+
+// 읽은 바이트 수. 0 = 더 받아야 함, -1 = 5바이트를 넘거나 uint32 를 넘음
+inline int getVarint(const char* p, size_t n, uint32_t& v) {
+    uint64_t x = 0;
+    for (size_t i = 0; i < 5; ++i) {
+        if (i == n) return 0;
+        uint8_t b = (uint8_t)p[i];
+        x |= (uint64_t)(b & 0x7F) << (7 * i);
+        if (!(b & 0x80)) {
+            if (x > 0xFFFFFFFFull) return -1;
+            v = (uint32_t)x;
+            return (int)i + 1;
+        }
+    }
+    return -1;
+}
+
+inline size_t headerSize(const Frame& f, size_t payloadLen) {
+    return 4 + varintSize(f.sender) + ((f.flags & FLAG_SEQ) ? varintSize(f.seq) : 0) + varintSize((uint32_t)payloadLen);
+}
+inline size_t encodedSize(const Frame& f) { return headerSize(f, f.len) + f.len; }
+
+// 헤더만 쓴다 (payload 를 따로 보낼 때: sendfile 등). 쓴 바이트 수, 자리가 모자라면 0.
+inline size_t encodeHeader(const Frame& f, size_t payloadLen, char* out, size_t cap) {
+    if (payloadLen > PAYLOAD_MAX || cap < headerSize(f, payloadLen)) return 0;
+    out[0] = (char)MAGIC; out[1] = (char)f.version; out[2] = (char)f.type; out[3] = (char)f.flags;
+    size_t n = 4 + putVarint(out + 4, f.sender);
+    if (f.flags & FLAG_SEQ) n += putVarint(out + n, f.seq);
+    return n + putVarint(out + n, (uint32_t)payloadLen);
+}
+
+inline size_t encode(const Frame& f, char* out, size_t cap) {
+    if (cap < encodedSize(f)) return 0;
+    size_t n = encodeHeader(f, f.len, out, cap);
+    if (n == 0) return 0;
+    if (f.len) memcpy(out + n, f.payload, f.len);
+    return n + f.len;
+}
+
+// p 맨 앞의 frame 하나. Ok 면 used = frame 전체 길이
+inline Status decode(const char* p, size_t n, Frame& f, size_t& used) {
+    if (n == 0) return Status::NeedMore;
+    if ((uint8_t)p[0] != MAGIC) return Status::Bad;
+    if (n < 4) return Status::NeedMore;
+    f.version = (uint8_t)p[1]; f.type = (uint8_t)p[2]; f.flags = (uint8_t)p[3];
+    if (f.version == 0) return Status::Bad;
+    size_t off = 4;
+    int k = getVarint(p + off, n - off, f.sender);
+    if (k <= 0) return k < 0 ? Status::Bad : Status::NeedMore;
+    off += (size_t)k;
+    f.seq = 0;
+    if (f.flags & FLAG_SEQ) {
+        k = getVarint(p + off, n - off, f.seq);
+        if (k <= 0) return k < 0 ? Status::Bad : Status::NeedMore;
+        off += (size_t)k;
+    }
+    uint32_t len = 0;
+    k = getVarint(p + off, n - off, len);
+    if (k <= 0) return k < 0 ? Status::Bad : Status::NeedMore;
+    off += (size_t)k;
+    if (len > PAYLOAD_MAX) return Status::Bad;
+    if (n - off < len) return Status::NeedMore;
+    f.payload = p + off; f.len = len;
+    used = off + len;
+    return Status::Ok;
+}
+
+// TCP stream 에서 frame 을 잘라 내는 고정 크기 버퍼. N 바이트를 넘는 frame 은 Bad.
+//   while ((st = rx.next(f)) == Status::Ok) ...;   if (st == Status::Bad) 끊기;   recv(s, rx.space(), rx.room())
+template <size_t N>
+class StreamReader {
+public:
+    char* space() { compact(); return buf + end; }
+    size_t room() const { return N - end; }
+    void commit(size_t n) { end += n; }
+
+    // 다음 완성된 frame. f.payload 는 다음 space() 호출 전까지만 유효하다.
+    Status next(Frame& f) {
+        size_t used = 0;
+        Status st = decode(buf + start, end - start, f, used);
+        if (st == Status::Ok) start += used;
+        else if (st == Status::NeedMore && start == 0 && end == N) st = Status::Bad;
+        return st;
+    }
+
+private:
+    char buf[N];
+    size_t start = 0, end = 0;
+
+    void compact() {
+        if (start == 0) return;
+        memmove(buf, buf + start, end - start);
+        end -= start; start = 0;
+    }
+};
+
+} // namespace wire
@@ -0,0 +1,381 @@
+// fec.h
+// UDP 방송용 FEC (forward error correction). 블록마다 data datagram K개 + parity datagram M개를 보내면
+// 수신자는 블록 안에서 M개까지의 손실을 재전송 없이 복구한다. (방송은 수백 수신자의 NAK 을 받을 길이 없다)
+// 부호는 GF(2^8) 위의 체계적(systematic) Reed-Solomon, parity 행렬은 Cauchy 행렬이라 어떤 손실 조합도 풀린다.
+// M == 1 이면 parity 는 data 의 XOR 과 같다.
+// 영역 곱셈(dst ^= c * src)은 nibble 표 + pshufb (AVX2 / SSSE3, aarch64 는 NEON tbl), 없으면 256x256 표.
+//
+//   datagram: [0x02][k][m][index][block:4][...]
+//     index <  k : data,   뒤는 원래 payload 그대로
+//     index >= k : parity, 뒤는 shard (모든 parity 가 같은 길이)
+//   data shard = [len:2][payload][0 ... ] 를 블록에서 가장 긴 shard 길이까지 0으로 채운 것
+//
+// 덜 찬 블록은 Encoder::flush() 로 그때까지의 k 로 닫는다 (k 는 datagram 마다 실려 있다).
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <cstddef>
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <vector>
+#include <map>
+#include <chrono>
+#include <functional>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define FEC_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define FEC_TARGET(x)
+#else
+#define FEC_TARGET(x) __attribute__((target(x)))
+#endif
+#elif defined(__aarch64__)
+#define FEC_NEON 1
+#include <arm_neon.h>
+#endif
+
+namespace fec {
+
+constexpr uint8_t MAGIC = 0x02;
+constexpr size_t HEADER = 8;
+constexpr int MAX_SHARDS = 255;   // k + m, index 가 1바이트
+constexpr size_t MAX_SHARD = 2 + 0xffff;   // [len:2][payload]. Encoder 가 payload 를 0xffff 로 자른다
+
+// ---------------- GF(2^8) ----------------
+// 원시 다항식 x^8 + x^4 + x^3 + x^2 + 1 (0x11d)
+struct Gf {
+    uint8_t exp[512];
+    uint8_t log[256];
+    uint8_t inv[256];
+    uint8_t mul[256][256];
+
+    Gf() {
+        int x = 1;
+        for (int i = 0; i < 255; ++i) { exp[i] = (uint8_t)x; log[x] = (uint8_t)i; x <<= 1; if (x & 0x100) x ^= 0x11d; }
+        for (int i = 255; i < 512; ++i) exp[i] = exp[i - 255];
+        log[0] = 0;
+        for (int a = 0; a < 256; ++a)
+            for (int b = 0; b < 256; ++b) mul[a][b] = (a && b) ? exp[log[a] + log[b]] : 0;
+        inv[0] = 0;
+        for (int a = 1; a < 256; ++a) inv[a] = exp[255 - log[a]];
+    }
+};
+
+inline const Gf& gf() { static const Gf t; return t; }
+
+enum class Simd { Scalar, Ssse3, Avx2, Neon };
+
+inline const char* simdName(Simd s) {
+    switch (s) { case Simd::Ssse3: return "ssse3"; case Simd::Avx2: return "avx2"; case Simd::Neon: return "neon"; default: return "scalar"; }
+}
+
+inline Simd detectSimd() {
+#if defined(FEC_X86) && defined(_MSC_VER)
+    int r[4];
+    __cpuid(r, 1);
+    bool ssse3 = (r[2] >> 9) & 1, osxsave = (r[2] >> 27) & 1, avx = (r[2] >> 28) & 1;
+    bool avx2 = false;
+    if (osxsave && avx && (_xgetbv(0) & 6) == 6) { __cpuidex(r, 7, 0); avx2 = (r[1] >> 5) & 1; }
+    return avx2 ? Simd::Avx2 : ssse3 ? Simd::Ssse3 : Simd::Scalar;
+#elif defined(FEC_X86)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) return Simd::Avx2;
+    if (__builtin_cpu_supports("ssse3")) return Simd::Ssse3;
+    return Simd::Scalar;
+#elif defined(FEC_NEON)
+    return Simd::Neon;
+#else
+    return Simd::Scalar;
+#endif
+}
+
+// 현재 쓰는 구현. 벤치마크가 scalar 와 비교하려고 바꿀 수 있다.
+inline Simd& activeSimd() { static Simd s = detectSimd(); return s; }
+
+// ---------------- 영역 곱셈 ----------------
+// 각 함수는 처리한 바이트 수를 돌려주고 나머지 꼬리는 호출자가 scalar 로 처리한다.
+#ifdef FEC_X86
+FEC_TARGET("ssse3") inline size_t mulAddSsse3(uint8_t* d, const uint8_t* s, const uint8_t* lo, const uint8_t* hi, size_t n) {
+    const __m128i tl = _mm_loadu_si128((const __m128i*)lo), th = _mm_loadu_si128((const __m128i*)hi), mask = _mm_set1_epi8(0x0f);
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m128i x = _mm_loadu_si128((const __m128i*)(s + i));
+        __m128i p = _mm_xor_si128(_mm_shuffle_epi8(tl, _mm_and_si128(x, mask)), _mm_shuffle_epi8(th, _mm_and_si128(_mm_srli_epi64(x, 4), mask)));
+        _mm_storeu_si128((__m128i*)(d + i), _mm_xor_si128(_mm_loadu_si128((const __m128i*)(d + i)), p));
+    }
+    return i;
+}
+
+FEC_TARGET("avx2") inline size_t mulAddAvx2(uint8_t* d, const uint8_t* s, const uint8_t* lo, const uint8_t* hi, size_t n) {
+    const __m256i tl = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)lo));
+    const __m256i th = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)hi));
+    const __m256i mask = _mm256_set1_epi8(0x0f);
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        __m256i x = _mm256_loadu_si256((const __m256i*)(s + i));
+        __m256i p = _mm256_xor_si256(_mm256_shuffle_epi8(tl, _mm256_and_si256(x, mask)), _mm256_shuffle_epi8(th, _mm256_and_si256(_mm256_srli_epi64(x, 4), mask)));
+        _mm256_storeu_si256((__m256i*)(d + i), _mm256_xor_si256(_mm256_loadu_si256((const __m256i*)(d + i)), p));
+    }
+    return i;
+}
+#endif
+
+#ifdef FEC_NEON
+inline size_t mulAddNeon(uint8_t* d, const uint8_t* s, const uint8_t* lo, const uint8_t* hi, size_t n) {
+    const uint8x16_t tl = vld1q_u8(lo), th = vld1q_u8(hi), mask = vdupq_n_u8(0x0f);
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        uint8x16_t x = vld1q_u8(s + i);
+        uint8x16_t p = veorq_u8(vqtbl1q_u8(tl, vandq_u8(x, mask)), vqtbl1q_u8(th, vshrq_n_u8(x, 4)));
+        vst1q_u8(d + i, veorq_u8(vld1q_u8(d + i), p));
+    }
+    return i;
+}
+#endif
+
+// dst[i] ^= c * src[i]
+inline void mulAdd(uint8_t* dst, const uint8_t* src, uint8_t c, size_t n) {
+    if (c == 0) return;
+    size_t i = 0;
+    if (c == 1) {
+        for (; i + 8 <= n; i += 8) { uint64_t a, b; memcpy(&a, dst + i, 8); memcpy(&b, src + i, 8); a ^= b; memcpy(dst + i, &a, 8); }
+        for (; i < n; ++i) dst[i] ^= src[i];
+        return;
+    }
+    const Gf& g = gf();
+    Simd simd = activeSimd();
+    if (simd != Simd::Scalar && n >= 16) {
+        uint8_t lo[16], hi[16];
+        for (int x = 0; x < 16; ++x) { lo[x] = g.mul[c][x]; hi[x] = g.mul[c][x << 4]; }
+#ifdef FEC_X86
+        if (simd == Simd::Avx2) i = mulAddAvx2(dst, src, lo, hi, n);
+        i += mulAddSsse3(dst + i, src + i, lo, hi, n - i);
+#endif
+#ifdef FEC_NEON
+        i = mulAddNeon(dst, src, lo, hi, n);
+#endif
+    }
+    const uint8_t* row = g.mul[c];
+    for (; i < n; ++i) dst[i] ^= row[src[i]];
+}
+
+// parity 행 r, data 열 j 의 계수. Cauchy 행렬 1 / (x_r + y_j) (x_r = r, y_j = m + j) 의 열을 y_j 배 해서
+// 첫 행이 모두 1(= XOR)이 되게 했다. 행/열 상수배는 정방 부분행렬의 정칙성을 바꾸지 않는다.
+// k 와 무관하므로 덜 찬 블록도 같은 식으로 부호화된다. k + m <= 256 이어야 한다.
+inline uint8_t coef(int r, int j, int m) { const Gf& g = gf(); return g.mul[g.inv[r ^ (m + j)]][m + j]; }
+
+// ---------------- 부호화 / 복호 ----------------
+// parity[r] = sum_j coef(r, j) * data[j], 각 shard 는 len 바이트
+inline void encode(const uint8_t* const* data, int k, uint8_t* const* parity, int m, size_t len) {
+    for (int r = 0; r < m; ++r) {
+        memset(parity[r], 0, len);
+        for (int j = 0; j < k; ++j) mulAdd(parity[r], data[j], coef(r, j, m), len);
+    }
+}
+
+// GF(2^8) 정방 행렬 역행렬 (Gauss-Jordan). a 는 n*n, 결과도 a 에.
+inline bool invert(std::vector<uint8_t>& a, int n) {
+    const Gf& g = gf();
+    std::vector<uint8_t> b(n * n, 0);
+    for (int i = 0; i < n; ++i) b[i * n + i] = 1;
+    for (int c = 0; c < n; ++c) {
+        int p = c;
+        while (p < n && a[p * n + c] == 0) ++p;
+        if (p == n) return false;
+        if (p != c) for (int x = 0; x < n; ++x) { std::swap(a[p * n + x], a[c * n + x]); std::swap(b[p * n + x], b[c * n + x]); }
+        uint8_t iv = g.inv[a[c * n + c]];
+        for (int x = 0; x < n; ++x) { a[c * n + x] = g.mul[iv][a[c * n + x]]; b[c * n + x] = g.mul[iv][b[c * n + x]]; }
+        for (int r = 0; r < n; ++r) {
+            uint8_t f = a[r * n + c];
+            if (r == c || f == 0) continue;
+            for (int x = 0; x < n; ++x) { a[r * n + x] ^= g.mul[f][a[c * n + x]]; b[r * n + x] ^= g.mul[f][b[c * n + x]]; }
+        }
+    }
+    a.swap(b);
+    return true;
+}
+
+// 빠진 data shard 를 복구한다. data[j] 는 모두 len 바이트 버퍼, haveData[j] 가 false 인 것을 채운다.
+// 받은 parity 수가 빠진 data 수보다 적으면 false.
+inline bool reconstruct(uint8_t* const* data, const bool* haveData, int k, const uint8_t* const* parity, const bool* haveParity, int m, size_t len) {
+    std::vector<int> lost, rows;
+    for (int j = 0; j < k; ++j) if (!haveData[j]) lost.push_back(j);
+    if (lost.empty()) return true;
+    for (int r = 0; r < m && rows.size() < lost.size(); ++r) if (haveParity[r]) rows.push_back(r);
+    if (rows.size() < lost.size()) return false;
+
+    int e = (int)lost.size();
+    // syndrome: 받은 parity 에서 아는 data 의 기여를 뺀다. 남는 것은 빠진 data 의 선형결합.
+    std::vector<std::vector<uint8_t>> syn(e, std::vector<uint8_t>(len));
+    for (int a = 0; a < e; ++a) {
+        memcpy(syn[a].data(), parity[rows[a]], len);
+        for (int j = 0; j < k; ++j) if (haveData[j]) mulAdd(syn[a].data(), data[j], coef(rows[a], j, m), len);
+    }
+    std::vector<uint8_t> mat(e * e);
+    for (int a = 0; a < e; ++a)
+        for (int b = 0; b < e; ++b) mat[a * e + b] = coef(rows[a], lost[b], m);
+    if (!invert(mat, e)) return false;
+    for (int b = 0; b < e; ++b) {
+        memset(data[lost[b]], 0, len);
+        for (int a = 0; a < e; ++a) mulAdd(data[lost[b]], syn[a].data(), mat[b * e + a], len);
+    }
+    return true;
+}
+
+// ---------------- datagram 단위 ----------------
+inline bool isPacket(const char* p, size_t n) { return n >= HEADER && (uint8_t)p[0] == MAGIC && (uint8_t)p[3] < (uint8_t)p[1] + (uint8_t)p[2]; }
+
+inline std::string header(int k, int m, int index, uint32_t block) {
+    std::string h(HEADER, '\0');
+    h[0] = (char)MAGIC; h[1] = (char)k; h[2] = (char)m; h[3] = (char)index;
+    for (int i = 0; i < 4; ++i) h[4 + i] = (char)(block >> (24 - 8 * i));
+    return h;
+}
+
+// 보내는 쪽. 스레드 안전하지 않다.
+class Encoder {
+public:
+    Encoder(int k, int m) : k(k), m(m) {}
+
+    int dataShards() const { return k; }
+    int parityShards() const { return m; }
+    bool pending() const { return !shards.empty(); }
+    std::chrono::steady_clock::time_point openedAt() const { return opened; }
+
+    // payload 의 data datagram 을 frames 에 붙이고, 블록이 차면 parity datagram 도 붙인다.
+    void add(const char* p, size_t n, std::vector<std::string>& frames) {
+        if (n > 0xffff) n = 0xffff;
+        if (shards.empty()) opened = std::chrono::steady_clock::now();
+        frames.push_back(header(k, m, (int)shards.size(), block) + std::string(p, n));
+        std::string s(2, '\0');
+        s[0] = (char)(n >> 8); s[1] = (char)n;
+        s.append(p, n);
+        shards.push_back(std::move(s));
+        if ((int)shards.size() == k) flush(frames);
+    }
+
+    // 지금까지 모인 data 로 블록을 닫는다.
+    void flush(std::vector<std::string>& frames) {
+        if (shards.empty()) return;
+        int kk = (int)shards.size();
+        size_t len = 0;
+        for (auto& s : shards) len = std::max(len, s.size());
+        for (auto& s : shards) s.resize(len, '\0');
+        std::vector<const uint8_t*> in(kk);
+        for (int j = 0; j < kk; ++j) in[j] = (const uint8_t*)shards[j].data();
+        std::vector<std::string> par(m, header(kk, m, 0, block) + std::string(len, '\0'));
+        std::vector<uint8_t*> out(m);
+        for (int r = 0; r < m; ++r) { par[r][3] = (char)(kk + r); out[r] = (uint8_t*)&par[r][HEADER]; }
+        encode(in.data(), kk, out.data(), m, len);
+        // 덜 찬 블록의 data datagram 은 이미 k 로 나갔으므로 수신자는 parity 의 k 를 믿는다
+        for (auto& f : par) frames.push_back(std::move(f));
+        shards.clear();
+        ++block;
+    }
+
+private:
+    int k, m;
+    uint32_t block = 0;
+    std::vector<std::string> shards;
+    std::chrono::steady_clock::time_point opened;
+};
+
+// 받는 쪽. data 는 도착하는 대로 넘기고, 빠진 것은 parity 가 충분히 모이면 복구해서 넘긴다.
+// 보내는 쪽(주소) 하나당 하나씩 쓴다. 스레드 안전하지 않다.
+class Decoder {
+public:
+    typedef std::function<void(const char*, size_t, bool recovered)> Deliver;
+    struct Stats { uint64_t data = 0, recovered = 0, lost = 0; };
+
+    static constexpr int WINDOW = 16;   // 복구를 기다리는 최근 블록 수
+
+    void onPacket(const char* p, size_t n, const Deliver& deliver) {
+        if (!isPacket(p, n)) return;
+        int k = (uint8_t)p[1], m = (uint8_t)p[2], idx = (uint8_t)p[3];
+        uint32_t id = 0;
+        for (int i = 0; i < 4; ++i) id = (id << 8) | (uint8_t)p[4 + i];
+        const char* body = p + HEADER;
+        size_t len = n - HEADER;
+
+        if (started && (int32_t)(id - newest) <= -WINDOW) return;   // 이미 버린 블록
+        if (!started || (int32_t)(id - newest) > 0) { newest = id; started = true; evict(); }
+        Block& b = blocks[id];
+        if (b.data.empty()) { b.m = m; b.data.resize(MAX_SHARDS); b.have.assign(MAX_SHARDS, false); b.parity.resize(m); b.haveParity.assign(m, false); }
+        if (m != b.m) return;
+
+        if (idx < k && idx < MAX_SHARDS - m) {
+            if (b.have[idx]) return;
+            b.have[idx] = true; ++b.count; ++stats_.data;
+            b.data[idx].assign(2, '\0');
+            b.data[idx][0] = (char)(len >> 8); b.data[idx][1] = (char)len;
+            b.data[idx].append(body, len);
+            if (!b.done) deliver(body, len, false);
+        }
+        else {
+            int r = idx - k;
+            if (r < 0 || r >= m || b.haveParity[r]) return;
+            // 한 블록의 parity 는 모두 같은 길이, 같은 k 다. 처음 받은 것과 다르면 깨졌거나 꾸민 datagram 이므로 버린다
+            // (복구는 모든 shard 를 그 길이만큼 읽는다)
+            if (len == 0 || len > MAX_SHARD || (b.len != 0 && (len != b.len || k != b.k))) return;
+            b.k = k;   // parity 의 k 가 블록의 실제 크기 (덜 찬 블록)
+            b.len = len;
+            b.haveParity[r] = true; ++b.count;
+            b.parity[r].assign(body, len);
+        }
+        if (!b.done && b.k > 0 && b.count >= b.k) recover(b, deliver);
+    }
+
+    Stats stats() const { return stats_; }
+
+private:
+    struct Block {
+        int k = 0, m = 0, count = 0;
+        size_t len = 0;   // parity 길이 (처음 받은 parity 로 정한다)
+        bool done = false;
+        std::vector<std::string> data, parity;
+        std::vector<bool> have, haveParity;
+    };
+    std::map<uint32_t, Block> blocks;
+    uint32_t newest = 0;
+    bool started = false;
+    Stats stats_;
+
+    void recover(Block& b, const Deliver& deliver) {
+        b.done = true;
+        size_t len = b.len;
+        bool missing = false;
+        for (int j = 0; j < b.k; ++j) if (!b.have[j]) missing = true;
+        if (!missing) return;
+        std::vector<uint8_t*> d(b.k);
+        std::vector<const uint8_t*> par(b.m);
+        std::unique_ptr<bool[]> have(new bool[b.k]), haveP(new bool[b.m]);
+        for (int j = 0; j < b.k; ++j) { b.data[j].resize(len, '\0'); d[j] = (uint8_t*)&b.data[j][0]; have[j] = b.have[j]; }
+        for (int r = 0; r < b.m; ++r) { par[r] = (const uint8_t*)b.parity[r].data(); haveP[r] = b.haveParity[r]; }
+        if (!reconstruct(d.data(), have.get(), b.k, par.data(), haveP.get(), b.m, len)) return;
+        for (int j = 0; j < b.k; ++j) {
+            if (b.have[j]) continue;
+            b.have[j] = true;
+            size_t n = ((size_t)(uint8_t)b.data[j][0] << 8) | (uint8_t)b.data[j][1];
+            if (n + 2 > len) continue;   // 깨진 shard
+            ++stats_.recovered;
+            deliver(b.data[j].data() + 2, n, true);
+        }
+    }
+
+    void evict() {
+        for (auto it = blocks.begin(); it != blocks.end();) {
+            if ((int32_t)(newest - it->first) < WINDOW) { ++it; continue; }
+            const Block& b = it->second;
+            int k = b.k;   // parity 를 하나도 못 받았으면 받은 data 의 최대 index 까지만 센다
+            if (k == 0) for (int j = 0; j < MAX_SHARDS; ++j) if (b.have[j]) k = j + 1;
+            for (int j = 0; j < k; ++j) if (!b.have[j]) ++stats_.lost;
+            it = blocks.erase(it);
+        }
+    }
+};
+
+} // namespace fec
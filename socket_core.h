@@ -0,0 +1,803 @@
+// socket_core.h
+// 이 저장소의 프로그램들이 같이 쓰는 소켓 기반. Winsock 과 POSIX 의 차이를 덮는 shim, RAII 소켓, 주소 도우미, TCP 쓰기 정책 (NODELAY, cork),
+// 다른 스레드에서 이벤트 루프를 깨우는 Waker, 그리고 backend 를 고를 수 있는 Poller.
+//
+//   net::WinsockInit w;                                    // Windows 는 WSAStartup/WSACleanup, POSIX 는 아무것도 안 한다
+//   net::Socket s = net::udpBind(9000);                    // 소멸자가 closesocket
+//   sockaddr_in peer; net::parseAddress("127.0.0.1", 9001, peer);
+//   net::Poller p;                                         // net::defaultBackend()
+//   p.add(s.get(), net::Poller::READ);
+//   vector<net::Poller::Event> evs; p.wait(evs, 100);      // 준비된 소켓들, timeout 이면 비어 있다
+//
+// Poller backend (모두 level-triggered, 같은 인터페이스):
+//   select    어디서나. POSIX 는 fd < FD_SETSIZE, Windows 는 FD_SETSIZE 개까지. 기다릴 때마다 모든 소켓을 훑는다
+//   poll      어디서나 (Windows 는 WSAPoll). 역시 모든 소켓을 훑는다
+//   epoll     Linux. 대기 비용이 등록된 소켓 수가 아니라 준비된 소켓 수에 비례한다
+//   io_uring  Linux 5.11+. 소켓마다 IORING_OP_POLL_ADD (oneshot) 를 걸고 완료되면 다음 wait 에서 다시 건다
+// 빌드 때 NET_NO_EPOLL / NET_NO_IO_URING 으로 뺄 수 있고 NET_DEFAULT_BACKEND=<이름> 으로 기본값을 바꾼다.
+// 실행 때는 환경 변수 NET_POLLER=<이름> 이나 setDefaultBackend(). 이 호스트에서 쓸 수 없는 backend 는
+// 쓸 수 있는 가장 좋은 것 (epoll > poll) 으로 떨어진다.
+#pragma once
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#include <windows.h>
+#pragma comment(lib, "ws2_32.lib")
+#else
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/select.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#endif
+#ifdef __linux__
+#ifndef NET_NO_EPOLL
+#include <sys/epoll.h>
+#define NET_HAVE_EPOLL 1
+#endif
+#include <sys/eventfd.h>
+#if !defined(NET_NO_IO_URING) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <csignal>
+#define NET_HAVE_IO_URING 1
+#endif
+#endif
+#if defined(NET_HAVE_EPOLL) && defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 35))
+#define NET_HAVE_EPOLL_PWAIT2 1   // us 단위 timeout (커널 5.11+, 아니면 실행 때 epoll_wait 로)
+#endif
+#endif
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <memory>
+#include <stdexcept>
+#include <unordered_map>
+#include <algorithm>
+#include <climits>
+
+// ---------------- Platform ----------------
+// POSIX 에서도 Winsock 이름으로 쓴다 (SOCKET, closesocket, WSAGetLastError ...)
+#ifndef _WIN32
+typedef int SOCKET;
+constexpr SOCKET INVALID_SOCKET = -1;
+constexpr int SOCKET_ERROR = -1;
+constexpr int SD_BOTH = SHUT_RDWR;
+constexpr int WSAEWOULDBLOCK = EWOULDBLOCK;
+constexpr int WSAEINTR = EINTR;
+constexpr int WSAECONNABORTED = ECONNABORTED;
+constexpr int WSAECONNRESET = ECONNRESET;
+constexpr int WSAENOBUFS = ENOBUFS;
+inline int closesocket(SOCKET s) { return close(s); }
+inline int WSAGetLastError() { return errno; }
+#else
+inline int poll(pollfd* fds, unsigned long n, int timeoutMs) { return WSAPoll(fds, n, timeoutMs); }
+#endif
+
+namespace net {
+
+inline std::string lastWinsockError() {
+#ifdef _WIN32
+    int code = WSAGetLastError();
+    char* buf = nullptr;
+    FormatMessageA(FORMAT_MESSAGE_ALLOCATE_BUFFER | FORMAT_MESSAGE_FROM_SYSTEM | FORMAT_MESSAGE_IGNORE_INSERTS,
+        nullptr, code, MAKELANGID(LANG_NEUTRAL, SUBLANG_DEFAULT), (LPSTR)&buf, 0, nullptr);
+    std::string s = buf ? buf : "<unknown>";
+    if (buf) LocalFree(buf);
+    return s;
+#else
+    return strerror(errno);
+#endif
+}
+
+// ---------------- Winsock RAII ----------------
+class WinsockInit {
+public:
+#ifdef _WIN32
+    WinsockInit() {
+        WSADATA w;
+        if (WSAStartup(MAKEWORD(2, 2), &w) != 0) throw std::runtime_error("WSAStartup failed");
+    }
+    ~WinsockInit() { WSACleanup(); }
+#else
+    WinsockInit() {}
+#endif
+    WinsockInit(const WinsockInit&) = delete;
+    WinsockInit& operator=(const WinsockInit&) = delete;
+};
+
+inline void setNonBlocking(SOCKET s, bool on = true) {
+#ifdef _WIN32
+    u_long mode = on ? 1 : 0; ioctlsocket(s, FIONBIO, &mode);
+#else
+    int fl = fcntl(s, F_GETFL, 0); fcntl(s, F_SETFL, on ? fl | O_NONBLOCK : fl & ~O_NONBLOCK);
+#endif
+}
+
+// ---------------- Socket ----------------
+// 소켓 하나를 가진다 (move 만). 소멸자와 reset() 이 닫는다.
+class Socket {
+public:
+    Socket() = default;
+    explicit Socket(SOCKET s) : s(s) {}
+    Socket(int family, int type, int protocol) : s(::socket(family, type, protocol)) {
+        if (s == INVALID_SOCKET) throw std::runtime_error("socket() failed: " + lastWinsockError());
+    }
+    ~Socket() { reset(); }
+    Socket(Socket&& o) noexcept : s(o.release()) {}
+    Socket& operator=(Socket&& o) noexcept { if (this != &o) reset(o.release()); return *this; }
+    Socket(const Socket&) = delete;
+    Socket& operator=(const Socket&) = delete;
+
+    static Socket tcp() { return Socket(AF_INET, SOCK_STREAM, IPPROTO_TCP); }
+    static Socket udp() { return Socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP); }
+
+    SOCKET get() const { return s; }
+    explicit operator bool() const { return s != INVALID_SOCKET; }
+    SOCKET release() { SOCKET r = s; s = INVALID_SOCKET; return r; }
+    void reset(SOCKET n = INVALID_SOCKET) {
+        if (s != INVALID_SOCKET) closesocket(s);
+        s = n;
+    }
+
+    // int 값 옵션 하나. 실패하면 false (lastWinsockError)
+    bool setOption(int level, int name, int value) {
+        return setsockopt(s, level, name, (const char*)&value, sizeof(value)) == 0;
+    }
+
+private:
+    SOCKET s = INVALID_SOCKET;
+};
+
+// ---------------- Addresses ----------------
+// "a.b.c.d:port" 를 out 뒤에 붙인다 (out 의 capacity 가 충분하면 할당 없음)
+inline void appendSockaddr(std::string& out, const sockaddr_in& a) {
+    char buf[INET_ADDRSTRLEN + 8] = { 0 };
+    inet_ntop(AF_INET, &a.sin_addr, buf, INET_ADDRSTRLEN);
+    size_t n = strlen(buf);
+    n += (size_t)snprintf(buf + n, sizeof(buf) - n, ":%u", (unsigned)ntohs(a.sin_port));
+    out.append(buf, n);
+}
+
+inline std::string sockaddrToString(const sockaddr_in& a) {
+    std::string s;
+    appendSockaddr(s, a);
+    return s;
+}
+
+// INADDR_ANY:port
+inline sockaddr_in anyAddress(unsigned short port) {
+    sockaddr_in a{};
+    a.sin_family = AF_INET;
+    a.sin_addr.s_addr = htonl(INADDR_ANY);
+    a.sin_port = htons(port);
+    return a;
+}
+
+// host 는 점 표기 IPv4 또는 이름 (getaddrinfo). 못 풀면 false
+inline bool parseAddress(const std::string& host, unsigned short port, sockaddr_in& out) {
+    out = anyAddress(port);
+    if (inet_pton(AF_INET, host.c_str(), &out.sin_addr) == 1) return true;
+    addrinfo hints{}; addrinfo* res = nullptr;
+    hints.ai_family = AF_INET;
+    if (getaddrinfo(host.c_str(), nullptr, &hints, &res) != 0 || !res) return false;
+    out.sin_addr = ((const sockaddr_in*)res->ai_addr)->sin_addr;
+    freeaddrinfo(res);
+    return true;
+}
+
+// ---------------- Common sockets ----------------
+// 실패하면 runtime_error ("bind() failed: ..." 처럼 어느 단계인지와 OS 메시지)
+
+inline Socket udpBind(unsigned short port, bool broadcast = false, bool reuseAddr = false) {
+    Socket s = Socket::udp();
+    if (reuseAddr) s.setOption(SOL_SOCKET, SO_REUSEADDR, 1);
+    if (broadcast && !s.setOption(SOL_SOCKET, SO_BROADCAST, 1)) throw std::runtime_error("SO_BROADCAST failed: " + lastWinsockError());
+    sockaddr_in a = anyAddress(port);
+    if (bind(s.get(), (const sockaddr*)&a, sizeof(a)) == SOCKET_ERROR) throw std::runtime_error("bind() failed: " + lastWinsockError());
+    return s;
+}
+
+inline Socket tcpListen(unsigned short port, int backlog = SOMAXCONN) {
+    Socket s = Socket::tcp();
+    s.setOption(SOL_SOCKET, SO_REUSEADDR, 1);
+    sockaddr_in a = anyAddress(port);
+    if (bind(s.get(), (const sockaddr*)&a, sizeof(a)) == SOCKET_ERROR) throw std::runtime_error("bind() failed: " + lastWinsockError());
+    if (listen(s.get(), backlog) == SOCKET_ERROR) throw std::runtime_error("listen() failed: " + lastWinsockError());
+    return s;
+}
+
+inline Socket tcpConnect(const sockaddr_in& to) {
+    Socket s = Socket::tcp();
+    if (connect(s.get(), (const sockaddr*)&to, sizeof(to)) == SOCKET_ERROR) throw std::runtime_error("connect() failed: " + lastWinsockError());
+    return s;
+}
+
+// ---------------- Write policy ----------------
+// TCP 소켓 하나에 작은 응답/메시지를 어떻게 내보낼지. 두 mode 모두 TCP_NODELAY (Nagle 과 상대의 delayed ACK 가
+// 줄 하나를 수십 ms 잡아 두지 않도록): 모으는 것은 커널이 아니라 호출자가 정한다.
+//   Latency     쌓이는 대로 바로 보낸다
+//   Throughput  첫 바이트가 쌓인 뒤 window 동안, 또는 bytes 가 찰 때까지 모았다가 한 번에 보낸다.
+//               그 한 번을 cork(s, true) ... cork(s, false) 로 감싸면 writev / sendfile 여러 번이 꽉 찬 segment 로 묶이고
+//               풀 때 남은 꼬리가 바로 나간다
+enum class WriteMode { Latency, Throughput };
+
+struct WritePolicy {
+    WriteMode mode = WriteMode::Latency;
+    std::chrono::microseconds window{ 200 };
+    size_t bytes = 16 << 10;
+};
+
+inline const char* writeModeName(WriteMode m) { return m == WriteMode::Latency ? "latency" : "throughput"; }
+
+inline bool parseWriteMode(const std::string& name, WriteMode& out) {
+    if (name == "latency") out = WriteMode::Latency;
+    else if (name == "throughput") out = WriteMode::Throughput;
+    else return false;
+    return true;
+}
+
+inline bool setNoDelay(SOCKET s, bool on = true) {
+    int v = on ? 1 : 0;
+    return setsockopt(s, IPPROTO_TCP, TCP_NODELAY, (const char*)&v, sizeof(v)) == 0;
+}
+
+// Linux TCP_CORK, BSD/macOS TCP_NOPUSH. 없는 OS (Windows) 에서는 아무것도 안 한다: 한 번에 보내는 writev 로 충분하다
+inline void cork(SOCKET s, bool on) {
+    int v = on ? 1 : 0;
+#if defined(TCP_CORK)
+    setsockopt(s, IPPROTO_TCP, TCP_CORK, (const char*)&v, sizeof(v));
+#elif defined(TCP_NOPUSH)
+    setsockopt(s, IPPROTO_TCP, TCP_NOPUSH, (const char*)&v, sizeof(v));
+#else
+    (void)s; (void)v;
+#endif
+}
+
+// ---------------- Waker ----------------
+// Poller 에 소켓처럼 넣을 수 있는 깨우기 핸들. Linux 는 eventfd, 다른 POSIX 는 self-pipe,
+// Windows 는 자기 자신에게 connect 한 루프백 UDP 소켓 (WSAPoll/select 는 소켓만 받는다).
+// wake() 는 write/send 하나라 시그널 핸들러에서 불러도 된다. drain() 하지 않으면 계속 readable 이다.
+class Waker {
+public:
+    Waker() {
+#if defined(__linux__)
+        rfd = wfd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (rfd < 0) throw std::runtime_error("eventfd failed: " + lastWinsockError());
+#elif defined(_WIN32)
+        rfd = wfd = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+        sockaddr_in a{}; a.sin_family = AF_INET; a.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        int len = sizeof(a);
+        if (rfd == INVALID_SOCKET || bind(rfd, (sockaddr*)&a, sizeof(a)) != 0 || getsockname(rfd, (sockaddr*)&a, &len) != 0 || connect(rfd, (sockaddr*)&a, sizeof(a)) != 0)
+            throw std::runtime_error("waker socket failed: " + lastWinsockError());
+        setNonBlocking(rfd);
+#else
+        int p[2];
+        if (pipe(p) != 0) throw std::runtime_error("pipe failed: " + lastWinsockError());
+        rfd = p[0]; wfd = p[1];
+        setNonBlocking(rfd); setNonBlocking(wfd);
+#endif
+    }
+    ~Waker() {
+        closesocket(rfd);
+        if (wfd != rfd) closesocket(wfd);
+    }
+    Waker(const Waker&) = delete;
+    Waker& operator=(const Waker&) = delete;
+
+    SOCKET fd() const { return rfd; }
+
+    void wake() const {
+#if defined(__linux__)
+        uint64_t one = 1;
+        if (write(wfd, &one, sizeof(one)) < 0) {}
+#elif defined(_WIN32)
+        send(wfd, "w", 1, 0);
+#else
+        if (write(wfd, "w", 1) < 0) {}
+#endif
+    }
+
+    void drain() const {
+        char buf[64];
+#ifdef _WIN32
+        while (recv(rfd, buf, sizeof(buf), 0) > 0) {}
+#else
+        while (read(rfd, buf, sizeof(buf)) > 0) {}
+#endif
+    }
+
+private:
+    SOCKET rfd, wfd;
+};
+
+// ---------------- Poller backends ----------------
+enum class Backend { Select, Poll, Epoll, IoUring };
+
+inline const char* backendName(Backend b) {
+    switch (b) {
+    case Backend::Select: return "select";
+    case Backend::Poll:   return "poll";
+    case Backend::Epoll:  return "epoll";
+    default:              return "io_uring";
+    }
+}
+
+inline bool parseBackend(const std::string& name, Backend& out) {
+    for (Backend b : { Backend::Select, Backend::Poll, Backend::Epoll, Backend::IoUring })
+        if (name == backendName(b)) { out = b; return true; }
+    return false;
+}
+
+inline bool backendAvailable(Backend b);
+
+// 여러 소켓의 readiness 를 기다린다. 한 스레드에서만 쓴다.
+class Poller {
+public:
+    enum { READ = 1, WRITE = 2 };
+    struct Event { SOCKET fd; int events; };   // 오류/HUP 는 READ|WRITE 로 알린다 (다음 recv/send 가 결과를 돌려준다)
+
+    class Impl {
+    public:
+        virtual ~Impl() {}
+        virtual void add(SOCKET s, int events) = 0;
+        virtual void modify(SOCKET s, int events) = 0;
+        virtual void remove(SOCKET s) = 0;
+        virtual void wait(std::vector<Event>& out, int64_t timeoutUs) = 0;   // < 0 이면 무한정
+    };
+
+    explicit Poller(Backend b);
+    Poller();
+
+    Backend backend() const { return kind; }
+
+    // 등록 실패 (epoll_ctl, select 의 FD_SETSIZE 등) 는 runtime_error
+    void add(SOCKET s, int events) { impl->add(s, events); }
+    void modify(SOCKET s, int events) { impl->modify(s, events); }
+    void remove(SOCKET s) { impl->remove(s); }
+
+    // 준비된 소켓을 out 에 채워 개수를 돌려준다. timeoutMs < 0 이면 무한정 (시그널로 끊기면 0)
+    int wait(std::vector<Event>& out, int timeoutMs) { return waitUs(out, timeoutMs < 0 ? -1 : (int64_t)timeoutMs * 1000); }
+
+    // us 단위 (Reactor 의 짧은 timer 용). select, poll (Linux ppoll), epoll (epoll_pwait2), io_uring 은 그대로,
+    // 그 밖에는 ms 로 올린다
+    int waitUs(std::vector<Event>& out, int64_t timeoutUs) {
+        out.clear();
+        impl->wait(out, timeoutUs);
+        return (int)out.size();
+    }
+
+private:
+    Backend kind;
+    std::unique_ptr<Impl> impl;
+};
+
+namespace detail {
+
+// us -> ms 올림 (ms 만 받는 대기용). 음수는 무한정
+inline int ceilMs(int64_t us) { return us < 0 ? -1 : (int)std::min<int64_t>((us + 999) / 1000, INT_MAX); }
+
+// poll/select 공용: 등록 순서대로의 목록 + fd -> 자리 (지울 때 맨 뒤 것으로 메운다)
+template <typename Entry>
+class FdList {
+public:
+    std::vector<Entry> items;
+
+    bool has(SOCKET s) const { return index.count(s) != 0; }
+    Entry* find(SOCKET s) { auto it = index.find(s); return it == index.end() ? nullptr : &items[it->second]; }
+    void push(SOCKET s, const Entry& e) { index[s] = items.size(); items.push_back(e); }
+    void erase(SOCKET s, SOCKET (*fdOf)(const Entry&)) {
+        auto it = index.find(s);
+        if (it == index.end()) return;
+        size_t at = it->second;
+        index.erase(it);
+        if (at + 1 != items.size()) { items[at] = items.back(); index[fdOf(items[at])] = at; }
+        items.pop_back();
+    }
+
+private:
+    std::unordered_map<SOCKET, size_t> index;
+};
+
+class SelectPoller : public Poller::Impl {
+public:
+    void add(SOCKET s, int events) override {
+        if (list.has(s)) throw std::runtime_error("select: socket already added");
+#ifdef _WIN32
+        if (list.items.size() >= FD_SETSIZE) throw std::runtime_error("select: more than FD_SETSIZE sockets");
+#else
+        if (s < 0 || s >= FD_SETSIZE) throw std::runtime_error("select: fd >= FD_SETSIZE");
+#endif
+        list.push(s, { s, events });
+    }
+    void modify(SOCKET s, int events) override { if (Item* it = list.find(s)) it->events = events; }
+    void remove(SOCKET s) override { list.erase(s, [](const Item& i) { return i.fd; }); }
+
+    void wait(std::vector<Poller::Event>& out, int64_t timeoutUs) override {
+        fd_set rd, wr, ex;
+        FD_ZERO(&rd); FD_ZERO(&wr); FD_ZERO(&ex);
+        SOCKET maxFd = 0;
+        int n = 0;
+        for (auto& i : list.items) {
+            if (i.events & Poller::READ) { FD_SET(i.fd, &rd); ++n; }
+            if (i.events & Poller::WRITE) { FD_SET(i.fd, &wr); FD_SET(i.fd, &ex); ++n; }   // Windows 는 connect 실패를 ex 로 알린다
+            maxFd = std::max(maxFd, i.fd);
+        }
+        timeval tv{ (long)(timeoutUs / 1000000), (long)(timeoutUs % 1000000) };
+#ifdef _WIN32
+        if (n == 0) { Sleep(timeoutUs < 0 ? INFINITE : (DWORD)ceilMs(timeoutUs)); return; }   // Winsock select 는 빈 집합을 받지 않는다
+#endif
+        if (select((int)maxFd + 1, &rd, &wr, &ex, timeoutUs < 0 ? nullptr : &tv) <= 0) return;
+        for (auto& i : list.items) {
+            int e = 0;
+            if (FD_ISSET(i.fd, &rd)) e |= Poller::READ;
+            if (FD_ISSET(i.fd, &wr)) e |= Poller::WRITE;
+            if (FD_ISSET(i.fd, &ex)) e |= Poller::READ | Poller::WRITE;
+            if (e) out.push_back({ i.fd, e });
+        }
+    }
+
+private:
+    struct Item { SOCKET fd; int events; };
+    FdList<Item> list;
+};
+
+class PollPoller : public Poller::Impl {
+public:
+    void add(SOCKET s, int events) override {
+        if (list.has(s)) throw std::runtime_error("poll: socket already added");
+        pollfd p{}; p.fd = s; p.events = mask(events);
+        list.push(s, p);
+    }
+    void modify(SOCKET s, int events) override { if (pollfd* p = list.find(s)) p->events = mask(events); }
+    void remove(SOCKET s) override { list.erase(s, [](const pollfd& p) { return (SOCKET)p.fd; }); }
+
+    void wait(std::vector<Poller::Event>& out, int64_t timeoutUs) override {
+#ifdef __linux__
+        timespec ts{ (time_t)(timeoutUs / 1000000), (long)(timeoutUs % 1000000) * 1000 };
+        if (ppoll(list.items.data(), (nfds_t)list.items.size(), timeoutUs < 0 ? nullptr : &ts, nullptr) <= 0) return;
+#else
+        if (poll(list.items.data(), (unsigned long)list.items.size(), ceilMs(timeoutUs)) <= 0) return;
+#endif
+        for (auto& p : list.items) {
+            if (!p.revents) continue;
+            int e = 0;
+            if (p.revents & POLLIN) e |= Poller::READ;
+            if (p.revents & POLLOUT) e |= Poller::WRITE;
+            if (p.revents & (POLLERR | POLLHUP | POLLNVAL)) e |= Poller::READ | Poller::WRITE;
+            out.push_back({ (SOCKET)p.fd, e });
+        }
+    }
+
+private:
+    FdList<pollfd> list;
+    static short mask(int events) { return (short)((events & Poller::READ ? POLLIN : 0) | (events & Poller::WRITE ? POLLOUT : 0)); }
+};
+
+#ifdef NET_HAVE_EPOLL
+class EpollPoller : public Poller::Impl {
+public:
+    EpollPoller() : ep(epoll_create1(EPOLL_CLOEXEC)) { if (ep < 0) throw std::runtime_error("epoll_create1 failed: " + lastWinsockError()); }
+    ~EpollPoller() override { close(ep); }
+    void add(SOCKET s, int events) override { ctl(EPOLL_CTL_ADD, s, events); }
+    void modify(SOCKET s, int events) override { ctl(EPOLL_CTL_MOD, s, events); }
+    void remove(SOCKET s) override { epoll_ctl(ep, EPOLL_CTL_DEL, s, nullptr); }
+
+    void wait(std::vector<Poller::Event>& out, int64_t timeoutUs) override {
+        epoll_event evs[64];
+        int n = -1;
+#ifdef NET_HAVE_EPOLL_PWAIT2
+        if (pwait2) {
+            timespec ts{ (time_t)(timeoutUs / 1000000), (long)(timeoutUs % 1000000) * 1000 };
+            n = epoll_pwait2(ep, evs, 64, timeoutUs < 0 ? nullptr : &ts, nullptr);
+            if (n < 0 && errno == ENOSYS) pwait2 = false;
+        }
+        if (!pwait2)
+#endif
+        n = epoll_wait(ep, evs, 64, ceilMs(timeoutUs));
+        for (int i = 0; i < n; ++i) {
+            int e = 0;
+            if (evs[i].events & (EPOLLIN | EPOLLRDHUP)) e |= Poller::READ;
+            if (evs[i].events & EPOLLOUT) e |= Poller::WRITE;
+            if (evs[i].events & (EPOLLERR | EPOLLHUP)) e |= Poller::READ | Poller::WRITE;
+            out.push_back({ evs[i].data.fd, e });
+        }
+    }
+
+private:
+    int ep;
+#ifdef NET_HAVE_EPOLL_PWAIT2
+    bool pwait2 = true;   // 커널이 모르면 (ENOSYS) epoll_wait 로
+#endif
+    void ctl(int op, SOCKET s, int events) {
+        epoll_event ev{};
+        ev.events = (events & Poller::READ ? (uint32_t)(EPOLLIN | EPOLLRDHUP) : 0u) | (events & Poller::WRITE ? (uint32_t)EPOLLOUT : 0u);
+        ev.data.fd = s;
+        if (epoll_ctl(ep, op, s, &ev) != 0) throw std::runtime_error("epoll_ctl failed: " + lastWinsockError());
+    }
+};
+#endif
+
+#ifdef NET_HAVE_IO_URING
+// liburing 없이 syscall 로. 소켓마다 oneshot POLL_ADD 하나가 떠 있다: 완료되면 Event 로 내보내고
+// 다음 wait() 에 들어갈 때 다시 건다 (아직 준비돼 있으면 바로 다시 완료되므로 level-triggered 와 같다).
+// 관심 이벤트를 바꾸거나 지우면 POLL_REMOVE 로 옛 요청을 취소한다. 요청마다 세대 번호를 붙여
+// 취소되기 전에 도착한 옛 완료나 같은 fd 번호를 다시 쓴 소켓의 것을 구별한다.
+// SQE 는 모아 두었다가 wait() 의 io_uring_enter 한 번으로 제출한다 (그래서 remove 뒤 close 한 소켓도 다음 wait 에서 풀린다).
+class UringPoller : public Poller::Impl {
+public:
+    UringPoller() {
+        io_uring_params p{};
+        p.flags = IORING_SETUP_CQSIZE;
+        p.cq_entries = CQ_ENTRIES;
+        ring = (int)syscall(__NR_io_uring_setup, SQ_ENTRIES, &p);
+        if (ring < 0) throw std::runtime_error("io_uring_setup failed: " + lastWinsockError());
+        if (!(p.features & IORING_FEAT_EXT_ARG) || !(p.features & IORING_FEAT_NODROP)) {
+            close(ring);
+            throw std::runtime_error("io_uring: kernel too old (needs IORING_FEAT_EXT_ARG, 5.11+)");
+        }
+        sqLen = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+        cqLen = p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe);
+        bool single = (p.features & IORING_FEAT_SINGLE_MMAP) != 0;
+        if (single) sqLen = cqLen = std::max(sqLen, cqLen);
+        sqMap = mmap(nullptr, sqLen, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring, IORING_OFF_SQ_RING);
+        cqMap = single ? sqMap : mmap(nullptr, cqLen, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring, IORING_OFF_CQ_RING);
+        sqesLen = p.sq_entries * sizeof(io_uring_sqe);
+        sqes = (io_uring_sqe*)mmap(nullptr, sqesLen, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring, IORING_OFF_SQES);
+        if (sqMap == MAP_FAILED || cqMap == MAP_FAILED || sqes == (io_uring_sqe*)MAP_FAILED) {
+            std::string err = lastWinsockError();
+            unmap();
+            close(ring);
+            throw std::runtime_error("io_uring mmap failed: " + err);
+        }
+        char* sq = (char*)sqMap;
+        char* cq = (char*)cqMap;
+        sqHead = (unsigned*)(sq + p.sq_off.head); sqTail = (unsigned*)(sq + p.sq_off.tail);
+        sqMask = *(unsigned*)(sq + p.sq_off.ring_mask); sqEntries = p.sq_entries;
+        sqArray = (unsigned*)(sq + p.sq_off.array);
+        cqHead = (unsigned*)(cq + p.cq_off.head); cqTail = (unsigned*)(cq + p.cq_off.tail);
+        cqMask = *(unsigned*)(cq + p.cq_off.ring_mask);
+        cqes = (io_uring_cqe*)(cq + p.cq_off.cqes);
+    }
+    ~UringPoller() override {
+        unmap();
+        close(ring);   // 떠 있는 POLL_ADD 는 커널이 취소한다
+    }
+
+    void add(SOCKET s, int events) override {
+        if (entries.count(s)) throw std::runtime_error("io_uring: socket already added");
+        Entry& e = entries[s];
+        e.events = events;
+        arm(s, e);
+    }
+    void modify(SOCKET s, int events) override {
+        auto it = entries.find(s);
+        if (it == entries.end()) throw std::runtime_error("io_uring: modify of unknown socket");
+        Entry& e = it->second;
+        if (e.events == events) return;
+        if (e.armed) cancel(s, e);
+        e.events = events;
+        arm(s, e);
+    }
+    void remove(SOCKET s) override {
+        auto it = entries.find(s);
+        if (it == entries.end()) return;
+        if (it->second.armed) cancel(s, it->second);
+        entries.erase(it);
+    }
+
+    void wait(std::vector<Poller::Event>& out, int64_t timeoutUs) override {
+        for (SOCKET s : fired) {   // 지난번에 완료된 것을 다시 건다
+            auto it = entries.find(s);
+            if (it != entries.end() && !it->second.armed) arm(s, it->second);
+        }
+        fired.clear();
+        bool ready = __atomic_load_n(cqTail, __ATOMIC_ACQUIRE) != *cqHead;
+        if (ready || timeoutUs == 0) enter(0, nullptr);
+        else {
+            __kernel_timespec ts{ timeoutUs / 1000000, (long long)(timeoutUs % 1000000) * 1000 };
+            io_uring_getevents_arg arg{};
+            arg.sigmask_sz = _NSIG / 8;
+            if (timeoutUs > 0) arg.ts = (uint64_t)(uintptr_t)&ts;
+            enter(1, &arg);
+        }
+        reap(out);
+    }
+
+private:
+    static constexpr unsigned SQ_ENTRIES = 256;
+    static constexpr unsigned CQ_ENTRIES = 4096;   // 넘치면 커널이 잡아 두었다가 (NODROP) 다음 enter 에 넘긴다
+    static constexpr uint64_t CANCEL_TAG = ~0ull;
+
+    struct Entry { int events = 0; uint32_t gen = 0; bool armed = false; };
+
+    int ring = -1;
+    void* sqMap = MAP_FAILED; void* cqMap = MAP_FAILED;
+    size_t sqLen = 0, cqLen = 0, sqesLen = 0;
+    io_uring_sqe* sqes = (io_uring_sqe*)MAP_FAILED;
+    unsigned *sqHead = nullptr, *sqTail = nullptr, *sqArray = nullptr, *cqHead = nullptr, *cqTail = nullptr;
+    unsigned sqMask = 0, sqEntries = 0, cqMask = 0;
+    io_uring_cqe* cqes = nullptr;
+    unsigned unsubmitted = 0;
+    uint32_t nextGen = 0;
+    std::unordered_map<SOCKET, Entry> entries;
+    std::vector<SOCKET> fired;
+
+    void unmap() {
+        if (sqes != (io_uring_sqe*)MAP_FAILED) munmap(sqes, sqesLen);
+        if (cqMap != MAP_FAILED && cqMap != sqMap) munmap(cqMap, cqLen);
+        if (sqMap != MAP_FAILED) munmap(sqMap, sqLen);
+    }
+
+    static uint64_t tag(SOCKET s, uint32_t gen) { return ((uint64_t)gen << 32) | (uint32_t)s; }
+
+    io_uring_sqe* nextSqe() {
+        unsigned tail = *sqTail;
+        if (tail - __atomic_load_n(sqHead, __ATOMIC_ACQUIRE) == sqEntries) enter(0, nullptr);   // 꽉 찼다: 먼저 제출
+        unsigned idx = tail & sqMask;
+        io_uring_sqe* sqe = &sqes[idx];
+        memset(sqe, 0, sizeof(*sqe));
+        sqArray[idx] = idx;
+        __atomic_store_n(sqTail, tail + 1, __ATOMIC_RELEASE);
+        ++unsubmitted;
+        return sqe;
+    }
+
+    void arm(SOCKET s, Entry& e) {
+        if (++nextGen == 0) nextGen = 1;
+        e.gen = nextGen;
+        e.armed = true;
+        io_uring_sqe* sqe = nextSqe();
+        sqe->opcode = IORING_OP_POLL_ADD;
+        sqe->fd = s;
+        sqe->poll32_events = (e.events & Poller::READ ? POLLIN | POLLRDHUP : 0) | (e.events & Poller::WRITE ? POLLOUT : 0);
+        sqe->user_data = tag(s, e.gen);
+    }
+
+    void cancel(SOCKET s, Entry& e) {
+        io_uring_sqe* sqe = nextSqe();
+        sqe->opcode = IORING_OP_POLL_REMOVE;
+        sqe->fd = -1;
+        sqe->addr = tag(s, e.gen);
+        sqe->user_data = CANCEL_TAG;
+        e.armed = false;
+    }
+
+    // 모아 둔 SQE 를 제출하고 minComplete 개가 완료될 때까지 (arg 의 timeout 까지) 기다린다
+    void enter(unsigned minComplete, io_uring_getevents_arg* arg) {
+        unsigned flags = minComplete ? IORING_ENTER_GETEVENTS : 0;
+        if (arg) flags |= IORING_ENTER_EXT_ARG;
+        for (;;) {
+            long r = syscall(__NR_io_uring_enter, ring, unsubmitted, minComplete, flags, arg, arg ? sizeof(*arg) : 0);
+            if (r >= 0) { unsubmitted -= std::min(unsubmitted, (unsigned)r); return; }
+            if (errno == ETIME || errno == EINTR) return;   // timeout / 시그널: 제출은 이미 됐다
+            if (errno == EBUSY || errno == EAGAIN) { if (!minComplete) return; minComplete = 0; flags &= ~IORING_ENTER_GETEVENTS; continue; }
+            throw std::runtime_error("io_uring_enter failed: " + lastWinsockError());
+        }
+    }
+
+    void reap(std::vector<Poller::Event>& out) {
+        unsigned head = *cqHead, tail = __atomic_load_n(cqTail, __ATOMIC_ACQUIRE);
+        for (; head != tail; ++head) {
+            const io_uring_cqe& c = cqes[head & cqMask];
+            if (c.user_data == CANCEL_TAG) continue;
+            SOCKET s = (SOCKET)(uint32_t)c.user_data;
+            auto it = entries.find(s);
+            if (it == entries.end() || it->second.gen != (uint32_t)(c.user_data >> 32)) continue;   // 취소됐거나 옛 요청
+            it->second.armed = false;
+            fired.push_back(s);
+            if (c.res == -ECANCELED) continue;
+            int e = 0;
+            if (c.res < 0) e = Poller::READ | Poller::WRITE;   // 잘못된 fd 등: 다음 recv/send 가 알린다
+            else {
+                if (c.res & (POLLIN | POLLRDHUP)) e |= Poller::READ;
+                if (c.res & POLLOUT) e |= Poller::WRITE;
+                if (c.res & (POLLERR | POLLHUP | POLLNVAL)) e |= Poller::READ | Poller::WRITE;
+            }
+            out.push_back({ s, e });
+        }
+        __atomic_store_n(cqHead, head, __ATOMIC_RELEASE);
+    }
+};
+#endif
+
+inline Backend parseDefaultBackend() {
+#ifdef NET_DEFAULT_BACKEND
+#define NET_STR2(x) #x
+#define NET_STR(x) NET_STR2(x)
+    const char* built = NET_STR(NET_DEFAULT_BACKEND);
+#else
+    const char* built = nullptr;
+#endif
+    Backend b;
+    const char* env = getenv("NET_POLLER");
+    if (env && parseBackend(env, b) && backendAvailable(b)) return b;
+    if (built && parseBackend(built, b) && backendAvailable(b)) return b;
+#ifdef NET_HAVE_EPOLL
+    return Backend::Epoll;
+#else
+    return Backend::Poll;
+#endif
+}
+
+inline Backend& defaultSlot() {
+    static Backend b = parseDefaultBackend();
+    return b;
+}
+
+} // namespace detail
+
+// 이 빌드에 들어 있고 이 호스트 (커널) 에서 실제로 열리는지
+inline bool backendAvailable(Backend b) {
+    switch (b) {
+    case Backend::Select:
+    case Backend::Poll:
+        return true;
+    case Backend::Epoll:
+#ifdef NET_HAVE_EPOLL
+        return true;
+#else
+        return false;
+#endif
+    default:
+#ifdef NET_HAVE_IO_URING
+    {
+        static const bool ok = []() { try { detail::UringPoller p; return true; } catch (const std::exception&) { return false; } }();
+        return ok;
+    }
+#else
+        return false;
+#endif
+    }
+}
+
+inline std::vector<Backend> availableBackends() {
+    std::vector<Backend> out;
+    for (Backend b : { Backend::Select, Backend::Poll, Backend::Epoll, Backend::IoUring })
+        if (backendAvailable(b)) out.push_back(b);
+    return out;
+}
+
+// 인자 없이 만든 Poller 가 쓰는 backend. 처음 부를 때 NET_POLLER / NET_DEFAULT_BACKEND 를 본다
+inline Backend defaultBackend() { return detail::defaultSlot(); }
+
+// Poller 를 만들기 전에 (옵션을 읽을 때). 쓸 수 없는 backend 면 false 이고 기본값은 그대로다
+inline bool setDefaultBackend(Backend b) {
+    if (!backendAvailable(b)) return false;
+    detail::defaultSlot() = b;
+    return true;
+}
+
+inline Poller::Poller() : Poller(defaultBackend()) {}
+
+inline Poller::Poller(Backend b) : kind(b) {
+    switch (b) {
+    case Backend::Select: impl.reset(new detail::SelectPoller()); break;
+    case Backend::Poll:   impl.reset(new detail::PollPoller()); break;
+#ifdef NET_HAVE_EPOLL
+    case Backend::Epoll:  impl.reset(new detail::EpollPoller()); break;
+#endif
+#ifdef NET_HAVE_IO_URING
+    case Backend::IoUring: impl.reset(new detail::UringPoller()); break;
+#endif
+    default: throw std::runtime_error(std::string("poller backend not built in: ") + backendName(b));
+    }
+}
+
+} // namespace net
@@ -0,0 +1,182 @@
+// tls_core.h
+// 선택적 TLS. handshake 는 OpenSSL 이 userspace 에서 하고, 끝나면 세션 키를 커널에 넘긴다
+// (kTLS: setsockopt(SOL_TCP, TCP_ULP, "tls") 뒤 TLS_TX / TLS_RX. SSL_OP_ENABLE_KTLS 를 켜 두면 OpenSSL 이 한다).
+// 커널로 넘어간 방향은 record 암호화를 커널이 하므로 그 소켓에 plain send / writev / sendfile 을 그대로 쓴다:
+// sendfile 이 파일을 userspace 로 올리지 않는 것 (zero-copy) 이 TLS 위에서도 유지된다.
+// 커널에 tls 모듈이 없거나 (/proc/sys/net/ipv4/tcp_available_ulp) cipher 를 넘길 수 없으면 그 방향은 SSL_read / SSL_write
+// 로 남는다. 어느 쪽인지는 kernelSend() / kernelRecv(). OpenSSL 3.0 은 TLS 1.3 에서 송신만, TLS 1.2 에서 양방향을 넘긴다.
+//
+//   빌드: -DNET_TLS ... -lssl -lcrypto   (NET_TLS 가 없으면 이 헤더는 비어 있고 NET_HAVE_TLS 도 정의되지 않는다)
+//
+//   net::TlsContext ctx = net::TlsContext::server(cert, key);    // cert 가 비어 있으면 이 실행 동안만 쓰는 self-signed
+//   net::TlsSession t(ctx, s);                                   // non-blocking 소켓이면 Want* 동안 handshake() 를 되풀이
+//   net::TlsContext::client(ca)                                  // 서버 인증서와 이름을 ca (없으면 시스템 CA) 로 검증한다
+//   if (t.handshake() == net::TlsSession::Done && t.kernelSend()) sendfile(s, fd, &off, n);
+#pragma once
+
+#ifdef NET_TLS
+#include "socket_core.h"
+#include <openssl/ssl.h>
+#include <openssl/err.h>
+#include <openssl/evp.h>
+#include <openssl/x509.h>
+#ifdef _WIN32
+#pragma comment(lib, "libssl.lib")
+#pragma comment(lib, "libcrypto.lib")
+#endif
+#define NET_HAVE_TLS 1
+
+namespace net {
+
+// OpenSSL 오류 큐의 맨 앞 (큐는 비운다)
+inline std::string tlsError() {
+    unsigned long e = ERR_get_error();
+    ERR_clear_error();
+    if (e == 0) return "TLS error";
+    char buf[256];
+    ERR_error_string_n(e, buf, sizeof(buf));
+    return buf;
+}
+
+class TlsContext {
+public:
+    // certFile / keyFile 은 PEM. 비어 있으면 P-256 self-signed (CN=localhost, 하루) 를 만든다
+    static TlsContext server(const std::string& certFile = "", const std::string& keyFile = "") {
+        TlsContext t(TLS_server_method());
+        SSL_CTX* c = t.get();
+        SSL_CTX_set_num_tickets(c, 0);   // 재개 안 함. handshake 뒤에 userspace 가 쓰는 record 가 없다
+        if (!certFile.empty()) {
+            if (SSL_CTX_use_certificate_chain_file(c, certFile.c_str()) != 1 ||
+                SSL_CTX_use_PrivateKey_file(c, (keyFile.empty() ? certFile : keyFile).c_str(), SSL_FILETYPE_PEM) != 1 ||
+                SSL_CTX_check_private_key(c) != 1)
+                throw std::runtime_error("TLS certificate: " + tlsError());
+            return t;
+        }
+        EVP_PKEY* key = EVP_EC_gen("P-256");
+        X509* x = X509_new();
+        bool ok = key && x;
+        if (ok) {
+            ASN1_INTEGER_set(X509_get_serialNumber(x), 1);
+            X509_gmtime_adj(X509_getm_notBefore(x), 0);
+            X509_gmtime_adj(X509_getm_notAfter(x), 24L * 60 * 60);
+            X509_NAME* name = X509_get_subject_name(x);
+            X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC, (const unsigned char*)"localhost", -1, -1, 0);
+            ok = X509_set_version(x, 2) && X509_set_issuer_name(x, name) && X509_set_pubkey(x, key) &&
+                 X509_sign(x, key, EVP_sha256()) && SSL_CTX_use_certificate(c, x) == 1 && SSL_CTX_use_PrivateKey(c, key) == 1;
+        }
+        X509_free(x);
+        EVP_PKEY_free(key);
+        if (!ok) throw std::runtime_error("TLS self-signed certificate: " + tlsError());
+        return t;
+    }
+
+    // 서버 인증서를 caFile (비어 있으면 시스템 기본 CA) 로 검증하고, 세션의 host 와 이름이 맞는지 본다.
+    // verify = false 는 검증하지 않는다: 중간자를 막지 못하므로 명시적으로 고른 경우만 (--tls-insecure, 루프백 벤치마크)
+    static TlsContext client(const std::string& caFile = "", bool verify = true) {
+        TlsContext t(TLS_client_method());
+        if (!verify) return t;
+        if (!caFile.empty() ? SSL_CTX_load_verify_locations(t.get(), caFile.c_str(), nullptr) != 1
+                            : SSL_CTX_set_default_verify_paths(t.get()) != 1)
+            throw std::runtime_error("TLS CA: " + tlsError());
+        SSL_CTX_set_verify(t.get(), SSL_VERIFY_PEER, nullptr);
+        return t;
+    }
+
+    // 이 context 로 만드는 세션은 키를 커널에 넘기지 않는다 (비교용)
+    void userspaceOnly() { SSL_CTX_clear_options(ctx.get(), SSL_OP_ENABLE_KTLS); }
+
+    // 소켓을 plain recv 로 읽을 쪽 (수신도 커널이 풀어야 한다). OpenSSL 3.2 전에는 TLS 1.3 수신 키를 넘기지 못하므로 TLS 1.2 까지만
+    void kernelBothWays() {
+#if OPENSSL_VERSION_NUMBER < 0x30200000L
+        SSL_CTX_set_max_proto_version(ctx.get(), TLS1_2_VERSION);
+#endif
+    }
+
+    SSL_CTX* get() const { return ctx.get(); }
+    bool verifies() const { return SSL_CTX_get_verify_mode(ctx.get()) & SSL_VERIFY_PEER; }
+
+private:
+    struct Free { void operator()(SSL_CTX* c) const { SSL_CTX_free(c); } };
+    std::unique_ptr<SSL_CTX, Free> ctx;
+
+    // kTLS 가 받는 것은 AES-GCM, ChaCha20-Poly1305 뿐이라 TLS 1.2 도 그것만 고른다 (TLS 1.3 은 원래 AEAD 뿐)
+    explicit TlsContext(const SSL_METHOD* m) : ctx(SSL_CTX_new(m)) {
+        if (!ctx) throw std::runtime_error("SSL_CTX_new: " + tlsError());
+        SSL_CTX* c = ctx.get();
+        SSL_CTX_set_min_proto_version(c, TLS1_2_VERSION);
+        SSL_CTX_set_cipher_list(c, "ECDHE+AESGCM:ECDHE+CHACHA20");
+        SSL_CTX_set_options(c, SSL_OP_ENABLE_KTLS);
+#ifdef SSL_OP_IGNORE_UNEXPECTED_EOF
+        // close_notify 없이 닫아도 (프로세스 종료 등) 오류가 아니라 EOF. 메시지는 채팅 / 파일 프로토콜이 따로 구분한다
+        SSL_CTX_set_options(c, SSL_OP_IGNORE_UNEXPECTED_EOF);
+#endif
+        // non-blocking 소켓에서 SSL_write 가 일부만 보내고 돌아오고, 다시 부를 때 버퍼 위치가 달라도 되도록
+        SSL_CTX_set_mode(c, SSL_MODE_ENABLE_PARTIAL_WRITE | SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER);
+    }
+};
+
+// 연결 하나의 TLS. 소켓은 빌려 쓴다 (닫지 않는다)
+class TlsSession {
+public:
+    enum Step { Done, WantRead, WantWrite, Failed };
+    static constexpr int AGAIN = -2;   // read / write: 지금은 못 한다 (Poller 로 기다린다)
+
+    // host 는 클라이언트만: SNI, 검증하는 context 면 인증서 이름도 맞춰 본다
+    TlsSession(const TlsContext& ctx, SOCKET s, bool isServer = true, const std::string& host = "") : ssl(SSL_new(ctx.get())) {
+        if (!ssl || SSL_set_fd(ssl.get(), (int)s) != 1) throw std::runtime_error("SSL_new: " + tlsError());
+        if (isServer) SSL_set_accept_state(ssl.get());
+        else {
+            SSL_set_connect_state(ssl.get());
+            if (!host.empty()) {
+                SSL_set_tlsext_host_name(ssl.get(), host.c_str());
+                if (ctx.verifies()) SSL_set1_host(ssl.get(), host.c_str());
+            }
+        }
+    }
+
+    // blocking 소켓이면 한 번에 Done / Failed. 실패 이유는 error
+    Step handshake() {
+        int r = SSL_do_handshake(ssl.get());
+        if (r == 1) return Done;
+        switch (SSL_get_error(ssl.get(), r)) {
+        case SSL_ERROR_WANT_READ: return WantRead;
+        case SSL_ERROR_WANT_WRITE: return WantWrite;
+        default: error = failure(); return Failed;
+        }
+    }
+
+    // recv / send 처럼: 바이트 수, 0 = 상대가 닫음 (read), AGAIN, -1 = 오류
+    int read(char* buf, int len) { return result(SSL_read(ssl.get(), buf, len)); }
+    int write(const char* buf, int len) { return result(SSL_write(ssl.get(), buf, len)); }
+
+    bool kernelSend() const { return BIO_get_ktls_send(SSL_get_wbio(ssl.get())) == 1; }
+    // read 가 돌려주지 않고 남긴 평문 (record 가 read 의 len 보다 길었다). 소켓은 이것 때문에 다시 readable 해지지 않는다
+    bool buffered() const { return SSL_pending(ssl.get()) > 0; }
+    bool kernelRecv() const { return BIO_get_ktls_recv(SSL_get_rbio(ssl.get())) == 1; }
+    std::string describe() const {
+        return std::string(SSL_get_version(ssl.get())) + " " + SSL_get_cipher_name(ssl.get()) +
+               ", 송신 " + (kernelSend() ? "kTLS" : "userspace") + ", 수신 " + (kernelRecv() ? "kTLS" : "userspace");
+    }
+
+    std::string error;
+
+private:
+    struct Free { void operator()(SSL* s) const { SSL_free(s); } };
+    std::unique_ptr<SSL, Free> ssl;
+
+    // SSL_ERROR_SYSCALL 은 오류 큐가 빈 채로 온다: 상대가 끊었다 (EOF, EPIPE, RST)
+    static std::string failure() { return ERR_peek_error() ? tlsError() : "connection lost"; }
+
+    int result(int r) {
+        if (r > 0) return r;
+        switch (SSL_get_error(ssl.get(), r)) {
+        case SSL_ERROR_WANT_READ:
+        case SSL_ERROR_WANT_WRITE: return AGAIN;
+        case SSL_ERROR_ZERO_RETURN: return 0;   // close_notify
+        default: error = failure(); return -1;
+        }
+    }
+};
+
+} // namespace net
+#endif // NET_TLS
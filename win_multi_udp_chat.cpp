@@ -1,4 +1,5 @@
-#define NOMINMAX
+// UDP 멀티-유저 채팅. socket_core.h 위에서 Windows, Linux 둘 다 빌드된다.
+// 입력 스레드가 줄을 큐에 넣고 Waker 로 메인 루프를 깨운다 (메인 루프는 소켓과 Waker 를 같이 기다린다).
 
 #include <iostream>
 #include <string>
@@ -9,13 +10,9 @@
 #include <thread>
 #include <mutex>
 #include <queue>
-#include <condition_variable>
 #include <atomic>
 
-#include <winsock2.h>
-#include <ws2tcpip.h>
-
-#pragma comment(lib, "ws2_32.lib")
+#include "socket_core.h"    // WinSock2 / POSIX 소켓, Poller, Waker
 
 #define BUF_SIZE 1024
 
@@ -33,21 +30,13 @@ void printPrompt(const std::string& targetName) {
     std::cout.flush();              // [분석] 출력 버퍼 즉시 비움
 }
 
-int main() {
-    SOCKET sockfd = INVALID_SOCKET;      // [분석] UDP 통신에 사용할 소켓 핸들
-    sockaddr_in local_addr{};            // [분석] 로컬(내 컴퓨터) 바운드 주소 구조체
-
+int main() try {
     int local_port = 0;                  // [분석] 사용자가 입력하는 로컬 포트
     int peerCount = 0;                   // [분석] 등록할 피어 수
     std::vector<Peer> peers;             // [분석] 피어 목록 저장 벡터
 
-    // Winsock 초기화
-    WSADATA wsaData;
-    int wsaRet = WSAStartup(MAKEWORD(2, 2), &wsaData); // [분석] Windows에서 소켓 기능 활성화 필수 호출
-    if (wsaRet != 0) {
-        cerr << "WSAStartup 실패, 오류 코드: " << wsaRet << endl;
-        return 1;
-    }
+    // Winsock 초기화 (소멸자가 WSACleanup)
+    net::WinsockInit winsock;            // [분석] Windows에서 소켓 기능 활성화 필수 호출
 
     // 1) 설정 입력
     cout << "[설정] 내(로컬) 포트 번호를 입력하세요: ";
@@ -57,12 +46,10 @@ int main() {
 
     if (local_port <= 0 || local_port > 65535) { // [분석] 포트 번호 유효범위 검사
         cerr << "로컬 포트 번호는 1~65535 사이여야 합니다.\n";
-        WSACleanup();
         return 1;
     }
     if (peerCount <= 0) {
         cerr << "최소 1명 이상의 피어가 필요합니다.\n";
-        WSACleanup();
         return 1;
     }
 
@@ -86,16 +73,12 @@ int main() {
 
         if (p.port <= 0 || p.port > 65535) {  // [분석] 포트 범위 검사
             cerr << "포트 번호는 1~65535 사이여야 합니다.\n";
-            WSACleanup();
             return 1;
         }
 
-        memset(&p.addr, 0, sizeof(p.addr)); // [분석] 주소 구조체 초기화
-        p.addr.sin_family = AF_INET;        // [분석] IPv4
-        p.addr.sin_port = htons(static_cast<uint16_t>(p.port)); // [분석] 포트를 network byte order 로 변환
-        if (::inet_pton(AF_INET, p.ipStr.c_str(), &p.addr.sin_addr) <= 0) { // [분석] IP 문자열 → binary 변환
+        // [분석] IPv4 주소 구조체 (포트는 network byte order). IP 문자열 또는 호스트 이름
+        if (!net::parseAddress(p.ipStr, static_cast<uint16_t>(p.port), p.addr)) {
             cerr << "잘못된 IP 주소: " << p.ipStr << "\n";
-            WSACleanup();
             return 1;
         }
 
@@ -104,32 +87,15 @@ int main() {
 
     if (peers.empty()) { // [분석] 피어가 1명도 없으면 통신 불가
         cerr << "피어가 없습니다.\n";
-        WSACleanup();
         return 1;
     }
 
     int currentPeerIdx = 0;                 // [분석] 첫 피어를 기본 선택
     string currentTargetName = peers[currentPeerIdx].name; // [분석] 현재 메시지를 보낼 대상 이름
 
-    // 2) UDP 소켓 생성 & bind
-    sockfd = ::socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP); // [분석] UDP 소켓 생성
-    if (sockfd == INVALID_SOCKET) {
-        cerr << "socket() 실패: " << WSAGetLastError() << "\n";
-        WSACleanup();
-        return 1;
-    }
-
-    memset(&local_addr, 0, sizeof(local_addr));
-    local_addr.sin_family = AF_INET;           // [분석] IPv4
-    local_addr.sin_addr.s_addr = htonl(INADDR_ANY); // [분석] 모든 로컬 인터페이스에서 수신
-    local_addr.sin_port = htons(static_cast<uint16_t>(local_port)); // [분석] 바인드할 포트
-
-    if (::bind(sockfd, reinterpret_cast<sockaddr*>(&local_addr), sizeof(local_addr)) == SOCKET_ERROR) {
-        cerr << "bind() 실패: " << WSAGetLastError() << "\n";
-        closesocket(sockfd);
-        WSACleanup();
-        return 1;
-    }
+    // 2) UDP 소켓 생성 & bind (모든 로컬 인터페이스). 실패하면 runtime_error
+    net::Socket sock = net::udpBind(static_cast<uint16_t>(local_port)); // [분석] 소멸자가 closesocket
+    SOCKET sockfd = sock.get();
 
     cout << "\n=== UDP 멀티-유저 채팅 시작 ===\n";
     cout << "로컬 포트: " << local_port << "\n";
@@ -149,23 +115,29 @@ int main() {
     // 입력 큐 + 동기화 객체
     queue<string> inputQueue;             // [분석] 입력 문자열을 저장하는 큐
     mutex qMutex;                         // [분석] 큐 보호용 뮤텍스
-    condition_variable qCv;               // [분석] 입력 대기용 조건 변수
+    net::Waker inputWaker;                // [분석] 입력이 들어오면 메인 루프의 wait 를 깨운다
     atomic<bool> running(true);           // [분석] 프로그램 동작 여부 플래그
 
+    // 메인 루프가 기다릴 것: UDP 소켓 + Waker
+    net::Poller poller;
+    poller.add(sockfd, net::Poller::READ);
+    poller.add(inputWaker.fd(), net::Poller::READ);
+    vector<net::Poller::Event> events;
+
     // 입력 스레드: 블로킹 getline을 이 스레드가 담당하여 큐에 넣음
     thread inputThread([&]() {
         while (running.load()) {                          // [분석] running이 true일 때만 입력 처리
             string line;
             if (!std::getline(cin, line)) {               // [분석] Ctrl+Z 등으로 입력 스트림 종료 가능
                 running.store(false);
-                qCv.notify_all();                         // [분석] 대기 중인 스레드 깨움
+                inputWaker.wake();                        // [분석] 대기 중인 메인 루프 깨움
                 break;
             }
             {
                 lock_guard<mutex> lock(qMutex);          // [분석] 큐 안전 접근
                 inputQueue.push(line);                   // [분석] 입력 저장
             }
-            qCv.notify_all();                             // [분석] 입력 도착 알림
+            inputWaker.wake();                            // [분석] 입력 도착 알림
             if (line == "/quit") {                       // [분석] 종료 명령이면 스레드 종료
                 running.store(false);
                 break;
@@ -173,32 +145,23 @@ int main() {
         }
     });
 
-    // 메인 루프: select로 소켓 수신, 그리고 입력 큐 처리
+    // 메인 루프: Poller 로 소켓 수신과 입력을 같이 기다린 뒤 입력 큐 처리
     while (running.load()) {
-        // select 준비
-        fd_set readfds;
-        FD_ZERO(&readfds);                    // [분석] fd_set 초기화
-        FD_SET(sockfd, &readfds);             // [분석] 소켓을 감시 목록에 등록
-
-        TIMEVAL tv;
-        tv.tv_sec = 0;
-        tv.tv_usec = 200000;                  // [분석] 0.2초 타임아웃
-
-        // [분석] select() 호출: 소켓에 읽을 데이터가 있는지 검사 (Windows에서는 첫 인자는 0 사용)
-        int ret = ::select(0, &readfds, nullptr, nullptr, &tv);
-
-        // [분석] select() 수행 중 오류가 발생한 경우
-        if (ret == SOCKET_ERROR) {
-            cerr << "select() 실패, 오류 코드: " << WSAGetLastError() << "\n";
-            break;
+        // [분석] 타임아웃 없이 잔다: 소켓에 데이터가 오거나 입력 스레드가 wake() 할 때만 깬다
+        poller.wait(events, -1);
+
+        bool readable = false;
+        for (auto& ev : events) {
+            if (ev.fd == sockfd) readable = true;
+            else inputWaker.drain();          // [분석] 깨운 표시 지우기 (큐는 아래에서 비운다)
         }
 
         // 소켓 수신 처리
-        // [분석] select 결과: 소켓에 읽을 데이터가 있을 경우만 실행
-        if (ret > 0 && FD_ISSET(sockfd, &readfds)) {
+        // [분석] Poller 결과: 소켓에 읽을 데이터가 있을 경우만 실행
+        if (readable) {
             char recv_buf[BUF_SIZE + 1];                  // [분석] 수신 버퍼 (+1은 NULL 문자 공간)
             sockaddr_in from_addr{};                      // [분석] 발신자 주소
-            int from_len = sizeof(from_addr);
+            socklen_t from_len = sizeof(from_addr);
 
             // [분석] recvfrom(): UDP 패킷을 읽고 발신자 주소를 받음
             int received = ::recvfrom(sockfd, recv_buf, BUF_SIZE, 0,
@@ -206,7 +169,7 @@ int main() {
                 &from_len);
 
             if (received == SOCKET_ERROR) {
-                cerr << "recvfrom() 실패: " << WSAGetLastError() << "\n";
+                cerr << "recvfrom() 실패: " << net::lastWinsockError() << "\n";
                 break;  // [분석] 수신 실패 → 루프 탈출
             }
 
@@ -316,7 +279,7 @@ int main() {
                                 sizeof(p.addr)
                             );
                             if (sent == SOCKET_ERROR) {
-                                cerr << "sendto() 실패: " << WSAGetLastError() << "\n";
+                                cerr << "sendto() 실패: " << net::lastWinsockError() << "\n";
                             }
                         }
                         cout << "모든 피어에게 전송되었습니다.\n";
@@ -340,7 +303,7 @@ int main() {
                     );
 
                     if (sent == SOCKET_ERROR) {
-                        cerr << "sendto() 실패: " << WSAGetLastError() << "\n";
+                        cerr << "sendto() 실패: " << net::lastWinsockError() << "\n";
                     }
                 }
                 else {
@@ -354,11 +317,12 @@ int main() {
 
     // 정리
     running.store(false); // [분석] 종료 플래그 설정
-    qCv.notify_all();     // [분석] 조건 변수 대기 스레드 깨우기
     if (inputThread.joinable()) inputThread.join(); // [분석] 입력 스레드 종료 대기
 
-    if (sockfd != INVALID_SOCKET) closesocket(sockfd); // [분석] 소켓 닫기
-    WSACleanup(); // [분석] Winsock 자원 해제
-
+    // [분석] 소켓 닫기, Winsock 자원 해제는 sock / winsock 의 소멸자
     return 0;
 }
+catch (const exception& e) {   // [분석] socket/bind 실패 등
+    cerr << e.what() << "\n";
+    return 1;
+}
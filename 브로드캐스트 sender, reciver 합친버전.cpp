@@ -1,78 +1,161 @@
 #define _WINSOCK_DEPRECATED_NO_WARNINGS
-#include <winsock2.h>
+#include "socket_core.h"   // 소켓, Poller, Waker (Windows, Linux 공통)
 #include <iostream>
 #include <thread>
-
-#pragma comment(lib, "ws2_32.lib")
+#include <mutex>
+#include <condition_variable>
+#include <map>
+#include <string>
+#include <vector>
+#include <cctype>
+#include "fec.h"
 
 #define PORT      9000
 #define BUF_SIZE  512
+#define FEC_FLUSH_MS  50   // 덜 찬 FEC 블록을 닫기까지 기다리는 시간
+
+// 사용법: 실행파일 [--fec K M]
+//   --fec K M : 메시지 K개마다 parity M개를 같이 방송 (수신 쪽은 옵션 없이도 FEC 를 알아듣는다)
+
+void PrintMessage(const sockaddr_in& from, const char* msg, size_t len, bool recovered)
+{
+    std::cout << "[수신] "
+        << net::sockaddrToString(from) // IP 주소:포트 번호 출력
+        << " : " << std::string(msg, len)
+        << (recovered ? " (FEC 복구)" : "") << std::endl;
+}
+
+// 대소문자 구분 없이 같은지 (_stricmp 대신)
+bool EqualsIgnoreCase(const char* a, const char* b)
+{
+    for (; *a && *b; ++a, ++b)
+        if (std::tolower((unsigned char)*a) != std::tolower((unsigned char)*b)) return false;
+    return *a == *b;
+}
 
-void RecvThread(SOCKET sock)
+// 소켓과 stop 을 같이 기다린다. main 이 stop.wake() 하면 돌아온다 (join 할 수 있게)
+void RecvThread(SOCKET sock, const net::Waker& stop)
 {
     char buf[BUF_SIZE];
     sockaddr_in from;
-    int addrlen = sizeof(from);
+    socklen_t addrlen = sizeof(from);
+    std::map<unsigned long long, fec::Decoder> decoders; // 송신자(IP:포트)마다 블록 번호가 따로 간다
+
+    net::Poller poller;
+    poller.add(sock, net::Poller::READ);
+    poller.add(stop.fd(), net::Poller::READ);
+    std::vector<net::Poller::Event> events;
 
     while (true) {
+        poller.wait(events, -1);
+        bool readable = false;
+        for (auto& ev : events) {
+            if (ev.fd == stop.fd()) return;
+            readable = true;
+        }
+        if (!readable) continue;
+
+        addrlen = sizeof(from);
         int ret = recvfrom(sock, buf, BUF_SIZE - 1, 0, (sockaddr*)&from, &addrlen);
         if (ret > 0) {
+            if (fec::isPacket(buf, ret)) {
+                unsigned long long key = ((unsigned long long)from.sin_addr.s_addr << 16) | from.sin_port;
+                decoders[key].onPacket(buf, ret, [&](const char* msg, size_t len, bool recovered) { PrintMessage(from, msg, len, recovered); });
+                continue;
+            }
             buf[ret] = 0;
-
-            std::cout << "[수신] "
-                << inet_ntoa(from.sin_addr) // IP 주소 출력
-                << ":" << ntohs(from.sin_port) // 포트 번호 출력
-                << " : " << buf << std::endl;
+            PrintMessage(from, buf, ret, false);
         }
     }
 }
 
-int main()
+int main(int argc, char** argv)
 {
-    WSADATA wsa;
-    WSAStartup(MAKEWORD(2, 2), &wsa);
-
-    // UDP 소켓 생성
-    SOCKET sock = socket(AF_INET, SOCK_DGRAM, 0);
-
-    // 옵션: 브로드캐스트 + 주소 재사용
-    BOOL opt = TRUE;
-    setsockopt(sock, SOL_SOCKET, SO_BROADCAST, (char*)&opt, sizeof(opt));
-    setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, (char*)&opt, sizeof(opt));
-    // Windows에는 SO_REUSEPORT 없음 → SO_REUSEADDR만 써도 다중 실행 가능
-
-    // bind
-    sockaddr_in local = {};
-    local.sin_family = AF_INET;
-    local.sin_addr.s_addr = htonl(INADDR_ANY);
-    local.sin_port = htons(PORT);
-
-    if (bind(sock, (sockaddr*)&local, sizeof(local)) == SOCKET_ERROR) {
-        std::cout << "bind 실패! 포트 이미 사용 중" << std::endl;
+    int fecK = 0, fecM = 0;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--fec") == 0 && i + 2 < argc) { fecK = atoi(argv[i + 1]); fecM = atoi(argv[i + 2]); i += 2; }
+    }
+    if (fecK < 0 || fecM < 0 || fecK + fecM > fec::MAX_SHARDS || (fecK > 0) != (fecM > 0)) {
+        std::cout << "--fec K M : K >= 1, M >= 1, K + M <= 255" << std::endl;
+        return 1;
+    }
+
+    net::WinsockInit winsock;
+
+    // UDP 소켓 생성 + 옵션 (브로드캐스트 + 주소 재사용) + bind
+    // Windows에는 SO_REUSEPORT 없음 → SO_REUSEADDR만 써도 다중 실행 가능 (Linux 는 같은 포트 두 번째 실행이 bind 실패)
+    net::Socket sockHolder;
+    try {
+        sockHolder = net::udpBind(PORT, true, true);
+    }
+    catch (const std::exception& e) {
+        std::cout << "bind 실패! 포트 이미 사용 중 (" << e.what() << ")" << std::endl;
         return 1;
     }
+    SOCKET sock = sockHolder.get();
 
-    // 수신 스레드 시작
-    std::thread th(RecvThread, sock);
-    th.detach();
+    // 수신 스레드 시작 (끝낼 때 recvStop.wake() 후 join)
+    net::Waker recvStop;
+    std::thread th(RecvThread, sock, std::cref(recvStop));
 
     // 송신용 주소
-    sockaddr_in bc = {};
-    bc.sin_family = AF_INET;
-    bc.sin_addr.s_addr = inet_addr("255.255.255.255");
-    bc.sin_port = htons(PORT);
+    sockaddr_in bc = net::anyAddress(PORT);
+    bc.sin_addr.s_addr = htonl(INADDR_BROADCAST);
+
+    // FEC: 메시지는 바로 보내고, 블록이 차거나 FEC_FLUSH_MS 가 지나면 parity 를 보낸다
+    fec::Encoder encoder(fecK > 0 ? fecK : 1, fecM > 0 ? fecM : 1);
+    std::mutex fecMtx;
+    std::condition_variable fecCv;
+    bool quit = false;
+    auto sendFrames = [&](const std::vector<std::string>& frames) {
+        for (auto& f : frames) sendto(sock, f.data(), (int)f.size(), 0, (sockaddr*)&bc, sizeof(bc));
+    };
+    std::thread flusher;
+    if (fecK > 0) {
+        std::cout << "FEC: 메시지 " << fecK << "개마다 parity " << fecM << "개" << std::endl;
+        flusher = std::thread([&]() {
+            std::unique_lock<std::mutex> lk(fecMtx);
+            while (!quit) {
+                if (!encoder.pending()) { fecCv.wait(lk); continue; }
+                auto due = encoder.openedAt() + std::chrono::milliseconds(FEC_FLUSH_MS);
+                if (std::chrono::steady_clock::now() < due) { fecCv.wait_until(lk, due); continue; }
+                std::vector<std::string> frames;
+                encoder.flush(frames);
+                sendFrames(frames);
+            }
+        });
+    }
 
     // 송신 루프
     while (true) {
         char msg[128];
-        std::cin.getline(msg, 128);
+        if (!std::cin.getline(msg, 128)) break;
 
-        if (_stricmp(msg, "quit") == 0) break;
+        if (EqualsIgnoreCase(msg, "quit")) break;
 
-        sendto(sock, msg, strlen(msg), 0, (sockaddr*)&bc, sizeof(bc));
+        if (fecK > 0) {
+            std::vector<std::string> frames;
+            std::lock_guard<std::mutex> lg(fecMtx);
+            encoder.add(msg, strlen(msg), frames);
+            sendFrames(frames);
+            fecCv.notify_one();
+        }
+        else sendto(sock, msg, (int)strlen(msg), 0, (sockaddr*)&bc, sizeof(bc));
+    }
+
+    if (flusher.joinable()) {
+        {
+            std::lock_guard<std::mutex> lg(fecMtx);
+            std::vector<std::string> frames;
+            encoder.flush(frames);
+            sendFrames(frames);
+            quit = true;
+        }
+        fecCv.notify_one();
+        flusher.join();
     }
 
-    closesocket(sock);
-    WSACleanup();
+    recvStop.wake();
+    th.join();
     return 0;
 }
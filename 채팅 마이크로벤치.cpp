@@ -0,0 +1,429 @@
+// chat_microbench.cpp
+// UDP+TCP통합 채팅 프로그램의 메시지당 hot path 마이크로벤치 (Google Benchmark)
+// Build (Linux):   g++ -std=c++20 -O2 -pthread chat_microbench.cpp -o chat-microbench -lbenchmark
+// Build (Windows): cl /EHsc /std:c++20 /O2 chat_microbench.cpp ws2_32.lib benchmark.lib shlwapi.lib
+
+/*
+[사용법 예시]
+   > ./chat-microbench
+   > ./chat-microbench --benchmark_filter=Broadcast --benchmark_repetitions=5
+   > ./chat-microbench --benchmark_out=after.json --benchmark_out_format=json
+   > ./chat-microbench --benchmark_filter=Forward && echo ok      (전달 경로의 malloc 검사: 빌드 뒤 돌리는 게이트)
+   - 채팅 프로그램 소스를 그대로 include 해서 (main 은 CHAT_NO_MAIN 으로 뺀다) 실제 함수를 잰다.
+   - 이 경로를 바꾸는 변경은 before/after JSON 을 같이 낼 것. 비교는 google/benchmark 의 tools/compare.py:
+     > compare.py benchmarks before.json after.json
+   - 대상:
+     sockaddrToString, Logger::timestamp, Logger::log (cout 은 버린다),
+     clientHandler 의 메시지 만들기 (buildTcpMessage),
+     registerUdpClient (등록된 클라이언트 10 ~ 100k: 재등록 / 새 주소),
+     TimerWheel 다시 걸기 (걸린 timer 10 ~ 100k, 옛 Reactor 의 multimap 과 비교),
+     broadcastTcp (루프백 TCP 쌍 sink), broadcastUdp (루프백 UDP sink),
+     방 fan-out (sink 256개를 8명짜리 방 32개로 나눈 것 vs 256명 방 하나: 글 하나의 비용은 방 크기만 따른다),
+     /msg 받는 사람 찾기 (접속자 16 ~ 16k, NickIndex vs clients 를 이름으로 훑기),
+     binary wire protocol 의 encode / decode (chat_wire.h, 스택 버퍼만),
+     TCP / UDP 메시지 하나의 전달 (clientHandler 의 onClientText, udpLoop 의 forwardUdp) 과 그 malloc 횟수
+   - 전달 벤치는 데운 뒤의 malloc 을 전역 operator new 로 세어 allocs_per_msg 로 낸다.
+     0 이 아니면 그 벤치를 에러로 표시하고, 프로세스가 exit code 1 로 끝난다 (버퍼 풀이 깨진 것).
+     전달 경로를 바꾸면 꼭 위의 --benchmark_filter=Forward 로 돌려 볼 것 (스크립트 / CI 가 실패로 본다).
+*/
+
+#include <benchmark/benchmark.h>
+
+#define CHAT_NO_MAIN
+#include "UDP+TCP통합 채팅 프로그램.cpp"
+
+// 전역 operator new 를 바꿔 malloc 횟수를 센다 (모든 스레드)
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ >= 11
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"   // 바꾼 new/delete 가 malloc/free 로 짝을 이룬다
+#endif
+static atomic<uint64_t> g_allocs{ 0 };
+void* operator new(size_t n) {
+    g_allocs.fetch_add(1, memory_order_relaxed);
+    if (void* p = malloc(n ? n : 1)) return p;
+    throw bad_alloc();
+}
+void operator delete(void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+
+// ChatServer / Logger 의 private 멤버에 닿는 창구 (두 클래스가 friend 로 둔다)
+struct ChatBench {
+    static void timestamp(char* out) { Logger::timestamp(out); }
+
+    // registerUdpClient 를 N 번 부르면 매번 스냅샷을 다시 만들어 O(N^2) 이므로 목록을 직접 채운다
+    static void fillUdpClients(ChatServer& s, int n) {
+        lock_guard<mutex> lg(s.udpMtx);
+        for (int i = 0; i < n; ++i) {
+            UDPClient& u = s.udpClients[endpointKey(benchAddr(i))];
+            u.addr = benchAddr(i);
+            u.name = "user" + to_string(i);
+        }
+        s.rebuildUdpTargets();
+    }
+    static void popUdpClient(ChatServer& s, const sockaddr_in& a) { lock_guard<mutex> lg(s.udpMtx); s.udpClients.erase(endpointKey(a)); }
+    static void registerUdpClient(ChatServer& s, const string& name, const sockaddr_in& from) { s.registerUdpClient(name, from); }
+
+    static shared_ptr<TCPClient> addTcpClient(ChatServer& s, SOCKET sock, const string& name) {
+        auto c = make_shared<TCPClient>();
+        c->sock = sock; c->name = name;
+        lock_guard<mutex> lg(s.clientsMtx);
+        s.clients.push_back(c);
+        return c;
+    }
+    static void fanoutRoom(ChatServer& s, const string& room, const HistoryRing::Message& m) { s.fanoutRoom(room, m, nullptr); }
+    static void broadcastTcp(ChatServer& s, const HistoryRing::Message& m) { s.broadcastTcp(m); }
+    static void broadcastUdp(ChatServer& s, const string& m, SOCKET sock) { s.broadcastUdp(m, sock); }
+    static HistoryRing::Message buildTcpMessage(const string& name, const char* text, size_t len) { return ChatServer::buildTcpMessage(name, text, len); }
+    static void onClientText(ChatServer& s, const shared_ptr<TCPClient>& c, const string& text) { s.onClientText(c, text.data(), text.size()); }
+    static void forwardUdp(ChatServer& s, SOCKET sock, const string& d, const sockaddr_in& from, vector<string>& outs) { s.forwardUdp(sock, d.data(), d.size(), from, outs); }
+
+    // 10.x.y.z:port 로 서로 다른 주소 i 개
+    static sockaddr_in benchAddr(int i) {
+        sockaddr_in a{};
+        a.sin_family = AF_INET;
+        a.sin_addr.s_addr = htonl(0x0A000000u | (uint32_t)(i >> 8));
+        a.sin_port = htons((unsigned short)(10000 + (i & 0xff)));
+        return a;
+    }
+};
+
+// 루프백 TCP 연결 하나: server 쪽은 방송이 쓰는 blocking 소켓, reader 쪽은 비워 주는 non-blocking 소켓
+void loopbackTcpPair(SOCKET& server, SOCKET& reader) {
+    SOCKET l = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    sockaddr_in a{}; a.sin_family = AF_INET; a.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t len = sizeof(a);
+    if (l == INVALID_SOCKET || bind(l, (sockaddr*)&a, sizeof(a)) != 0 || listen(l, 1) != 0 || getsockname(l, (sockaddr*)&a, &len) != 0)
+        throw runtime_error("bench listen failed: " + lastWinsockError());
+    reader = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (connect(reader, (sockaddr*)&a, sizeof(a)) != 0) throw runtime_error("bench connect failed: " + lastWinsockError());
+    server = accept(l, nullptr, nullptr);
+    closesocket(l);
+    if (server == INVALID_SOCKET) throw runtime_error("bench accept failed: " + lastWinsockError());
+    setNonBlocking(reader);
+}
+
+void drain(const vector<SOCKET>& readers) {
+    char buf[65536];
+    for (SOCKET r : readers) while (recv(r, buf, sizeof(buf), 0) > 0) {}
+}
+
+static void BM_SockaddrToString(benchmark::State& state) {
+    sockaddr_in a{}; a.sin_family = AF_INET; inet_pton(AF_INET, "192.168.100.200", &a.sin_addr); a.sin_port = htons(54321);
+    for (auto _ : state) benchmark::DoNotOptimize(sockaddrToString(a));
+}
+BENCHMARK(BM_SockaddrToString);
+
+static void BM_LoggerTimestamp(benchmark::State& state) {
+    char ts[32];
+    for (auto _ : state) { ChatBench::timestamp(ts); benchmark::DoNotOptimize(ts); }
+}
+BENCHMARK(BM_LoggerTimestamp);
+
+static void BM_LoggerLog(benchmark::State& state) {
+    NullBuf null;
+    streambuf* old = cout.rdbuf(&null);
+    const string msg = "TCP msg: [alice] hello everyone, this is a typical chat line";
+    for (auto _ : state) Logger::info(msg);
+    cout.rdbuf(old);
+}
+BENCHMARK(BM_LoggerLog);
+
+// clientHandler 가 받은 글마다 하는 일: 로그 줄 + 공유 방송 버퍼
+static void BM_ClientHandlerBuildMessage(benchmark::State& state) {
+    const string name = "alice";
+    const string text((size_t)state.range(0), 'x');
+    for (auto _ : state) benchmark::DoNotOptimize(ChatBench::buildTcpMessage(name, text.data(), text.size()));
+    state.SetBytesProcessed((int64_t)state.iterations() * state.range(0));
+}
+BENCHMARK(BM_ClientHandlerBuildMessage)->Arg(16)->Arg(256)->Arg(4000);
+
+// binary 프로토콜: 같은 글을 CHAT frame 으로 (버퍼는 호출자 스택)
+static void BM_WireEncode(benchmark::State& state) {
+    const string text((size_t)state.range(0), 'x');
+    char out[wire::HEADER_MAX + 4096];
+    wire::Frame f; f.type = wire::CHAT; f.sender = 12345; f.payload = text.data(); f.len = text.size();
+    for (auto _ : state) benchmark::DoNotOptimize(wire::encode(f, out, sizeof(out)));
+    state.SetBytesProcessed((int64_t)state.iterations() * state.range(0));
+}
+BENCHMARK(BM_WireEncode)->Arg(16)->Arg(256)->Arg(4000);
+
+// 한 번의 recv 에 붙어 온 frame 64개를 잘라 낸다
+static void BM_WireDecode(benchmark::State& state) {
+    const string text((size_t)state.range(0), 'x');
+    string stream;
+    for (int i = 0; i < 64; ++i) stream += makeFrame(wire::CHAT, (uint32_t)i + 1, text.data(), text.size());
+    for (auto _ : state) {
+        size_t off = 0, used = 0;
+        wire::Frame f;
+        while (wire::decode(stream.data() + off, stream.size() - off, f, used) == wire::Status::Ok) { benchmark::DoNotOptimize(f.payload); off += used; }
+    }
+    state.SetItemsProcessed((int64_t)state.iterations() * 64);
+}
+BENCHMARK(BM_WireDecode)->Arg(16)->Arg(256);
+
+// 이미 등록된 주소가 REGISTER 를 다시 보낸 경우 (클라이언트 재시작, 신뢰 채널 재시도)
+static void BM_RegisterUdpClientExisting(benchmark::State& state) {
+    ChatServer server("0");
+    int n = (int)state.range(0);
+    ChatBench::fillUdpClients(server, n);
+    mt19937 rng(1);
+    for (auto _ : state) {
+        int i = (int)(rng() % (uint32_t)n);
+        ChatBench::registerUdpClient(server, "user" + to_string(i), ChatBench::benchAddr(i));
+    }
+}
+BENCHMARK(BM_RegisterUdpClientExisting)->RangeMultiplier(10)->Range(10, 100000);
+
+// 새 주소가 들어오는 경우 (hash 추가 + 대상 스냅샷 재생성). 목록 크기를 n 으로 유지하려고 재지 않고 뺀다.
+static void BM_RegisterUdpClientNew(benchmark::State& state) {
+    ChatServer server("0");
+    int n = (int)state.range(0);
+    ChatBench::fillUdpClients(server, n);
+    sockaddr_in fresh = ChatBench::benchAddr(n);
+    for (auto _ : state) {
+        ChatBench::registerUdpClient(server, "newcomer", fresh);
+        state.PauseTiming();
+        ChatBench::popUdpClient(server, fresh);
+        state.ResumeTiming();
+    }
+}
+BENCHMARK(BM_RegisterUdpClientNew)->RangeMultiplier(10)->Range(10, 100000);
+
+// 연결 n 개가 저마다 idle timer 를 걸어 두고, 그중 하나가 recv 할 때마다 다시 건다 (heartbeat 의 hot path).
+// 칸 리스트에서 빼고 넣기뿐이라 n 과 상관없이 일정해야 한다
+static void BM_TimerWheelRearm(benchmark::State& state) {
+    int n = (int)state.range(0);
+    TimerWheel wheel;
+    vector<TimerWheel::Timer> timers(n);
+    auto now = steady_clock::now();
+    mt19937 rng(1);
+    for (auto& t : timers) wheel.arm(t, now + milliseconds(15000 + rng() % 30000));
+    for (auto _ : state) {
+        int i = (int)(rng() % (uint32_t)n);
+        wheel.arm(timers[i], now + milliseconds(15000 + rng() % 30000));
+    }
+    state.counters["armed"] = (double)wheel.size();
+}
+BENCHMARK(BM_TimerWheelRearm)->RangeMultiplier(10)->Range(10, 100000);
+
+// 같은 일을 timer wheel 전의 Reactor 처럼 multimap 으로 (erase + emplace: log n 과 할당)
+static void BM_TimerMultimapRearm(benchmark::State& state) {
+    int n = (int)state.range(0);
+    multimap<steady_clock::time_point, int> timers;
+    vector<multimap<steady_clock::time_point, int>::iterator> pos(n);
+    auto now = steady_clock::now();
+    mt19937 rng(1);
+    for (int i = 0; i < n; ++i) pos[i] = timers.emplace(now + milliseconds(15000 + rng() % 30000), i);
+    for (auto _ : state) {
+        int i = (int)(rng() % (uint32_t)n);
+        timers.erase(pos[i]);
+        pos[i] = timers.emplace(now + milliseconds(15000 + rng() % 30000), i);
+    }
+}
+BENCHMARK(BM_TimerMultimapRearm)->RangeMultiplier(10)->Range(10, 100000);
+
+// 방송 하나 = sink 수만큼 send + 기록 추가. sink 의 소켓 버퍼가 차지 않도록 64번마다 재지 않고 비운다.
+static void BM_BroadcastTcp(benchmark::State& state) {
+    WinsockInit w;
+    ChatServer server("0");
+    vector<SOCKET> servers, readers;
+    for (int i = 0; i < state.range(0); ++i) {
+        SOCKET s, r;
+        loopbackTcpPair(s, r);
+        servers.push_back(s); readers.push_back(r);
+        ChatBench::addTcpClient(server, s, "sink" + to_string(i));
+    }
+    auto msg = make_shared<const string>("[alice] hello everyone, this is a typical chat line\n");
+    int64_t k = 0;
+    for (auto _ : state) {
+        ChatBench::broadcastTcp(server, msg);
+        if (++k % 64 == 0) { state.PauseTiming(); drain(readers); state.ResumeTiming(); }
+    }
+    state.SetItemsProcessed((int64_t)state.iterations() * state.range(0));   // items = send 수
+    for (SOCKET s : servers) closesocket(s);
+    for (SOCKET r : readers) closesocket(r);
+}
+BENCHMARK(BM_BroadcastTcp)->Arg(1)->Arg(16)->Arg(256);
+
+// sink 256개를 range(0) 명씩 방에 나눠 넣고, 글을 방마다 돌아가며 하나씩 보낸다. items = send 수 (= 방 크기).
+// 8 이면 방 32개, 256 이면 방 하나 (= 방 없이 전체 방송한 BM_BroadcastTcp/256 과 같은 대상 수)
+static void BM_RoomFanout(benchmark::State& state) {
+    WinsockInit w;
+    ChatServer server("0");
+    const int total = 256, roomSize = (int)state.range(0), roomCount = total / roomSize;
+    vector<SOCKET> servers, readers;
+    NullBuf null;
+    streambuf* old = cout.rdbuf(&null);   // /join 마다 남는 입장 로그
+    for (int i = 0; i < total; ++i) {
+        SOCKET s, r;
+        loopbackTcpPair(s, r);
+        servers.push_back(s); readers.push_back(r);
+        auto c = ChatBench::addTcpClient(server, s, "sink" + to_string(i));
+        ChatBench::onClientText(server, c, "/join room" + to_string(i / roomSize));
+    }
+    cout.rdbuf(old);
+    drain(readers);
+    vector<string> names;
+    for (int i = 0; i < roomCount; ++i) names.push_back("room" + to_string(i));
+    auto msg = make_shared<const string>("[#room] [alice] hello everyone, this is a typical chat line\n");
+    int64_t k = 0;
+    for (auto _ : state) {
+        ChatBench::fanoutRoom(server, names[(size_t)(k % roomCount)], msg);
+        if (++k % 64 == 0) { state.PauseTiming(); drain(readers); state.ResumeTiming(); }
+    }
+    state.SetItemsProcessed((int64_t)state.iterations() * roomSize);
+    state.counters["rooms"] = roomCount;
+    for (SOCKET s : servers) closesocket(s);
+    for (SOCKET r : readers) closesocket(r);
+}
+BENCHMARK(BM_RoomFanout)->Arg(8)->Arg(256);
+
+// /msg 의 받는 사람 찾기: 접속자 range(0) 명 중 하나. NickIndex 는 shard 하나의 읽기 락 + 해시 한 번,
+// BM_NickScan 은 인덱스 전처럼 clientsMtx 안에서 clients 를 이름으로 훑는다 (보내기는 둘 다 같으므로 빼고 잰다)
+static void BM_NickLookup(benchmark::State& state) {
+    const int n = (int)state.range(0);
+    NickIndex index;
+    vector<string> names;
+    for (int i = 0; i < n; ++i) {
+        auto c = make_shared<TCPClient>();
+        c->name = "user" + to_string(i);
+        index.addTcp(c->name, c);
+        names.push_back(c->name);
+    }
+    int64_t k = 0, hits = 0;
+    for (auto _ : state) {
+        const string& to = names[(size_t)(k++ * 7919 % n)];
+        index.find(to, [&](NickIndex::Entry& e) { hits += (int64_t)e.tcp.size(); });
+    }
+    benchmark::DoNotOptimize(hits);
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_NickLookup)->Arg(16)->Arg(1024)->Arg(16384);
+
+static void BM_NickScan(benchmark::State& state) {
+    const int n = (int)state.range(0);
+    mutex mtx;
+    vector<shared_ptr<TCPClient>> clients;
+    vector<string> names;
+    for (int i = 0; i < n; ++i) {
+        auto c = make_shared<TCPClient>();
+        c->name = "user" + to_string(i);
+        clients.push_back(c);
+        names.push_back(c->name);
+    }
+    int64_t k = 0, hits = 0;
+    for (auto _ : state) {
+        const string& to = names[(size_t)(k++ * 7919 % n)];
+        lock_guard<mutex> lg(mtx);
+        for (auto& c : clients) if (c->name == to) ++hits;
+    }
+    benchmark::DoNotOptimize(hits);
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_NickScan)->Arg(16)->Arg(1024)->Arg(16384);
+
+// sink 는 읽지 않는다: 수신 큐가 차면 커널이 버리지만 재는 대상인 송신 비용은 같다 (benchUdpFanout 과 같음)
+static void BM_BroadcastUdp(benchmark::State& state) {
+    WinsockInit w;
+    ChatServer server("0");
+    sockaddr_in txAddr{};
+    SOCKET tx = benchUdpSocket(txAddr);
+    vector<SOCKET> sinks;
+    for (int i = 0; i < state.range(0); ++i) {
+        sockaddr_in a{};
+        sinks.push_back(benchUdpSocket(a));
+        ChatBench::registerUdpClient(server, "sink" + to_string(i), a);
+    }
+    const string msg = "[UDP][127.0.0.1:40000] hello everyone, this is a typical chat line";
+    for (auto _ : state) ChatBench::broadcastUdp(server, msg, tx);
+    state.SetItemsProcessed((int64_t)state.iterations() * state.range(0));
+    closesocket(tx);
+    for (SOCKET s : sinks) closesocket(s);
+}
+BENCHMARK(BM_BroadcastUdp)->Arg(1)->Arg(16)->Arg(256);
+
+// 할당한 전달 벤치 수. 0 이 아니면 main 이 1 을 돌려준다 (SkipWithError 만으로는 exit code 가 0 이다)
+static atomic<int> g_allocFailures{ 0 };
+
+// 데운 뒤의 malloc 횟수를 counter 로. 0 이 아니면 에러로 표시하고 실패로 센다.
+static void reportAllocs(benchmark::State& state, uint64_t allocs) {
+    state.counters["allocs_per_msg"] = benchmark::Counter((double)allocs / (double)max<int64_t>(1, (int64_t)state.iterations()));
+    if (!allocs) return;
+    g_allocFailures.fetch_add(1);
+    state.SkipWithError(("steady-state forward made " + to_string(allocs) + " allocation(s)").c_str());
+}
+
+// TCP 글 하나: 방송 버퍼 만들기 + 로그 줄 + sink 수만큼 send + 기록. 풀과 기록 링이 찰 때까지 먼저 데운다.
+static void BM_TcpForward(benchmark::State& state) {
+    WinsockInit w;
+    NullBuf null;
+    streambuf* old = cout.rdbuf(&null);
+    ChatServer server("0");
+    vector<SOCKET> servers, readers;
+    for (int i = 0; i < state.range(0); ++i) {
+        SOCKET s, r;
+        loopbackTcpPair(s, r);
+        servers.push_back(s); readers.push_back(r);
+        ChatBench::addTcpClient(server, s, "sink" + to_string(i));
+    }
+    auto sender = make_shared<TCPClient>();
+    sender->name = "alice"; sender->id = 1000;
+    const string text = "hello everyone, this is a typical chat line";
+    for (int i = 0; i < 4096; ++i) { ChatBench::onClientText(server, sender, text); if (i % 64 == 0) drain(readers); }
+    drain(readers);
+    uint64_t before = g_allocs.load();
+    int64_t k = 0;
+    for (auto _ : state) {
+        ChatBench::onClientText(server, sender, text);
+        if (++k % 64 == 0) { state.PauseTiming(); drain(readers); state.ResumeTiming(); }
+    }
+    uint64_t allocs = g_allocs.load() - before;
+    cout.rdbuf(old);
+    reportAllocs(state, allocs);
+    for (SOCKET s : servers) closesocket(s);
+    for (SOCKET r : readers) closesocket(r);
+}
+BENCHMARK(BM_TcpForward)->Arg(1)->Arg(16);
+
+// UDP datagram 하나: 방송 줄 만들기 + 로그 줄 + plain sink 수만큼 sendto
+static void BM_UdpForward(benchmark::State& state) {
+    WinsockInit w;
+    NullBuf null;
+    streambuf* old = cout.rdbuf(&null);
+    ChatServer server("0");
+    sockaddr_in txAddr{};
+    SOCKET tx = benchUdpSocket(txAddr);
+    vector<SOCKET> sinks;
+    for (int i = 0; i < state.range(0); ++i) {
+        sockaddr_in a{};
+        sinks.push_back(benchUdpSocket(a));
+        ChatBench::registerUdpClient(server, "sink" + to_string(i), a);
+    }
+    const sockaddr_in from = ChatBench::benchAddr(7);
+    const string text = "hello everyone, this is a typical chat line";
+    vector<string> outs;
+    for (int i = 0; i < 4096; ++i) ChatBench::forwardUdp(server, tx, text, from, outs);
+    uint64_t before = g_allocs.load();
+    for (auto _ : state) ChatBench::forwardUdp(server, tx, text, from, outs);
+    uint64_t allocs = g_allocs.load() - before;
+    cout.rdbuf(old);
+    reportAllocs(state, allocs);
+    closesocket(tx);
+    for (SOCKET s : sinks) closesocket(s);
+}
+BENCHMARK(BM_UdpForward)->Arg(1)->Arg(16);
+
+int main(int argc, char** argv) {
+#ifndef _WIN32
+    signal(SIGPIPE, SIG_IGN);
+#endif
+    WinsockInit w;
+    benchmark::Initialize(&argc, argv);
+    if (benchmark::ReportUnrecognizedArguments(argc, argv)) return 1;
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    if (int n = g_allocFailures.load()) {
+        cerr << "FAIL: " << n << " forward benchmark(s) allocated per message" << endl;
+        return 1;
+    }
+    return 0;
+}
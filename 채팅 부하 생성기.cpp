@@ -0,0 +1,504 @@
+// chat_loadgen.cpp
+// UDP+TCP통합 채팅 프로그램의 ChatServer 에 루프백으로 수천 개의 클라이언트를 붙여 방송 지연/처리량을 재는 부하 생성기 (Linux)
+// Build (Linux): g++ -std=c++17 -O2 -pthread chat_loadgen.cpp -o chat-load
+
+/*
+[사용법 예시]
+1. 서버 실행 (클라이언트마다 fd 를 쓰므로 ulimit -n 을 넉넉히):
+   > ulimit -n 65536; ./chat
+   Select: 1
+   Port: 9000
+
+2. 부하 생성:
+   > ./chat-load --port 9000 --clients 100,500,1000,2000 --senders 10 --rate 1000 --seconds 5
+   - 옵션:
+     --host H            서버 주소 (기본 127.0.0.1)
+     --port P            서버 포트 (기본 9000)
+     --ports P1,P2,...   federation 노드들의 포트. 클라이언트 i 는 i % 노드 수 번째 노드에 붙는다
+     --node-sweep        --ports 의 앞 1개, 2개, ... 노드로 단계를 반복한다 (노드를 늘릴 때의 총 처리량)
+     --clients A,B,...   단계별 클라이언트 수. 모두 같은 방이므로 방 크기이기도 하다 (기본 100)
+     --senders N         그중 메시지를 보내는 클라이언트 수 (기본 10)
+     --rate R            전체 초당 메시지 수 (기본 1000)
+     --size B            메시지 크기 (기본 64, 타임스탬프 토큰보다 작으면 토큰 크기)
+     --seconds S         단계별 측정 시간 (기본 5)
+     --warmup S          측정 전에 보내기만 하는 시간 (기본 1)
+     --threads T         이벤트 루프 스레드 수 (기본 4)
+     --udp               /udp 처럼 UDP 로 보내고 UDP 방송으로 받는다 (기본 TCP)
+   - 클라이언트는 ChatClient 와 같이 TCP 로 닉네임을 보내고 UDP 로 "REGISTER <닉네임>" 한다.
+   - 메시지에는 "LG:<run>:<보낸 시각 ns>;" 토큰이 들어 있어 받는 쪽이 방송 지연을 잰다.
+     다른 단계나 서버 기록 재전송으로 온 토큰은 run 이 달라 세지 않는다.
+   - 결과: 단계마다 한 줄. 전달률, 초당 전달 메시지 수/바이트, 방송 지연 p50/p99/p99.9/max
+   - federation 측정 예시 (노드 3개, 뒤 노드가 앞 노드들에 연결):
+     > ./chat --node-id 1 --mesh-port 9601                                         (Port 9001)
+     > ./chat --node-id 2 --mesh-port 9602 --mesh-peers 127.0.0.1:9601             (Port 9002)
+     > ./chat --node-id 3 --mesh-peers 127.0.0.1:9601,127.0.0.1:9602               (Port 9003)
+     > ./chat-load --ports 9001,9002,9003 --node-sweep --clients 300,1500
+     모든 노드가 한 방이므로 기대 전달 수는 단일 서버와 같다 (보낸 수 x (연결 수 - 1)).
+   - 서버는 --udp-idle-timeout (기본 90초) 동안 REGISTER 가 없는 UDP 등록을 지운다. 부하 생성기도 ChatClient 처럼
+     CLIENT_UDP_REFRESH 마다 (클라이언트들에 고르게 나눠) REGISTER 를 다시 보내므로 긴 --udp 단계에서도 받는 쪽이 빠지지 않는다.
+     앞 단계의 주소는 그 timeout 이 지나야 지워지므로 --udp 단계를 바로 이어 재면 그동안 죽은 주소로의 방송이 섞인다:
+     단계 사이를 timeout 만큼 띄우거나 서버를 새로 띄울 것.
+*/
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/resource.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <csignal>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <array>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <iomanip>
+#include <algorithm>
+#include <random>
+#include <memory>
+#include <limits>
+#include <cmath>
+
+using namespace std;
+using namespace std::chrono;
+
+constexpr int BUF_SIZE = 65536;
+constexpr int MAX_EVENTS = 256;
+constexpr const char* TOKEN = "LG:";
+constexpr int64_t CLIENT_UDP_REFRESH_NS = 30 * 1000000000LL;   // UDP REGISTER 를 다시 보내는 간격 (ChatClient 의 CLIENT_UDP_REFRESH)
+
+static int64_t nowNs() { return duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count(); }
+
+// ---------------- Options ----------------
+struct Config {
+    string host = "127.0.0.1";
+    vector<unsigned short> ports{ 9000 };
+    bool nodeSweep = false;
+    vector<int> clients{ 100 };
+    int senders = 10;
+    double rate = 1000;
+    size_t size = 64;
+    double seconds = 5, warmup = 1;
+    int threads = 4;
+    bool udp = false;
+};
+
+Config parseArgs(int argc, char** argv) {
+    Config c;
+    for (int i = 1; i < argc; ++i) {
+        string a = argv[i];
+        auto value = [&]() -> string { if (i + 1 >= argc) throw runtime_error("missing value for " + a); return argv[++i]; };
+        if (a == "--host") c.host = value();
+        else if (a == "--port") c.ports = { (unsigned short)stoi(value()) };
+        else if (a == "--ports") {
+            c.ports.clear();
+            istringstream iss(value());
+            for (string n; getline(iss, n, ',');) if (!n.empty()) c.ports.push_back((unsigned short)stoi(n));
+        }
+        else if (a == "--node-sweep") c.nodeSweep = true;
+        else if (a == "--clients") {
+            c.clients.clear();
+            istringstream iss(value());
+            for (string n; getline(iss, n, ',');) if (!n.empty()) c.clients.push_back(max(1, stoi(n)));
+        }
+        else if (a == "--senders") c.senders = max(1, stoi(value()));
+        else if (a == "--rate") c.rate = max(1.0, stod(value()));
+        else if (a == "--size") c.size = (size_t)max(1, stoi(value()));
+        else if (a == "--seconds") c.seconds = max(0.1, stod(value()));
+        else if (a == "--warmup") c.warmup = max(0.0, stod(value()));
+        else if (a == "--threads") c.threads = max(1, stoi(value()));
+        else if (a == "--udp") c.udp = true;
+        else throw runtime_error("unknown option: " + a);
+    }
+    if (c.clients.empty()) throw runtime_error("--clients needs at least one count");
+    if (c.ports.empty()) throw runtime_error("--ports needs at least one port");
+    return c;
+}
+
+// ---------------- Latency histogram ----------------
+// log-linear: 2 의 거듭제곱 구간마다 16칸 (오차 6% 이하). 스레드마다 하나씩 두고 끝나면 합친다.
+struct LatencyHistogram {
+    static constexpr int SUB = 16;
+    array<uint64_t, 64 * SUB> counts{};
+    uint64_t total = 0;
+    int64_t maxNs = 0;
+
+    static int bucket(uint64_t v) {
+        if (v < SUB) return (int)v;
+        int msb = 63 - __builtin_clzll(v);
+        return (msb - 3) * SUB + (int)((v >> (msb - 4)) & (SUB - 1));
+    }
+    static uint64_t lowerBound(int b) {
+        if (b < SUB) return (uint64_t)b;
+        int msb = b / SUB + 3;
+        return (uint64_t)(SUB + b % SUB) << (msb - 4);
+    }
+
+    void add(int64_t ns) {
+        if (ns < 0) ns = 0;
+        ++counts[bucket((uint64_t)ns)]; ++total;
+        maxNs = max(maxNs, ns);
+    }
+    void merge(const LatencyHistogram& o) {
+        for (size_t i = 0; i < counts.size(); ++i) counts[i] += o.counts[i];
+        total += o.total; maxNs = max(maxNs, o.maxNs);
+    }
+    // 칸의 가운데 값
+    int64_t percentile(double p) const {
+        if (!total) return 0;
+        uint64_t want = (uint64_t)ceil(p * (double)total), seen = 0;
+        for (int b = 0; b < (int)counts.size(); ++b) {
+            seen += counts[b];
+            if (seen >= max<uint64_t>(want, 1)) return (int64_t)min<uint64_t>((lowerBound(b) + lowerBound(b + 1)) / 2, (uint64_t)maxNs);
+        }
+        return maxNs;
+    }
+};
+
+// ---------------- Step ----------------
+// 한 단계 (클라이언트 수 하나) 동안 main 과 worker 가 함께 보는 상태
+struct Step {
+    Config cfg;
+    int clients = 0;
+    uint32_t run = 0;                       // 토큰의 run: 이 단계에서 보낸 것만 센다
+    vector<sockaddr_in> servers;            // 이 단계에 쓰는 노드들
+    atomic<int> connected{ 0 }, failed{ 0 };
+    atomic<bool> sending{ false }, stopping{ false };
+    atomic<int64_t> windowStart{ numeric_limits<int64_t>::max() }, windowEnd{ numeric_limits<int64_t>::max() };
+};
+
+struct WorkerStats {
+    uint64_t sent = 0, sendFailed = 0, delivered = 0, bytes = 0, late = 0;
+    LatencyHistogram latency;
+};
+
+// ---------------- Worker ----------------
+// 클라이언트 여러 개를 epoll 하나로 돌린다. 보내는 쪽은 rate 에 맞춰 타이머로 보낸다.
+class Worker {
+public:
+    Worker(Step& step, int first, int count, int senderCount, double rate)
+        : step(step), rate(rate), ep(epoll_create1(EPOLL_CLOEXEC)), wake(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) {
+        if (ep < 0 || wake < 0) throw runtime_error(string("epoll/eventfd: ") + strerror(errno));
+        watch(wake, EPOLLIN, WAKE_TAG);
+        conns.resize((size_t)count);
+        for (int i = 0; i < count; ++i) {
+            Conn& c = conns[(size_t)i];
+            c.name = "lg" + to_string(step.run % 10000) + "-" + to_string(first + i);
+            c.sender = i < senderCount;
+            c.server = &step.servers[(size_t)(first + i) % step.servers.size()];
+            open(c, (uint32_t)i);
+        }
+    }
+    ~Worker() {
+        for (auto& c : conns) { if (c.tcp >= 0) close(c.tcp); if (c.udp >= 0) close(c.udp); }
+        close(ep); close(wake);
+    }
+
+    void kick() { uint64_t one = 1; if (write(wake, &one, sizeof(one)) < 0) {} }
+    void start() { th = thread(&Worker::loop, this); }
+    void join() { if (th.joinable()) th.join(); }
+    const WorkerStats& stats() const { return st; }
+
+private:
+    struct Conn {
+        int tcp = -1, udp = -1;
+        bool connected = false, sender = false;
+        const sockaddr_in* server = nullptr;   // 붙을 노드
+        string name, inbuf;
+        string out;                            // TCP 로 일부만 나간 메시지의 남은 바이트. 다 나갈 때까지 다음 메시지를 붙이지 않는다
+    };
+    static constexpr uint64_t WAKE_TAG = ~0ull;
+
+    Step& step;
+    double rate;                 // 이 worker 가 보낼 초당 메시지 수
+    int ep, wake;
+    vector<Conn> conns;
+    thread th;
+    WorkerStats st;
+    string payload;
+
+    // data.u64: 클라이언트 번호 * 2 + (0 = TCP, 1 = UDP)
+    void watch(int fd, uint32_t events, uint64_t tag, int op = EPOLL_CTL_ADD) {
+        epoll_event ev{}; ev.events = events; ev.data.u64 = tag;
+        if (epoll_ctl(ep, op, fd, &ev) != 0) throw runtime_error(string("epoll_ctl: ") + strerror(errno));
+    }
+
+    void open(Conn& c, uint32_t idx) {
+        c.tcp = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        c.udp = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (c.tcp < 0 || c.udp < 0) throw runtime_error(string("socket: ") + strerror(errno) + " (ulimit -n?)");
+        int one = 1; setsockopt(c.tcp, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        sockaddr_in local{}; local.sin_family = AF_INET; local.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        bind(c.udp, (sockaddr*)&local, sizeof(local));
+        if (connect(c.tcp, (const sockaddr*)c.server, sizeof(*c.server)) != 0 && errno != EINPROGRESS) { fail(c); return; }
+        watch(c.tcp, EPOLLOUT, (uint64_t)idx * 2);
+        watch(c.udp, EPOLLIN, (uint64_t)idx * 2 + 1);
+    }
+
+    void fail(Conn& c) {
+        if (c.tcp >= 0) { close(c.tcp); c.tcp = -1; }
+        step.failed.fetch_add(1);
+    }
+
+    // ChatClient 와 같은 순서: TCP 로 닉네임, UDP 로 REGISTER
+    void onConnected(Conn& c, uint32_t idx) {
+        int err = 0; socklen_t len = sizeof(err);
+        getsockopt(c.tcp, SOL_SOCKET, SO_ERROR, &err, &len);
+        if (err != 0) { epoll_ctl(ep, EPOLL_CTL_DEL, c.tcp, nullptr); fail(c); return; }
+        c.connected = true;
+        send(c.tcp, c.name.data(), c.name.size(), MSG_NOSIGNAL);
+        sendRegister(c);
+        watch(c.tcp, EPOLLIN | EPOLLRDHUP, (uint64_t)idx * 2, EPOLL_CTL_MOD);
+        step.connected.fetch_add(1);
+    }
+
+    void sendRegister(Conn& c) {
+        string reg = "REGISTER " + c.name;
+        sendto(c.udp, reg.data(), reg.size(), 0, (const sockaddr*)c.server, sizeof(*c.server));
+    }
+
+    // 받은 글에서 이번 단계의 토큰을 모두 찾아 지연을 기록한다 (서버가 한 번에 읽은 메시지 여러 개가 한 줄에 붙어 올 수 있다)
+    void scan(const char* p, size_t n, int64_t now) {
+        int64_t from = step.windowStart.load(memory_order_relaxed), to = step.windowEnd.load(memory_order_relaxed);
+        for (const char* end = p + n; (p = (const char*)memmem(p, (size_t)(end - p), TOKEN, 3)) != nullptr;) {
+            p += 3;
+            char* q;
+            unsigned long run = strtoul(p, &q, 16);
+            if (q == end || *q != ':' || run != step.run) continue;
+            long long sentAt = strtoll(q + 1, &q, 10);
+            if (q == end || *q != ';') continue;
+            if (sentAt < from || sentAt >= to) continue;
+            ++st.delivered;
+            st.latency.add(now - sentAt);
+        }
+    }
+
+    void readTcp(Conn& c) {
+        char buf[BUF_SIZE];
+        for (int i = 0; i < 4; ++i) {
+            ssize_t r = recv(c.tcp, buf, sizeof(buf), MSG_DONTWAIT);
+            if (r > 0) {
+                int64_t now = nowNs();
+                st.bytes += (uint64_t)r;
+                c.inbuf.append(buf, (size_t)r);
+                size_t nl = c.inbuf.rfind('\n');
+                if (nl == string::npos) continue;
+                scan(c.inbuf.data(), nl + 1, now);
+                c.inbuf.erase(0, nl + 1);
+                continue;
+            }
+            if (r < 0 && (errno == EAGAIN || errno == EINTR)) return;
+            drop(c);   // 서버가 끊었다
+            return;
+        }
+    }
+
+    void drop(Conn& c) {
+        epoll_ctl(ep, EPOLL_CTL_DEL, c.tcp, nullptr);
+        close(c.tcp); c.tcp = -1; c.connected = false;
+        c.out.clear();
+    }
+
+    // 남은 바이트를 보낸다. 다 나가면 EPOLLOUT 을 끈다
+    void flushTcp(Conn& c, uint32_t idx) {
+        while (!c.out.empty()) {
+            ssize_t r = send(c.tcp, c.out.data(), c.out.size(), MSG_NOSIGNAL | MSG_DONTWAIT);
+            if (r > 0) { c.out.erase(0, (size_t)r); continue; }
+            if (r < 0 && (errno == EAGAIN || errno == EINTR)) return;
+            drop(c);
+            return;
+        }
+        watch(c.tcp, EPOLLIN | EPOLLRDHUP, (uint64_t)idx * 2, EPOLL_CTL_MOD);
+    }
+
+    void readUdp(Conn& c) {
+        char buf[BUF_SIZE];
+        for (int i = 0; i < 64; ++i) {
+            ssize_t r = recv(c.udp, buf, sizeof(buf), MSG_DONTWAIT);
+            if (r < 0) return;
+            st.bytes += (uint64_t)r;
+            scan(buf, (size_t)r, nowNs());
+        }
+    }
+
+    void sendOne(Conn& c, uint32_t idx, int64_t now) {
+        bool inWindow = now >= step.windowStart.load(memory_order_relaxed) && now < step.windowEnd.load(memory_order_relaxed);
+        if (!c.out.empty()) { ++st.sendFailed; return; }   // 앞 메시지가 아직 소켓 버퍼에 다 못 들어갔다: 이 메시지는 버린다
+        char tok[64];
+        int n = snprintf(tok, sizeof(tok), "%s%x:%lld;", TOKEN, step.run, (long long)now);
+        payload.assign(tok, (size_t)n);
+        if (payload.size() < step.cfg.size) payload.append(step.cfg.size - payload.size(), 'x');
+        if (step.cfg.udp) {
+            ssize_t r = sendto(c.udp, payload.data(), payload.size(), 0, (const sockaddr*)c.server, sizeof(*c.server));
+            if (r == (ssize_t)payload.size()) { if (inWindow) ++st.sent; }
+            else ++st.sendFailed;
+            return;
+        }
+        ssize_t r = send(c.tcp, payload.data(), payload.size(), MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (r < 0 && errno != EAGAIN && errno != EINTR) { drop(c); ++st.sendFailed; return; }
+        if (r <= 0) { ++st.sendFailed; return; }   // 서버가 못 따라와 소켓 버퍼가 찼다: 이 메시지는 버린다
+        // 일부라도 나갔으면 줄 경계를 지키려고 나머지를 EPOLLOUT 에서 마저 보낸다 (도착하므로 보낸 것으로 센다)
+        if ((size_t)r < payload.size()) {
+            c.out.assign(payload, (size_t)r, string::npos);
+            watch(c.tcp, EPOLLIN | EPOLLRDHUP | EPOLLOUT, (uint64_t)idx * 2, EPOLL_CTL_MOD);
+        }
+        if (inWindow) ++st.sent;
+    }
+
+    void loop() {
+        vector<size_t> senders;
+        for (size_t i = 0; i < conns.size(); ++i) if (conns[i].sender) senders.push_back(i);
+        const int64_t interval = senders.empty() ? 0 : (int64_t)(1e9 / rate);
+        int64_t due = 0;
+        size_t nextSender = 0;
+        // 서버가 등록을 지우지 않도록 CLIENT_UDP_REFRESH 동안 모든 클라이언트가 한 번씩, 한꺼번에 몰리지 않게 하나씩 돌아가며
+        const int64_t refreshEvery = CLIENT_UDP_REFRESH_NS / (int64_t)max<size_t>(1, conns.size());
+        int64_t refreshDue = nowNs() + refreshEvery;
+        size_t nextRefresh = 0;
+        epoll_event evs[MAX_EVENTS];
+
+        while (!step.stopping.load()) {
+            for (int64_t now = nowNs(); !conns.empty() && refreshDue <= now; refreshDue += refreshEvery) {
+                Conn& c = conns[nextRefresh++ % conns.size()];
+                if (c.connected) sendRegister(c);
+            }
+            int timeout = (int)max<int64_t>(0, (refreshDue - nowNs() + 999999) / 1000000);
+            bool sending = step.sending.load() && interval > 0;
+            if (sending) {
+                int64_t now = nowNs();
+                if (due == 0 || now - due > 1000000000LL) { if (due) ++st.late; due = now; }   // 1초 넘게 밀리면 따라잡지 않는다
+                for (; due <= now; due += interval) {
+                    for (size_t k = 0; k < senders.size(); ++k) {
+                        size_t i = senders[nextSender++ % senders.size()];
+                        Conn& c = conns[i];
+                        if (c.connected) { sendOne(c, (uint32_t)i, now); break; }
+                    }
+                }
+                timeout = min(timeout, (int)max<int64_t>(0, (due - nowNs() + 999999) / 1000000));
+            }
+            else due = 0;
+
+            int n = epoll_wait(ep, evs, MAX_EVENTS, timeout);
+            for (int i = 0; i < n; ++i) {
+                uint64_t tag = evs[i].data.u64;
+                if (tag == WAKE_TAG) { uint64_t v; if (read(wake, &v, sizeof(v)) < 0) {} continue; }
+                uint32_t idx = (uint32_t)(tag / 2);
+                Conn& c = conns[idx];
+                if (tag & 1) readUdp(c);
+                else if (c.tcp < 0) continue;
+                else if (!c.connected) onConnected(c, idx);
+                else {
+                    if (evs[i].events & EPOLLOUT) flushTcp(c, idx);
+                    if (c.tcp >= 0 && (evs[i].events & ~(uint32_t)EPOLLOUT)) readTcp(c);
+                }
+            }
+        }
+    }
+};
+
+// ---------------- Run ----------------
+void raiseFdLimit() {
+    rlimit rl{};
+    if (getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur < rl.rlim_max) { rl.rlim_cur = rl.rlim_max; setrlimit(RLIMIT_NOFILE, &rl); }
+}
+
+string formatNs(int64_t ns) {
+    ostringstream oss;
+    if (ns < 10000) oss << ns / 1000.0 << "us";
+    else if (ns < 10000000) oss << ns / 1000 << "us";
+    else oss << fixed << setprecision(1) << ns / 1e6 << "ms";
+    return oss.str();
+}
+
+void runStep(const Config& cfg, int clients, size_t nodes) {
+    Step step;
+    step.cfg = cfg;
+    step.clients = clients;
+    step.run = random_device{}();
+    for (size_t k = 0; k < nodes; ++k) {
+        sockaddr_in a{};
+        a.sin_family = AF_INET;
+        a.sin_port = htons(cfg.ports[k]);
+        if (inet_pton(AF_INET, cfg.host.c_str(), &a.sin_addr) != 1) throw runtime_error("bad --host " + cfg.host);
+        step.servers.push_back(a);
+    }
+
+    int threads = min(cfg.threads, clients), senders = min(cfg.senders, clients);
+    vector<unique_ptr<Worker>> workers;
+    auto t0 = steady_clock::now();
+    for (int w = 0, first = 0; w < threads; ++w) {
+        int count = clients / threads + (w < clients % threads ? 1 : 0);
+        int mySenders = senders / threads + (w < senders % threads ? 1 : 0);
+        workers.emplace_back(new Worker(step, first, count, mySenders, cfg.rate * mySenders / senders));
+        first += count;
+    }
+    for (auto& w : workers) w->start();
+
+    while (step.connected.load() + step.failed.load() < clients && steady_clock::now() - t0 < seconds(30)) this_thread::sleep_for(milliseconds(10));
+    double connectSecs = duration<double>(steady_clock::now() - t0).count();
+    this_thread::sleep_for(milliseconds(300));   // REGISTER 가 닿고 입장 때 재전송되는 기록을 다 받을 때까지
+
+    auto phase = [&](bool sending) { step.sending.store(sending); for (auto& w : workers) w->kick(); };
+    phase(true);
+    this_thread::sleep_for(duration<double>(cfg.warmup));
+    int64_t start = nowNs();
+    step.windowStart.store(start);
+    step.windowEnd.store(start + (int64_t)(cfg.seconds * 1e9));
+    this_thread::sleep_for(duration<double>(cfg.seconds));
+    phase(false);
+    this_thread::sleep_for(seconds(1));          // 측정 구간 끝에 보낸 메시지가 다 도착하도록
+    step.stopping.store(true);
+    for (auto& w : workers) { w->kick(); w->join(); }
+
+    WorkerStats total;
+    for (auto& w : workers) {
+        const WorkerStats& s = w->stats();
+        total.sent += s.sent; total.sendFailed += s.sendFailed; total.delivered += s.delivered; total.bytes += s.bytes; total.late += s.late;
+        total.latency.merge(s.latency);
+    }
+    int connected = step.connected.load();
+    // TCP 방송은 보낸 사람을 빼고, UDP 방송은 등록한 모두에게 간다
+    uint64_t expected = total.sent * (uint64_t)max(0, cfg.udp ? connected : connected - 1);
+    ostringstream oss;
+    oss << fixed << setprecision(1)
+        << (cfg.ports.size() > 1 ? "nodes " + to_string(nodes) + " " : string())
+        << "clients " << setw(5) << clients << " (connected " << connected << ", " << connectSecs << "s)"
+        << " senders " << senders << " " << (cfg.udp ? "udp" : "tcp")
+        << " | sent " << total.sent << " (" << total.sent / cfg.seconds << "/s)";
+    if (total.sendFailed) oss << " send-drop " << total.sendFailed;
+    if (total.late) oss << " rate-behind " << total.late;
+    oss << " | delivered " << total.delivered << " (" << (expected ? 100.0 * total.delivered / expected : 0.0) << "%)"
+        << " " << setprecision(0) << total.delivered / cfg.seconds << " msg/s " << setprecision(1) << total.bytes / cfg.seconds / 1e6 << " MB/s"
+        << " | latency p50 " << formatNs(total.latency.percentile(0.5)) << " p99 " << formatNs(total.latency.percentile(0.99))
+        << " p99.9 " << formatNs(total.latency.percentile(0.999)) << " max " << formatNs(total.latency.maxNs);
+    cout << oss.str() << endl;
+}
+
+int main(int argc, char** argv) {
+    signal(SIGPIPE, SIG_IGN);
+    try {
+        Config cfg = parseArgs(argc, argv);
+        raiseFdLimit();
+        ostringstream ports;
+        for (size_t k = 0; k < cfg.ports.size(); ++k) ports << (k ? "," : "") << cfg.ports[k];
+        cout << "chat-load -> " << cfg.host << ":" << ports.str() << ", " << cfg.rate << " msg/s, " << cfg.size << "B, "
+             << cfg.seconds << "s per step, " << cfg.threads << " thread(s)" << endl;
+        for (size_t nodes = cfg.nodeSweep ? 1 : cfg.ports.size(); nodes <= cfg.ports.size(); ++nodes) {
+            for (int n : cfg.clients) {
+                runStep(cfg, n, nodes);
+                this_thread::sleep_for(milliseconds(500));   // 서버가 이전 단계의 퇴장을 정리하도록
+            }
+        }
+    }
+    catch (const exception& ex) { cerr << "chat-load: " << ex.what() << "\n"; return 1; }
+    return 0;
+}